@@ -20,6 +20,10 @@
 
 #include "group.h"
 #include "vector.h"
+#include "parallel.h"
+#include "grid.h"
+#include "octree.h"
+#include "emitter.h"
 
 static PyTypeObject GravityController_Type;
 
@@ -71,6 +75,19 @@ GravityController_call(GravityControllerObject *self, PyObject *args)
 	return Py_None;
 }
 
+static PyObject *
+GravityController_analytic(GravityControllerObject *self)
+{
+	return Py_BuildValue("s(fff)", "gravity", 
+		self->gravity.x, self->gravity.y, self->gravity.z);
+}
+
+static PyMethodDef GravityController_methods[] = {
+	{"_analytic", (PyCFunction)GravityController_analytic, METH_NOARGS,
+		PyDoc_STR("Return the parameters of the controller for analytic groups")},
+	{NULL,		NULL}		/* sentinel */
+};
+
 PyDoc_STRVAR(GravityController__doc__, 
 	"Imparts a fixed accelleration to all particles\n\n"
 	"Gravity((gx, gy, gz))\n\n"
@@ -108,7 +125,7 @@ static PyTypeObject GravityController_Type = {
 	0,                      /*tp_weaklistoffset*/
 	0,                      /*tp_iter*/
 	0,                      /*tp_iternext*/
-	0,  /*tp_methods*/
+	GravityController_methods,  /*tp_methods*/
 	0,  /*tp_members*/
 	0,                      /*tp_getset*/
 	0,                      /*tp_base*/
@@ -205,6 +222,7 @@ MovementController_call(MovementControllerObject *self, PyObject *args)
 	register Particle *p;
 	Vec3 v;
 	float min_v, min_v_sq, max_v, max_v_sq, v_sq, v_adj;
+	GroupBounds bounds;
 	register unsigned long count;
 
 	if (!PyArg_ParseTuple(args, "fO:__init__", &td, &pgroup))
@@ -222,6 +240,9 @@ MovementController_call(MovementControllerObject *self, PyObject *args)
 	else
 		max_v_sq = FLT_MAX;
 	count = GroupObject_ActiveCount(pgroup);
+	/* Every particle is moved, so recompute the group bounds exactly */
+	GroupBounds_clear(&bounds);
+	bounds.max_size = pgroup->bounds.max_size;
 
 	if (self->damping.x == 1.0f && 
 		self->damping.y == 1.0f && 
@@ -233,6 +254,8 @@ MovementController_call(MovementControllerObject *self, PyObject *args)
 			Vec3_addi(&p->position, &v);
 			Vec3_scalar_mul(&v, &p->rotation, td);
 			Vec3_addi(&p->up, &v);
+			if (Particle_IsAlive(*p))
+				GroupBounds_include(&bounds, &p->position);
 			p++;
 		}
 	} else {
@@ -250,9 +273,12 @@ MovementController_call(MovementControllerObject *self, PyObject *args)
 			Vec3_addi(&p->position, &v);
 			Vec3_scalar_mul(&v, &p->rotation, td);
 			Vec3_addi(&p->up, &v);
+			if (Particle_IsAlive(*p))
+				GroupBounds_include(&bounds, &p->position);
 			p++;
 		}
 	}
+	pgroup->bounds = bounds;
 	
 	Py_INCREF(Py_None);
 	return Py_None;
@@ -268,6 +294,25 @@ static struct PyMemberDef MovementControllerController_members[] = {
 	{NULL}
 };
 
+static PyObject *
+MovementController_analytic(MovementControllerObject *self)
+{
+	if (self->damping.x != 1.0f || self->damping.y != 1.0f 
+		|| self->damping.z != 1.0f || self->min_velocity != 0.0f
+		|| self->max_velocity != FLT_MAX) {
+		PyErr_SetString(PyExc_ValueError, 
+			"Movement with damping or velocity limits is not analytic");
+		return NULL;
+	}
+	return Py_BuildValue("(s)", "movement");
+}
+
+static PyMethodDef MovementController_methods[] = {
+	{"_analytic", (PyCFunction)MovementController_analytic, METH_NOARGS,
+		PyDoc_STR("Return the parameters of the controller for analytic groups")},
+	{NULL,		NULL}		/* sentinel */
+};
+
 PyDoc_STRVAR(MovementController__doc__, 
 	"Updates particle position and velocity\n\n"
 	"Movement(damping=None, min_velocity=None, max_velocity=None)\n\n"
@@ -313,7 +358,7 @@ static PyTypeObject MovementController_Type = {
 	0,                      /*tp_weaklistoffset*/
 	0,                      /*tp_iter*/
 	0,                      /*tp_iternext*/
-	0,  /*tp_methods*/
+	MovementController_methods,  /*tp_methods*/
 	MovementControllerController_members,  /*tp_members*/
 	0,                      /*tp_getset*/
 	0,                      /*tp_base*/
@@ -439,6 +484,20 @@ FaderController_call(FaderControllerObject *self, PyObject *args)
 	return Py_None;
 }
 
+static PyObject *
+FaderController_analytic(FaderControllerObject *self)
+{
+	return Py_BuildValue("s(fffffff)", "fader", self->start_alpha, 
+		self->fade_in_start, self->fade_in_end, self->max_alpha, 
+		self->fade_out_start, self->fade_out_end, self->end_alpha);
+}
+
+static PyMethodDef FaderController_methods[] = {
+	{"_analytic", (PyCFunction)FaderController_analytic, METH_NOARGS,
+		PyDoc_STR("Return the parameters of the controller for analytic groups")},
+	{NULL,		NULL}		/* sentinel */
+};
+
 static PyTypeObject FaderController_Type = {
 	/* The ob_type field must be initialized in the module init function
 	 * to be portable to Windows without using C++. */
@@ -471,7 +530,7 @@ static PyTypeObject FaderController_Type = {
 	0,                      /*tp_weaklistoffset*/
 	0,                      /*tp_iter*/
 	0,                      /*tp_iternext*/
-	0,  /*tp_methods*/
+	FaderController_methods,  /*tp_methods*/
 	FaderControllerController_members,  /*tp_members*/
 	0,                      /*tp_getset*/
 	0,                      /*tp_base*/
@@ -488,110 +547,6 @@ static PyTypeObject FaderController_Type = {
 
 /* --------------------------------------------------------------------- */
 
-static PyTypeObject LifetimeController_Type;
-
-typedef struct {
-	PyObject_HEAD
-	float max_age;
-} LifetimeControllerObject;
-
-static void
-LifetimeController_dealloc(LifetimeControllerObject *self) {
-	PyObject_Del(self);
-}
-
-static int
-LifetimeController_init(LifetimeControllerObject *self, PyObject *args, PyObject *kwargs)
-{
-	static char *kwlist[] = {"max_age", NULL};
-
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "f:__init__", kwlist,
-		&self->max_age))
-		return -1;
-	return 0;
-}
-
-static PyObject *
-LifetimeController_call(LifetimeControllerObject *self, PyObject *args)
-{
-	float td, max_age;
-	GroupObject *pgroup;
-	register Particle *p;
-	register unsigned long count;
-
-	if (!PyArg_ParseTuple(args, "fO:__init__", &td, &pgroup))
-		return NULL;
-	
-	if (!GroupObject_Check(pgroup))
-		return NULL;
-
-	p = pgroup->plist->p;
-	max_age = self->max_age;
-	count = GroupObject_ActiveCount(pgroup);
-	while (count--) {
-		if (p->age > max_age)
-			Group_kill_p(pgroup, p);
-		p++;
-	}
-	
-	Py_INCREF(Py_None);
-	return Py_None;
-}
-
-PyDoc_STRVAR(LifetimeController__doc__, 
-	"Kills particles beyond an age threshold\n\n"
-	"Lifetime(max_age)\n\n"
-	"max_age -- Age threshold, particles older than this are killed.");
-
-static PyTypeObject LifetimeController_Type = {
-	/* The ob_type field must be initialized in the module init function
-	 * to be portable to Windows without using C++. */
-	PyObject_HEAD_INIT(NULL)
-	0,			/*ob_size*/
-	"controller.Lifetime",		/*tp_name*/
-	sizeof(LifetimeControllerObject),	/*tp_basicsize*/
-	0,			/*tp_itemsize*/
-	/* methods */
-	(destructor)LifetimeController_dealloc, /*tp_dealloc*/
-	0,			/*tp_print*/
-	0,          /*tp_getattr*/
-	0,          /*tp_setattr*/
-	0,			/*tp_compare*/
-	0,			/*tp_repr*/
-	0,			/*tp_as_number*/
-	0,	        /*tp_as_sequence*/
-	0,			/*tp_as_mapping*/
-	0,			/*tp_hash*/
-	(ternaryfunc)LifetimeController_call, /*tp_call*/
-	0,                      /*tp_str*/
-	0,                      /*tp_getattro*/
-	0,                      /*tp_setattro*/
-	0,                      /*tp_as_buffer*/
-	Py_TPFLAGS_DEFAULT,     /*tp_flags*/
-	LifetimeController__doc__,   /*tp_doc*/
-	0,                      /*tp_traverse*/
-	0,                      /*tp_clear*/
-	0,                      /*tp_richcompare*/
-	0,                      /*tp_weaklistoffset*/
-	0,                      /*tp_iter*/
-	0,                      /*tp_iternext*/
-	0,  /*tp_methods*/
-	0,  /*tp_members*/
-	0,                      /*tp_getset*/
-	0,                      /*tp_base*/
-	0,                      /*tp_dict*/
-	0,                      /*tp_descr_get*/
-	0,                      /*tp_descr_set*/
-	0,                      /*tp_dictoffset*/
-	(initproc)LifetimeController_init, /*tp_init*/
-	0,                      /*tp_alloc*/
-	0,                      /*tp_new*/
-	0,                      /*tp_free*/
-	0,                      /*tp_is_gc*/
-};
-
-/* --------------------------------------------------------------------- */
-
 static PyTypeObject ColorBlenderController_Type;
 
 typedef struct {
@@ -789,6 +744,20 @@ static struct PyMemberDef ColorBlenderController_members[] = {
 	{NULL}
 };
 
+static PyObject *
+ColorBlenderController_analytic(ColorBlenderControllerObject *self)
+{
+	return Py_BuildValue("sffks#", "color_blender", self->min_age, 
+		self->max_age, self->resolution, (char *)self->gradient, 
+		(int)(self->length * sizeof(Color)));
+}
+
+static PyMethodDef ColorBlenderController_methods[] = {
+	{"_analytic", (PyCFunction)ColorBlenderController_analytic, METH_NOARGS,
+		PyDoc_STR("Return the parameters of the controller for analytic groups")},
+	{NULL,		NULL}		/* sentinel */
+};
+
 PyDoc_STRVAR(ColorBlenderController__doc__, 
 	"Changes particle color over time\n\n"
 	"ColorBlender(color_times, resolution=30)\n\n"
@@ -839,7 +808,7 @@ static PyTypeObject ColorBlenderController_Type = {
 	0,                      /*tp_weaklistoffset*/
 	0,                      /*tp_iter*/
 	0,                      /*tp_iternext*/
-	0,  /*tp_methods*/
+	ColorBlenderController_methods,  /*tp_methods*/
 	ColorBlenderController_members,  /*tp_members*/
 	0,                      /*tp_getset*/
 	0,                      /*tp_base*/
@@ -934,7 +903,7 @@ GrowthController_init(GrowthControllerObject *self, PyObject *args, PyObject *kw
 static PyObject *
 GrowthController_call(GrowthControllerObject *self, PyObject *args)
 {
-	float td;
+	float td, grow;
 	GroupObject *pgroup;
 	register Particle *p;
 	Vec3 g;
@@ -955,12 +924,36 @@ GrowthController_call(GrowthControllerObject *self, PyObject *args)
 		Vec3_addi(&p->size, &g);
 		p++;
 	}
+	/* Every particle grows by the same amount */
+	grow = g.x > g.y ? g.x : g.y;
+	grow = g.z > grow ? g.z : grow;
+	if (grow > 0.0f)
+		pgroup->bounds.max_size += grow;
 	Vec3_muli(&self->growth, &self->damping);
 	
 	Py_INCREF(Py_None);
 	return Py_None;
 }
 
+static PyObject *
+GrowthController_analytic(GrowthControllerObject *self)
+{
+	if (self->damping.x != 1.0f || self->damping.y != 1.0f 
+		|| self->damping.z != 1.0f) {
+		PyErr_SetString(PyExc_ValueError, 
+			"Growth with damping is not analytic");
+		return NULL;
+	}
+	return Py_BuildValue("s(fff)", "growth", 
+		self->growth.x, self->growth.y, self->growth.z);
+}
+
+static PyMethodDef GrowthController_methods[] = {
+	{"_analytic", (PyCFunction)GrowthController_analytic, METH_NOARGS,
+		PyDoc_STR("Return the parameters of the controller for analytic groups")},
+	{NULL,		NULL}		/* sentinel */
+};
+
 PyDoc_STRVAR(GrowthController__doc__, 
 	"Changes the size of particles over time\n\n"
 	"Growth(growth, damping=1.0)\n\n"
@@ -1001,7 +994,7 @@ static PyTypeObject GrowthController_Type = {
 	0,                      /*tp_weaklistoffset*/
 	0,                      /*tp_iter*/
 	0,                      /*tp_iternext*/
-	0,  /*tp_methods*/
+	GrowthController_methods,  /*tp_methods*/
 	0,  /*tp_members*/
 	0,                      /*tp_getset*/
 	0,                      /*tp_base*/
@@ -1018,135 +1011,455 @@ static PyTypeObject GrowthController_Type = {
 
 /* --------------------------------------------------------------------- */
 
-static PyTypeObject CollectorController_Type;
+/* Compact record of a particle event, delivered to event buffer callbacks.
+ * Vec3 is padded for alignment, so plain float arrays are used here to
+ * keep the records tightly packed for the buffer interface.
+ */
+typedef struct {
+	unsigned int index;  /* Index of the particle in the group */
+	float point[3];
+	float normal[3];
+	float velocity[3];
+} ParticleEvent;
+
+#define EVENT_FORMAT "=I9f"
+
+static PyTypeObject EventBuffer_Type;
 
 typedef struct {
 	PyObject_HEAD
-	PyObject *domain;
-	int collect_inside;
-	int collected_count;
-	PyObject *callback;
-} CollectorControllerObject;
+	unsigned long count;
+	unsigned long alloc;
+	ParticleEvent *events;
+} EventBufferObject;
 
 static void
-CollectorController_dealloc(CollectorControllerObject *self) {
-	if (self->domain !=NULL)
-		Py_CLEAR(self->domain);
-	if (self->callback !=NULL)
-		Py_CLEAR(self->callback);
+EventBuffer_dealloc(EventBufferObject *self) {
+	PyMem_Free(self->events);
 	PyObject_Del(self);
 }
 
+/* Return the buffer stored in *buf emptied and ready to be appended to. If
+ * anything else still refers to the buffer from a previous call, it is
+ * left alone and a new buffer replaces it, so that events already
+ * delivered are never overwritten. Return NULL on failure with an
+ * exception set.
+ */
+static EventBufferObject *
+EventBuffer_reset(EventBufferObject **buf)
+{
+	if (*buf == NULL || Py_REFCNT(*buf) > 1) {
+		Py_CLEAR(*buf);
+		*buf = PyObject_New(EventBufferObject, &EventBuffer_Type);
+		if (*buf == NULL)
+			return NULL;
+		(*buf)->alloc = 0;
+		(*buf)->events = NULL;
+	}
+	(*buf)->count = 0;
+	return *buf;
+}
+
+static inline void
+Event_set(float *dst, Vec3 *src)
+{
+	dst[0] = src->x;
+	dst[1] = src->y;
+	dst[2] = src->z;
+}
+
+/* Append an event for particle p of group to the buffer. Return true on
+ * success, false on failure with an exception set.
+ */
 static int
-CollectorController_init(CollectorControllerObject *self, PyObject *args, PyObject *kwargs)
+EventBuffer_append(EventBufferObject *self, GroupObject *group, Particle *p,
+	Vec3 *point, Vec3 *normal)
 {
-	static char *kwlist[] = {"domain", "collect_inside", "callback", NULL};
+	ParticleEvent *e;
+	unsigned long alloc;
+
+	if (self->count >= self->alloc) {
+		alloc = self->alloc ? self->alloc * 2 : 64;
+		e = PyMem_Realloc(self->events, sizeof(ParticleEvent) * alloc);
+		if (e == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+		self->events = e;
+		self->alloc = alloc;
+	}
+	e = &self->events[self->count++];
+	e->index = (unsigned int)(p - group->plist->p);
+	Event_set(e->point, point);
+	Event_set(e->normal, normal);
+	Event_set(e->velocity, &p->velocity);
+	return 1;
+}
 
-	self->callback = NULL;
-	self->collect_inside = 1;
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|iO:__init__", kwlist,
-		&self->domain, &self->collect_inside, &self->callback))
-		return -1;
-	Py_INCREF(self->domain);
-	if (self->callback != NULL)
-		Py_INCREF(self->callback);
-	self->collected_count = 0;
-	return 0;
+/* Call callback(events, group, controller) if any events were recorded.
+ * Return true on success, false on failure with an exception set.
+ */
+static int
+EventBuffer_deliver(EventBufferObject *self, PyObject *callback,
+	GroupObject *group, PyObject *controller)
+{
+	PyObject *result;
+
+	if (self->count == 0)
+		return 1;
+	result = PyObject_CallFunctionObjArgs(callback, (PyObject *)self,
+		(PyObject *)group, controller, NULL);
+	if (result == NULL)
+		return 0;
+	Py_DECREF(result);
+	return 1;
+}
+
+static Py_ssize_t
+EventBuffer_length(EventBufferObject *self)
+{
+	return self->count;
 }
 
 static PyObject *
-CollectorController_call(CollectorControllerObject *self, PyObject *args)
+EventBuffer_item(EventBufferObject *self, Py_ssize_t i)
 {
-	float td;
-	GroupObject *pgroup;
-	VectorObject *vector = NULL;
-	ParticleRefObject *particleref = NULL;
-	PyObject *result;
-	int in_domain, collect_inside;
-	register Particle *p;
-	register unsigned long count;
+	ParticleEvent *e;
 
-	if (!PyArg_ParseTuple(args, "fO:__init__", &td, &pgroup))
-		return NULL;
-	
-	if (!GroupObject_Check(pgroup))
+	if (i < 0 || i >= (Py_ssize_t)self->count) {
+		PyErr_SetString(PyExc_IndexError, "index out of range");
 		return NULL;
+	}
+	e = &self->events[i];
+	return Py_BuildValue("I(fff)(fff)(fff)", e->index,
+		e->point[0], e->point[1], e->point[2],
+		e->normal[0], e->normal[1], e->normal[2],
+		e->velocity[0], e->velocity[1], e->velocity[2]);
+}
 
-	collect_inside = self->collect_inside ? 1 : 0;
-	p = pgroup->plist->p;
-	count = GroupObject_ActiveCount(pgroup);
-	vector = Vector_new(NULL, &p->position, 3);
-	particleref = ParticleRefObject_New((PyObject *)pgroup, p);
-	if (vector == NULL || particleref == NULL)
-		goto error;
-	while (count--) {
-		vector->vec = &p->position;
-		in_domain = PySequence_Contains(self->domain, (PyObject *)vector);
-		if (in_domain == -1)
-			goto error;
-		if (Particle_IsAlive(*p) && (in_domain == collect_inside)) {
-			if (self->callback != NULL && self->callback != Py_None) {
-				particleref->p = p;
-				result = PyObject_CallFunctionObjArgs(
-					self->callback, (PyObject *)particleref, (PyObject *)pgroup, 
-					(PyObject *)self, NULL);
-				if (result == NULL) {
-					goto error;
-				}
-				Py_DECREF(result);
-			}
-			Group_kill_p(pgroup, p);
-			self->collected_count++;
-		}
-		p++;
+static PySequenceMethods EventBuffer_as_sequence = {
+	(lenfunc)EventBuffer_length,	/* sq_length */
+	0,		/*sq_concat*/
+	0,		/*sq_repeat*/
+	(ssizeargfunc)EventBuffer_item,		/*sq_item*/
+};
+
+static Py_ssize_t
+EventBuffer_getreadbuf(EventBufferObject *self, Py_ssize_t segment, void **ptr)
+{
+	if (segment != 0) {
+		PyErr_SetString(PyExc_SystemError, "accessing non-existent segment");
+		return -1;
 	}
-	Py_DECREF(particleref);
-	Py_DECREF(vector);
-	
-	Py_INCREF(Py_None);
-	return Py_None;
+	*ptr = (void *)self->events;
+	return self->count * sizeof(ParticleEvent);
+}
 
-error:
-	Py_XDECREF(particleref);
-	Py_XDECREF(vector);
-	return NULL;
+static Py_ssize_t
+EventBuffer_getsegcount(EventBufferObject *self, Py_ssize_t *lenp)
+{
+	if (lenp != NULL)
+		*lenp = self->count * sizeof(ParticleEvent);
+	return 1;
 }
 
-static struct PyMemberDef CollectorController_members[] = {
-    {"collect_inside", T_INT, offsetof(CollectorControllerObject, collect_inside), 0,
-        "True to collect particles inside the domain, False "
-		"to collect particles outside the domain."},
-    {"domain", T_OBJECT, offsetof(CollectorControllerObject, domain), 0,
-        "Particles inside or outside this domain are killed depending "
-		"on the value of collect_inside"},
-    {"callback", T_OBJECT, offsetof(CollectorControllerObject, callback), 0,
-        "A function called called for each collected particle, or None\n"
-		"Must have the signature:\n"
-		"    callback(particle, group, collector)"},
-    {"collected_count", T_INT, offsetof(CollectorControllerObject, collected_count), 0,
-        "Total number of particles collected"},
-	{NULL}
+static int
+EventBuffer_getbuffer(EventBufferObject *self, Py_buffer *view, int flags)
+{
+	return PyBuffer_FillInfo(view, (PyObject *)self, (void *)self->events,
+		self->count * sizeof(ParticleEvent), 1, flags);
+}
+
+static PyBufferProcs EventBuffer_as_buffer = {
+	(readbufferproc)EventBuffer_getreadbuf,	/*bf_getreadbuffer*/
+	0,		/*bf_getwritebuffer*/
+	(segcountproc)EventBuffer_getsegcount,	/*bf_getsegcount*/
+	(charbufferproc)EventBuffer_getreadbuf,	/*bf_getcharbuffer*/
+	(getbufferproc)EventBuffer_getbuffer,	/*bf_getbuffer*/
+	0,		/*bf_releasebuffer*/
 };
 
-PyDoc_STRVAR(CollectorController__doc__, 
-	"domain -- particles inside or outside this domain are killed.\n"
-	"The domain must have a non-zero volume.\n\n"
-	"collect_inside -- True to collect particles inside the domain, False\n"
-	"to collect particles outside the domain.\n\n"
-	"callback -- an optional function called for each collected particle\n"
-	"Must have the signature:\n"
-	"    callback(particle, group, collector)");
+static PyObject *
+EventBuffer_get_format(EventBufferObject *self, void *closure)
+{
+	return PyString_FromString(EVENT_FORMAT);
+}
 
-static PyTypeObject CollectorController_Type = {
+static PyObject *
+EventBuffer_get_itemsize(EventBufferObject *self, void *closure)
+{
+	return PyInt_FromLong(sizeof(ParticleEvent));
+}
+
+static PyGetSetDef EventBuffer_descriptors[] = {
+	{"format", (getter)EventBuffer_get_format, NULL,
+		"The struct module format of each event record", NULL},
+	{"itemsize", (getter)EventBuffer_get_itemsize, NULL,
+		"The size of each event record in bytes", NULL},
+	{NULL}
+};
+
+PyDoc_STRVAR(EventBuffer__doc__, 
+	"Particle events recorded by a controller in one call, passed to its\n"
+	"callback when created with event_buffer=True.\n\n"
+	"Indexing the buffer returns (index, point, normal, velocity) tuples,\n"
+	"where index is the index of the particle in the group. The raw records\n"
+	"are also available through the buffer interface, packed in the struct\n"
+	"format given by the format attribute, one every itemsize bytes.\n\n"
+	"The buffer is reused by the controller on its next call unless a\n"
+	"reference to it is kept.");
+
+static PyTypeObject EventBuffer_Type = {
 	/* The ob_type field must be initialized in the module init function
 	 * to be portable to Windows without using C++. */
 	PyObject_HEAD_INIT(NULL)
 	0,			/*ob_size*/
-	"controller.Collector",		/*tp_name*/
-	sizeof(CollectorControllerObject),	/*tp_basicsize*/
+	"controller.EventBuffer",		/*tp_name*/
+	sizeof(EventBufferObject),	/*tp_basicsize*/
 	0,			/*tp_itemsize*/
 	/* methods */
-	(destructor)CollectorController_dealloc, /*tp_dealloc*/
+	(destructor)EventBuffer_dealloc, /*tp_dealloc*/
+	0,			/*tp_print*/
+	0,          /*tp_getattr*/
+	0,          /*tp_setattr*/
+	0,			/*tp_compare*/
+	0,			/*tp_repr*/
+	0,			/*tp_as_number*/
+	&EventBuffer_as_sequence,	/*tp_as_sequence*/
+	0,			/*tp_as_mapping*/
+	0,			/*tp_hash*/
+	0,			/*tp_call*/
+	0,                      /*tp_str*/
+	0,                      /*tp_getattro*/
+	0,                      /*tp_setattro*/
+	&EventBuffer_as_buffer,	/*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_HAVE_NEWBUFFER, /*tp_flags*/
+	EventBuffer__doc__,   /*tp_doc*/
+	0,                      /*tp_traverse*/
+	0,                      /*tp_clear*/
+	0,                      /*tp_richcompare*/
+	0,                      /*tp_weaklistoffset*/
+	0,                      /*tp_iter*/
+	0,                      /*tp_iternext*/
+	0,  /*tp_methods*/
+	0,  /*tp_members*/
+	EventBuffer_descriptors,	/*tp_getset*/
+	0,                      /*tp_base*/
+	0,                      /*tp_dict*/
+	0,                      /*tp_descr_get*/
+	0,                      /*tp_descr_set*/
+	0,                      /*tp_dictoffset*/
+	0,                      /*tp_init*/
+	0,                      /*tp_alloc*/
+	0,                      /*tp_new*/
+	0,                      /*tp_free*/
+	0,                      /*tp_is_gc*/
+};
+
+/* A StaticEmitter spawning particles at the events of a controller */
+typedef struct {
+	PyObject *emitter;
+	PyObject *group; /* Target group, NULL for the controlled group */
+	int count;       /* Particles emitted per event */
+} SubEmitter;
+
+static int
+SubEmitter_init(SubEmitter *self, PyObject *emitter, PyObject *group, int count)
+{
+	EmitterAPI *api;
+
+	self->emitter = NULL;
+	self->group = NULL;
+	self->count = count;
+	if (emitter == NULL || emitter == Py_None)
+		return 1;
+	api = EmitterAPI_get();
+	if (api == NULL)
+		return 0;
+	if (!api->check(emitter)) {
+		PyErr_SetString(PyExc_TypeError, "sub_emitter must be a StaticEmitter");
+		return 0;
+	}
+	if (group == Py_None)
+		group = NULL;
+	if (group != NULL && !GroupObject_Check((GroupObject *)group))
+		return 0;
+	if (count < 0) {
+		PyErr_SetString(PyExc_ValueError, "sub_count must be >= 0");
+		return 0;
+	}
+	Py_INCREF(emitter);
+	self->emitter = emitter;
+	Py_XINCREF(group);
+	self->group = group;
+	return 1;
+}
+
+static void
+SubEmitter_clear(SubEmitter *self)
+{
+	Py_CLEAR(self->emitter);
+	Py_CLEAR(self->group);
+}
+
+/* Emit the sub-emitter's particles for each event recorded for pgroup.
+ * Return true on success, false on failure with an exception set.
+ */
+static int
+SubEmitter_spawn(SubEmitter *self, EventBufferObject *events, GroupObject *pgroup)
+{
+	EmitterAPI *api;
+	ParticleEvent *e;
+	GroupObject *target;
+	Vec3 position, velocity;
+	unsigned long i;
+
+	if (self->emitter == NULL || self->count == 0)
+		return 1;
+	api = EmitterAPI_get();
+	if (api == NULL)
+		return 0;
+	target = self->group != NULL ? (GroupObject *)self->group : pgroup;
+	for (i = 0; i < events->count; i++) {
+		e = &events->events[i];
+		position.x = e->point[0];
+		position.y = e->point[1];
+		position.z = e->point[2];
+		velocity.x = e->velocity[0];
+		velocity.y = e->velocity[1];
+		velocity.z = e->velocity[2];
+		if (!api->emit_from(self->emitter, target, self->count, &position, &velocity))
+			return 0;
+	}
+	return 1;
+}
+
+/* --------------------------------------------------------------------- */
+
+static PyTypeObject LifetimeController_Type;
+
+typedef struct {
+	PyObject_HEAD
+	float max_age;
+	EventBufferObject *events;
+	SubEmitter sub;
+} LifetimeControllerObject;
+
+static void
+LifetimeController_dealloc(LifetimeControllerObject *self) {
+	Py_CLEAR(self->events);
+	SubEmitter_clear(&self->sub);
+	PyObject_Del(self);
+}
+
+static int
+LifetimeController_init(LifetimeControllerObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = {"max_age", "sub_emitter", "sub_group", "sub_count", NULL};
+	PyObject *sub_emitter = NULL, *sub_group = NULL;
+	int sub_count = 1;
+
+	SubEmitter_clear(&self->sub);
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "f|OOi:__init__", kwlist,
+		&self->max_age, &sub_emitter, &sub_group, &sub_count))
+		return -1;
+	if (!SubEmitter_init(&self->sub, sub_emitter, sub_group, sub_count))
+		return -1;
+	return 0;
+}
+
+static PyObject *
+LifetimeController_call(LifetimeControllerObject *self, PyObject *args)
+{
+	float td, max_age;
+	GroupObject *pgroup;
+	EventBufferObject *events = NULL;
+	Vec3 no_normal = {0.0f, 0.0f, 0.0f};
+	register Particle *p;
+	register unsigned long count;
+
+	if (!PyArg_ParseTuple(args, "fO:__init__", &td, &pgroup))
+		return NULL;
+	
+	if (!GroupObject_Check(pgroup))
+		return NULL;
+
+	if (self->sub.emitter != NULL) {
+		events = EventBuffer_reset(&self->events);
+		if (events == NULL)
+			return NULL;
+	}
+	p = pgroup->plist->p;
+	max_age = self->max_age;
+	count = GroupObject_ActiveCount(pgroup);
+	while (count--) {
+		if (p->age > max_age) {
+			if (events != NULL &&
+				!EventBuffer_append(events, pgroup, p, &p->position, &no_normal))
+				return NULL;
+			Group_kill_p(pgroup, p);
+		}
+		p++;
+	}
+	/* Emit after the loop, since emitting may reallocate the particles */
+	if (events != NULL && !SubEmitter_spawn(&self->sub, events, pgroup))
+		return NULL;
+	
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static PyObject *
+LifetimeController_analytic(LifetimeControllerObject *self)
+{
+	if (self->sub.emitter != NULL) {
+		PyErr_SetString(PyExc_TypeError,
+			"Lifetime controllers with a sub_emitter are not supported by analytic groups");
+		return NULL;
+	}
+	return Py_BuildValue("sf", "lifetime", self->max_age);
+}
+
+static PyMethodDef LifetimeController_methods[] = {
+	{"_analytic", (PyCFunction)LifetimeController_analytic, METH_NOARGS,
+		PyDoc_STR("Return the parameters of the controller for analytic groups")},
+	{NULL,		NULL}		/* sentinel */
+};
+
+PyDoc_STRVAR(LifetimeController__doc__, 
+	"Kills particles beyond an age threshold\n\n"
+	"Lifetime(max_age, sub_emitter=None, sub_group=None, sub_count=1)\n\n"
+	"max_age -- Age threshold, particles older than this are killed.\n\n"
+	"sub_emitter -- An optional StaticEmitter that emits sub_count particles\n"
+	"at the position of each particle killed, with its template velocity\n"
+	"offset by the killed particle's velocity. Lifetime controllers with a\n"
+	"sub_emitter cannot be used with analytic groups.\n\n"
+	"sub_group -- The group the sub_emitter emits into, the group being\n"
+	"controlled if omitted.\n\n"
+	"sub_count -- The number of particles emitted for each killed particle.");
+
+static struct PyMemberDef LifetimeController_members[] = {
+	{"max_age", T_FLOAT, offsetof(LifetimeControllerObject, max_age), 0,
+		"Age threshold, particles older than this are killed"},
+	{"sub_emitter", T_OBJECT, offsetof(LifetimeControllerObject, sub.emitter), READONLY,
+		"StaticEmitter that emits particles where each particle dies, or None"},
+	{"sub_group", T_OBJECT, offsetof(LifetimeControllerObject, sub.group), READONLY,
+		"Group the sub_emitter emits into, or None for the controlled group"},
+	{"sub_count", T_INT, offsetof(LifetimeControllerObject, sub.count), READONLY,
+		"Number of particles emitted by the sub_emitter for each particle killed"},
+	{NULL}
+};
+
+static PyTypeObject LifetimeController_Type = {
+	/* The ob_type field must be initialized in the module init function
+	 * to be portable to Windows without using C++. */
+	PyObject_HEAD_INIT(NULL)
+	0,			/*ob_size*/
+	"controller.Lifetime",		/*tp_name*/
+	sizeof(LifetimeControllerObject),	/*tp_basicsize*/
+	0,			/*tp_itemsize*/
+	/* methods */
+	(destructor)LifetimeController_dealloc, /*tp_dealloc*/
 	0,			/*tp_print*/
 	0,          /*tp_getattr*/
 	0,          /*tp_setattr*/
@@ -1156,28 +1469,28 @@ static PyTypeObject CollectorController_Type = {
 	0,	        /*tp_as_sequence*/
 	0,			/*tp_as_mapping*/
 	0,			/*tp_hash*/
-	(ternaryfunc)CollectorController_call, /*tp_call*/
+	(ternaryfunc)LifetimeController_call, /*tp_call*/
 	0,                      /*tp_str*/
 	0,                      /*tp_getattro*/
 	0,                      /*tp_setattro*/
 	0,                      /*tp_as_buffer*/
 	Py_TPFLAGS_DEFAULT,     /*tp_flags*/
-	CollectorController__doc__,   /*tp_doc*/
+	LifetimeController__doc__,   /*tp_doc*/
 	0,                      /*tp_traverse*/
 	0,                      /*tp_clear*/
 	0,                      /*tp_richcompare*/
 	0,                      /*tp_weaklistoffset*/
 	0,                      /*tp_iter*/
 	0,                      /*tp_iternext*/
-	0,  /*tp_methods*/
-	CollectorController_members,  /*tp_members*/
+	LifetimeController_methods,  /*tp_methods*/
+	LifetimeController_members,  /*tp_members*/
 	0,                      /*tp_getset*/
 	0,                      /*tp_base*/
 	0,                      /*tp_dict*/
 	0,                      /*tp_descr_get*/
 	0,                      /*tp_descr_set*/
 	0,                      /*tp_dictoffset*/
-	(initproc)CollectorController_init, /*tp_init*/
+	(initproc)LifetimeController_init, /*tp_init*/
 	0,                      /*tp_alloc*/
 	0,                      /*tp_new*/
 	0,                      /*tp_free*/
@@ -1186,58 +1499,1159 @@ static PyTypeObject CollectorController_Type = {
 
 /* --------------------------------------------------------------------- */
 
-static PyTypeObject BounceController_Type;
+static PyTypeObject CollectorController_Type;
 
 typedef struct {
 	PyObject_HEAD
 	PyObject *domain;
-	float bounce;
-	float friction;
-	int bounce_limit;
+	int collect_inside;
+	int collected_count;
 	PyObject *callback;
-} BounceControllerObject;
+	int event_buffer;
+	EventBufferObject *events;
+	SubEmitter sub;
+} CollectorControllerObject;
 
 static void
-BounceController_dealloc(BounceControllerObject *self) {
+CollectorController_dealloc(CollectorControllerObject *self) {
 	if (self->domain !=NULL)
 		Py_CLEAR(self->domain);
 	if (self->callback !=NULL)
 		Py_CLEAR(self->callback);
+	Py_CLEAR(self->events);
+	SubEmitter_clear(&self->sub);
 	PyObject_Del(self);
 }
 
 static int
-BounceController_init(BounceControllerObject *self, PyObject *args, PyObject *kwargs)
+CollectorController_init(CollectorControllerObject *self, PyObject *args, PyObject *kwargs)
 {
-	static char *kwlist[] = {"domain", "bounce", "friction", "bounce_limit", "callback", NULL};
+	static char *kwlist[] = {"domain", "collect_inside", "callback", "event_buffer", 
+		"sub_emitter", "sub_group", "sub_count", NULL};
+	PyObject *sub_emitter = NULL, *sub_group = NULL;
+	int sub_count = 1;
 
+	SubEmitter_clear(&self->sub);
 	self->callback = NULL;
-	self->bounce = 1.0f;
-	self->friction = 0.0f;
-	self->bounce_limit = 5;
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ffiO:__init__", kwlist,
-		&self->domain, &self->bounce, &self->friction, &self->bounce_limit, &self->callback))
+	self->collect_inside = 1;
+	self->event_buffer = 0;
+	self->events = NULL;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|iOiOOi:__init__", kwlist,
+		&self->domain, &self->collect_inside, &self->callback, &self->event_buffer,
+		&sub_emitter, &sub_group, &sub_count)) {
+		/* Parsing may have stored borrowed references before failing */
+		self->domain = NULL;
+		self->callback = NULL;
 		return -1;
+	}
 	Py_INCREF(self->domain);
-	if (self->callback != NULL)
-		Py_INCREF(self->callback);
+	Py_XINCREF(self->callback);
+	self->collected_count = 0;
+	if (!SubEmitter_init(&self->sub, sub_emitter, sub_group, sub_count))
+		return -1;
 	return 0;
 }
 
 static PyObject *
-BounceController_call(BounceControllerObject *self, PyObject *args)
+CollectorController_call(CollectorControllerObject *self, PyObject *args)
+{
+	float td;
+	GroupObject *pgroup;
+	VectorObject *vector = NULL;
+	ParticleRefObject *particleref = NULL;
+	EventBufferObject *events = NULL;
+	PyObject *result;
+	int in_domain, collect_inside, has_callback;
+	Vec3 no_normal = {0.0f, 0.0f, 0.0f};
+	register Particle *p;
+	register unsigned long count;
+
+	if (!PyArg_ParseTuple(args, "fO:__init__", &td, &pgroup))
+		return NULL;
+	
+	if (!GroupObject_Check(pgroup))
+		return NULL;
+
+	collect_inside = self->collect_inside ? 1 : 0;
+	has_callback = self->callback != NULL && self->callback != Py_None;
+	p = pgroup->plist->p;
+	count = GroupObject_ActiveCount(pgroup);
+	vector = Vector_new(NULL, &p->position, 3);
+	particleref = ParticleRefObject_New((PyObject *)pgroup, p);
+	if (vector == NULL || particleref == NULL)
+		goto error;
+	if ((has_callback && self->event_buffer) || self->sub.emitter != NULL) {
+		events = EventBuffer_reset(&self->events);
+		if (events == NULL)
+			goto error;
+	}
+	while (count--) {
+		vector->vec = &p->position;
+		in_domain = PySequence_Contains(self->domain, (PyObject *)vector);
+		if (in_domain == -1)
+			goto error;
+		if (Particle_IsAlive(*p) && (in_domain == collect_inside)) {
+			if (events != NULL &&
+				!EventBuffer_append(events, pgroup, p, &p->position, &no_normal))
+				goto error;
+			if (has_callback && !self->event_buffer) {
+				particleref->p = p;
+				result = PyObject_CallFunctionObjArgs(
+					self->callback, (PyObject *)particleref, (PyObject *)pgroup, 
+					(PyObject *)self, NULL);
+				if (result == NULL) {
+					goto error;
+				}
+				Py_DECREF(result);
+			}
+			Group_kill_p(pgroup, p);
+			self->collected_count++;
+		}
+		p++;
+	}
+	if (events != NULL && !SubEmitter_spawn(&self->sub, events, pgroup))
+		goto error;
+	if (events != NULL && has_callback && self->event_buffer && 
+		!EventBuffer_deliver(events, self->callback, pgroup, (PyObject *)self))
+		goto error;
+	Py_DECREF(particleref);
+	Py_DECREF(vector);
+	
+	Py_INCREF(Py_None);
+	return Py_None;
+
+error:
+	Py_XDECREF(particleref);
+	Py_XDECREF(vector);
+	return NULL;
+}
+
+static struct PyMemberDef CollectorController_members[] = {
+    {"collect_inside", T_INT, offsetof(CollectorControllerObject, collect_inside), 0,
+        "True to collect particles inside the domain, False "
+		"to collect particles outside the domain."},
+    {"domain", T_OBJECT, offsetof(CollectorControllerObject, domain), 0,
+        "Particles inside or outside this domain are killed depending "
+		"on the value of collect_inside"},
+    {"callback", T_OBJECT, offsetof(CollectorControllerObject, callback), 0,
+        "A function called called for each collected particle, or None\n"
+		"Must have the signature:\n"
+		"    callback(particle, group, collector)\n"
+		"or if event_buffer is true:\n"
+		"    callback(events, group, collector)"},
+	{"event_buffer", T_INT, offsetof(CollectorControllerObject, event_buffer), 0,
+		"True to pass the callback all of the particles collected in a call\n"
+		"at once as an EventBuffer, instead of calling it for each one."},
+	{"sub_emitter", T_OBJECT, offsetof(CollectorControllerObject, sub.emitter), READONLY,
+		"StaticEmitter that emits particles where each particle is collected, or None"},
+	{"sub_group", T_OBJECT, offsetof(CollectorControllerObject, sub.group), READONLY,
+		"Group the sub_emitter emits into, or None for the collected group"},
+	{"sub_count", T_INT, offsetof(CollectorControllerObject, sub.count), READONLY,
+		"Number of particles emitted by the sub_emitter for each collected particle"},
+    {"collected_count", T_INT, offsetof(CollectorControllerObject, collected_count), 0,
+        "Total number of particles collected"},
+	{NULL}
+};
+
+PyDoc_STRVAR(CollectorController__doc__, 
+	"domain -- particles inside or outside this domain are killed.\n"
+	"The domain must have a non-zero volume.\n\n"
+	"collect_inside -- True to collect particles inside the domain, False\n"
+	"to collect particles outside the domain.\n\n"
+	"callback -- an optional function called for each collected particle\n"
+	"Must have the signature:\n"
+	"    callback(particle, group, collector)\n\n"
+	"event_buffer -- if true, the callback is instead called once per call\n"
+	"of the controller with all of the particles it collected:\n"
+	"    callback(events, group, collector)\n"
+	"events is an EventBuffer. The event point is the particle's position,\n"
+	"its normal is zero. The callback is not called if nothing was collected.\n\n"
+	"sub_emitter -- an optional StaticEmitter that emits sub_count particles\n"
+	"into sub_group for each collected particle, without calling into\n"
+	"Python. The position and velocity of the emitted particles are\n"
+	"relative to those of the collected particle. If sub_group is None,\n"
+	"the particles are emitted into the group being collected from.");
+
+static PyTypeObject CollectorController_Type = {
+	/* The ob_type field must be initialized in the module init function
+	 * to be portable to Windows without using C++. */
+	PyObject_HEAD_INIT(NULL)
+	0,			/*ob_size*/
+	"controller.Collector",		/*tp_name*/
+	sizeof(CollectorControllerObject),	/*tp_basicsize*/
+	0,			/*tp_itemsize*/
+	/* methods */
+	(destructor)CollectorController_dealloc, /*tp_dealloc*/
+	0,			/*tp_print*/
+	0,          /*tp_getattr*/
+	0,          /*tp_setattr*/
+	0,			/*tp_compare*/
+	0,			/*tp_repr*/
+	0,			/*tp_as_number*/
+	0,	        /*tp_as_sequence*/
+	0,			/*tp_as_mapping*/
+	0,			/*tp_hash*/
+	(ternaryfunc)CollectorController_call, /*tp_call*/
+	0,                      /*tp_str*/
+	0,                      /*tp_getattro*/
+	0,                      /*tp_setattro*/
+	0,                      /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+	CollectorController__doc__,   /*tp_doc*/
+	0,                      /*tp_traverse*/
+	0,                      /*tp_clear*/
+	0,                      /*tp_richcompare*/
+	0,                      /*tp_weaklistoffset*/
+	0,                      /*tp_iter*/
+	0,                      /*tp_iternext*/
+	0,  /*tp_methods*/
+	CollectorController_members,  /*tp_members*/
+	0,                      /*tp_getset*/
+	0,                      /*tp_base*/
+	0,                      /*tp_dict*/
+	0,                      /*tp_descr_get*/
+	0,                      /*tp_descr_set*/
+	0,                      /*tp_dictoffset*/
+	(initproc)CollectorController_init, /*tp_init*/
+	0,                      /*tp_alloc*/
+	0,                      /*tp_new*/
+	0,                      /*tp_free*/
+	0,                      /*tp_is_gc*/
+};
+
+/* --------------------------------------------------------------------- */
+
+static PyTypeObject BounceController_Type;
+
+typedef struct {
+	PyObject_HEAD
+	PyObject *domain;
+	float bounce;
+	float friction;
+	int bounce_limit;
+	PyObject *callback;
+	int event_buffer;
+	EventBufferObject *events;
+	SubEmitter sub;
+} BounceControllerObject;
+
+static void
+BounceController_dealloc(BounceControllerObject *self) {
+	if (self->domain !=NULL)
+		Py_CLEAR(self->domain);
+	if (self->callback !=NULL)
+		Py_CLEAR(self->callback);
+	Py_CLEAR(self->events);
+	SubEmitter_clear(&self->sub);
+	PyObject_Del(self);
+}
+
+static int
+BounceController_init(BounceControllerObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = {"domain", "bounce", "friction", "bounce_limit", "callback", 
+		"event_buffer", "sub_emitter", "sub_group", "sub_count", NULL};
+	PyObject *sub_emitter = NULL, *sub_group = NULL;
+	int sub_count = 1;
+
+	SubEmitter_clear(&self->sub);
+	self->callback = NULL;
+	self->bounce = 1.0f;
+	self->friction = 0.0f;
+	self->bounce_limit = 5;
+	self->event_buffer = 0;
+	self->events = NULL;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|ffiOiOOi:__init__", kwlist,
+		&self->domain, &self->bounce, &self->friction, &self->bounce_limit, &self->callback,
+		&self->event_buffer, &sub_emitter, &sub_group, &sub_count)) {
+		/* Parsing may have stored borrowed references before failing */
+		self->domain = NULL;
+		self->callback = NULL;
+		return -1;
+	}
+	Py_INCREF(self->domain);
+	Py_XINCREF(self->callback);
+	if (!SubEmitter_init(&self->sub, sub_emitter, sub_group, sub_count))
+		return -1;
+	return 0;
+}
+
+static PyObject *
+BounceController_call(BounceControllerObject *self, PyObject *args)
+{
+	float td;
+	GroupObject *pgroup;
+	VectorObject *start_pos = NULL, *end_pos = NULL;
+	PyObject *collide_vec = NULL, *normal_vec = NULL;
+	ParticleRefObject *particleref = NULL;
+	EventBufferObject *events = NULL;
+	PyObject *result = NULL, *t = NULL, *intersect_str = NULL;
+	float tangent_scale, d;
+	Vec3 collide_point, normal, penetration, deflect, slide;
+	int bounces, started_inside, inside, has_callback;
+	register Particle *p;
+	register unsigned long count;
+
+	if (!PyArg_ParseTuple(args, "fO:__init__", &td, &pgroup))
+		return NULL;
+	
+	if (!GroupObject_Check(pgroup))
+		return NULL;
+	
+	intersect_str = PyString_InternFromString("intersect");
+	if (intersect_str == NULL)
+		goto error;
+
+	p = pgroup->plist->p;
+	tangent_scale = 1.0f - self->friction;
+	count = GroupObject_ActiveCount(pgroup);
+	start_pos = Vector_new(NULL, &p->last_position, 3);
+	end_pos = Vector_new(NULL, &p->position, 3);
+	if (start_pos == NULL || end_pos == NULL)
+		goto error;
+	has_callback = self->callback != NULL && self->callback != Py_None;
+	if ((has_callback && self->event_buffer) || self->sub.emitter != NULL) {
+		events = EventBuffer_reset(&self->events);
+		if (events == NULL)
+			goto error;
+	}
+	while (count--) {
+		if (Particle_IsAlive(*p)) {
+			start_pos->vec = &p->last_position;
+			end_pos->vec = &p->position;
+			started_inside = PySequence_Contains((PyObject *)self->domain, (PyObject *)start_pos);
+			if (started_inside == -1)
+				goto error;
+			bounces = self->bounce_limit;
+			while (bounces--) {
+				end_pos->vec = &p->position;
+				result = PyObject_CallMethodObjArgs(self->domain, intersect_str,
+					(PyObject *)start_pos, (PyObject *)end_pos, NULL);
+				if (result == NULL)
+					goto error;
+				t = PySequence_Tuple(result);
+				if (t == NULL)
+					goto error;
+				Py_CLEAR(result);
+				if (PySequence_Fast_GET_SIZE(t) && PySequence_Fast_GET_ITEM(t, 0) != Py_None) {
+					if (!PyArg_ParseTuple(t, "(fff)(fff);domain.intersect() returned invalid value",
+						&collide_point.x, &collide_point.y, &collide_point.z,
+						&normal.x, &normal.y, &normal.z))
+						goto error;
+					Vec3_sub(&penetration, &p->position, &collide_point);
+					d = Vec3_dot(&penetration, &normal);
+					Vec3_scalar_mul(&deflect, &normal, d);
+					Vec3_sub(&slide, &penetration, &deflect);
+					Vec3_scalar_muli(&deflect, self->bounce);
+					Vec3_scalar_muli(&slide, tangent_scale);
+					Vec3_sub(&p->position, &collide_point, &deflect);
+					Vec3_addi(&p->position, &slide);
+					GroupBounds_include(&pgroup->bounds, &p->position);
+					d = Vec3_dot(&p->velocity, &normal);
+					Vec3_scalar_mul(&deflect, &normal, d);
+					Vec3_sub(&slide, &p->velocity, &deflect);
+					Vec3_scalar_muli(&deflect, self->bounce);
+					Vec3_scalar_muli(&slide, tangent_scale);
+					Vec3_sub(&p->velocity, &slide, &deflect);
+					start_pos->vec = &collide_point;
+					if (events != NULL &&
+						!EventBuffer_append(events, pgroup, p, &collide_point, &normal))
+						goto error;
+					if (has_callback && !self->event_buffer) {
+						particleref = ParticleRefObject_New((PyObject *)pgroup, p);
+						collide_vec = Py_BuildValue(
+							"(fff)", collide_point.x, collide_point.y, collide_point.z);
+						normal_vec = Py_BuildValue("(fff)", normal.x, normal.y, normal.z);
+						if (particleref == NULL || collide_vec == NULL || normal_vec == NULL)
+							goto error;
+						result = PyObject_CallFunctionObjArgs(
+							self->callback, (PyObject *)particleref, (PyObject *)pgroup, 
+							(PyObject *)self, collide_vec, normal_vec, NULL);
+						if (result == NULL) {
+							goto error;
+						}
+						Py_CLEAR(result);
+						Py_CLEAR(particleref);
+						Py_CLEAR(collide_vec);
+						Py_CLEAR(normal_vec);
+					}
+					inside = PySequence_Contains((PyObject *)self->domain, (PyObject *)end_pos);
+					if (inside == -1)
+						goto error;
+					if ((started_inside == inside) | (self->bounce <= 0)) {
+						/* We started inside or outside and ended the same, we're done
+						   This is the common case
+						   XXX This is not perfect and may return a false
+						   positive for hollow domains with sharp angles */
+						break;
+					}
+				} else {
+					/* No collision */
+					break;
+				}
+			}
+			Py_CLEAR(t);
+		}
+		p++;
+	}
+	if (events != NULL && !SubEmitter_spawn(&self->sub, events, pgroup))
+		goto error;
+	if (events != NULL && has_callback && self->event_buffer && 
+		!EventBuffer_deliver(events, self->callback, pgroup, (PyObject *)self))
+		goto error;
+	Py_DECREF(intersect_str);
+	Py_DECREF(start_pos);
+	Py_DECREF(end_pos);
+	
+	Py_INCREF(Py_None);
+	return Py_None;
+
+error:
+	Py_XDECREF(result);
+	Py_XDECREF(t);
+	Py_XDECREF(intersect_str);
+	Py_XDECREF(particleref);
+	Py_XDECREF(start_pos);
+	Py_XDECREF(end_pos);
+	Py_XDECREF(collide_vec);
+	Py_XDECREF(normal_vec);
+	return NULL;
+}
+
+static struct PyMemberDef BounceController_members[] = {
+    {"domain", T_OBJECT, offsetof(BounceControllerObject, domain), 0,
+        "Particles are deflected when they collide with the domain boundary"},
+    {"bounce", T_FLOAT, offsetof(BounceControllerObject, bounce), 0,
+        "Multiplied by the normal component of the collision velocity,\n"
+		"this determines the amount of deflection from the domain's boundary.\n"
+		"If positive, the particle will bounce off of the domain. If zero\n"
+		"the particle will \"stick\" to the boundary. If negative, the particle\n"
+		"will be refracted across the boundary"},
+	{"friction", T_FLOAT, offsetof(BounceControllerObject, friction), 0,
+		"Multiplied by the tangental component of the collision velocity,\n"
+		"this determines the resistance to sliding tangentially across the\n"
+		"domain boundary. 1 - friction is multiplied by the tangental component\n"
+		"of the particle's velocity."},
+	{"bounce_limit", T_INT, offsetof(BounceControllerObject, bounce_limit), 0,
+		"The maximum number of bounces deflections calculated per particle\n"
+		"per iteration. Important for fast moving particles contained inside\n"
+		"small domains, or domains with corners. Small values may reduce CPU\n"
+		"cost, but also may allow particles to escape containment."},
+    {"callback", T_OBJECT, offsetof(BounceControllerObject, callback), 0,
+        "A function called called when a particle collides with the domain, or None\n"
+		"Must have the signature:\n"
+		"    callback(particle, group, controller, collision_point, collision_normal)\n"
+		"or if event_buffer is true:\n"
+		"    callback(events, group, controller)"},
+	{"event_buffer", T_INT, offsetof(BounceControllerObject, event_buffer), 0,
+		"True to pass the callback all of the collisions in a call at once\n"
+		"as an EventBuffer, instead of calling it for each one."},
+	{"sub_emitter", T_OBJECT, offsetof(BounceControllerObject, sub.emitter), READONLY,
+		"StaticEmitter that emits particles at each collision, or None"},
+	{"sub_group", T_OBJECT, offsetof(BounceControllerObject, sub.group), READONLY,
+		"Group the sub_emitter emits into, or None for the bouncing group"},
+	{"sub_count", T_INT, offsetof(BounceControllerObject, sub.count), READONLY,
+		"Number of particles emitted by the sub_emitter for each collision"},
+	{NULL}
+};
+
+PyDoc_STRVAR(BounceController__doc__, 
+	"Bounce(domain, bounce=1.0, friction=0, bounce_limit=5, callback=None,\n"
+	"       event_buffer=False, sub_emitter=None, sub_group=None, sub_count=1)\n\n"
+	"domain -- Particles that collide with the surface of this domain are\n"
+	"redirected as if they bounced or reflected off the surface. This\n"
+	"alters the position and velocity of the particle. The domain must have\n"
+	"a non-zero area.\n\n"
+	"bounce -- The coefficient of restitution multiplied by the normal\n"
+	"component of the collision velocity. This determines the deflection\n"
+	"velocity of the particle. If 1.0 (default) the particle is deflected\n"
+	"with the same energy it struck the domain with, if zero, the particle\n"
+	"will stick to the domain's surface and not bounce off.\n\n"
+	"friction -- The resistance presented by the domain surface to sliding\n"
+	"particle movement tangental to the domain. 1 - friction is multiplied\n"
+	"by the tangental component of the particles velocity. A value of 0\n"
+	"means no friction.  if friction is negative, the particle will gain\n"
+	"velocity.\n\n"
+	"bounce_limit -- The maximum number of bounces deflections calculated per\n"
+	"particle per iteration. Higher values can result in more accuracy\n"
+	"at potentially higher CPU cost. A value of -1 is effectively infinite.\n\n"
+	"callback -- An optional function called when a particle collides\n"
+	"with the domain. Must have the signature:\n"
+	"	callback(particle, group, controller, collision_point, collision_normal)\n"
+	"collision_point is point on the domain where the collision occurred.\n"
+	"collision_normal is the normal vector on the domain's surface at the\n"
+	"point of collision.\n\n"
+	"event_buffer -- if true, the callback is instead called once per call\n"
+	"of the controller with all of the collisions that occurred:\n"
+	"	callback(events, group, controller)\n"
+	"events is an EventBuffer holding the collision point and normal and the\n"
+	"particle's velocity after the bounce for each collision. The callback is\n"
+	"not called if there were no collisions.\n\n"
+	"sub_emitter -- An optional StaticEmitter that emits sub_count particles\n"
+	"into sub_group at each collision, without calling into Python. The\n"
+	"position of the emitted particles is relative to the collision point\n"
+	"and their velocity relative to the particle's velocity after the\n"
+	"bounce. If sub_group is None, the particles are emitted into the\n"
+	"bouncing group."
+);
+
+static PyTypeObject BounceController_Type = {
+	/* The ob_type field must be initialized in the module init function
+	 * to be portable to Windows without using C++. */
+	PyObject_HEAD_INIT(NULL)
+	0,			/*ob_size*/
+	"controller.Bounce",		/*tp_name*/
+	sizeof(BounceControllerObject),	/*tp_basicsize*/
+	0,			/*tp_itemsize*/
+	/* methods */
+	(destructor)BounceController_dealloc, /*tp_dealloc*/
+	0,			/*tp_print*/
+	0,          /*tp_getattr*/
+	0,          /*tp_setattr*/
+	0,			/*tp_compare*/
+	0,			/*tp_repr*/
+	0,			/*tp_as_number*/
+	0,	        /*tp_as_sequence*/
+	0,			/*tp_as_mapping*/
+	0,			/*tp_hash*/
+	(ternaryfunc)BounceController_call, /*tp_call*/
+	0,                      /*tp_str*/
+	0,                      /*tp_getattro*/
+	0,                      /*tp_setattro*/
+	0,                      /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+	BounceController__doc__,   /*tp_doc*/
+	0,                      /*tp_traverse*/
+	0,                      /*tp_clear*/
+	0,                      /*tp_richcompare*/
+	0,                      /*tp_weaklistoffset*/
+	0,                      /*tp_iter*/
+	0,                      /*tp_iternext*/
+	0,  /*tp_methods*/
+	BounceController_members,  /*tp_members*/
+	0,                      /*tp_getset*/
+	0,                      /*tp_base*/
+	0,                      /*tp_dict*/
+	0,                      /*tp_descr_get*/
+	0,                      /*tp_descr_set*/
+	0,                      /*tp_dictoffset*/
+	(initproc)BounceController_init, /*tp_init*/
+	0,                      /*tp_alloc*/
+	0,                      /*tp_new*/
+	0,                      /*tp_free*/
+	0,                      /*tp_is_gc*/
+};
+
+/* --------------------------------------------------------------------- */
+
+static PyTypeObject CollisionController_Type;
+
+typedef struct {
+	PyObject_HEAD
+	PyObject *other_group;
+	float bounce;
+	SpatialGrid grid;
+	Vec3 *deltas; /* Velocity and position change pairs for each particle */
+	unsigned long deltas_alloc;
+} CollisionControllerObject;
+
+static void
+CollisionController_dealloc(CollisionControllerObject *self) {
+	if (self->other_group != NULL)
+		Py_CLEAR(self->other_group);
+	SpatialGrid_clear(&self->grid);
+	PyMem_Free(self->deltas);
+	PyObject_Del(self);
+}
+
+static int
+CollisionController_init(CollisionControllerObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = {"bounce", "other_group", NULL};
+	PyObject *other_group = NULL;
+
+	self->bounce = 1.0f;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|fO:__init__", kwlist,
+		&self->bounce, &other_group))
+		return -1;
+	if (other_group == Py_None)
+		other_group = NULL; /* Avoid having to test for NULL and None */
+	if (other_group != NULL && !GroupObject_Check((GroupObject *)other_group))
+		return -1;
+	Py_XINCREF(other_group);
+	Py_XDECREF(self->other_group);
+	self->other_group = other_group;
+	return 0;
+}
+
+/* State shared by the collision worker chunks */
+typedef struct {
+	Particle *p;       /* Particles being updated */
+	Particle *other;   /* Particles indexed in the grid */
+	int self_collide;  /* True if p and other are the same particles */
+	SpatialGrid *grid;
+	Vec3 *deltas;
+	float bounce;
+	GroupBounds moved[PARALLEL_MAX_CHUNKS]; /* Bounds of moved particles */
+} CollisionJob;
+
+/* Compute the velocity and position changes for a range of particles
+ * colliding with the particles in the grid. The particles themselves are
+ * not modified, so the result does not depend on the order particles are
+ * visited in, and chunks can run concurrently.
+ */
+static void
+Collision_compute(CollisionJob *job, unsigned long chunk,
+	unsigned long start, unsigned long end)
+{
+	unsigned long slots[GRID_QUERY_CELLS];
+	unsigned long i, j, k, kend;
+	int nslots, s;
+	float ri, mi, reach, dist2, dist, share, vn;
+	Vec3 normal, rvel, tmp;
+	Vec3 *dv, *dp;
+	Particle *p, *q;
+
+	for (i = start; i < end; i++) {
+		p = &job->p[i];
+		dv = &job->deltas[i * 2];
+		dp = dv + 1;
+		dv->x = dv->y = dv->z = 0.0f;
+		dp->x = dp->y = dp->z = 0.0f;
+		if (!Particle_IsAlive(*p))
+			continue;
+		ri = p->size.x * 0.5f;
+		mi = Particle_Mass(*p);
+		nslots = SpatialGrid_query_slots(job->grid, &p->position, slots);
+		for (s = 0; s < nslots; s++) {
+			kend = job->grid->cell_start[slots[s] + 1];
+			for (k = job->grid->cell_start[slots[s]]; k < kend; k++) {
+				j = job->grid->indices[k];
+				if (job->self_collide && j == i)
+					continue;
+				q = &job->other[j];
+				reach = ri + q->size.x * 0.5f;
+				Vec3_sub(&normal, &p->position, &q->position);
+				dist2 = Vec3_len_sq(&normal);
+				if (dist2 >= reach * reach || dist2 <= 0.0f)
+					continue;
+				dist = sqrtf(dist2);
+				Vec3_scalar_muli(&normal, 1.0f / dist);
+				/* This particle's share of the response is inversely
+				   proportional to its share of the total mass */
+				share = Particle_Mass(*q);
+				share = share / (mi + share);
+				Vec3_scalar_mul(&tmp, &normal, (reach - dist) * share);
+				Vec3_addi(dp, &tmp);
+				Vec3_sub(&rvel, &p->velocity, &q->velocity);
+				vn = Vec3_dot(&rvel, &normal);
+				if (vn < 0.0f) {
+					/* Approaching, apply the impulse */
+					Vec3_scalar_mul(&tmp, &normal, -(1.0f + job->bounce) * vn * share);
+					Vec3_addi(dv, &tmp);
+				}
+			}
+		}
+	}
+}
+
+static void
+Collision_apply(CollisionJob *job, unsigned long chunk,
+	unsigned long start, unsigned long end)
+{
+	unsigned long i;
+	Particle *p;
+	GroupBounds *moved = &job->moved[chunk];
+
+	GroupBounds_clear(moved);
+	for (i = start; i < end; i++) {
+		p = &job->p[i];
+		if (Particle_IsAlive(*p)) {
+			Vec3_addi(&p->velocity, &job->deltas[i * 2]);
+			Vec3_addi(&p->position, &job->deltas[i * 2 + 1]);
+			GroupBounds_include(moved, &p->position);
+		}
+	}
+}
+
+#define COLLISION_MIN_CHUNK 256
+
+static PyObject *
+CollisionController_call(CollisionControllerObject *self, PyObject *args)
+{
+	float td, max_size;
+	GroupObject *pgroup, *ogroup;
+	CollisionJob job;
+	Vec3 *deltas;
+	unsigned long count, ocount, chunks, i;
+
+	if (!PyArg_ParseTuple(args, "fO:__init__", &td, &pgroup))
+		return NULL;
+	
+	if (!GroupObject_Check(pgroup))
+		return NULL;
+
+	ogroup = self->other_group != NULL ? (GroupObject *)self->other_group : pgroup;
+	if (!GroupObject_Check(ogroup))
+		return NULL;
+	
+	count = GroupObject_ActiveCount(pgroup);
+	ocount = GroupObject_ActiveCount(ogroup);
+	if (!count || !ocount) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+
+	/* The cells must be at least as large as the largest collision
+	   distance so that only adjacent cells need to be searched */
+	max_size = 0.0f;
+	for (i = 0; i < ocount; i++) {
+		if (Particle_IsAlive(ogroup->plist->p[i]) && ogroup->plist->p[i].size.x > max_size)
+			max_size = ogroup->plist->p[i].size.x;
+	}
+	for (i = 0; i < count; i++) {
+		if (Particle_IsAlive(pgroup->plist->p[i]) && pgroup->plist->p[i].size.x > max_size)
+			max_size = pgroup->plist->p[i].size.x;
+	}
+	if (max_size <= 0.0f) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+
+	if (count > self->deltas_alloc) {
+		deltas = PyMem_Realloc(self->deltas, sizeof(Vec3) * 2 * count);
+		if (deltas == NULL)
+			return PyErr_NoMemory();
+		self->deltas = deltas;
+		self->deltas_alloc = count;
+	}
+	if (!SpatialGrid_build(&self->grid, ogroup->plist->p, ocount, max_size))
+		return NULL;
+
+	job.p = pgroup->plist->p;
+	job.other = ogroup->plist->p;
+	job.self_collide = (ogroup == pgroup);
+	job.grid = &self->grid;
+	job.deltas = self->deltas;
+	job.bounce = self->bounce;
+	parallel_for(count, COLLISION_MIN_CHUNK, (ParallelFunc)Collision_compute, &job);
+	chunks = parallel_for(count, COLLISION_MIN_CHUNK * 4, (ParallelFunc)Collision_apply, &job);
+	for (i = 0; i < chunks; i++)
+		GroupBounds_merge(&pgroup->bounds, &job.moved[i]);
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static struct PyMemberDef CollisionController_members[] = {
+    {"bounce", T_FLOAT, offsetof(CollisionControllerObject, bounce), 0,
+        "Coefficient of restitution of particle collisions. 1.0 is\n"
+		"perfectly elastic, 0 is perfectly inelastic"},
+    {"other_group", T_OBJECT, offsetof(CollisionControllerObject, other_group), READONLY,
+        "Group the particles collide with, or None to collide particles\n"
+		"with each other in the same group"},
+	{NULL}
+};
+
+PyDoc_STRVAR(CollisionController__doc__, 
+	"Collision(bounce=1.0, other_group=None)\n\n"
+	"Resolve collisions between particles treating each as a sphere with\n"
+	"a radius of half its width (size.x). Overlapping particles are\n"
+	"pushed apart and their velocities are changed by an impulse\n"
+	"apportioned by their mass. Particles with zero mass are treated\n"
+	"as having unit mass.\n\n"
+	"bounce -- The coefficient of restitution of the collisions. If 1.0\n"
+	"(default) particles bounce off each other without losing energy, if\n"
+	"zero, colliding particles stick together.\n\n"
+	"other_group -- If specified, particles collide with the particles\n"
+	"of this group instead of each other. Only the particles of the\n"
+	"group being updated are affected; bind a Collision controller to\n"
+	"each group for a two-way interaction."
+);
+
+static PyTypeObject CollisionController_Type = {
+	/* The ob_type field must be initialized in the module init function
+	 * to be portable to Windows without using C++. */
+	PyObject_HEAD_INIT(NULL)
+	0,			/*ob_size*/
+	"controller.Collision",		/*tp_name*/
+	sizeof(CollisionControllerObject),	/*tp_basicsize*/
+	0,			/*tp_itemsize*/
+	/* methods */
+	(destructor)CollisionController_dealloc, /*tp_dealloc*/
+	0,			/*tp_print*/
+	0,          /*tp_getattr*/
+	0,          /*tp_setattr*/
+	0,			/*tp_compare*/
+	0,			/*tp_repr*/
+	0,			/*tp_as_number*/
+	0,	        /*tp_as_sequence*/
+	0,			/*tp_as_mapping*/
+	0,			/*tp_hash*/
+	(ternaryfunc)CollisionController_call, /*tp_call*/
+	0,                      /*tp_str*/
+	0,                      /*tp_getattro*/
+	0,                      /*tp_setattro*/
+	0,                      /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+	CollisionController__doc__,   /*tp_doc*/
+	0,                      /*tp_traverse*/
+	0,                      /*tp_clear*/
+	0,                      /*tp_richcompare*/
+	0,                      /*tp_weaklistoffset*/
+	0,                      /*tp_iter*/
+	0,                      /*tp_iternext*/
+	0,  /*tp_methods*/
+	CollisionController_members,  /*tp_members*/
+	0,                      /*tp_getset*/
+	0,                      /*tp_base*/
+	0,                      /*tp_dict*/
+	0,                      /*tp_descr_get*/
+	0,                      /*tp_descr_set*/
+	0,                      /*tp_dictoffset*/
+	(initproc)CollisionController_init, /*tp_init*/
+	0,                      /*tp_alloc*/
+	0,                      /*tp_new*/
+	0,                      /*tp_free*/
+	0,                      /*tp_is_gc*/
+};
+
+/* --------------------------------------------------------------------- */
+
+static PyTypeObject FlockController_Type;
+
+typedef struct {
+	PyObject_HEAD
+	float radius;
+	float separation;
+	float alignment;
+	float cohesion;
+	int max_neighbors;
+	SpatialGrid grid;
+} FlockControllerObject;
+
+static void
+FlockController_dealloc(FlockControllerObject *self) {
+	SpatialGrid_clear(&self->grid);
+	PyObject_Del(self);
+}
+
+static int
+FlockController_init(FlockControllerObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = {"radius", "separation", "alignment", "cohesion", 
+		"max_neighbors", NULL};
+
+	self->separation = 1.0f;
+	self->alignment = 1.0f;
+	self->cohesion = 1.0f;
+	self->max_neighbors = 16;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "f|fffi:__init__", kwlist,
+		&self->radius, &self->separation, &self->alignment, &self->cohesion,
+		&self->max_neighbors))
+		return -1;
+	if (self->radius <= 0.0f) {
+		PyErr_SetString(PyExc_ValueError, "Flock: expected radius > 0");
+		return -1;
+	}
+	return 0;
+}
+
+/* State shared by the flocking worker chunks */
+typedef struct {
+	Particle *p;
+	SpatialGrid *grid;
+	FlockControllerObject *flock;
+	float td;
+} FlockJob;
+
+/* Steer a range of particles. Only the velocity of each particle in the
+ * range is written, and neighbor velocities are read from last_velocity
+ * so chunks can run concurrently and the result does not depend on order.
+ */
+static void
+Flock_steer(FlockJob *job, unsigned long chunk,
+	unsigned long start, unsigned long end)
+{
+	unsigned long slots[GRID_QUERY_CELLS];
+	unsigned long i, j, k, kend;
+	int nslots, s, neighbors;
+	const int max_neighbors = job->flock->max_neighbors;
+	const float radius = job->flock->radius;
+	const float radius_sq = radius * radius;
+	float dist2, dist, scale;
+	Vec3 offset, separate, heading, center, steer;
+	Particle *p, *q;
+
+	for (i = start; i < end; i++) {
+		p = &job->p[i];
+		if (!Particle_IsAlive(*p))
+			continue;
+		separate.x = separate.y = separate.z = 0.0f;
+		heading.x = heading.y = heading.z = 0.0f;
+		center.x = center.y = center.z = 0.0f;
+		neighbors = 0;
+		nslots = SpatialGrid_query_slots(job->grid, &p->position, slots);
+		for (s = 0; s < nslots; s++) {
+			kend = job->grid->cell_start[slots[s] + 1];
+			for (k = job->grid->cell_start[slots[s]]; k < kend; k++) {
+				j = job->grid->indices[k];
+				if (j == i)
+					continue;
+				q = &job->p[j];
+				Vec3_sub(&offset, &p->position, &q->position);
+				dist2 = Vec3_len_sq(&offset);
+				if (dist2 >= radius_sq)
+					continue;
+				if (dist2 > 0.0f) {
+					/* Push away harder the closer the neighbor is */
+					dist = sqrtf(dist2);
+					scale = (radius - dist) / (radius * dist);
+					Vec3_scalar_muli(&offset, scale);
+					Vec3_addi(&separate, &offset);
+				}
+				Vec3_addi(&heading, &q->last_velocity);
+				Vec3_addi(&center, &q->position);
+				if (++neighbors == max_neighbors)
+					goto steer;
+			}
+		}
+		if (!neighbors)
+			continue;
+	steer:
+		scale = 1.0f / neighbors;
+		/* Alignment toward the average neighbor velocity */
+		Vec3_scalar_muli(&heading, scale);
+		Vec3_subi(&heading, &p->last_velocity);
+		/* Cohesion toward the average neighbor position */
+		Vec3_scalar_muli(&center, scale);
+		Vec3_subi(&center, &p->position);
+		Vec3_scalar_mul(&steer, &separate, job->flock->separation);
+		Vec3_scalar_muli(&heading, job->flock->alignment);
+		Vec3_addi(&steer, &heading);
+		Vec3_scalar_muli(&center, job->flock->cohesion);
+		Vec3_addi(&steer, &center);
+		Vec3_scalar_muli(&steer, job->td);
+		Vec3_addi(&p->velocity, &steer);
+	}
+}
+
+#define FLOCK_MIN_CHUNK 256
+
+static PyObject *
+FlockController_call(FlockControllerObject *self, PyObject *args)
+{
+	float td;
+	GroupObject *pgroup;
+	FlockJob job;
+	unsigned long count;
+
+	if (!PyArg_ParseTuple(args, "fO:__init__", &td, &pgroup))
+		return NULL;
+	
+	if (!GroupObject_Check(pgroup))
+		return NULL;
+	
+	count = GroupObject_ActiveCount(pgroup);
+	if (count > 1 && self->radius > 0.0f) {
+		if (!SpatialGrid_build(&self->grid, pgroup->plist->p, count, self->radius))
+			return NULL;
+		job.p = pgroup->plist->p;
+		job.grid = &self->grid;
+		job.flock = self;
+		job.td = td;
+		parallel_for(count, FLOCK_MIN_CHUNK, (ParallelFunc)Flock_steer, &job);
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static struct PyMemberDef FlockController_members[] = {
+    {"radius", T_FLOAT, offsetof(FlockControllerObject, radius), 0,
+        "Particles closer than this distance are neighbors"},
+    {"separation", T_FLOAT, offsetof(FlockControllerObject, separation), 0,
+        "Weight of the acceleration away from close neighbors"},
+    {"alignment", T_FLOAT, offsetof(FlockControllerObject, alignment), 0,
+        "Weight of the acceleration toward the neighbors' average velocity"},
+    {"cohesion", T_FLOAT, offsetof(FlockControllerObject, cohesion), 0,
+        "Weight of the acceleration toward the neighbors' average position"},
+    {"max_neighbors", T_INT, offsetof(FlockControllerObject, max_neighbors), 0,
+        "Maximum number of neighbors considered per particle, 0 for no limit"},
+	{NULL}
+};
+
+PyDoc_STRVAR(FlockController__doc__, 
+	"Flock(radius, separation=1.0, alignment=1.0, cohesion=1.0, max_neighbors=16)\n\n"
+	"Steer particles like a flock of birds or a swarm of insects. Each\n"
+	"particle is accelerated by the weighted sum of three rules applied to\n"
+	"its neighbors. Only particle velocities are changed, combine with\n"
+	"a Movement controller to move the particles.\n\n"
+	"radius -- Particles closer than this distance are neighbors.\n\n"
+	"separation -- Weight of the acceleration away from neighbors, which\n"
+	"grows as they get closer.\n\n"
+	"alignment -- Weight of the acceleration matching the average velocity\n"
+	"of the neighbors.\n\n"
+	"cohesion -- Weight of the acceleration toward the average position\n"
+	"of the neighbors.\n\n"
+	"max_neighbors -- The maximum number of neighbors considered for each\n"
+	"particle. The neighbors considered are the first found, not\n"
+	"necessarily the nearest. Bounding the neighbors keeps the cost per\n"
+	"particle constant in dense flocks. 0 means no limit."
+);
+
+static PyTypeObject FlockController_Type = {
+	/* The ob_type field must be initialized in the module init function
+	 * to be portable to Windows without using C++. */
+	PyObject_HEAD_INIT(NULL)
+	0,			/*ob_size*/
+	"controller.Flock",		/*tp_name*/
+	sizeof(FlockControllerObject),	/*tp_basicsize*/
+	0,			/*tp_itemsize*/
+	/* methods */
+	(destructor)FlockController_dealloc, /*tp_dealloc*/
+	0,			/*tp_print*/
+	0,          /*tp_getattr*/
+	0,          /*tp_setattr*/
+	0,			/*tp_compare*/
+	0,			/*tp_repr*/
+	0,			/*tp_as_number*/
+	0,	        /*tp_as_sequence*/
+	0,			/*tp_as_mapping*/
+	0,			/*tp_hash*/
+	(ternaryfunc)FlockController_call, /*tp_call*/
+	0,                      /*tp_str*/
+	0,                      /*tp_getattro*/
+	0,                      /*tp_setattro*/
+	0,                      /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+	FlockController__doc__,   /*tp_doc*/
+	0,                      /*tp_traverse*/
+	0,                      /*tp_clear*/
+	0,                      /*tp_richcompare*/
+	0,                      /*tp_weaklistoffset*/
+	0,                      /*tp_iter*/
+	0,                      /*tp_iternext*/
+	0,  /*tp_methods*/
+	FlockController_members,  /*tp_members*/
+	0,                      /*tp_getset*/
+	0,                      /*tp_base*/
+	0,                      /*tp_dict*/
+	0,                      /*tp_descr_get*/
+	0,                      /*tp_descr_set*/
+	0,                      /*tp_dictoffset*/
+	(initproc)FlockController_init, /*tp_init*/
+	0,                      /*tp_alloc*/
+	0,                      /*tp_new*/
+	0,                      /*tp_free*/
+	0,                      /*tp_is_gc*/
+};
+
+/* --------------------------------------------------------------------- */
+
+static PyTypeObject NBodyController_Type;
+
+typedef struct {
+	PyObject_HEAD
+	float G;
+	float theta;
+	float epsilon;
+	Octree tree;
+} NBodyControllerObject;
+
+static void
+NBodyController_dealloc(NBodyControllerObject *self) {
+	Octree_clear(&self->tree);
+	PyObject_Del(self);
+}
+
+static int
+NBodyController_init(NBodyControllerObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = {"G", "theta", "epsilon", NULL};
+
+	self->G = 1.0f;
+	self->theta = 0.5f;
+	self->epsilon = 0.01f;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|fff:__init__", kwlist,
+		&self->G, &self->theta, &self->epsilon))
+		return -1;
+	if (self->theta < 0.0f) {
+		PyErr_SetString(PyExc_ValueError, "NBody: expected theta >= 0");
+		return -1;
+	}
+	return 0;
+}
+
+/* State shared by the n-body worker chunks */
+typedef struct {
+	Particle *p;
+	OctNode *nodes;
+	float theta_sq;
+	float epsilon_sq;
+	float scale; /* G * td */
+} NBodyJob;
+
+/* Accelerate a range of particles toward the mass in the tree. Nodes that
+ * are small relative to their distance from the particle are treated as a
+ * single body at their center of mass, otherwise their children are visited.
+ * Only the velocity of each particle in the range is written, so chunks can
+ * run concurrently.
+ */
+static void
+NBody_accelerate(NBodyJob *job, unsigned long chunk,
+	unsigned long start, unsigned long end)
+{
+	int stack[OCTREE_MAX_DEPTH * 8 + 8];
+	int top, c;
+	unsigned long i;
+	float dist2, size, f;
+	Vec3 accel, d;
+	OctNode *node;
+	Particle *p;
+
+	for (i = start; i < end; i++) {
+		p = &job->p[i];
+		if (!Particle_IsAlive(*p))
+			continue;
+		accel.x = accel.y = accel.z = 0.0f;
+		stack[0] = 0;
+		top = 1;
+		while (top) {
+			node = &job->nodes[stack[--top]];
+			if (node->body == (int)i)
+				continue; /* Don't attract yourself */
+			Vec3_sub(&d, &node->com, &p->position);
+			dist2 = Vec3_len_sq(&d);
+			size = node->half_size * 2.0f;
+			if (node->body != OCTREE_INTERNAL || size * size < job->theta_sq * dist2) {
+				dist2 += job->epsilon_sq;
+				if (dist2 > 0.0f) {
+					f = node->mass / (dist2 * sqrtf(dist2));
+					Vec3_scalar_muli(&d, f);
+					Vec3_addi(&accel, &d);
+				}
+			} else {
+				for (c = 0; c < 8; c++) {
+					if (node->child[c] >= 0)
+						stack[top++] = node->child[c];
+				}
+			}
+		}
+		Vec3_scalar_muli(&accel, job->scale);
+		Vec3_addi(&p->velocity, &accel);
+	}
+}
+
+#define NBODY_MIN_CHUNK 128
+
+static PyObject *
+NBodyController_call(NBodyControllerObject *self, PyObject *args)
 {
 	float td;
 	GroupObject *pgroup;
-	VectorObject *start_pos = NULL, *end_pos = NULL;
-	PyObject *collide_vec = NULL, *normal_vec = NULL;
-	ParticleRefObject *particleref = NULL;
-	PyObject *result = NULL, *t = NULL, *intersect_str = NULL;
-	float tangent_scale, d;
-	Vec3 collide_point, normal, penetration, deflect, slide;
-	int bounces, started_inside, inside;
-	register Particle *p;
-	register unsigned long count;
+	NBodyJob job;
+	unsigned long count;
 
 	if (!PyArg_ParseTuple(args, "fO:__init__", &td, &pgroup))
 		return NULL;
@@ -1245,174 +2659,61 @@ BounceController_call(BounceControllerObject *self, PyObject *args)
 	if (!GroupObject_Check(pgroup))
 		return NULL;
 	
-	intersect_str = PyString_InternFromString("intersect");
-	if (intersect_str == NULL)
-		goto error;
-
-	p = pgroup->plist->p;
-	tangent_scale = 1.0f - self->friction;
 	count = GroupObject_ActiveCount(pgroup);
-	start_pos = Vector_new(NULL, &p->last_position, 3);
-	end_pos = Vector_new(NULL, &p->position, 3);
-	if (start_pos == NULL || end_pos == NULL)
-		goto error;
-	while (count--) {
-		if (Particle_IsAlive(*p)) {
-			start_pos->vec = &p->last_position;
-			end_pos->vec = &p->position;
-			started_inside = PySequence_Contains((PyObject *)self->domain, (PyObject *)start_pos);
-			if (started_inside == -1)
-				goto error;
-			bounces = self->bounce_limit;
-			while (bounces--) {
-				end_pos->vec = &p->position;
-				result = PyObject_CallMethodObjArgs(self->domain, intersect_str,
-					(PyObject *)start_pos, (PyObject *)end_pos, NULL);
-				if (result == NULL)
-					goto error;
-				t = PySequence_Tuple(result);
-				if (t == NULL)
-					goto error;
-				Py_CLEAR(result);
-				if (PySequence_Fast_GET_SIZE(t) && PySequence_Fast_GET_ITEM(t, 0) != Py_None) {
-					if (!PyArg_ParseTuple(t, "(fff)(fff);domain.intersect() returned invalid value",
-						&collide_point.x, &collide_point.y, &collide_point.z,
-						&normal.x, &normal.y, &normal.z))
-						goto error;
-					Vec3_sub(&penetration, &p->position, &collide_point);
-					d = Vec3_dot(&penetration, &normal);
-					Vec3_scalar_mul(&deflect, &normal, d);
-					Vec3_sub(&slide, &penetration, &deflect);
-					Vec3_scalar_muli(&deflect, self->bounce);
-					Vec3_scalar_muli(&slide, tangent_scale);
-					Vec3_sub(&p->position, &collide_point, &deflect);
-					Vec3_addi(&p->position, &slide);
-					d = Vec3_dot(&p->velocity, &normal);
-					Vec3_scalar_mul(&deflect, &normal, d);
-					Vec3_sub(&slide, &p->velocity, &deflect);
-					Vec3_scalar_muli(&deflect, self->bounce);
-					Vec3_scalar_muli(&slide, tangent_scale);
-					Vec3_sub(&p->velocity, &slide, &deflect);
-					start_pos->vec = &collide_point;
-					if (self->callback != NULL && self->callback != Py_None) {
-						particleref = ParticleRefObject_New((PyObject *)pgroup, p);
-						collide_vec = Py_BuildValue(
-							"(fff)", collide_point.x, collide_point.y, collide_point.z);
-						normal_vec = Py_BuildValue("(fff)", normal.x, normal.y, normal.z);
-						if (particleref == NULL || collide_vec == NULL || normal_vec == NULL)
-							goto error;
-						result = PyObject_CallFunctionObjArgs(
-							self->callback, (PyObject *)particleref, (PyObject *)pgroup, 
-							(PyObject *)self, collide_vec, normal_vec, NULL);
-						if (result == NULL) {
-							goto error;
-						}
-						Py_CLEAR(result);
-						Py_CLEAR(particleref);
-						Py_CLEAR(collide_vec);
-						Py_CLEAR(normal_vec);
-					}
-					inside = PySequence_Contains((PyObject *)self->domain, (PyObject *)end_pos);
-					if (inside == -1)
-						goto error;
-					if ((started_inside == inside) | (self->bounce <= 0)) {
-						/* We started inside or outside and ended the same, we're done
-						   This is the common case
-						   XXX This is not perfect and may return a false
-						   positive for hollow domains with sharp angles */
-						break;
-					}
-				} else {
-					/* No collision */
-					break;
-				}
-			}
-			Py_CLEAR(t);
-		}
-		p++;
+	if (!Octree_build(&self->tree, pgroup->plist->p, count))
+		return NULL;
+	if (self->tree.count) {
+		job.p = pgroup->plist->p;
+		job.nodes = self->tree.nodes;
+		job.theta_sq = self->theta * self->theta;
+		job.epsilon_sq = self->epsilon * self->epsilon;
+		job.scale = self->G * td;
+		parallel_for(count, NBODY_MIN_CHUNK, (ParallelFunc)NBody_accelerate, &job);
 	}
-	Py_DECREF(intersect_str);
-	Py_DECREF(start_pos);
-	Py_DECREF(end_pos);
-	
+
 	Py_INCREF(Py_None);
 	return Py_None;
-
-error:
-	Py_XDECREF(result);
-	Py_XDECREF(t);
-	Py_XDECREF(intersect_str);
-	Py_XDECREF(particleref);
-	Py_XDECREF(start_pos);
-	Py_XDECREF(end_pos);
-	Py_XDECREF(collide_vec);
-	Py_XDECREF(normal_vec);
-	return NULL;
 }
 
-static struct PyMemberDef BounceController_members[] = {
-    {"domain", T_OBJECT, offsetof(BounceControllerObject, domain), 0,
-        "Particles are deflected when they collide with the domain boundary"},
-    {"bounce", T_FLOAT, offsetof(BounceControllerObject, bounce), 0,
-        "Multiplied by the normal component of the collision velocity,\n"
-		"this determines the amount of deflection from the domain's boundary.\n"
-		"If positive, the particle will bounce off of the domain. If zero\n"
-		"the particle will \"stick\" to the boundary. If negative, the particle\n"
-		"will be refracted across the boundary"},
-	{"friction", T_FLOAT, offsetof(BounceControllerObject, friction), 0,
-		"Multiplied by the tangental component of the collision velocity,\n"
-		"this determines the resistance to sliding tangentially across the\n"
-		"domain boundary. 1 - friction is multiplied by the tangental component\n"
-		"of the particle's velocity."},
-	{"bounce_limit", T_INT, offsetof(BounceControllerObject, bounce_limit), 0,
-		"The maximum number of bounces deflections calculated per particle\n"
-		"per iteration. Important for fast moving particles contained inside\n"
-		"small domains, or domains with corners. Small values may reduce CPU\n"
-		"cost, but also may allow particles to escape containment."},
-    {"callback", T_OBJECT, offsetof(BounceControllerObject, callback), 0,
-        "A function called called when a particle collides with the domain, or None\n"
-		"Must have the signature:\n"
-		"    callback(particle, group, controller, collision_point, collision_normal)"},
+static struct PyMemberDef NBodyController_members[] = {
+    {"G", T_FLOAT, offsetof(NBodyControllerObject, G), 0,
+        "Gravitational constant, negative values make particles repel"},
+    {"theta", T_FLOAT, offsetof(NBodyControllerObject, theta), 0,
+        "Opening angle of the approximation, larger is faster but less accurate"},
+    {"epsilon", T_FLOAT, offsetof(NBodyControllerObject, epsilon), 0,
+        "Softening distance that limits the force between close particles"},
 	{NULL}
 };
 
-PyDoc_STRVAR(BounceController__doc__, 
-	"Bounce(domain, bounce=1.0, friction=0, bounce_limit=5, callback=None)\n\n"
-	"domain -- Particles that collide with the surface of this domain are\n"
-	"redirected as if they bounced or reflected off the surface. This\n"
-	"alters the position and velocity of the particle. The domain must have\n"
-	"a non-zero area.\n\n"
-	"bounce -- The coefficient of restitution multiplied by the normal\n"
-	"component of the collision velocity. This determines the deflection\n"
-	"velocity of the particle. If 1.0 (default) the particle is deflected\n"
-	"with the same energy it struck the domain with, if zero, the particle\n"
-	"will stick to the domain's surface and not bounce off.\n\n"
-	"friction -- The resistance presented by the domain surface to sliding\n"
-	"particle movement tangental to the domain. 1 - friction is multiplied\n"
-	"by the tangental component of the particles velocity. A value of 0\n"
-	"means no friction.  if friction is negative, the particle will gain\n"
-	"velocity.\n\n"
-	"bounce_limit -- The maximum number of bounces deflections calculated per\n"
-	"particle per iteration. Higher values can result in more accuracy\n"
-	"at potentially higher CPU cost. A value of -1 is effectively infinite.\n\n"
-	"callback -- An optional function called when a particle collides\n"
-	"with the domain. Must have the signature:\n"
-	"	callback(particle, group, controller, collision_point, collision_normal)\n"
-	"collision_point is point on the domain where the collision occurred.\n"
-	"collision_normal is the normal vector on the domain's surface at the\n"
-	"point of collision."
+PyDoc_STRVAR(NBodyController__doc__, 
+	"NBody(G=1.0, theta=0.5, epsilon=0.01)\n\n"
+	"Mutual gravitational attraction between all particles in a group.\n"
+	"Each particle is accelerated toward every other particle in proportion\n"
+	"to its mass and the inverse square of their distance. Particles with\n"
+	"zero mass are treated as having unit mass. Only particle velocities\n"
+	"are changed, combine with a Movement controller to move the particles.\n\n"
+	"An octree is built over the particles each update, and the mass of\n"
+	"distant clusters of particles is approximated by their center of mass\n"
+	"(Barnes-Hut) so the cost is O(n log n) rather than O(n^2).\n\n"
+	"G -- The gravitational constant. Negative values cause particles to\n"
+	"repel each other.\n\n"
+	"theta -- The ratio of node size to distance below which a node is\n"
+	"approximated by its center of mass. Zero computes all interactions\n"
+	"exactly, larger values are faster but less accurate.\n\n"
+	"epsilon -- Softening distance added to the distance between particles\n"
+	"to avoid extreme accelerations when particles pass close together."
 );
 
-static PyTypeObject BounceController_Type = {
+static PyTypeObject NBodyController_Type = {
 	/* The ob_type field must be initialized in the module init function
 	 * to be portable to Windows without using C++. */
 	PyObject_HEAD_INIT(NULL)
 	0,			/*ob_size*/
-	"controller.Bounce",		/*tp_name*/
-	sizeof(BounceControllerObject),	/*tp_basicsize*/
+	"controller.NBody",		/*tp_name*/
+	sizeof(NBodyControllerObject),	/*tp_basicsize*/
 	0,			/*tp_itemsize*/
 	/* methods */
-	(destructor)BounceController_dealloc, /*tp_dealloc*/
+	(destructor)NBodyController_dealloc, /*tp_dealloc*/
 	0,			/*tp_print*/
 	0,          /*tp_getattr*/
 	0,          /*tp_setattr*/
@@ -1422,13 +2723,13 @@ static PyTypeObject BounceController_Type = {
 	0,	        /*tp_as_sequence*/
 	0,			/*tp_as_mapping*/
 	0,			/*tp_hash*/
-	(ternaryfunc)BounceController_call, /*tp_call*/
+	(ternaryfunc)NBodyController_call, /*tp_call*/
 	0,                      /*tp_str*/
 	0,                      /*tp_getattro*/
 	0,                      /*tp_setattro*/
 	0,                      /*tp_as_buffer*/
 	Py_TPFLAGS_DEFAULT,     /*tp_flags*/
-	BounceController__doc__,   /*tp_doc*/
+	NBodyController__doc__,   /*tp_doc*/
 	0,                      /*tp_traverse*/
 	0,                      /*tp_clear*/
 	0,                      /*tp_richcompare*/
@@ -1436,14 +2737,14 @@ static PyTypeObject BounceController_Type = {
 	0,                      /*tp_iter*/
 	0,                      /*tp_iternext*/
 	0,  /*tp_methods*/
-	BounceController_members,  /*tp_members*/
+	NBodyController_members,  /*tp_members*/
 	0,                      /*tp_getset*/
 	0,                      /*tp_base*/
 	0,                      /*tp_dict*/
 	0,                      /*tp_descr_get*/
 	0,                      /*tp_descr_set*/
 	0,                      /*tp_dictoffset*/
-	(initproc)BounceController_init, /*tp_init*/
+	(initproc)NBodyController_init, /*tp_init*/
 	0,                      /*tp_alloc*/
 	0,                      /*tp_new*/
 	0,                      /*tp_free*/
@@ -1798,6 +3099,139 @@ static PyTypeObject DragController_Type = {
 
 /* --------------------------------------------------------------------- */
 
+static PyTypeObject ClumperController_Type;
+
+typedef struct {
+	PyObject_HEAD
+	float magnitude;
+} ClumperControllerObject;
+
+static void
+ClumperController_dealloc(ClumperControllerObject *self) {
+	PyObject_Del(self);
+}
+
+static int
+ClumperController_init(ClumperControllerObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = {"magnitude", NULL};
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "f:__init__", kwlist,
+		&self->magnitude))
+		return -1;
+	return 0;
+}
+
+static PyObject *
+ClumperController_call(ClumperControllerObject *self, PyObject *args)
+{
+	float td, mag;
+	GroupObject *pgroup;
+	ParticleReduction centroid;
+	Vec3 center, accel;
+	register Particle *p;
+	register unsigned long count;
+
+	if (!PyArg_ParseTuple(args, "fO:__init__", &td, &pgroup))
+		return NULL;
+	
+	if (!GroupObject_Check(pgroup))
+		return NULL;
+	
+	Group_reduce(pgroup, offsetof(Particle, position), 3, &centroid);
+	if (centroid.count) {
+		center.x = centroid.sum[0] / centroid.count;
+		center.y = centroid.sum[1] / centroid.count;
+		center.z = centroid.sum[2] / centroid.count;
+		mag = self->magnitude * td;
+		p = pgroup->plist->p;
+		count = GroupObject_ActiveCount(pgroup);
+		while (count--) {
+			if (Particle_IsAlive(*p)) {
+				/* Accelerate toward the center from the position 
+				   looking ahead one frame */
+				Vec3_sub(&accel, &center, &p->position);
+				Vec3_subi(&accel, &p->velocity);
+				if (Vec3_normalize(&accel, &accel)) {
+					Vec3_scalar_muli(&accel, mag);
+					Vec3_addi(&p->velocity, &accel);
+				}
+			}
+			p++;
+		}
+	}
+
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static struct PyMemberDef ClumperController_members[] = {
+    {"magnitude", T_FLOAT, offsetof(ClumperControllerObject, magnitude), 0,
+        "Acceleration magnitude toward the group center"},
+	{NULL}
+};
+
+PyDoc_STRVAR(ClumperController__doc__, 
+	"EXPERMENTAL: SUBJECT TO CHANGE\n\n"
+	"Clumps objects in a group together or keeps them apart\n\n"
+	"Clumper(magnitude)\n\n"
+	"The center of the group is calculated by averaging all of the\n"
+	"particle positions, and all particles are accelerated toward\n"
+	"(or away) from this center point.\n\n"
+	"magnitude -- The acceleration magnitude toward the\n"
+	"group center. If negative, the acceleration is\n"
+	"away from the center."
+);
+
+static PyTypeObject ClumperController_Type = {
+	/* The ob_type field must be initialized in the module init function
+	 * to be portable to Windows without using C++. */
+	PyObject_HEAD_INIT(NULL)
+	0,			/*ob_size*/
+	"controller.Clumper",		/*tp_name*/
+	sizeof(ClumperControllerObject),	/*tp_basicsize*/
+	0,			/*tp_itemsize*/
+	/* methods */
+	(destructor)ClumperController_dealloc, /*tp_dealloc*/
+	0,			/*tp_print*/
+	0,          /*tp_getattr*/
+	0,          /*tp_setattr*/
+	0,			/*tp_compare*/
+	0,			/*tp_repr*/
+	0,			/*tp_as_number*/
+	0,	        /*tp_as_sequence*/
+	0,			/*tp_as_mapping*/
+	0,			/*tp_hash*/
+	(ternaryfunc)ClumperController_call, /*tp_call*/
+	0,                      /*tp_str*/
+	0,                      /*tp_getattro*/
+	0,                      /*tp_setattro*/
+	0,                      /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+	ClumperController__doc__,   /*tp_doc*/
+	0,                      /*tp_traverse*/
+	0,                      /*tp_clear*/
+	0,                      /*tp_richcompare*/
+	0,                      /*tp_weaklistoffset*/
+	0,                      /*tp_iter*/
+	0,                      /*tp_iternext*/
+	0,                      /*tp_methods*/
+	ClumperController_members,  /*tp_members*/
+	0,                      /*tp_getset*/
+	0,                      /*tp_base*/
+	0,                      /*tp_dict*/
+	0,                      /*tp_descr_get*/
+	0,                      /*tp_descr_set*/
+	0,                      /*tp_dictoffset*/
+	(initproc)ClumperController_init, /*tp_init*/
+	0,                      /*tp_alloc*/
+	0,                      /*tp_new*/
+	0,                      /*tp_free*/
+	0,                      /*tp_is_gc*/
+};
+
+/* --------------------------------------------------------------------- */
+
 PyMODINIT_FUNC
 init_controller(void)
 {
@@ -1840,6 +3274,10 @@ init_controller(void)
 	if (PyType_Ready(&GrowthController_Type) < 0)
 		return;
 
+	EventBuffer_Type.tp_getattro = PyObject_GenericGetAttr;
+	if (PyType_Ready(&EventBuffer_Type) < 0)
+		return;
+	
 	CollectorController_Type.tp_alloc = PyType_GenericAlloc;
 	CollectorController_Type.tp_new = PyType_GenericNew;
 	CollectorController_Type.tp_getattro = PyObject_GenericGetAttr;
@@ -1852,6 +3290,24 @@ init_controller(void)
 	if (PyType_Ready(&BounceController_Type) < 0)
 		return;
 
+	CollisionController_Type.tp_alloc = PyType_GenericAlloc;
+	CollisionController_Type.tp_new = PyType_GenericNew;
+	CollisionController_Type.tp_getattro = PyObject_GenericGetAttr;
+	if (PyType_Ready(&CollisionController_Type) < 0)
+		return;
+
+	FlockController_Type.tp_alloc = PyType_GenericAlloc;
+	FlockController_Type.tp_new = PyType_GenericNew;
+	FlockController_Type.tp_getattro = PyObject_GenericGetAttr;
+	if (PyType_Ready(&FlockController_Type) < 0)
+		return;
+
+	NBodyController_Type.tp_alloc = PyType_GenericAlloc;
+	NBodyController_Type.tp_new = PyType_GenericNew;
+	NBodyController_Type.tp_getattro = PyObject_GenericGetAttr;
+	if (PyType_Ready(&NBodyController_Type) < 0)
+		return;
+
 	MagnetController_Type.tp_alloc = PyType_GenericAlloc;
 	MagnetController_Type.tp_new = PyType_GenericNew;
 	MagnetController_Type.tp_getattro = PyObject_GenericGetAttr;
@@ -1864,6 +3320,12 @@ init_controller(void)
 	if (PyType_Ready(&DragController_Type) < 0)
 		return;
 
+	ClumperController_Type.tp_alloc = PyType_GenericAlloc;
+	ClumperController_Type.tp_new = PyType_GenericNew;
+	ClumperController_Type.tp_getattro = PyObject_GenericGetAttr;
+	if (PyType_Ready(&ClumperController_Type) < 0)
+		return;
+
 	/* Create the module and add the types */
 	m = Py_InitModule3("_controller", NULL, "Particle Controllers");
 	if (m == NULL)
@@ -1881,12 +3343,22 @@ init_controller(void)
 	PyModule_AddObject(m, "ColorBlender", (PyObject *)&ColorBlenderController_Type);
 	Py_INCREF(&GrowthController_Type);
 	PyModule_AddObject(m, "Growth", (PyObject *)&GrowthController_Type);
+	Py_INCREF(&EventBuffer_Type);
+	PyModule_AddObject(m, "EventBuffer", (PyObject *)&EventBuffer_Type);
 	Py_INCREF(&CollectorController_Type);
 	PyModule_AddObject(m, "Collector", (PyObject *)&CollectorController_Type);
 	Py_INCREF(&BounceController_Type);
 	PyModule_AddObject(m, "Bounce", (PyObject *)&BounceController_Type);
+	Py_INCREF(&CollisionController_Type);
+	PyModule_AddObject(m, "Collision", (PyObject *)&CollisionController_Type);
+	Py_INCREF(&FlockController_Type);
+	PyModule_AddObject(m, "Flock", (PyObject *)&FlockController_Type);
+	Py_INCREF(&NBodyController_Type);
+	PyModule_AddObject(m, "NBody", (PyObject *)&NBodyController_Type);
 	Py_INCREF(&MagnetController_Type);
 	PyModule_AddObject(m, "Magnet", (PyObject *)&MagnetController_Type);
 	Py_INCREF(&DragController_Type);
 	PyModule_AddObject(m, "Drag", (PyObject *)&DragController_Type);
+	Py_INCREF(&ClumperController_Type);
+	PyModule_AddObject(m, "Clumper", (PyObject *)&ClumperController_Type);
 }
@@ -0,0 +1,62 @@
+/****************************************************************************
+*
+* Copyright (c) 2009 by Casey Duncan and contributors
+* All Rights Reserved.
+*
+* This software is subject to the provisions of the MIT License
+* A copy of the license should accompany this distribution.
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*
+****************************************************************************/
+/* Native emitter interface for use by other modules
+ *
+ * The emitter module exports this table of functions through the
+ * lepton.emitter._emitter_api CObject, so that controllers can spawn
+ * particles from a StaticEmitter without calling back into Python.
+ *
+ * $Id$
+ */
+
+#ifndef _EMITTER_H_
+#define _EMITTER_H_
+
+#include "group.h"
+
+typedef struct {
+	/* Return true if o is a StaticEmitter */
+	int (*check)(PyObject *o);
+
+	/* Emit count particles from emitter into group, with the position and
+	 * velocity of each relative to the position and velocity given. Return
+	 * true on success, false on failure with an exception set.
+	 */
+	int (*emit_from)(PyObject *emitter, GroupObject *group, unsigned long count,
+		Vec3 *position, Vec3 *velocity);
+} EmitterAPI;
+
+/* Return the emitter interface, or NULL with an exception set if it cannot
+ * be found.
+ */
+static inline EmitterAPI *
+EmitterAPI_get(void)
+{
+	static EmitterAPI *api = NULL;
+	PyObject *m, *c;
+
+	if (api == NULL) {
+		m = PyImport_ImportModule("lepton.emitter");
+		if (m == NULL)
+			return NULL;
+		c = PyObject_GetAttrString(m, "_emitter_api");
+		Py_DECREF(m);
+		if (c == NULL)
+			return NULL;
+		api = (EmitterAPI *)PyCObject_AsVoidPtr(c);
+		Py_DECREF(c);
+	}
+	return api;
+}
+
+#endif
@@ -21,6 +21,8 @@
 #include "fastrng.h"
 #include "group.h"
 #include "vector.h"
+#include "emitter.h"
+#include "parallel.h"
 
 static PyTypeObject StaticEmitter_Type;
 
@@ -385,6 +387,71 @@ Emitter_make_particle(StaticEmitterObject *self, Particle *p)
 	return 1;
 }
 
+/* Return true if the emitter makes particles from its template and
+ * deviation alone, without domains or discrete values. Such particles
+ * can be made by Emitter_make_particle_r() without the GIL.
+ */
+static int
+Emitter_is_native(StaticEmitterObject *self)
+{
+	int i;
+
+	for (i = 0; i < DISCRETE_COUNT; i++) {
+		if (self->domain[i] != NULL || self->discrete[i] != NULL)
+			return 0;
+	}
+	return 1;
+}
+
+static inline void
+Vec3_deviate_r(Vec3 *dest, Vec3 *deviation, RandState *rng)
+{
+	dest->x = deviation->x ? rand_state_norm(rng, dest->x, deviation->x) : dest->x;
+	dest->y = deviation->y ? rand_state_norm(rng, dest->y, deviation->y) : dest->y;
+	dest->z = deviation->z ? rand_state_norm(rng, dest->z, deviation->z) : dest->z;
+}
+
+static inline void
+Color_deviate_r(Color *dest, Color *deviation, RandState *rng)
+{
+	dest->r = deviation->r ? rand_state_norm(rng, dest->r, deviation->r) : dest->r;
+	dest->g = deviation->g ? rand_state_norm(rng, dest->g, deviation->g) : dest->g;
+	dest->b = deviation->b ? rand_state_norm(rng, dest->b, deviation->b) : dest->b;
+	dest->a = deviation->a ? rand_state_norm(rng, dest->a, deviation->a) : dest->a;
+}
+
+/* Populate a particle at position from the emitter's template and
+ * deviation, drawing from the generator state specified. The emitter must
+ * be native, this is safe to call without the GIL.
+ */
+static void
+Emitter_make_particle_r(StaticEmitterObject *self, Particle *p, Vec3 *position,
+	RandState *rng)
+{
+	Particle *dev = &self->pdeviation;
+
+	Vec3_copy(&p->position, position);
+	Vec3_copy(&p->velocity, &self->ptemplate.velocity);
+	Vec3_copy(&p->size, &self->ptemplate.size);
+	Vec3_copy(&p->up, &self->ptemplate.up);
+	Vec3_copy(&p->rotation, &self->ptemplate.rotation);
+	Color_copy(&p->color, &self->ptemplate.color);
+	p->age = self->ptemplate.age;
+	p->mass = self->ptemplate.mass;
+	if (self->has_deviation) {
+		Vec3_deviate_r(&p->position, &dev->position, rng);
+		Vec3_deviate_r(&p->velocity, &dev->velocity, rng);
+		Vec3_deviate_r(&p->size, &dev->size, rng);
+		Vec3_deviate_r(&p->up, &dev->up, rng);
+		Vec3_deviate_r(&p->rotation, &dev->rotation, rng);
+		Color_deviate_r(&p->color, &dev->color, rng);
+		p->age = dev->age ? rand_state_norm(rng, p->age, dev->age) : p->age;
+		p->mass = dev->mass ? rand_state_norm(rng, p->mass, dev->mass) : p->mass;
+	}
+	if (p->age < 0)
+		p->age = 0;
+}
+
 static PyObject *
 StaticEmitter_call(StaticEmitterObject *self, PyObject *args)
 {
@@ -442,7 +509,7 @@ Emitter_emit(StaticEmitterObject *self, PyObject *args)
 	GroupObject *pgroup;
 	long pindex;
 
-	if (!PyArg_ParseTuple(args, "iO:emit", &count, &pgroup))
+	if (!PyArg_ParseTuple(args, "lO:emit", &count, &pgroup))
 		return NULL;
 	
 	if (!GroupObject_Check(pgroup))
@@ -468,6 +535,37 @@ Emitter_emit(StaticEmitterObject *self, PyObject *args)
 	return Py_None;
 }
 
+static int
+Emitter_check(PyObject *o)
+{
+	return PyObject_TypeCheck(o, &StaticEmitter_Type);
+}
+
+/* Emit particles relative to a parent particle for other native modules */
+static int
+Emitter_emit_from(PyObject *emitter, GroupObject *pgroup, unsigned long count,
+	Vec3 *position, Vec3 *velocity)
+{
+	long pindex;
+	Particle *p;
+
+	while (count--) {
+		pindex = Group_new_p(pgroup);
+		if (pindex < 0) {
+			PyErr_NoMemory();
+			return 0;
+		}
+		p = &pgroup->plist->p[pindex];
+		if (!Emitter_make_particle((StaticEmitterObject *)emitter, p))
+			return 0;
+		Vec3_addi(&p->position, position);
+		Vec3_addi(&p->velocity, velocity);
+	}
+	return 1;
+}
+
+static EmitterAPI emitter_api = {Emitter_check, Emitter_emit_from};
+
 static struct PyMemberDef StaticEmitter_members[] = {
     {"rate", T_FLOAT, offsetof(StaticEmitterObject, rate), 0,
         "Rate of particle emission per unit time"},
@@ -476,12 +574,22 @@ static struct PyMemberDef StaticEmitter_members[] = {
 	{NULL}
 };
 
+/* Emitters only add particles, so they run as usual in analytic groups */
+static PyObject *
+Emitter_analytic(PyObject *self)
+{
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
 static PyMethodDef StaticEmitter_methods[] = {
 	{"emit", (PyCFunction)Emitter_emit, METH_VARARGS,
 		PyDoc_STR("emit(count, group) -> None\n"
 			"Emit count new particles into the group specified.\n"
 			"This call is not affected by the emitter rate or\n"
 			"time to live values.")},
+	{"_analytic", (PyCFunction)Emitter_analytic, METH_NOARGS,
+		PyDoc_STR("Return None, emitters are supported by analytic groups")},
 	{NULL,		NULL}		/* sentinel */
 };
 
@@ -591,10 +699,132 @@ typedef struct {
 	GroupObject *source_group;
 } PerParticleEmitterObject;
 
+/* Return a new reference to the group holding the current state of the
+ * source group's particles, evaluated if it is analytic, held until
+ * GroupObject_EndDraw() is called. The source group may have been
+ * reassigned, so it is checked first. Return NULL on failure with an
+ * exception set.
+ */
+static GroupObject *
+Emitter_begin_source(GroupObject *source_group)
+{
+	if (source_group == NULL) {
+		PyErr_SetString(PyExc_TypeError, "Expected ParticleGroup object");
+		return NULL;
+	}
+	if (!GroupObject_Check(source_group))
+		return NULL;
+	return GroupObject_BeginRead(source_group);
+}
+
+/* Minimum number of particles spawned per chunk when emitting across threads */
+#define SPAWN_MIN_CHUNK 4096
+
+/* Spawn of a fixed number of particles for each live source particle. The
+ * source particles are split into chunks, the live particles in each are
+ * counted, then the chunks fill their share of the target slots reserved
+ * for all of them at once.
+ */
+typedef struct {
+	StaticEmitterObject *emitter;
+	Particle *source;
+	unsigned long source_count;
+	unsigned long chunks;
+	unsigned long per_source;
+	Particle *dest;
+	/* Live source particles in each chunk, then the number in the chunks
+	   before each after the prefix sum */
+	unsigned long offset[PARALLEL_MAX_CHUNKS + 1];
+	RandState rng[PARALLEL_MAX_CHUNKS];
+} SpawnJob;
+
+/* Return the first of count source particles in chunk of chunks */
+static inline unsigned long
+Spawn_chunk_start(unsigned long count, unsigned long chunks, unsigned long chunk)
+{
+	return chunk * (count / chunks) + chunk * (count % chunks) / chunks;
+}
+
+static void
+SpawnJob_count(SpawnJob *job, unsigned long unused, 
+	unsigned long start, unsigned long end)
+{
+	unsigned long c, i, last, live;
+
+	for (c = start; c < end; c++) {
+		live = 0;
+		last = Spawn_chunk_start(job->source_count, job->chunks, c + 1);
+		for (i = Spawn_chunk_start(job->source_count, job->chunks, c); i < last; i++)
+			live += Particle_IsAlive(job->source[i]);
+		job->offset[c + 1] = live;
+	}
+}
+
+static void
+SpawnJob_fill(SpawnJob *job, unsigned long unused, 
+	unsigned long start, unsigned long end)
+{
+	unsigned long c, i, last, n;
+	Particle *p;
+
+	for (c = start; c < end; c++) {
+		p = job->dest + job->offset[c] * job->per_source;
+		last = Spawn_chunk_start(job->source_count, job->chunks, c + 1);
+		for (i = Spawn_chunk_start(job->source_count, job->chunks, c); i < last; i++) {
+			if (Particle_IsAlive(job->source[i])) {
+				for (n = job->per_source; n > 0; n--)
+					Emitter_make_particle_r(
+						job->emitter, p++, &job->source[i].position, &job->rng[c]);
+			}
+		}
+	}
+}
+
+/* Emit per_source particles into pgroup for each live particle of the
+ * source group, which must be native. The source particles are read from
+ * source, the group holding their current state. Return the number of live
+ * source particles, or -1 on failure with an exception set.
+ */
+static long
+PerParticleEmitter_spawn(PerParticleEmitterObject *self, GroupObject *source,
+	GroupObject *pgroup, unsigned long per_source)
+{
+	SpawnJob job;
+	unsigned long c, min_chunk;
+	long pindex;
+
+	job.emitter = (StaticEmitterObject *)self;
+	job.source = source->plist->p;
+	job.source_count = GroupObject_ActiveCount(source);
+	job.per_source = per_source;
+	min_chunk = SPAWN_MIN_CHUNK / per_source;
+	job.chunks = parallel_chunk_count(job.source_count, min_chunk);
+	job.offset[0] = 0;
+	parallel_for(job.chunks, 1, (ParallelFunc)SpawnJob_count, &job);
+	for (c = 0; c < job.chunks; c++) {
+		job.offset[c + 1] += job.offset[c];
+		rand_state_seed(&job.rng[c], rand_int32());
+	}
+	if (job.offset[job.chunks] == 0)
+		return 0;
+
+	pindex = Group_new_n(pgroup, job.offset[job.chunks] * per_source);
+	if (pindex < 0) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	/* The source particles move if the source is the target group */
+	job.source = source->plist->p;
+	job.dest = &pgroup->plist->p[pindex];
+	parallel_for(job.chunks, 1, (ParallelFunc)SpawnJob_fill, &job);
+	return job.offset[job.chunks];
+}
+
 static int
 PerParticleEmitter_init(PerParticleEmitterObject *self, PyObject *args, PyObject *kwargs)
 {
 	PyObject *ptemplate = NULL, *pdeviation = NULL;
+	GroupObject *source_group;
 	int i, success;
 
 	for (i = 0; i < DISCRETE_COUNT; i++) {
@@ -604,11 +834,15 @@ PerParticleEmitter_init(PerParticleEmitterObject *self, PyObject *args, PyObject
 	self->rate = -FLT_MAX;
 	self->time_to_live = NO_TTL;
 	if (!PyArg_ParseTuple(args, "O|fOOf:__init__",
-		&self->source_group, &self->rate, &ptemplate, &pdeviation, &self->time_to_live))
+		&source_group, &self->rate, &ptemplate, &pdeviation, &self->time_to_live))
 		return -1;
 	
-	if (!GroupObject_Check(self->source_group))
+	if (!GroupObject_Check(source_group))
 		return -1;
+	/* The source group is read when emitting, so it is kept alive */
+	Py_INCREF(source_group);
+	Py_XDECREF(self->source_group);
+	self->source_group = source_group;
 	
 	if (kwargs != NULL) {
 		if (!Emitter_parse_kwargs((StaticEmitterObject *)self, &ptemplate, &pdeviation, kwargs))
@@ -651,9 +885,9 @@ static PyObject *
 PerParticleEmitter_call(PerParticleEmitterObject *self, PyObject *args)
 {
 	float td;
-	GroupObject *pgroup;
+	GroupObject *pgroup, *source;
 	float count, remaining;
-	long pindex, total = 0;
+	long pindex, live, total = 0;
 	Particle *p;
 	unsigned long pcount;
 	PyObject *result;
@@ -680,10 +914,25 @@ PerParticleEmitter_call(PerParticleEmitterObject *self, PyObject *args)
 	}
 	count = td * self->rate + self->partial;
 	remaining = count;
+	if (count < 1.0f) {
+		self->partial = count;
+		return PyInt_FromLong(0);
+	}
 
-	if (count >= 1.0f) {
-		p = self->source_group->plist->p;
-		pcount = GroupObject_ActiveCount(self->source_group);
+	/* Analytic source groups are evaluated to spawn from their particles'
+	   current state */
+	source = Emitter_begin_source(self->source_group);
+	if (source == NULL)
+		return NULL;
+	if (Emitter_is_native((StaticEmitterObject *)self)) {
+		live = PerParticleEmitter_spawn(self, source, pgroup, (unsigned long)count);
+		if (live < 0)
+			goto error;
+		total = live * (long)count;
+		self->partial = live ? count - (long)count : count;
+	} else {
+		p = source->plist->p;
+		pcount = GroupObject_ActiveCount(source);
 
 		while (pcount--) {
 			if (Particle_IsAlive(*p)) {
@@ -694,11 +943,11 @@ PerParticleEmitter_call(PerParticleEmitterObject *self, PyObject *args)
 					pindex = Group_new_p(pgroup);
 					if (pindex < 0) {
 						PyErr_NoMemory();
-						return NULL;
+						goto error;
 					}
 					if (!Emitter_make_particle(
 						(StaticEmitterObject *)self, &pgroup->plist->p[pindex]))
-						return NULL;
+						goto error;
 					remaining--;
 				}
 				total += (long)count;
@@ -706,11 +955,14 @@ PerParticleEmitter_call(PerParticleEmitterObject *self, PyObject *args)
 			p++;
 		}
 		self->partial = remaining;
-	} else {
-		self->partial = count;
 	}
+	GroupObject_EndDraw(source);
 
 	return PyInt_FromLong(total);
+
+error:
+	GroupObject_EndDraw(source);
+	return NULL;
 }
 
 static PyObject *
@@ -718,11 +970,11 @@ PerParticleEmitter_emit(PerParticleEmitterObject *self, PyObject *args)
 {
 	long count, remaining;
 	unsigned long pcount;
-	GroupObject *pgroup;
+	GroupObject *pgroup, *source;
 	Particle *p;
 	long pindex;
 
-	if (!PyArg_ParseTuple(args, "iO:__init__", &count, &pgroup))
+	if (!PyArg_ParseTuple(args, "lO:__init__", &count, &pgroup))
 		return NULL;
 	
 	if (!GroupObject_Check(pgroup))
@@ -733,8 +985,24 @@ PerParticleEmitter_emit(PerParticleEmitterObject *self, PyObject *args)
 	if (count < 0)
 		count = 0;
 
-	p = self->source_group->plist->p;
-	pcount = GroupObject_ActiveCount(self->source_group);
+	if (count == 0) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+
+	source = Emitter_begin_source(self->source_group);
+	if (source == NULL)
+		return NULL;
+	if (Emitter_is_native((StaticEmitterObject *)self)) {
+		if (PerParticleEmitter_spawn(self, source, pgroup, count) < 0)
+			goto error;
+		GroupObject_EndDraw(source);
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+
+	p = source->plist->p;
+	pcount = GroupObject_ActiveCount(source);
 
 	while (pcount--) {
 		if (Particle_IsAlive(*p)) {
@@ -745,19 +1013,24 @@ PerParticleEmitter_emit(PerParticleEmitterObject *self, PyObject *args)
 				pindex = Group_new_p(pgroup);
 				if (pindex < 0) {
 					PyErr_NoMemory();
-					return NULL;
+					goto error;
 				}
 				if (!Emitter_make_particle(
 					(StaticEmitterObject *)self, &pgroup->plist->p[pindex])) {
-					return NULL;
+					goto error;
 				}
 			}
 		}
 		p++;
 	}
+	GroupObject_EndDraw(source);
 
 	Py_INCREF(Py_None);
 	return Py_None;
+
+error:
+	GroupObject_EndDraw(source);
+	return NULL;
 }
 
 static struct PyMemberDef PerParticleEmitter_members[] = {
@@ -776,9 +1049,18 @@ static PyMethodDef PerParticleEmitter_methods[] = {
 			"Emit count new particles per source particle into the\n"
 			"group specified. This call is not affected by the emitter\n" 
 			"rate or time to live values.")},
+	{"_analytic", (PyCFunction)Emitter_analytic, METH_NOARGS,
+		PyDoc_STR("Return None, emitters are supported by analytic groups")},
 	{NULL,		NULL}		/* sentinel */
 };
 
+static void
+PerParticleEmitter_dealloc(PerParticleEmitterObject *self)
+{
+	Py_CLEAR(self->source_group);
+	Emitter_dealloc((StaticEmitterObject *)self);
+}
+
 static PyObject *
 PerParticleEmitter_getattr(PerParticleEmitterObject *self, PyObject *o)
 {
@@ -835,7 +1117,7 @@ static PyTypeObject PerParticleEmitter_Type = {
 	sizeof(PerParticleEmitterObject),	/*tp_basicsize*/
 	0,			/*tp_itemsize*/
 	/* methods */
-	(destructor)Emitter_dealloc, /*tp_dealloc*/
+	(destructor)PerParticleEmitter_dealloc, /*tp_dealloc*/
 	0,			/*tp_print*/
 	0,   /*tp_getattr*/
 	0,          /*tp_setattr*/
@@ -875,6 +1157,470 @@ static PyTypeObject PerParticleEmitter_Type = {
 
 /* --------------------------------------------------------------------- */
 
+static PyTypeObject TrailEmitter_Type;
+
+typedef struct {
+	PyObject_HEAD
+	Particle ptemplate;
+	Particle pdeviation;
+	int has_deviation;
+	float rate;
+	float partial;
+	float time_to_live;
+	PyObject *domain[DISCRETE_COUNT];
+	PyObject *discrete[DISCRETE_COUNT];
+	GroupObject *source_group;
+	float density;
+	float inherit_velocity;
+	int inherit_color;
+} TrailEmitterObject;
+
+static int
+TrailEmitter_init(TrailEmitterObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *ptemplate = NULL, *pdeviation = NULL, *value;
+	GroupObject *source_group;
+	int i, success;
+
+	for (i = 0; i < DISCRETE_COUNT; i++) {
+		self->domain[i] = NULL;
+		self->discrete[i] = NULL;
+	}
+	self->rate = -FLT_MAX;
+	self->time_to_live = NO_TTL;
+	self->density = 0.0f;
+	self->inherit_velocity = 0.0f;
+	self->inherit_color = 0;
+	if (!PyArg_ParseTuple(args, "O|fOOf:__init__",
+		&source_group, &self->rate, &ptemplate, &pdeviation, &self->time_to_live))
+		return -1;
+	
+	if (!GroupObject_Check(source_group))
+		return -1;
+	/* The source group is read when emitting, so it is kept alive */
+	Py_INCREF(source_group);
+	Py_XDECREF(self->source_group);
+	self->source_group = source_group;
+	
+	if (kwargs != NULL) {
+		/* Pick out our own options before the common ones are parsed */
+		value = PyDict_GetItemString(kwargs, "density");
+		if (value != NULL) {
+			self->density = (float)PyFloat_AsDouble(value);
+			if (PyErr_Occurred())
+				return -1;
+			PyDict_DelItemString(kwargs, "density");
+		}
+		value = PyDict_GetItemString(kwargs, "inherit_velocity");
+		if (value != NULL) {
+			self->inherit_velocity = (float)PyFloat_AsDouble(value);
+			if (PyErr_Occurred())
+				return -1;
+			PyDict_DelItemString(kwargs, "inherit_velocity");
+		}
+		value = PyDict_GetItemString(kwargs, "inherit_color");
+		if (value != NULL) {
+			self->inherit_color = PyObject_IsTrue(value);
+			if (self->inherit_color < 0)
+				return -1;
+			PyDict_DelItemString(kwargs, "inherit_color");
+		}
+		if (!Emitter_parse_kwargs((StaticEmitterObject *)self, &ptemplate, &pdeviation, kwargs))
+			return -1;
+		if (!Emitter_is_native((StaticEmitterObject *)self)) {
+			PyErr_SetString(PyExc_TypeError, 
+				"TrailEmitter: domains and discrete values are not supported");
+			goto error;
+		}
+	} else {
+		Py_XINCREF(ptemplate);
+		Py_XINCREF(pdeviation);
+	}
+
+	if (self->rate == -FLT_MAX) {
+		self->rate = 0;
+	} else if (self->rate < 0) {
+		PyErr_SetString(PyExc_ValueError, "TrailEmitter: Expected rate >= 0");
+		goto error;
+	}
+	if (self->density < 0) {
+		PyErr_SetString(PyExc_ValueError, "TrailEmitter: Expected density >= 0");
+		goto error;
+	}
+
+	if (ptemplate != NULL) {
+		success = Emitter_fill_particle_from(&self->ptemplate, ptemplate);
+		Py_CLEAR(ptemplate);
+		if (!success)
+			goto error;
+	}
+	
+	if (pdeviation != NULL) {
+		success = Emitter_fill_particle_from(&self->pdeviation, pdeviation);
+		Py_CLEAR(pdeviation);
+		if (!success)
+			goto error;
+		self->has_deviation = 1;
+	} else {
+		self->has_deviation = 0;
+	}
+	
+	return 0;
+
+error:
+	Py_XDECREF(ptemplate);
+	Py_XDECREF(pdeviation);
+	return -1;
+}
+
+/* Trail spawn across threads. Unlike SpawnJob, the number of particles
+ * varies per source particle with the length of its motion, and is
+ * recomputed identically by the fill pass from the same random stream.
+ */
+typedef struct {
+	TrailEmitterObject *emitter;
+	Particle *source;
+	unsigned long source_count;
+	unsigned long chunks;
+	float td;
+	float per_source; /* Particles per source particle, before density */
+	Particle *dest;
+	unsigned long offset[PARALLEL_MAX_CHUNKS + 1];
+	unsigned long seed[PARALLEL_MAX_CHUNKS]; /* Seeds for counting */
+	RandState rng[PARALLEL_MAX_CHUNKS];      /* Streams for making particles */
+} TrailJob;
+
+/* Return the number of particles to emit along the motion of source
+ * particle p. The fractional part is rounded randomly so that the
+ * expected count is exact.
+ */
+static inline unsigned long
+TrailJob_particle_count(TrailJob *job, Particle *p, RandState *rng)
+{
+	Vec3 motion;
+	float n = job->per_source;
+
+	if (job->emitter->density > 0) {
+		Vec3_sub(&motion, &p->position, &p->last_position);
+		n += job->emitter->density * Vec3_len(&motion);
+	}
+	return (unsigned long)(n + (rand_state_int32(rng) >> 8) * (1.0f / 16777216.0f));
+}
+
+static void
+TrailJob_count(TrailJob *job, unsigned long unused, 
+	unsigned long start, unsigned long end)
+{
+	unsigned long c, i, last, total;
+	RandState rng;
+
+	for (c = start; c < end; c++) {
+		total = 0;
+		rand_state_seed(&rng, job->seed[c]);
+		last = Spawn_chunk_start(job->source_count, job->chunks, c + 1);
+		for (i = Spawn_chunk_start(job->source_count, job->chunks, c); i < last; i++) {
+			if (Particle_IsAlive(job->source[i]))
+				total += TrailJob_particle_count(job, &job->source[i], &rng);
+		}
+		job->offset[c + 1] = total;
+	}
+}
+
+/* Make the n particles along the motion of source particle src */
+static inline Particle *
+TrailJob_make_particles(TrailJob *job, Particle *p, Particle *src, 
+	unsigned long n, RandState *rng)
+{
+	TrailEmitterObject *self = job->emitter;
+	Vec3 position, velocity;
+	unsigned long k;
+	float t;
+
+	for (k = 1; k <= n; k++, p++) {
+		/* Space the particles evenly, ending at the current position so
+		   that consecutive segments join seamlessly */
+		t = (float)k / n;
+		Vec3_lerp(&position, t, &src->last_position, &src->position);
+		Emitter_make_particle_r((StaticEmitterObject *)self, p, &position, rng);
+		if (self->inherit_velocity != 0) {
+			Vec3_lerp(&velocity, t, &src->last_velocity, &src->velocity);
+			Vec3_scalar_muli(&velocity, self->inherit_velocity);
+			Vec3_addi(&p->velocity, &velocity);
+		}
+		if (self->inherit_color) {
+			p->color.r += src->color.r - self->ptemplate.color.r;
+			p->color.g += src->color.g - self->ptemplate.color.g;
+			p->color.b += src->color.b - self->ptemplate.color.b;
+			p->color.a += src->color.a - self->ptemplate.color.a;
+		}
+		/* Particles further back were emitted earlier */
+		p->age += (1.0f - t) * job->td;
+	}
+	return p;
+}
+
+static void
+TrailJob_fill(TrailJob *job, unsigned long unused, 
+	unsigned long start, unsigned long end)
+{
+	unsigned long c, i, last, n;
+	RandState count_rng;
+	Particle *p;
+
+	for (c = start; c < end; c++) {
+		p = job->dest + job->offset[c];
+		rand_state_seed(&count_rng, job->seed[c]);
+		last = Spawn_chunk_start(job->source_count, job->chunks, c + 1);
+		for (i = Spawn_chunk_start(job->source_count, job->chunks, c); i < last; i++) {
+			if (Particle_IsAlive(job->source[i])) {
+				n = TrailJob_particle_count(job, &job->source[i], &count_rng);
+				p = TrailJob_make_particles(job, p, &job->source[i], n, &job->rng[c]);
+			}
+		}
+	}
+}
+
+/* Emit particles into pgroup along the motion of each live particle of the
+ * source group, per_source for each plus the density times the length of
+ * its motion. Return the number of particles emitted, or -1 on failure with
+ * an exception set.
+ */
+static long
+TrailEmitter_spawn(TrailEmitterObject *self, GroupObject *pgroup,
+	float per_source, float td)
+{
+	TrailJob job;
+	GroupObject *source;
+	unsigned long c;
+	long pindex;
+
+	/* Analytic source groups are evaluated to spawn along their 
+	   particles' current motion */
+	source = Emitter_begin_source(self->source_group);
+	if (source == NULL)
+		return -1;
+	job.emitter = self;
+	job.source = source->plist->p;
+	job.source_count = GroupObject_ActiveCount(source);
+	job.td = td;
+	job.per_source = per_source;
+	job.chunks = parallel_chunk_count(job.source_count, SPAWN_MIN_CHUNK / 8);
+	for (c = 0; c < job.chunks; c++) {
+		job.seed[c] = rand_int32();
+		rand_state_seed(&job.rng[c], rand_int32());
+	}
+	job.offset[0] = 0;
+	parallel_for(job.chunks, 1, (ParallelFunc)TrailJob_count, &job);
+	for (c = 0; c < job.chunks; c++)
+		job.offset[c + 1] += job.offset[c];
+	if (job.offset[job.chunks] == 0) {
+		GroupObject_EndDraw(source);
+		return 0;
+	}
+
+	pindex = Group_new_n(pgroup, job.offset[job.chunks]);
+	if (pindex < 0) {
+		GroupObject_EndDraw(source);
+		PyErr_NoMemory();
+		return -1;
+	}
+	/* The source particles move if the source is the target group */
+	job.source = source->plist->p;
+	job.dest = &pgroup->plist->p[pindex];
+	parallel_for(job.chunks, 1, (ParallelFunc)TrailJob_fill, &job);
+	GroupObject_EndDraw(source);
+	return job.offset[job.chunks];
+}
+
+static PyObject *
+TrailEmitter_call(TrailEmitterObject *self, PyObject *args)
+{
+	float td;
+	GroupObject *pgroup;
+	long total;
+	PyObject *result;
+
+	if (!PyArg_ParseTuple(args, "fO:__init__", &td, &pgroup))
+		return NULL;
+	
+	if (!GroupObject_Check(pgroup))
+		return NULL;
+
+	if (self->time_to_live != NO_TTL) {
+		if (self->time_to_live > td) {
+			self->time_to_live -= td;
+		} else {
+			/* time's up, remove ourselves from the group */
+			td = self->time_to_live;
+			self->time_to_live = 0;
+			result = PyObject_CallMethod((PyObject *)pgroup, "unbind_controller", 
+				"O", (PyObject *)self);
+			if (result == NULL)
+				return NULL;
+			Py_DECREF(result);
+		}
+	}
+	total = TrailEmitter_spawn(self, pgroup, td * self->rate, td);
+	if (total < 0)
+		return NULL;
+	return PyInt_FromLong(total);
+}
+
+static PyObject *
+TrailEmitter_emit(TrailEmitterObject *self, PyObject *args)
+{
+	long count;
+	GroupObject *pgroup;
+
+	if (!PyArg_ParseTuple(args, "lO:emit", &count, &pgroup))
+		return NULL;
+	
+	if (!GroupObject_Check(pgroup))
+		return NULL;
+	
+	/* Clamp to zero to gracefully handle random input values that 
+	 * occasionally go negative */
+	if (count < 0)
+		count = 0;
+
+	if (TrailEmitter_spawn(self, pgroup, (float)count, 0.0f) < 0)
+		return NULL;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static struct PyMemberDef TrailEmitter_members[] = {
+    {"rate", T_FLOAT, offsetof(TrailEmitterObject, rate), 0,
+        "Number of particles per particle in the source group emitted per unit time"},
+    {"time_to_live", T_FLOAT, offsetof(TrailEmitterObject, time_to_live), 0,
+        "Time remaining before emitter is removed from the group (-1 to disable)"},
+    {"source_group", T_OBJECT, offsetof(TrailEmitterObject, source_group), 0,
+        "Source particle group containing template particles"},
+    {"density", T_FLOAT, offsetof(TrailEmitterObject, density), 0,
+        "Number of particles emitted per unit distance moved by each source particle"},
+    {"inherit_velocity", T_FLOAT, offsetof(TrailEmitterObject, inherit_velocity), 0,
+        "Fraction of the source particle's velocity added to emitted particles"},
+    {"inherit_color", T_INT, offsetof(TrailEmitterObject, inherit_color), 0,
+        "True to emit particles with the color of their source particle"},
+	{NULL}
+};
+
+static PyMethodDef TrailEmitter_methods[] = {
+	{"emit", (PyCFunction)TrailEmitter_emit, METH_VARARGS,
+		PyDoc_STR("emit(count, group) -> None\n"
+			"Emit count new particles per source particle along its\n"
+			"last motion into the group specified, plus any for the\n"
+			"emitter density. This call is not affected by the emitter\n" 
+			"rate or time to live values.")},
+	{"_analytic", (PyCFunction)Emitter_analytic, METH_NOARGS,
+		PyDoc_STR("Return None, emitters are supported by analytic groups")},
+	{NULL,		NULL}		/* sentinel */
+};
+
+static PyObject *
+TrailEmitter_getattr(TrailEmitterObject *self, PyObject *o)
+{
+	char *name = PyString_AS_STRING(o);
+	struct PyMemberDef *member;
+
+	if (!strcmp(name, "template")) {
+		return (PyObject *)ParticleRefObject_New(NULL, &self->ptemplate);	
+	} else if (!strcmp(name, "deviation")) {
+		return (PyObject *)ParticleRefObject_New(NULL, &self->pdeviation);	
+	}
+	for (member = TrailEmitter_members; member->name != NULL; member++) {
+		if (!strcmp(name, member->name))
+			return PyMember_GetOne((char *)self, member);
+	}
+	return Py_FindMethod(TrailEmitter_methods, (PyObject *)self, name);
+}
+
+static void
+TrailEmitter_dealloc(TrailEmitterObject *self)
+{
+	Py_CLEAR(self->source_group);
+	Emitter_dealloc((StaticEmitterObject *)self);
+}
+
+PyDoc_STRVAR(TrailEmitter__doc__, 
+	"Creates particles along the path of each particle in a source group,\n"
+	"from its last position to its current position, so that fast moving\n"
+	"particles leave continuous trails without high emission rates.\n\n"
+	"TrailEmitter(source_group, rate=0, template=None, deviation=None,\n"
+	"    time_to_live=None, density=0, inherit_velocity=0,\n"
+	"    inherit_color=False)\n\n"
+	"source_group -- Source particles whose motion is followed. The source\n"
+	"group should be updated before the group this emitter is bound to.\n\n"
+	"rate -- Emission rate in particles per source particle per unit time.\n\n"
+	"template -- A Particle instance used as the basis (mathematical\n"
+	"average) for the emitted particles' attributes. The position is\n"
+	"always taken from the path of the source particle.\n\n"
+	"deviation -- A Particle instance used as the standard deviation for\n"
+	"randomizing the particle attributes.\n\n"
+	"time_to_live -- If specified, the emitter will unbind itself from\n"
+	"its calling group after the specified time has elapsed.\n\n"
+	"density -- Particles emitted per unit distance moved by each source\n"
+	"particle, in addition to those emitted for the rate.\n\n"
+	"inherit_velocity -- Fraction of the source particle's velocity added\n"
+	"to the emitted particles' velocity, interpolated from its last\n"
+	"velocity along the path.\n\n"
+	"inherit_color -- If true, emitted particles take the color of their\n"
+	"source particle, plus any deviation.\n\n"
+	"The particles emitted for each source particle are spaced evenly along\n"
+	"its path, and aged by the time since the source passed them. Fractional\n"
+	"counts are rounded randomly, so that the average count is exact.\n"
+	"Particles are made natively across threads, so domains and discrete\n"
+	"values are not supported.");
+
+static PyTypeObject TrailEmitter_Type = {
+	/* The ob_type field must be initialized in the module init function
+	 * to be portable to Windows without using C++. */
+	PyObject_HEAD_INIT(NULL)
+	0,			/*ob_size*/
+	"emitter.TrailEmitter",		/*tp_name*/
+	sizeof(TrailEmitterObject),	/*tp_basicsize*/
+	0,			/*tp_itemsize*/
+	/* methods */
+	(destructor)TrailEmitter_dealloc, /*tp_dealloc*/
+	0,			/*tp_print*/
+	0,   /*tp_getattr*/
+	0,          /*tp_setattr*/
+	0,			/*tp_compare*/
+	0,			/*tp_repr*/
+	0,			/*tp_as_number*/
+	0,	        /*tp_as_sequence*/
+	0,			/*tp_as_mapping*/
+	0,			/*tp_hash*/
+	(ternaryfunc)TrailEmitter_call, /*tp_call*/
+	0,                      /*tp_str*/
+	(getattrofunc)TrailEmitter_getattr, /*tp_getattro*/
+	0,                      /*tp_setattro*/
+	0,                      /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT,     /*tp_flags*/
+	TrailEmitter__doc__,   /*tp_doc*/
+	0,                      /*tp_traverse*/
+	0,                      /*tp_clear*/
+	0,                      /*tp_richcompare*/
+	0,                      /*tp_weaklistoffset*/
+	0,                      /*tp_iter*/
+	0,                      /*tp_iternext*/
+	TrailEmitter_methods,  /*tp_methods*/
+	TrailEmitter_members,  /*tp_members*/
+	0,                      /*tp_getset*/
+	0,                      /*tp_base*/
+	0,                      /*tp_dict*/
+	0,                      /*tp_descr_get*/
+	0,                      /*tp_descr_set*/
+	0,                      /*tp_dictoffset*/
+	(initproc)TrailEmitter_init, /*tp_init*/
+	0,                      /*tp_alloc*/
+	0,                      /*tp_new*/
+	0,                      /*tp_free*/
+	0,                      /*tp_is_gc*/
+};
+
+/* --------------------------------------------------------------------- */
+
 PyMODINIT_FUNC
 initemitter(void)
 {
@@ -891,6 +1637,11 @@ initemitter(void)
 	if (PyType_Ready(&PerParticleEmitter_Type) < 0)
 		return;
 
+	TrailEmitter_Type.tp_alloc = PyType_GenericAlloc;
+	TrailEmitter_Type.tp_new = PyType_GenericNew;
+	if (PyType_Ready(&TrailEmitter_Type) < 0)
+		return;
+
 	/* Create the module and add the types */
 	m = Py_InitModule3("emitter", NULL, "Particle Emitters");
 	if (m == NULL)
@@ -900,6 +1651,9 @@ initemitter(void)
 	PyModule_AddObject(m, "StaticEmitter", (PyObject *)&StaticEmitter_Type);
 	Py_INCREF(&PerParticleEmitter_Type);
 	PyModule_AddObject(m, "PerParticleEmitter", (PyObject *)&PerParticleEmitter_Type);
+	Py_INCREF(&TrailEmitter_Type);
+	PyModule_AddObject(m, "TrailEmitter", (PyObject *)&TrailEmitter_Type);
+	PyModule_AddObject(m, "_emitter_api", PyCObject_FromVoidPtr(&emitter_api, NULL));
 
 	rand_seed((unsigned long)time(NULL));
 }
@@ -173,7 +173,7 @@ norm_outlier(long hz, long iz)
 			return x;
 
 		/* Try again from the top and see if we can exit */
-		hz = rand_int32();
+		hz = (int)rand_int32();
 		iz = hz & 127;
 		if ((unsigned long)labs(hz) < kn[iz]) 
 			return hz * wn[iz];
@@ -189,7 +189,7 @@ norm_outlier(long hz, long iz)
 inline float
 rand_norm(const float mu, const float sigma)
 {
-	long hz = rand_int32();
+	long hz = (int)rand_int32();
 	long iz = hz & 127;
 	return mu + (((unsigned long)labs(hz) < kn[iz]) ? hz * wn[iz] : norm_outlier(hz, iz)) * sigma;
 }
@@ -237,3 +237,74 @@ rand_expo(const float mu)
 	return ((hz < ke[iz]) ? hz * we[iz] : expo_outlier(hz, iz)) * mu;
 }
 
+
+/*
+	Set the seed of a generator state
+*/
+void
+rand_state_seed(RandState *state, unsigned long s)
+{
+	state->jsr = (unsigned int)s ? (unsigned int)s : 123456789;
+	state->z = 362436069;
+	state->w = 521288629;
+	state->jcong = 380116160;
+	state->z = rand_state_int32(state) | 1;
+	state->w = rand_state_int32(state) | 1;
+	state->jcong = rand_state_int32(state);
+}
+
+/*
+   Generate a 32-bit random number from the state specified
+*/
+inline unsigned int
+rand_state_int32(RandState *state)
+{
+	unsigned int j = state->jsr;
+	state->jsr ^= state->jsr << 13;
+	state->jsr ^= state->jsr >> 17;
+	state->jsr ^= state->jsr << 5;
+	state->z = 36969 * (state->z & 65535) + (state->z >> 16);
+	state->w = 18000 * (state->w & 65535) + (state->w >> 16);
+	state->jcong = 69069 * state->jcong + 1234567;
+	return (((state->z << 16) + state->w) ^ state->jcong) + (j + state->jsr);
+}
+
+/*
+	Generate a random number with uniform distribution in the interval (0, 1.0]
+	from the state specified
+*/
+inline float
+rand_state_uni(RandState *state)
+{
+	return 0.5f + (int)rand_state_int32(state) * .2328306e-9f;
+}
+
+/*
+	Generate a random number with normal distribution from the state
+	specified, using the ziggurat tables setup by rand_seed()
+*/
+inline float
+rand_state_norm(RandState *state, const float mu, const float sigma)
+{
+	long hz, iz;
+	float x, y;
+
+	for (;;) {
+		hz = (int)rand_state_int32(state);
+		iz = hz & 127;
+		x = hz * wn[iz];
+		if ((unsigned long)labs(hz) < kn[iz])
+			return mu + x * sigma;
+		if (iz == 0) {
+			/* handle the base strip */
+			do { 
+				x = -logf(rand_state_uni(state)) * ONE_OVER_RIGHT_TAIL; 
+				y = -logf(rand_state_uni(state));
+			} while (y + y < x * x);
+			return mu + ((hz > 0) ? RIGHT_TAIL + x : -RIGHT_TAIL - x) * sigma;
+		}
+		/* handle the wedges of other strips */
+		if (fn[iz] + rand_state_uni(state)*(fn[iz-1] - fn[iz]) < expf(-0.5f * x*x)) 
+			return mu + x * sigma;
+	}
+}
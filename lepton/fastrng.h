@@ -52,4 +52,29 @@ rand_norm(const float mu, const float sigma);
 inline float
 rand_expo(const float mu);
 
+/* Independent generator state, so that concurrent threads can each draw
+ * from their own stream. The functions below are the same generators as
+ * above using this state, computed in 32 bits.
+ */
+typedef struct {
+	unsigned int jsr;
+	unsigned int z;
+	unsigned int w;
+	unsigned int jcong;
+} RandState;
+
+/* Seed the generator state. rand_seed() must have been called before
+   rand_state_norm() is used, to initialize its tables */
+void
+rand_state_seed(RandState *state, unsigned long s);
+
+inline unsigned int
+rand_state_int32(RandState *state);
+
+inline float
+rand_state_uni(RandState *state);
+
+inline float
+rand_state_norm(RandState *state, const float mu, const float sigma);
+
 #endif
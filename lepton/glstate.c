@@ -0,0 +1,241 @@
+/****************************************************************************
+*
+* Copyright (c) 2009 by Casey Duncan and contributors
+* All Rights Reserved.
+*
+* This software is subject to the provisions of the MIT License
+* A copy of the license should accompany this distribution.
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*
+****************************************************************************/
+/* Redundant GL state elimination for renderers and texturizers
+ *
+ * $Id$
+ */
+
+#include <Python.h>
+
+#include <GL/glew.h>
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+#ifdef __APPLE__
+#include <OpenGL/gl.h>
+#else
+#include <GL/gl.h>
+#endif
+
+#include "glstate.h"
+
+/* State saved for the duration of a batch */
+#define BATCH_ATTRIB_BITS (GL_ENABLE_BIT | GL_POINT_BIT | GL_TEXTURE_BIT)
+
+static const GLenum cap_enums[GLSTATE_CAPS] = {
+	GL_TEXTURE_2D, GL_TEXTURE_3D, GL_POINT_SPRITE};
+
+void
+GLState_invalidate(GLState *state)
+{
+	int i;
+
+	for (i = 0; i < GLSTATE_CAPS; i++)
+		state->enabled[i] = GLSTATE_UNKNOWN;
+	for (i = 0; i < 2; i++) {
+		state->texture[i] = GLSTATE_UNKNOWN;
+		state->tex_filter[i] = GLSTATE_UNKNOWN;
+		state->tex_wrap[i] = GLSTATE_UNKNOWN;
+	}
+	state->point_size = -1.0f;
+	state->coord_replace = GLSTATE_UNKNOWN;
+}
+
+void
+GLState_init(GLState *state)
+{
+	state->batch_depth = 0;
+	state->deferred = 0;
+	state->issued = 0;
+	state->skipped = 0;
+	GLState_invalidate(state);
+}
+
+GLState *
+GLState_get(void)
+{
+	static GLState *shared = NULL;
+	PyObject *m, *c;
+
+	if (shared == NULL) {
+		m = PyImport_ImportModule("lepton.renderer");
+		if (m == NULL)
+			return NULL;
+		c = PyObject_GetAttrString(m, "_gl_state");
+		Py_DECREF(m);
+		if (c == NULL)
+			return NULL;
+		shared = (GLState *)PyCObject_AsVoidPtr(c);
+		Py_DECREF(c);
+	}
+	return shared;
+}
+
+void
+GLState_begin_batch(GLState *state)
+{
+	if (state->batch_depth++ == 0) {
+		glPushAttrib(BATCH_ATTRIB_BITS);
+		GLState_invalidate(state);
+		state->deferred = 0;
+	}
+}
+
+void
+GLState_end_batch(GLState *state)
+{
+	if (state->batch_depth > 0 && --state->batch_depth == 0) {
+		glPopAttrib();
+		GLState_invalidate(state);
+		state->deferred = 0;
+	}
+}
+
+void
+GLState_flush(GLState *state)
+{
+	if (state->batch_depth > 0 && state->deferred) {
+		glPopAttrib();
+		glPushAttrib(BATCH_ATTRIB_BITS);
+		GLState_invalidate(state);
+		state->deferred = 0;
+		state->issued += 2;
+	}
+}
+
+int
+GLState_suspend(GLState *state)
+{
+	int depth = state->batch_depth;
+
+	GLState_flush(state);
+	state->batch_depth = 0;
+	return depth;
+}
+
+void
+GLState_resume(GLState *state, int depth)
+{
+	state->batch_depth = depth;
+	GLState_invalidate(state);
+}
+
+void
+GLState_push(GLState *state)
+{
+	if (state->batch_depth == 0) {
+		glPushAttrib(GL_ENABLE_BIT);
+		GLState_invalidate(state);
+		state->issued++;
+	} else {
+		state->skipped++;
+	}
+}
+
+void
+GLState_pop(GLState *state)
+{
+	if (state->batch_depth == 0) {
+		glPopAttrib();
+		GLState_invalidate(state);
+		state->issued++;
+	} else {
+		state->deferred = 1;
+		state->skipped++;
+	}
+}
+
+void
+GLState_enable(GLState *state, int cap, int enable)
+{
+	if (state->batch_depth > 0 && state->enabled[cap] == enable) {
+		state->skipped++;
+		return;
+	}
+	if (enable)
+		glEnable(cap_enums[cap]);
+	else
+		glDisable(cap_enums[cap]);
+	state->enabled[cap] = enable;
+	state->issued++;
+}
+
+void
+GLState_enable_texture(GLState *state, GLenum target)
+{
+	int cap = (target == GL_TEXTURE_3D) ? GLSTATE_TEXTURE_3D : GLSTATE_TEXTURE_2D;
+	int other = (cap == GLSTATE_TEXTURE_3D) ? GLSTATE_TEXTURE_2D : GLSTATE_TEXTURE_3D;
+
+	if (state->batch_depth > 0 && state->enabled[other] == 1)
+		GLState_enable(state, other, 0);
+	GLState_enable(state, cap, 1);
+}
+
+void
+GLState_bind_texture(GLState *state, GLenum target, GLuint texture,
+	GLint filter, GLint wrap)
+{
+	int t = (target == GL_TEXTURE_3D);
+
+	if (state->batch_depth > 0 && state->texture[t] == (GLint)texture) {
+		state->skipped++;
+	} else {
+		glBindTexture(target, texture);
+		state->texture[t] = texture;
+		/* The parameters belong to the texture */
+		state->tex_filter[t] = GLSTATE_UNKNOWN;
+		state->tex_wrap[t] = GLSTATE_UNKNOWN;
+		state->issued++;
+	}
+	if (state->batch_depth > 0 && state->tex_filter[t] == filter) {
+		state->skipped += 2;
+	} else {
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, filter);
+		state->tex_filter[t] = filter;
+		state->issued += 2;
+	}
+	if (state->batch_depth > 0 && state->tex_wrap[t] == wrap) {
+		state->skipped += 2;
+	} else {
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
+		state->tex_wrap[t] = wrap;
+		state->issued += 2;
+	}
+}
+
+void
+GLState_point_size(GLState *state, float size)
+{
+	if (state->batch_depth > 0 && state->point_size == size) {
+		state->skipped++;
+		return;
+	}
+	glPointSize(size);
+	state->point_size = size;
+	state->issued++;
+}
+
+void
+GLState_coord_replace(GLState *state, GLint replace)
+{
+	if (state->batch_depth > 0 && state->coord_replace == replace) {
+		state->skipped++;
+		return;
+	}
+	glTexEnvi(GL_POINT_SPRITE, GL_COORD_REPLACE, replace);
+	state->coord_replace = replace;
+	state->issued++;
+}
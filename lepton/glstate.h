@@ -0,0 +1,127 @@
+/****************************************************************************
+*
+* Copyright (c) 2009 by Casey Duncan and contributors
+* All Rights Reserved.
+*
+* This software is subject to the provisions of the MIT License
+* A copy of the license should accompany this distribution.
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*
+****************************************************************************/
+/* Redundant GL state elimination for renderers and texturizers
+ *
+ * The renderer and texturizer modules make their GL state changes through
+ * a single shared tracker, owned by the renderer module and found by the
+ * others through the lepton.renderer._gl_state CObject.
+ *
+ * Outside of a batch every call is issued, since the application may
+ * change GL state between draws. Inside a batch the tracker remembers the
+ * state it has set, skips calls that would not change it, and turns the
+ * push and pop of each texturizer into no-ops. The state in effect when
+ * the batch began is restored when it ends.
+ *
+ * $Id$
+ */
+
+#ifndef _GLSTATE_H_
+#define _GLSTATE_H_
+
+/* Tracked capabilities */
+#define GLSTATE_TEXTURE_2D 0
+#define GLSTATE_TEXTURE_3D 1
+#define GLSTATE_POINT_SPRITE 2
+#define GLSTATE_CAPS 3
+
+#define GLSTATE_UNKNOWN -1
+
+typedef struct {
+	int batch_depth;                 /* Nesting depth of begin_batch() */
+	int deferred;                    /* A pop was deferred in the batch */
+	int enabled[GLSTATE_CAPS];       /* 0, 1 or GLSTATE_UNKNOWN */
+	GLint texture[2];                /* Bound 2D and 3D textures */
+	GLint tex_filter[2];             /* Parameters last set for them */
+	GLint tex_wrap[2];
+	float point_size;
+	GLint coord_replace;
+	unsigned long issued;            /* GL calls made */
+	unsigned long skipped;           /* GL calls found redundant */
+} GLState;
+
+/* Initialize the state with everything unknown */
+void
+GLState_init(GLState *state);
+
+/* Return the state shared by all modules, or NULL with an exception set
+ * if it cannot be found.
+ */
+GLState *
+GLState_get(void);
+
+/* Begin a batch of draws. Saves the current enable, point and texture
+ * state, which is restored by the matching GLState_end_batch(). Batches
+ * may be nested, only the outermost has any effect.
+ */
+void
+GLState_begin_batch(GLState *state);
+
+void
+GLState_end_batch(GLState *state);
+
+/* Save the enable state before a texturizer changes it, and restore it
+ * afterward. Inside a batch the restore is deferred until the state is
+ * needed again by GLState_flush() or the batch ends.
+ */
+void
+GLState_push(GLState *state);
+
+void
+GLState_pop(GLState *state);
+
+/* Apply any deferred restore, returning to the state at the start of the
+ * batch. Called before drawing without a texturizer.
+ */
+void
+GLState_flush(GLState *state);
+
+/* Forget the tracked state after GL calls made outside of the tracker */
+void
+GLState_invalidate(GLState *state);
+
+/* Temporarily leave the batch so that other code sees the state as it
+ * was before the batch, returning the batch depth to pass to
+ * GLState_resume() afterward.
+ */
+int
+GLState_suspend(GLState *state);
+
+void
+GLState_resume(GLState *state, int depth);
+
+/* Enable or disable the tracked capability cap, one of GLSTATE_* */
+void
+GLState_enable(GLState *state, int cap, int enable);
+
+/* Enable texturing for target, GL_TEXTURE_2D or GL_TEXTURE_3D. Inside a
+ * batch, the other target is disabled if it was enabled in the batch, 
+ * since it would otherwise take precedence.
+ */
+void
+GLState_enable_texture(GLState *state, GLenum target);
+
+/* Bind texture to target, GL_TEXTURE_2D or GL_TEXTURE_3D, and set its
+ * filter and wrap parameters.
+ */
+void
+GLState_bind_texture(GLState *state, GLenum target, GLuint texture,
+	GLint filter, GLint wrap);
+
+void
+GLState_point_size(GLState *state, float size);
+
+/* Set GL_COORD_REPLACE for point sprites */
+void
+GLState_coord_replace(GLState *state, GLint replace);
+
+#endif
@@ -0,0 +1,162 @@
+/****************************************************************************
+*
+* Copyright (c) 2009 by Casey Duncan and contributors
+* All Rights Reserved.
+*
+* This software is subject to the provisions of the MIT License
+* A copy of the license should accompany this distribution.
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*
+****************************************************************************/
+/* Spatial hash grid for particle neighbor queries
+ *
+ * $Id$
+ */
+
+#include <Python.h>
+#include <math.h>
+#include "grid.h"
+
+#define GRID_MIN_TABLE 64
+#define GRID_MAX_COORD 1.0e9f
+
+void
+SpatialGrid_init(SpatialGrid *grid)
+{
+	grid->cell_size = 1.0f;
+	grid->inv_cell_size = 1.0f;
+	grid->table_mask = 0;
+	grid->count = 0;
+	grid->cell_start = NULL;
+	grid->indices = NULL;
+	grid->hashes = NULL;
+	grid->table_alloc = 0;
+	grid->index_alloc = 0;
+}
+
+void
+SpatialGrid_clear(SpatialGrid *grid)
+{
+	PyMem_Free(grid->cell_start);
+	PyMem_Free(grid->indices);
+	PyMem_Free(grid->hashes);
+	SpatialGrid_init(grid);
+}
+
+static inline long
+grid_coord(SpatialGrid *grid, float v)
+{
+	v = floorf(v * grid->inv_cell_size);
+	return (long)clamp(v, -GRID_MAX_COORD, GRID_MAX_COORD);
+}
+
+static inline unsigned long
+grid_hash(SpatialGrid *grid, long x, long y, long z)
+{
+	return ((unsigned long)x * 73856093UL ^ (unsigned long)y * 19349663UL
+		^ (unsigned long)z * 83492791UL) & grid->table_mask;
+}
+
+int
+SpatialGrid_build(SpatialGrid *grid, Particle *p, unsigned long count,
+	float cell_size)
+{
+	unsigned long table_size, i, h, total, n;
+	unsigned long *buf;
+
+	if (cell_size < EPSILON)
+		cell_size = EPSILON;
+	grid->cell_size = cell_size;
+	grid->inv_cell_size = 1.0f / cell_size;
+
+	table_size = GRID_MIN_TABLE;
+	while (table_size < count * 2)
+		table_size <<= 1;
+	if (table_size + 1 > grid->table_alloc) {
+		buf = PyMem_Realloc(grid->cell_start, sizeof(unsigned long) * (table_size + 1));
+		if (buf == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+		grid->cell_start = buf;
+		grid->table_alloc = table_size + 1;
+	}
+	if (count > grid->index_alloc) {
+		buf = PyMem_Realloc(grid->indices, sizeof(unsigned long) * count);
+		if (buf == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+		grid->indices = buf;
+		buf = PyMem_Realloc(grid->hashes, sizeof(unsigned long) * count);
+		if (buf == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+		grid->hashes = buf;
+		grid->index_alloc = count;
+	}
+	grid->table_mask = table_size - 1;
+	memset(grid->cell_start, 0, sizeof(unsigned long) * (table_size + 1));
+
+	/* Count the particles in each slot, dead particles are not indexed */
+	n = 0;
+	for (i = 0; i < count; i++) {
+		if (Particle_IsAlive(p[i])) {
+			h = grid_hash(grid, grid_coord(grid, p[i].position.x),
+				grid_coord(grid, p[i].position.y), grid_coord(grid, p[i].position.z));
+			grid->cell_start[h]++;
+			n++;
+		} else {
+			h = table_size; /* sentinel */
+		}
+		grid->hashes[i] = h;
+	}
+	grid->count = n;
+
+	/* Convert the counts to end offsets, then decrement them back to the
+	   start offsets as each particle is placed */
+	total = 0;
+	for (h = 0; h < table_size; h++) {
+		total += grid->cell_start[h];
+		grid->cell_start[h] = total;
+	}
+	grid->cell_start[table_size] = total;
+	for (i = count; i-- > 0;) {
+		h = grid->hashes[i];
+		if (h < table_size)
+			grid->indices[--grid->cell_start[h]] = i;
+	}
+	return 1;
+}
+
+int
+SpatialGrid_query_slots(SpatialGrid *grid, Vec3 *pos, unsigned long *slots)
+{
+	long cx, cy, cz, x, y, z;
+	unsigned long h;
+	int i, n = 0;
+
+	if (grid->count == 0)
+		return 0;
+	cx = grid_coord(grid, pos->x);
+	cy = grid_coord(grid, pos->y);
+	cz = grid_coord(grid, pos->z);
+	for (x = cx - 1; x <= cx + 1; x++) {
+		for (y = cy - 1; y <= cy + 1; y++) {
+			for (z = cz - 1; z <= cz + 1; z++) {
+				h = grid_hash(grid, x, y, z);
+				if (grid->cell_start[h] == grid->cell_start[h + 1])
+					continue; /* empty */
+				/* Hash collisions may map several cells to the same slot,
+				   which must only be visited once */
+				for (i = 0; i < n && slots[i] != h; i++);
+				if (i == n)
+					slots[n++] = h;
+			}
+		}
+	}
+	return n;
+}
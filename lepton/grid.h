@@ -0,0 +1,71 @@
+/****************************************************************************
+*
+* Copyright (c) 2009 by Casey Duncan and contributors
+* All Rights Reserved.
+*
+* This software is subject to the provisions of the MIT License
+* A copy of the license should accompany this distribution.
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*
+****************************************************************************/
+/* Spatial hash grid for particle neighbor queries
+ *
+ * Live particles are binned into uniform cubic cells which are hashed into
+ * a power of two sized table. The particle indices are then counting-sorted
+ * by cell so that the particles in each table slot are contiguous. Any
+ * particle within cell_size of a point is found in the 27 cells surrounding
+ * the point's cell. Hash collisions can put unrelated particles in the same
+ * slot, so queries must still test the actual distance.
+ *
+ * The grid keeps its buffers between builds to avoid reallocating them
+ * each frame.
+ *
+ * $Id$
+ */
+
+#include "group.h"
+
+#ifndef _GRID_H_
+#define _GRID_H_
+
+#define GRID_QUERY_CELLS 27
+
+typedef struct {
+	float			cell_size;
+	float			inv_cell_size;
+	unsigned long	table_mask;  /* table size - 1 */
+	unsigned long	count;       /* Number of particles indexed */
+	unsigned long	*cell_start; /* Table of start offsets into indices */
+	unsigned long	*indices;    /* Particle indices sorted by cell */
+	unsigned long	*hashes;     /* Cell hash for each particle */
+	unsigned long	table_alloc;
+	unsigned long	index_alloc;
+} SpatialGrid;
+
+/* Initialize an empty grid */
+void
+SpatialGrid_init(SpatialGrid *grid);
+
+/* Free the grid's buffers */
+void
+SpatialGrid_clear(SpatialGrid *grid);
+
+/* Index the live particles in the array of count particles into cells of
+ * the size specified. Return true on success, false on failure with an
+ * exception set. Must be called with the GIL held.
+ */
+int
+SpatialGrid_build(SpatialGrid *grid, Particle *p, unsigned long count,
+	float cell_size);
+
+/* Store the distinct table slots of the cells surrounding pos in slots
+ * and return their number, which is at most GRID_QUERY_CELLS. The
+ * particles in slot s are grid->indices[cell_start[s]:cell_start[s+1]].
+ * Safe to call concurrently once the grid is built.
+ */
+int
+SpatialGrid_query_slots(SpatialGrid *grid, Vec3 *pos, unsigned long *slots);
+
+#endif
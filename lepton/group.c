@@ -17,7 +17,15 @@
 
 #include <Python.h>
 #include <float.h>
+#include <stddef.h>
 #include "group.h"
+#include "parallel.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 /* Return an index for a new particle in the group, allocating space for it if
  * necessary.
@@ -46,6 +54,88 @@ Group_new_p(GroupObject *group) {
 	return pindex;
 }
 
+/* Reserve count contiguous new particles in the group, growing it once
+ * for all of them if necessary. Return the index of the first, or -1 if
+ * memory could not be allocated.
+ */
+long
+Group_new_n(GroupObject *group, unsigned long count) {
+	unsigned long pindex;
+	unsigned long expansion;
+	ParticleList *realloc_plist;
+
+	pindex = group->plist->pactive + group->plist->pkilled + group->plist->pnew;
+	if (pindex + count > group->plist->palloc) {
+		expansion = group->plist->palloc / 5;
+		if (expansion < GROUP_MIN_ALLOC)
+			expansion = GROUP_MIN_ALLOC;
+		if (expansion < pindex + count - group->plist->palloc)
+			expansion = pindex + count - group->plist->palloc;
+		realloc_plist = (ParticleList *)PyMem_Realloc(group->plist,
+			sizeof(ParticleList) + 
+			sizeof(Particle) * (group->plist->palloc + expansion));
+		if (realloc_plist == NULL) {
+			return -1;
+		}
+		group->plist = realloc_plist;
+		group->plist->palloc += expansion;
+	}
+	group->plist->pnew += count;
+	return pindex;
+}
+
+ParticleList *
+ParticleList_new(void)
+{
+	ParticleList *plist;
+
+	plist = (ParticleList *)PyMem_Malloc(
+		sizeof(ParticleList) + sizeof(Particle) * GROUP_MIN_ALLOC);
+	if (plist == NULL) {
+		PyErr_NoMemory();
+		return NULL;
+	}
+	plist->palloc = GROUP_MIN_ALLOC;
+	plist->pactive = 0;
+	plist->pnew = 0;
+	plist->pkilled = 0;
+	return plist;
+}
+
+GroupObject *
+Group_new_snapshot(PyTypeObject *type)
+{
+	GroupObject *snapshot;
+
+	snapshot = PyObject_New(GroupObject, type);
+	if (snapshot == NULL)
+		return NULL;
+	snapshot->controllers = NULL;
+	snapshot->renderer = NULL;
+	snapshot->system = NULL;
+	snapshot->iteration = 0;
+	GroupBounds_clear(&snapshot->bounds);
+	snapshot->gpu_time = -1.0;
+	snapshot->interpolation = 1.0f;
+	snapshot->snapshot[0] = snapshot->snapshot[1] = NULL;
+	snapshot->front = 0;
+	snapshot->readers = 0;
+#ifdef GROUP_HAVE_FENCE
+	snapshot->fence_ready = 0;
+#endif
+	Group_init_fence(snapshot);
+	snapshot->analytic = NULL;
+	snapshot->history.length = snapshot->history.head = 0;
+	snapshot->history.alloc = 0;
+	snapshot->history.samples = NULL;
+	snapshot->plist = ParticleList_new();
+	if (snapshot->plist == NULL) {
+		Py_DECREF(snapshot);
+		return NULL;
+	}
+	return snapshot;
+}
+
 /* Kill the particle specified.
  */
 void inline
@@ -60,6 +150,507 @@ Group_kill_p(GroupObject *group, Particle *p) {
 	p->position.z = FLT_MAX;
 }
 
+void
+Group_init_fence(GroupObject *group)
+{
+#ifdef GROUP_HAVE_FENCE
+	if (!group->fence_ready) {
+		pthread_mutex_init(&group->fence_lock, NULL);
+		pthread_cond_init(&group->fence_clear, NULL);
+		group->fence_ready = 1;
+	}
+#endif
+}
+
+void
+Group_destroy_fence(GroupObject *group)
+{
+#ifdef GROUP_HAVE_FENCE
+	if (group->fence_ready) {
+		pthread_cond_destroy(&group->fence_clear);
+		pthread_mutex_destroy(&group->fence_lock);
+		group->fence_ready = 0;
+	}
+#endif
+}
+
+void
+Group_end_read(GroupObject *group)
+{
+#ifdef GROUP_HAVE_FENCE
+	pthread_mutex_lock(&group->fence_lock);
+	if (--group->readers == 0)
+		pthread_cond_broadcast(&group->fence_clear);
+	pthread_mutex_unlock(&group->fence_lock);
+#else
+	group->readers--;
+#endif
+}
+
+/* Wait for the draws reading the group to finish. They may be 
+   waiting for the GIL, so it is released meanwhile. Another draw may 
+   begin before it is reacquired, so the readers are checked again */
+static void
+Group_wait_readers(GroupObject *group)
+{
+	while (group->readers > 0) {
+		Py_BEGIN_ALLOW_THREADS
+#ifdef GROUP_HAVE_FENCE
+		pthread_mutex_lock(&group->fence_lock);
+		while (group->readers > 0)
+			pthread_cond_wait(&group->fence_clear, &group->fence_lock);
+		pthread_mutex_unlock(&group->fence_lock);
+#else
+		/* Without threads, draws only release the GIL briefly */
+		while (group->readers > 0) {
+#ifdef _WIN32
+			Sleep(0);
+#else
+			usleep(50);
+#endif
+		}
+#endif
+		Py_END_ALLOW_THREADS
+	}
+}
+
+/* Grow the history samples to hold count particles, keeping those
+   already sampled */
+static int
+PositionHistory_reserve(PositionHistory *history, unsigned long count)
+{
+	Vec3 *samples;
+
+	if (count <= history->alloc)
+		return 1;
+	samples = (Vec3 *)PyMem_Realloc(history->samples, 
+		sizeof(Vec3) * history->length * count);
+	if (samples == NULL) {
+		PyErr_NoMemory();
+		return 0;
+	}
+	history->samples = samples;
+	history->alloc = count;
+	return 1;
+}
+
+int
+Group_reserve_history(GroupObject *group)
+{
+	if (group->history.length == 0)
+		return 1;
+	return PositionHistory_reserve(&group->history, group->plist->palloc);
+}
+
+void
+Group_fill_history(GroupObject *group, unsigned long start, unsigned long end)
+{
+	PositionHistory *history = &group->history;
+	Particle *p = group->plist->p;
+	Vec3 *sample;
+	unsigned long i;
+	int k;
+
+	for (i = start; i < end; i++) {
+		sample = &history->samples[i * history->length];
+		for (k = 0; k < history->length; k++)
+			sample[k] = p[i].position;
+	}
+}
+
+void
+Group_sample_history(GroupObject *group)
+{
+	PositionHistory *history = &group->history;
+	Particle *p = group->plist->p;
+	unsigned long i, count;
+
+	if (history->length == 0)
+		return;
+	history->head = (history->head + 1) % history->length;
+	count = GroupObject_ActiveCount(group);
+	for (i = 0; i < count; i++)
+		*PositionHistory_sample(history, i, 0) = p[i].position;
+}
+
+int
+Group_set_history(GroupObject *group, long length)
+{
+	PositionHistory *history = &group->history;
+
+	if (length != 0 && (length < 2 || length > GROUP_MAX_HISTORY)) {
+		PyErr_Format(PyExc_ValueError, 
+			"history length must be 0 or from 2 to %d", GROUP_MAX_HISTORY);
+		return 0;
+	}
+	if (length == history->length)
+		return 1;
+	PyMem_Free(history->samples);
+	history->samples = NULL;
+	history->alloc = 0;
+	history->head = 0;
+	history->length = (int)length;
+	if (length == 0)
+		return 1;
+	if (!Group_reserve_history(group)) {
+		history->length = 0;
+		return 0;
+	}
+	/* New particles are filled when incorporated */
+	Group_fill_history(group, 0, GroupObject_ActiveCount(group));
+	return 1;
+}
+
+int
+Group_publish(GroupObject *group)
+{
+	GroupObject *back;
+	ParticleList *plist;
+	unsigned long count;
+
+	if (group->snapshot[0] == NULL)
+		return 1;
+	back = group->snapshot[!group->front];
+	Group_wait_readers(back);
+	/* New particles are not drawn until incorporated */
+	count = GroupObject_ActiveCount(group);
+	if (count > back->plist->palloc) {
+		plist = (ParticleList *)PyMem_Realloc(back->plist,
+			sizeof(ParticleList) + sizeof(Particle) * group->plist->palloc);
+		if (plist == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+		back->plist = plist;
+		back->plist->palloc = group->plist->palloc;
+	}
+	memcpy(back->plist->p, group->plist->p, sizeof(Particle) * count);
+	back->plist->pactive = group->plist->pactive;
+	back->plist->pkilled = group->plist->pkilled;
+	back->plist->pnew = 0;
+	back->bounds = group->bounds;
+	back->interpolation = group->interpolation;
+	if (back->history.length != group->history.length) {
+		PyMem_Free(back->history.samples);
+		back->history.samples = NULL;
+		back->history.alloc = 0;
+		back->history.length = group->history.length;
+	}
+	if (group->history.length > 0) {
+		if (!PositionHistory_reserve(&back->history, group->history.alloc)) {
+			back->history.length = 0;
+			return 0;
+		}
+		memcpy(back->history.samples, group->history.samples, 
+			sizeof(Vec3) * group->history.length * count);
+		back->history.head = group->history.head;
+	}
+	back->iteration++; /* invalidate proxies and iterators */
+	group->front = !group->front;
+	return 1;
+}
+
+#define EVALUATE_MIN_CHUNK 4096
+
+/* State shared by the analytic evaluation chunks */
+typedef struct {
+	AnalyticState *state;
+	Particle *src;
+	Particle *dest;
+	GroupBounds bounds[PARALLEL_MAX_CHUNKS];
+} EvaluateJob;
+
+/* Return the alpha set by the Fader for the age, or the alpha
+   specified if the age is outside of its ranges, same as the controller */
+static inline float
+analytic_fade(AnalyticState *state, float age, float alpha)
+{
+	if (age > state->fade_in_end && age <= state->fade_out_start) {
+		return state->max_alpha;
+	} else if (age > state->fade_in_start && age < state->fade_in_end) {
+		return state->start_alpha + (state->max_alpha - state->start_alpha) 
+			* (age - state->fade_in_start) 
+			/ (state->fade_in_end - state->fade_in_start);
+	} else if (age >= state->fade_out_start && age < state->fade_out_end) {
+		return state->max_alpha + (state->end_alpha - state->max_alpha) 
+			* (age - state->fade_out_start) 
+			/ (state->fade_out_end - state->fade_out_start);
+	} else if (age >= state->fade_out_end) {
+		return state->end_alpha;
+	}
+	return alpha;
+}
+
+/* Return the position of the particle at time t after its birth */
+static inline void
+analytic_position(AnalyticState *state, Particle *p, float t, Vec3 *pos)
+{
+	Vec3 v;
+
+	*pos = p->position;
+	if (state->movement) {
+		Vec3_scalar_mul(&v, &p->velocity, t);
+		Vec3_addi(pos, &v);
+		Vec3_scalar_mul(&v, &state->gravity, 0.5f * t * t);
+		Vec3_addi(pos, &v);
+	}
+}
+
+static void
+Group_evaluate_chunk(EvaluateJob *job, unsigned long chunk,
+	unsigned long start, unsigned long end)
+{
+	AnalyticState *state = job->state;
+	GroupBounds *bounds = &job->bounds[chunk];
+	Particle *p, *out;
+	Vec3 v;
+	unsigned long i, g;
+	float t;
+
+	GroupBounds_clear(bounds);
+	for (i = start; i < end; i++) {
+		p = &job->src[i];
+		out = &job->dest[i];
+		*out = *p;
+		if (!Particle_IsAlive(*p))
+			continue;
+		t = p->age - p->scratch1;
+		analytic_position(state, p, t, &out->position);
+		analytic_position(state, p, 
+			t > state->last_td ? t - state->last_td : 0.0f, &out->last_position);
+		Vec3_scalar_mul(&v, &state->gravity, t);
+		Vec3_addi(&out->velocity, &v);
+		if (state->movement) {
+			Vec3_scalar_mul(&v, &p->rotation, t);
+			Vec3_addi(&out->up, &v);
+		}
+		Vec3_scalar_mul(&v, &state->growth, t);
+		Vec3_addi(&out->size, &v);
+		if (state->fade && !state->fade_last)
+			out->color.a = analytic_fade(state, p->age, out->color.a);
+		if (state->gradient != NULL && p->age >= state->gradient_min_age 
+			&& p->age <= state->gradient_max_age) {
+			g = (unsigned long)((p->age - state->gradient_min_age) 
+				* state->resolution);
+			if (g >= state->gradient_length)
+				g = state->gradient_length - 1;
+			out->color = state->gradient[g];
+		}
+		if (state->fade && state->fade_last)
+			out->color.a = analytic_fade(state, p->age, out->color.a);
+		GroupBounds_include(bounds, &out->position);
+		GroupBounds_include_size(bounds, &out->size);
+	}
+}
+
+GroupObject *
+Group_evaluate(GroupObject *group, GroupObject *src)
+{
+	AnalyticState *state = group->analytic;
+	GroupObject *evaluated = state->evaluated;
+	ParticleList *plist;
+	EvaluateJob job;
+	unsigned long count, chunks, c;
+
+	if (evaluated->readers > 0) {
+		/* The readers may include the caller, so they cannot be waited
+		   for. Share the evaluated particles if they are current,
+		   otherwise evaluate into a new group, the readers keep theirs */
+		if (state->evaluated_src == src 
+			&& state->evaluated_iteration == src->iteration) {
+			Py_INCREF(evaluated);
+			return evaluated;
+		}
+		evaluated = Group_new_snapshot(evaluated->ob_type);
+		if (evaluated == NULL)
+			return NULL;
+		Py_DECREF(state->evaluated);
+		state->evaluated = evaluated;
+	}
+	Py_INCREF(evaluated);
+	state->evaluated_src = NULL;
+	count = GroupObject_ActiveCount(src);
+	if (count > evaluated->plist->palloc) {
+		plist = (ParticleList *)PyMem_Realloc(evaluated->plist,
+			sizeof(ParticleList) + sizeof(Particle) * src->plist->palloc);
+		if (plist == NULL) {
+			Py_DECREF(evaluated);
+			PyErr_NoMemory();
+			return NULL;
+		}
+		evaluated->plist = plist;
+		evaluated->plist->palloc = src->plist->palloc;
+	}
+	job.state = state;
+	job.src = src->plist->p;
+	job.dest = evaluated->plist->p;
+	/* The GIL is released while evaluating, hold off updates to the 
+	   source particles and other evaluations into the same group */
+	src->readers++;
+	evaluated->readers++;
+	chunks = parallel_for(count, EVALUATE_MIN_CHUNK, 
+		(ParallelFunc)Group_evaluate_chunk, &job);
+	Group_end_read(evaluated);
+	Group_end_read(src);
+	GroupBounds_clear(&evaluated->bounds);
+	for (c = 0; c < chunks; c++)
+		GroupBounds_merge(&evaluated->bounds, &job.bounds[c]);
+	evaluated->interpolation = src->interpolation;
+	evaluated->plist->pactive = src->plist->pactive;
+	evaluated->plist->pkilled = src->plist->pkilled;
+	evaluated->plist->pnew = 0;
+	evaluated->iteration++; /* invalidate proxies and iterators */
+	/* The group may have been rebound or evaluated into a new group 
+	   while the GIL was released */
+	state = group->analytic;
+	if (state != NULL && state->evaluated == evaluated) {
+		state->evaluated_src = src;
+		state->evaluated_iteration = src->iteration;
+	}
+	return evaluated;
+}
+
+/* State shared by the reduction chunks */
+typedef struct {
+	Particle *p;
+	int offset;
+	int width;
+	ParticleReduction partial[PARALLEL_MAX_CHUNKS];
+	double energy[PARALLEL_MAX_CHUNKS];
+} ReduceJob;
+
+#define REDUCE_MIN_CHUNK 4096
+
+static void
+Group_reduce_chunk(ReduceJob *job, unsigned long chunk,
+	unsigned long start, unsigned long end)
+{
+	ParticleReduction *r = &job->partial[chunk];
+	unsigned long i, n = 0;
+	double sum[4] = {0.0, 0.0, 0.0, 0.0};
+	float min[4] = {FLT_MAX, FLT_MAX, FLT_MAX, FLT_MAX};
+	float max[4] = {-FLT_MAX, -FLT_MAX, -FLT_MAX, -FLT_MAX};
+	const float *v;
+	int k;
+
+	if (job->width == 1) {
+		for (i = start; i < end; i++) {
+			if (Particle_IsAlive(job->p[i])) {
+				v = (float *)((char *)&job->p[i] + job->offset);
+				sum[0] += v[0];
+				min[0] = v[0] < min[0] ? v[0] : min[0];
+				max[0] = v[0] > max[0] ? v[0] : max[0];
+				n++;
+			}
+		}
+	} else {
+		/* Vectors and colors are padded to 4 floats, always reducing all 4
+		   lanes gives the compiler a fixed width loop it can vectorize */
+		for (i = start; i < end; i++) {
+			if (Particle_IsAlive(job->p[i])) {
+				v = (float *)((char *)&job->p[i] + job->offset);
+				for (k = 0; k < 4; k++) {
+					sum[k] += v[k];
+					min[k] = v[k] < min[k] ? v[k] : min[k];
+					max[k] = v[k] > max[k] ? v[k] : max[k];
+				}
+				n++;
+			}
+		}
+	}
+	r->count = n;
+	for (k = 0; k < 4; k++) {
+		r->sum[k] = sum[k];
+		r->min[k] = min[k];
+		r->max[k] = max[k];
+	}
+}
+
+void
+Group_reduce(GroupObject *group, int offset, int width, ParticleReduction *result)
+{
+	ReduceJob job;
+	unsigned long chunks, c;
+	int k;
+
+	job.p = group->plist->p;
+	job.offset = offset;
+	job.width = width;
+	chunks = parallel_for(GroupObject_ActiveCount(group), REDUCE_MIN_CHUNK,
+		(ParallelFunc)Group_reduce_chunk, &job);
+	*result = job.partial[0];
+	for (c = 1; c < chunks; c++) {
+		result->count += job.partial[c].count;
+		for (k = 0; k < 4; k++) {
+			result->sum[k] += job.partial[c].sum[k];
+			if (job.partial[c].min[k] < result->min[k])
+				result->min[k] = job.partial[c].min[k];
+			if (job.partial[c].max[k] > result->max[k])
+				result->max[k] = job.partial[c].max[k];
+		}
+	}
+}
+
+static void
+Group_energy_chunk(ReduceJob *job, unsigned long chunk,
+	unsigned long start, unsigned long end)
+{
+	double energy = 0.0;
+	unsigned long i;
+
+	for (i = start; i < end; i++) {
+		if (Particle_IsAlive(job->p[i]))
+			energy += Particle_Mass(job->p[i]) * Vec3_len_sq(&job->p[i].velocity);
+	}
+	job->energy[chunk] = energy * 0.5;
+}
+
+double
+Group_kinetic_energy(GroupObject *group)
+{
+	ReduceJob job;
+	unsigned long chunks, c;
+	double energy = 0.0;
+
+	job.p = group->plist->p;
+	chunks = parallel_for(GroupObject_ActiveCount(group), REDUCE_MIN_CHUNK,
+		(ParallelFunc)Group_energy_chunk, &job);
+	for (c = 0; c < chunks; c++)
+		energy += job.energy[c];
+	return energy;
+}
+
+int
+Particle_attr_offset(const char *name, int *width)
+{
+	static const struct {
+		const char *name;
+		int offset;
+		int width;
+	} attrs[] = {
+		{"position", offsetof(Particle, position), 3},
+		{"velocity", offsetof(Particle, velocity), 3},
+		{"size", offsetof(Particle, size), 3},
+		{"up", offsetof(Particle, up), 3},
+		{"rotation", offsetof(Particle, rotation), 3},
+		{"last_position", offsetof(Particle, last_position), 3},
+		{"last_velocity", offsetof(Particle, last_velocity), 3},
+		{"color", offsetof(Particle, color), 4},
+		{"mass", offsetof(Particle, mass), 1},
+		{"age", offsetof(Particle, age), 1},
+		{NULL}
+	};
+	int i;
+
+	for (i = 0; attrs[i].name != NULL; i++) {
+		if (!strcmp(name, attrs[i].name)) {
+			*width = attrs[i].width;
+			return attrs[i].offset;
+		}
+	}
+	return -1;
+}
+
 /* Return true if o is a bon-a-fide GroupObject */
 int
 GroupObject_Check(GroupObject *o)
@@ -159,7 +750,7 @@ get_Float(float *f, PyObject *dict, PyObject *template, const char *attrname)
 		}
 	} else {
 		PyErr_Clear();
-		f = 0;
+		*f = 0;
 		result = 1;
 	}
 	Py_XDECREF(attr);
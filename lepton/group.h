@@ -3,11 +3,17 @@
  * $id$
  */
 
+#include <float.h>
 #include "vector.h"
 
 #ifndef _GROUP_H_
 #define _GROUP_H_
 
+#if !defined(_WIN32) && !defined(LEPTON_NO_THREADS)
+#define GROUP_HAVE_FENCE 1
+#include <pthread.h>
+#endif
+
 typedef struct {
 	/* Note order is important for alignment */
 	Vec3	position;
@@ -26,6 +32,10 @@ typedef struct {
 
 #define Particle_IsAlive(p) ((p).age >= 0)
 
+/* Mass used for particle interactions, massless particles behave
+ * as though they have unit mass */
+#define Particle_Mass(p) ((p).mass > 0.0f ? (p).mass : 1.0f)
+
 /* A ParticleList is a dynamic array arranged as follows:
  * |<----- active and killed ----->|<- new ->|            |
  * |<--------- allocated slots -------------------------->|
@@ -64,19 +74,242 @@ typedef struct {
 	Particle		p[];
 } ParticleList;
 
-/* The particle group object */
+/* Conservative bounds of the live particles in a group. The bounds are
+ * recomputed exactly when the group is updated and by the Movement
+ * controller. Any other code that moves or resizes particles must include
+ * the new values so that the bounds always contain every live particle.
+ * Killed particles are not removed from the bounds until the next update.
+ */
+typedef struct {
+	Vec3	min;      /* Minimum particle position */
+	Vec3	max;      /* Maximum particle position */
+	float	max_size; /* Largest particle size component */
+} GroupBounds;
+
+/* Parameters of the closed-form particle state of an analytic group.
+ * Particles in an analytic group keep their state at birth, with their
+ * age at birth in scratch1. Their current state is evaluated from it by
+ * Group_evaluate() when drawn, rather than by the controllers on update.
+ */
+typedef struct {
+	Vec3			gravity;      /* Total acceleration */
+	int				movement;     /* Particles move by their velocity */
+	Vec3			growth;       /* Size change per unit time */
+	float			max_age;      /* Particles older are killed */
+	int				fade;         /* Fader parameters are set */
+	int				fade_last;    /* Fade after color blending */
+	float			fade_in_start, fade_in_end, fade_out_start, fade_out_end;
+	float			start_alpha, max_alpha, end_alpha;
+	Color			*gradient;    /* ColorBlender gradient, or NULL */
+	unsigned long	gradient_length;
+	unsigned long	resolution;
+	float			gradient_min_age;
+	float			gradient_max_age;
+	float			last_td;      /* Time delta of the last update */
+	PyObject		*controllers; /* Bound controllers run on update */
+	struct _GroupObject *evaluated; /* Group holding the evaluated state */
+	struct _GroupObject *evaluated_src; /* Group it was evaluated from */
+	unsigned long	evaluated_iteration; /* Iteration of evaluated_src then */
+} AnalyticState;
+
+/* Recent positions of the particles in a group, for renderers that draw
+ * trails behind them. A sample is taken of each particle at the end of
+ * each update. The samples of the particle at index i form a ring of
+ * length samples starting at samples[i * length], the newest at index head.
+ * New particles start with every sample at their initial position, and the
+ * samples move with the particle when its index changes.
+ */
 typedef struct {
+	int				length;  /* Samples per particle, 0 if not kept */
+	int				head;    /* Ring index of the newest sample */
+	unsigned long	alloc;   /* Particles the samples are allocated for */
+	Vec3			*samples;
+} PositionHistory;
+
+#define GROUP_MAX_HISTORY 64
+
+/* Return the sample of the particle at index taken age updates before the
+ * newest. age must be less than the history length.
+ */
+static inline Vec3 *
+PositionHistory_sample(PositionHistory *history, unsigned long index, int age)
+{
+	int k = history->head - age;
+	if (k < 0)
+		k += history->length;
+	return &history->samples[index * history->length + k];
+}
+
+/* The particle group object
+ *
+ * A double buffered group publishes a copy of its particles at the end of
+ * each update, which native renderers draw instead of the particle list.
+ * The snapshots are themselves groups, with no controllers or system, so
+ * that they can be drawn like any other group. Two snapshots alternate so
+ * that an update can publish while the previous snapshot is drawn. 
+ * Snapshots being drawn have a non-zero reader count, which acts as a
+ * fence: the update does not overwrite a snapshot until it is zero. The
+ * count is decremented under the fence lock, which signals the waiting
+ * update when it reaches zero.
+ */
+typedef struct _GroupObject {
 	PyObject_HEAD
 	PyObject		*controllers;
 	PyObject		*renderer;
 	PyObject		*system;
 	unsigned long	iteration; /* update iteration count */ 
 	ParticleList	*plist;
+	GroupBounds		bounds;
+	double			gpu_time;  /* GPU draw time in ms, < 0 if unknown */
+	float			interpolation; /* Fraction of the last step to draw */
+	struct _GroupObject *snapshot[2]; /* Render snapshots if double buffered */
+	int				front;     /* Index of the published snapshot */
+	int				readers;   /* Draws in progress using the particles */
+#ifdef GROUP_HAVE_FENCE
+	int				fence_ready; /* True once the lock and cond are initialized */
+	pthread_mutex_t	fence_lock;
+	pthread_cond_t	fence_clear; /* Signalled when readers drops to zero */
+#endif
+	AnalyticState	*analytic; /* Closed-form state if analytic, or NULL */
+	PositionHistory	history;   /* Recent particle positions, if kept */
 } GroupObject;
 
 #define GroupObject_ActiveCount(group) \
 	((group)->plist->pactive + (group)->plist->pkilled)
 
+/* Initialize the group's reader fence, if not already. Called when the
+ * group is created.
+ */
+void
+Group_init_fence(GroupObject *group);
+
+/* Release the group's reader fence, when the group is destroyed */
+void
+Group_destroy_fence(GroupObject *group);
+
+/* Finish reading the group's particles, waking an update waiting for the
+ * draws reading them to finish.
+ */
+void
+Group_end_read(GroupObject *group);
+
+/* Evaluate the current state of the particles of an analytic group from
+ * those of src, the group itself or its published snapshot, returning a 
+ * new reference to the group holding them, or NULL on failure with an
+ * exception set. The evaluated group is shared and is not rewritten while
+ * it is being read: it is returned as is if it was evaluated from the
+ * current src, otherwise the state is evaluated into a new group. Must be
+ * called with the GIL held.
+ */
+GroupObject *
+Group_evaluate(GroupObject *group, GroupObject *src);
+
+/* Return a new reference to the group whose particles should be drawn for
+ * the group, and hold off updates to them until GroupObject_EndDraw() is
+ * called. Return NULL on failure with an exception set. Must be called
+ * with the GIL held, but the particles may then be read without it.
+ */
+static inline GroupObject *
+GroupObject_BeginDraw(GroupObject *group)
+{
+	GroupObject *src = group;
+
+	if (group->snapshot[0] != NULL)
+		src = group->snapshot[group->front];
+	if (group->analytic != NULL) {
+		group = Group_evaluate(group, src);
+		if (group == NULL)
+			return NULL;
+	} else {
+		group = src;
+		Py_INCREF(group);
+	}
+	group->readers++;
+	return group;
+}
+
+/* Return a new reference to the group holding the current state of the
+ * group's particles, rather than the published state drawn, for emitters
+ * that spawn from them. Like GroupObject_BeginDraw(), the particles are
+ * held until GroupObject_EndDraw() is called.
+ */
+static inline GroupObject *
+GroupObject_BeginRead(GroupObject *group)
+{
+	if (group->analytic != NULL) {
+		group = Group_evaluate(group, group);
+		if (group == NULL)
+			return NULL;
+	} else {
+		Py_INCREF(group);
+	}
+	group->readers++;
+	return group;
+}
+
+static inline void
+GroupObject_EndDraw(GroupObject *group)
+{
+	Group_end_read(group);
+	Py_DECREF(group);
+}
+
+/* Reset the bounds to contain nothing */
+static inline void
+GroupBounds_clear(GroupBounds *bounds)
+{
+	bounds->min.x = bounds->min.y = bounds->min.z = FLT_MAX;
+	bounds->max.x = bounds->max.y = bounds->max.z = -FLT_MAX;
+	bounds->max_size = 0.0f;
+}
+
+/* Return true if the bounds contain no particles */
+#define GroupBounds_IsEmpty(bounds) ((bounds)->min.x > (bounds)->max.x)
+
+/* Expand the bounds to contain the position */
+static inline void
+GroupBounds_include(GroupBounds *bounds, const Vec3 *pos)
+{
+	if (pos->x < bounds->min.x) bounds->min.x = pos->x;
+	if (pos->y < bounds->min.y) bounds->min.y = pos->y;
+	if (pos->z < bounds->min.z) bounds->min.z = pos->z;
+	if (pos->x > bounds->max.x) bounds->max.x = pos->x;
+	if (pos->y > bounds->max.y) bounds->max.y = pos->y;
+	if (pos->z > bounds->max.z) bounds->max.z = pos->z;
+}
+
+/* Expand the bounds to account for the particle size */
+static inline void
+GroupBounds_include_size(GroupBounds *bounds, const Vec3 *size)
+{
+	if (size->x > bounds->max_size) bounds->max_size = size->x;
+	if (size->y > bounds->max_size) bounds->max_size = size->y;
+	if (size->z > bounds->max_size) bounds->max_size = size->z;
+}
+
+/* Expand the bounds to contain the other bounds */
+static inline void
+GroupBounds_merge(GroupBounds *bounds, const GroupBounds *other)
+{
+	if (!GroupBounds_IsEmpty(other)) {
+		GroupBounds_include(bounds, &other->min);
+		GroupBounds_include(bounds, &other->max);
+	}
+	if (other->max_size > bounds->max_size) 
+		bounds->max_size = other->max_size;
+}
+
+/* Store the center and radius of a sphere containing the bounds */
+static inline void
+GroupBounds_sphere(const GroupBounds *bounds, Vec3 *center, float *radius)
+{
+	Vec3 half;
+	Vec3_add(center, &bounds->min, &bounds->max);
+	Vec3_scalar_muli(center, 0.5f);
+	Vec3_sub(&half, &bounds->max, center);
+	*radius = Vec3_len(&half);
+}
+
 /* Particle reference object are used for Particle proxies and iterators.
  *
  * Particle proxy objects are used to access and manipulate individual
@@ -119,18 +352,97 @@ typedef struct {
 
 #define GROUP_MIN_ALLOC 100
 
+/* Aggregate of a particle attribute over the live particles of a group.
+ * Only the first width components of each array are meaningful
+ */
+typedef struct {
+	unsigned long	count; /* Number of particles reduced */
+	double			sum[4];
+	float			min[4];
+	float			max[4];
+} ParticleReduction;
+
 /* Return an index for a new particle in the group, allocating space for it if
  * necessary.
  */
 long
 Group_new_p(GroupObject *group);
 
+/* Return the index of the first of count contiguous new particles in the
+ * group, allocating space for all of them at once if necessary. Return -1
+ * if memory could not be allocated.
+ */
+long
+Group_new_n(GroupObject *group, unsigned long count);
+
+/* Allocate an empty particle list. Return NULL on failure with an 
+ * exception set.
+ */
+ParticleList *
+ParticleList_new(void);
+
+/* Create an empty render snapshot group of the type specified, with no
+ * controllers or system. Return NULL on failure with an exception set.
+ */
+GroupObject *
+Group_new_snapshot(PyTypeObject *type);
+
 /* Kill the particle at the index specified. Does nothing if the index does
  * not point to a valid particle
  */
 void inline
 Group_kill_p(GroupObject *group, Particle *p);
 
+/* Copy the group's particles into its back snapshot and make it the
+ * front snapshot, waiting for any draws still reading it to finish. Does
+ * nothing if the group is not double buffered. Return true on success,
+ * false on failure with an exception set. Must be called with the GIL held.
+ */
+int
+Group_publish(GroupObject *group);
+
+/* Keep length recent positions of each particle in the group, from 2 to
+ * GROUP_MAX_HISTORY, or none if length is 0. The existing particles start
+ * with every sample at their current position. Return true on success,
+ * false on failure with an exception set.
+ */
+int
+Group_set_history(GroupObject *group, long length);
+
+/* Set every history sample of the particles from index start up to end
+ * to their current position. The history must have room for them.
+ */
+void
+Group_fill_history(GroupObject *group, unsigned long start, unsigned long end);
+
+/* Allocate history samples for every particle slot in the group. Return
+ * true on success, false on failure with an exception set.
+ */
+int
+Group_reserve_history(GroupObject *group);
+
+/* Advance the history, sampling the current position of each particle */
+void
+Group_sample_history(GroupObject *group);
+
+/* Reduce the particle attribute at the offset specified into the Particle
+ * struct over all live particles in the group. width is the number of float
+ * components in the attribute (1, 3 or 4). Must be called with the GIL held.
+ */
+void
+Group_reduce(GroupObject *group, int offset, int width, ParticleReduction *result);
+
+/* Return the total kinetic energy of the live particles in the group */
+double
+Group_kinetic_energy(GroupObject *group);
+
+/* Return the offset of the named attribute in the Particle struct and store
+ * the number of float components it has in width. Return -1 if there is no
+ * such attribute.
+ */
+int
+Particle_attr_offset(const char *name, int *width);
+
 /* Return true if o is a bon-a-fide GroupObject */
 int
 GroupObject_Check(GroupObject *o);
@@ -25,43 +25,274 @@ static PyTypeObject ParticleProxy_Type;
 static PyObject *InvalidParticleRefError;
 
 #define GroupObject_CHECK(v) ((v)->ob_type == &ParticleGroup_Type)
+/* Groups may be instances of the group type of another extension module,
+   so compare by type name rather than identity */
+#define GroupObject_ANY_CHECK(v) \
+	(!strcmp((v)->ob_type->tp_name, ParticleGroup_Type.tp_name))
 #define ParticleProxy_CHECK(v) ((v)->ob_type == &ParticleProxy_Type)
 
+static void
+Analytic_free(AnalyticState *state);
+
 static void
 ParticleGroup_dealloc(GroupObject *self)
 {
 	Py_CLEAR(self->controllers);
 	Py_CLEAR(self->renderer);
 	Py_CLEAR(self->system);
+	Py_CLEAR(self->snapshot[0]);
+	Py_CLEAR(self->snapshot[1]);
+	Analytic_free(self->analytic);
+	self->analytic = NULL;
+	PyMem_Free(self->history.samples);
+	self->history.samples = NULL;
 	PyMem_Free(self->plist);
 	self->plist = NULL;
+	Group_destroy_fence(self);
 	PyObject_Del(self);
 }
 
+static void
+Analytic_free(AnalyticState *state)
+{
+	if (state != NULL) {
+		PyMem_Free(state->gradient);
+		Py_XDECREF(state->controllers);
+		Py_XDECREF(state->evaluated);
+		PyMem_Free(state);
+	}
+}
+
+/* Fold the parameters of a controller returned by its _analytic() method
+   into the state */
+static int
+Analytic_add_params(AnalyticState *state, PyObject *params)
+{
+	const char *kind;
+	Vec3 v;
+	float f, min_age, max_age;
+	unsigned long resolution;
+	char *gradient;
+	int gradient_size;
+
+	if (!PyTuple_Check(params) || PyTuple_GET_SIZE(params) < 1 
+		|| !PyString_Check(PyTuple_GET_ITEM(params, 0))) {
+		PyErr_SetString(PyExc_TypeError, 
+			"Expected tuple from controller _analytic() method");
+		return 0;
+	}
+	kind = PyString_AS_STRING(PyTuple_GET_ITEM(params, 0));
+	if (!strcmp(kind, "gravity")) {
+		if (!PyArg_ParseTuple(params, "s(fff)", &kind, &v.x, &v.y, &v.z))
+			return 0;
+		Vec3_addi(&state->gravity, &v);
+	} else if (!strcmp(kind, "growth")) {
+		if (!PyArg_ParseTuple(params, "s(fff)", &kind, &v.x, &v.y, &v.z))
+			return 0;
+		Vec3_addi(&state->growth, &v);
+	} else if (!strcmp(kind, "lifetime")) {
+		if (!PyArg_ParseTuple(params, "sf", &kind, &f))
+			return 0;
+		if (f < state->max_age)
+			state->max_age = f;
+	} else if (!strcmp(kind, "movement")) {
+		if (state->movement) {
+			PyErr_SetString(PyExc_ValueError, 
+				"Analytic groups support only one Movement controller");
+			return 0;
+		}
+		state->movement = 1;
+	} else if (!strcmp(kind, "fader")) {
+		if (state->fade) {
+			PyErr_SetString(PyExc_ValueError, 
+				"Analytic groups support only one Fader controller");
+			return 0;
+		}
+		if (!PyArg_ParseTuple(params, "s(fffffff)", &kind, 
+			&state->start_alpha, &state->fade_in_start, &state->fade_in_end,
+			&state->max_alpha, &state->fade_out_start, &state->fade_out_end,
+			&state->end_alpha))
+			return 0;
+		state->fade = 1;
+		state->fade_last = (state->gradient != NULL);
+	} else if (!strcmp(kind, "color_blender")) {
+		if (state->gradient != NULL) {
+			PyErr_SetString(PyExc_ValueError, 
+				"Analytic groups support only one ColorBlender controller");
+			return 0;
+		}
+		if (!PyArg_ParseTuple(params, "sffks#", &kind, &min_age, &max_age,
+			&resolution, &gradient, &gradient_size))
+			return 0;
+		if (gradient_size < (int)sizeof(Color) 
+			|| gradient_size % sizeof(Color) != 0) {
+			PyErr_SetString(PyExc_ValueError, "Invalid ColorBlender gradient");
+			return 0;
+		}
+		state->gradient = PyMem_Malloc(gradient_size);
+		if (state->gradient == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+		memcpy(state->gradient, gradient, gradient_size);
+		state->gradient_length = gradient_size / sizeof(Color);
+		state->gradient_min_age = min_age;
+		state->gradient_max_age = max_age;
+		state->resolution = resolution;
+	} else {
+		PyErr_Format(PyExc_ValueError, 
+			"Unknown analytic controller parameters \"%.100s\"", kind);
+		return 0;
+	}
+	return 1;
+}
+
+/* Create the analytic state for the controllers specified, which must all
+   implement the _analytic() method. The evaluated group of the previous
+   state is reused if specified */
+static AnalyticState *
+Analytic_new(PyObject *controllers, AnalyticState *previous)
+{
+	AnalyticState *state;
+	PyObject *ctrlr, *params, *run;
+	Py_ssize_t i, count = 0;
+
+	state = PyMem_Malloc(sizeof(AnalyticState));
+	if (state == NULL) {
+		PyErr_NoMemory();
+		return NULL;
+	}
+	memset(state, 0, sizeof(AnalyticState));
+	state->max_age = FLT_MAX;
+	if (previous != NULL) {
+		state->evaluated = previous->evaluated;
+		Py_INCREF(state->evaluated);
+		state->last_td = previous->last_td;
+	} else {
+		state->evaluated = Group_new_snapshot(&ParticleGroup_Type);
+		if (state->evaluated == NULL)
+			goto error;
+	}
+	if (controllers != NULL)
+		count = PyTuple_GET_SIZE(controllers);
+	/* Controllers that have no parameters only add particles, they are
+	   run on update as usual */
+	run = PyList_New(0);
+	if (run == NULL)
+		goto error;
+	for (i = 0; i < count; i++) {
+		ctrlr = PyTuple_GET_ITEM(controllers, i);
+		params = PyObject_CallMethod(ctrlr, "_analytic", NULL);
+		if (params == NULL) {
+			if (PyErr_ExceptionMatches(PyExc_AttributeError)) {
+				PyErr_Format(PyExc_TypeError, 
+					"%.100s controllers are not supported by analytic groups",
+					ctrlr->ob_type->tp_name);
+			}
+			goto error_run;
+		}
+		if (params == Py_None) {
+			if (PyList_Append(run, ctrlr) < 0) {
+				Py_DECREF(params);
+				goto error_run;
+			}
+		} else if (!Analytic_add_params(state, params)) {
+			Py_DECREF(params);
+			goto error_run;
+		}
+		Py_DECREF(params);
+	}
+	state->controllers = PySequence_Tuple(run);
+	Py_DECREF(run);
+	if (state->controllers == NULL)
+		goto error;
+	return state;
+
+error_run:
+	Py_DECREF(run);
+error:
+	Analytic_free(state);
+	return NULL;
+}
+
+/* Return true if the group may be modified, false with an exception set
+   if it is a read-only snapshot */
+static int
+ParticleGroup_check_writable(GroupObject *self)
+{
+	if (self->system == NULL) {
+		PyErr_SetString(PyExc_TypeError, "Cannot modify a group snapshot");
+		return 0;
+	}
+	return 1;
+}
+
+/* Turn double buffering on or off. When turned on, the current particles
+   are published immediately */
+static int
+ParticleGroup_set_double_buffer(GroupObject *self, PyObject *value, 
+	void *closure)
+{
+	int enable;
+
+	if (value == NULL) {
+		PyErr_SetString(PyExc_TypeError, "Cannot delete double_buffer");
+		return -1;
+	}
+	if (!ParticleGroup_check_writable(self))
+		return -1;
+	enable = PyObject_IsTrue(value);
+	if (enable < 0)
+		return -1;
+	if (enable && self->snapshot[0] == NULL) {
+		self->snapshot[0] = Group_new_snapshot(&ParticleGroup_Type);
+		self->snapshot[1] = Group_new_snapshot(&ParticleGroup_Type);
+		self->front = 0;
+		if (self->snapshot[0] == NULL || self->snapshot[1] == NULL 
+			|| !Group_publish(self)) {
+			Py_CLEAR(self->snapshot[0]);
+			Py_CLEAR(self->snapshot[1]);
+			return -1;
+		}
+	} else if (!enable) {
+		/* Draws in progress hold their own references */
+		Py_CLEAR(self->snapshot[0]);
+		Py_CLEAR(self->snapshot[1]);
+	}
+	return 0;
+}
+
 static int
 ParticleGroup_init(GroupObject *self, PyObject *args, PyObject *kwargs)
 {
 	PyObject *particle_module, *r;
-	PyObject *controllers = NULL, *system = NULL;
+	PyObject *controllers = NULL, *system = NULL, *double_buffer = NULL;
+	int analytic = 0, history = 0;
 
-	static char *kwlist[] = {"controllers", "renderer", "system", NULL};
+	static char *kwlist[] = {"controllers", "renderer", "system", 
+		"double_buffer", "analytic", "history", NULL};
 
 	self->renderer = NULL;
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOO:__init__", kwlist,
-		&controllers, &self->renderer, &system))
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|OOOOii:__init__", kwlist,
+		&controllers, &self->renderer, &system, &double_buffer, &analytic,
+		&history))
 		return -1;
 
 	self->iteration = 0;
-	self->plist = (ParticleList *)PyMem_Malloc(
-		sizeof(ParticleList) + sizeof(Particle) * GROUP_MIN_ALLOC);
-	if (self->plist == NULL) {
-		PyErr_NoMemory();
+	self->plist = ParticleList_new();
+	if (self->plist == NULL)
 		return -1;
-	}
-	self->plist->palloc = GROUP_MIN_ALLOC;
-	self->plist->pactive = 0;
-	self->plist->pnew = 0;
-	self->plist->pkilled = 0;
+	GroupBounds_clear(&self->bounds);
+	self->gpu_time = -1.0;
+	self->interpolation = 1.0f;
+	self->snapshot[0] = self->snapshot[1] = NULL;
+	self->front = 0;
+	self->readers = 0;
+	Group_init_fence(self);
+	self->analytic = NULL;
+	self->history.length = self->history.head = 0;
+	self->history.alloc = 0;
+	self->history.samples = NULL;
 	self->controllers = NULL;
 	self->system = NULL;
 
@@ -75,6 +306,22 @@ ParticleGroup_init(GroupObject *self, PyObject *args, PyObject *kwargs)
 	}
 	self->controllers = controllers;
 
+	if (analytic) {
+		self->analytic = Analytic_new(controllers, NULL);
+		if (self->analytic == NULL)
+			goto error;
+	}
+
+	if (history != 0) {
+		if (self->analytic != NULL) {
+			PyErr_SetString(PyExc_ValueError, 
+				"Analytic groups cannot keep a position history");
+			goto error;
+		}
+		if (!Group_set_history(self, history))
+			goto error;
+	}
+
 	if (system == NULL) {
 		/* grab the global default particle system */
 		particle_module = PyImport_ImportModule("lepton");
@@ -88,6 +335,11 @@ ParticleGroup_init(GroupObject *self, PyObject *args, PyObject *kwargs)
 		Py_INCREF(system);
 	}
 	self->system = system;
+
+	if (double_buffer != NULL 
+		&& ParticleGroup_set_double_buffer(self, double_buffer, NULL) < 0)
+		goto error;
+
 	if (system != Py_None) {
 		r = PyObject_CallMethod(system, "add_group", "O", self);
 		Py_XDECREF(r);
@@ -98,10 +350,18 @@ ParticleGroup_init(GroupObject *self, PyObject *args, PyObject *kwargs)
 	return 0;
 
 error:
-	Py_XDECREF(self->controllers);
-	Py_XDECREF(self->renderer);
-	Py_XDECREF(self->system);
+	/* The group is still deallocated, so leave nothing to free twice */
+	Py_CLEAR(self->controllers);
+	Py_CLEAR(self->renderer);
+	Py_CLEAR(self->system);
+	Py_CLEAR(self->snapshot[0]);
+	Py_CLEAR(self->snapshot[1]);
+	Analytic_free(self->analytic);
+	self->analytic = NULL;
+	PyMem_Free(self->history.samples);
+	self->history.samples = NULL;
 	PyMem_Free(self->plist);
+	self->plist = NULL;
 	return -1;
 }
 
@@ -119,6 +379,8 @@ ParticleGroup_new(GroupObject *self, PyObject *args, PyObject *kwargs)
 	int success, arg_count;
 	PyObject *ptemplate = NULL;
 	
+	if (!ParticleGroup_check_writable(self))
+		return NULL;
 	pindex = Group_new_p(self);
 	if (pindex < 0) {
 		PyErr_NoMemory();
@@ -162,7 +424,7 @@ ParticleGroup_kill(GroupObject *self, ParticleRefObject *pref)
 			"Expected particle reference first argument");
 		return NULL;
 	}
-	if (!ParticleRefObject_IsValid(pref)) 
+	if (!ParticleGroup_check_writable(self) || !ParticleRefObject_IsValid(pref)) 
 		return NULL;
 
 	Group_kill_p(self, pref->p);
@@ -220,12 +482,28 @@ ParticleGroup_update(GroupObject *self, PyObject *args)
 	PyObject *ctrlr, *ctrlr_seq, *ctrlr_iter[2], *ctrlr_args;
 	PyObject *r;
 	int i;
+	float interpolation = -1.0f;
 
-	if (!PyArg_ParseTuple(args, "f:update",  &td))
+	if (!PyArg_ParseTuple(args, "f|f:update",  &td, &interpolation))
+		return NULL;
+	if (!ParticleGroup_check_writable(self))
+		return NULL;
+	if (PyTuple_GET_SIZE(args) > 1 && (interpolation < 0.0f || interpolation > 1.0f)) {
+		PyErr_SetString(PyExc_ValueError, 
+			"interpolation must be between 0 and 1");
 		return NULL;
+	}
 	
 	self->iteration++; /* invalidate proxies and group iterators */
 
+	if (self->analytic != NULL) {
+		/* Record the birth age of the new particles */
+		p = self->plist->p;
+		tail = GroupObject_ActiveCount(self) + self->plist->pnew;
+		for (head = GroupObject_ActiveCount(self); head < tail; head++)
+			p[head].scratch1 = p[head].age;
+	}
+
 	/* consolidate active and new particles, reclaim some killed in the
 	 * process. The goal here is to strike a balance between consolidation
 	 * cost and keeping killed particles at bay. New particles are moved into
@@ -238,6 +516,14 @@ ParticleGroup_update(GroupObject *self, PyObject *args)
 	 */
 	p = self->plist->p;
 	pnew = self->plist->pnew;
+	if (self->history.length > 0) {
+		/* New particles start with their whole history where they are */
+		if (!Group_reserve_history(self))
+			return NULL;
+		Group_fill_history(self, GroupObject_ActiveCount(self), 
+			GroupObject_ActiveCount(self) + pnew);
+	}
+	GroupBounds_clear(&self->bounds);
 	head = 0;
 	tail = GroupObject_ActiveCount(self) + pnew;
 	/* Incorporate new particles and update last* and age particle attributes */
@@ -246,6 +532,10 @@ ParticleGroup_update(GroupObject *self, PyObject *args)
 			if (pnew > 0) {
 				if (Particle_IsAlive(p[--tail])) {
 					memcpy(&p[head], &p[tail], sizeof(Particle));
+					if (self->history.length > 0)
+						memcpy(&self->history.samples[head * self->history.length],
+							&self->history.samples[tail * self->history.length],
+							sizeof(Vec3) * self->history.length);
 					self->plist->pactive++;
 				}
 				pnew--;
@@ -259,6 +549,8 @@ ParticleGroup_update(GroupObject *self, PyObject *args)
 			p[head].age += td;
 			p[head].last_position = p[head].position;
 			p[head].last_velocity = p[head].velocity;
+			GroupBounds_include(&self->bounds, &p[head].position);
+			GroupBounds_include_size(&self->bounds, &p[head].size);
 			head++;
 		}
 	}
@@ -269,15 +561,35 @@ ParticleGroup_update(GroupObject *self, PyObject *args)
 	self->plist->pkilled = tail - self->plist->pactive;
 	self->plist->pnew = 0;
 
+	if (self->analytic != NULL) {
+		/* The particles' state is evaluated when drawn, only their
+		   lifetime is enforced */
+		self->analytic->last_td = td;
+		if (self->analytic->max_age != FLT_MAX) {
+			for (head = 0; head < tail; head++) {
+				if (p[head].age > self->analytic->max_age)
+					Group_kill_p(self, &p[head]);
+			}
+		}
+	}
+
 	/* invoke the controllers */
 	ctrlr_seq = PyObject_GetAttrString(self->system, "controllers");
 	if (ctrlr_seq == NULL)
 		return NULL;
+	if (self->analytic != NULL && PyObject_IsTrue(ctrlr_seq)) {
+		Py_DECREF(ctrlr_seq);
+		PyErr_SetString(PyExc_TypeError, 
+			"Global controllers are not supported by analytic groups");
+		return NULL;
+	}
 	ctrlr_iter[0] = PyObject_GetIter(ctrlr_seq);
 	Py_CLEAR(ctrlr_seq);
 	if (ctrlr_iter[0] == NULL)
 		return NULL;
-	if (self->controllers != NULL) 
+	if (self->analytic != NULL)
+		ctrlr_iter[1] = PyObject_GetIter(self->analytic->controllers);
+	else if (self->controllers != NULL) 
 		ctrlr_iter[1] = PyObject_GetIter(self->controllers);
 	else
 		ctrlr_iter[1] = NULL;
@@ -299,6 +611,13 @@ ParticleGroup_update(GroupObject *self, PyObject *args)
 	}
 	
 	Py_DECREF(ctrlr_args);
+	Group_sample_history(self);
+	/* Set with the particles it applies to, so that it is published 
+	   along with them */
+	if (PyTuple_GET_SIZE(args) > 1)
+		self->interpolation = interpolation;
+	if (!Group_publish(self))
+		return NULL;
 	Py_INCREF(Py_None);
 	return Py_None;
 error:
@@ -308,20 +627,46 @@ error:
 	return NULL;
 }
 
+/* Replace the group's controllers with the tuple specified, stealing
+   the reference to it. Analytic groups reject unsupported controllers,
+   leaving the group unchanged. Return false on failure */
+static int
+ParticleGroup_set_controllers(GroupObject *self, PyObject *controllers)
+{
+	AnalyticState *state;
+
+	if (self->analytic != NULL) {
+		state = Analytic_new(controllers, self->analytic);
+		if (state == NULL) {
+			Py_DECREF(controllers);
+			return 0;
+		}
+		Analytic_free(self->analytic);
+		self->analytic = state;
+	}
+	Py_XDECREF(self->controllers);
+	self->controllers = controllers;
+	return 1;
+}
+
 /* Bind one or more controllers to the group */
 static PyObject *
 ParticleGroup_bind_controller(GroupObject *self, PyObject *args)
 {
 	PyObject *new_list;
 
+	if (!ParticleGroup_check_writable(self))
+		return NULL;
 	if (self->controllers != NULL) {
 		new_list = PySequence_Concat(self->controllers, args);
-		Py_DECREF(self->controllers);
-		self->controllers = new_list;
+		if (new_list == NULL)
+			return NULL;
 	} else {
 		Py_INCREF(args);
-		self->controllers = args;
+		new_list = args;
 	}
+	if (!ParticleGroup_set_controllers(self, new_list))
+		return NULL;
 	Py_INCREF(Py_None);
 	return Py_None;
 }
@@ -333,6 +678,8 @@ ParticleGroup_unbind_controller(GroupObject *self, PyObject *ctrlr)
 	PyObject *new_ctrlrs, *item;
 	int i, n, ctrlr_count;
 
+	if (!ParticleGroup_check_writable(self))
+		return NULL;
 	if (self->controllers == NULL || !PySequence_Contains(self->controllers, ctrlr)) {
 		PyErr_SetString(PyExc_ValueError, "controller not bound");
 		return NULL;
@@ -349,8 +696,8 @@ ParticleGroup_unbind_controller(GroupObject *self, PyObject *ctrlr)
 			PyTuple_SET_ITEM(new_ctrlrs, n++, item);
 		}
 	}
-	Py_DECREF(self->controllers);
-	self->controllers = new_ctrlrs;
+	if (!ParticleGroup_set_controllers(self, new_ctrlrs))
+		return NULL;
 	Py_INCREF(Py_None);
 	return Py_None;
 }
@@ -378,6 +725,357 @@ ParticleGroup_draw(GroupObject *self)
 	return Py_None;
 }
 
+/* Return the group to draw for the group, holding off updates to its
+   particles until its end_draw() method is called */
+static PyObject *
+ParticleGroup_begin_draw(GroupObject *self)
+{
+	return (PyObject *)GroupObject_BeginDraw(self);
+}
+
+/* Finish a draw started with begin_draw() */
+static PyObject *
+ParticleGroup_end_draw(GroupObject *self)
+{
+	if (self->readers <= 0) {
+		PyErr_SetString(PyExc_ValueError, "end_draw() called without begin_draw()");
+		return NULL;
+	}
+	Group_end_read(self);
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+/* Return a float, or a tuple of width floats for the reduction values */
+static PyObject *
+reduction_value(const double *dvalues, const float *fvalues, int width)
+{
+	PyObject *result;
+	int i;
+
+	if (width == 1)
+		return PyFloat_FromDouble(dvalues != NULL ? dvalues[0] : fvalues[0]);
+	result = PyTuple_New(width);
+	if (result == NULL)
+		return NULL;
+	for (i = 0; i < width; i++) {
+		PyTuple_SET_ITEM(result, i, 
+			PyFloat_FromDouble(dvalues != NULL ? dvalues[i] : fvalues[i]));
+	}
+	return result;
+}
+
+enum {REDUCE_MEAN, REDUCE_SUM, REDUCE_MIN, REDUCE_MAX};
+
+/* Reduce the named particle attribute over the group */
+static PyObject *
+ParticleGroup_reduce_attr(GroupObject *self, PyObject *args, int op)
+{
+	ParticleReduction r;
+	char *name;
+	int offset, width, i;
+
+	if (!PyArg_ParseTuple(args, "s", &name))
+		return NULL;
+	offset = Particle_attr_offset(name, &width);
+	if (offset < 0) {
+		PyErr_Format(PyExc_ValueError, "No particle attribute named '%s'", name);
+		return NULL;
+	}
+	Group_reduce(self, offset, width, &r);
+	if (!r.count && op != REDUCE_SUM) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	switch (op) {
+		case REDUCE_MEAN:
+			for (i = 0; i < width; i++)
+				r.sum[i] /= r.count;
+			return reduction_value(r.sum, NULL, width);
+		case REDUCE_SUM:
+			return reduction_value(r.sum, NULL, width);
+		case REDUCE_MIN:
+			return reduction_value(NULL, r.min, width);
+		default:
+			return reduction_value(NULL, r.max, width);
+	}
+}
+
+static PyObject *
+ParticleGroup_mean(GroupObject *self, PyObject *args)
+{
+	return ParticleGroup_reduce_attr(self, args, REDUCE_MEAN);
+}
+
+static PyObject *
+ParticleGroup_sum(GroupObject *self, PyObject *args)
+{
+	return ParticleGroup_reduce_attr(self, args, REDUCE_SUM);
+}
+
+static PyObject *
+ParticleGroup_min(GroupObject *self, PyObject *args)
+{
+	return ParticleGroup_reduce_attr(self, args, REDUCE_MIN);
+}
+
+static PyObject *
+ParticleGroup_max(GroupObject *self, PyObject *args)
+{
+	return ParticleGroup_reduce_attr(self, args, REDUCE_MAX);
+}
+
+/* Return the average particle position */
+static PyObject *
+ParticleGroup_centroid(GroupObject *self)
+{
+	ParticleReduction r;
+
+	Group_reduce(self, offsetof(Particle, position), 3, &r);
+	if (!r.count) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	return Py_BuildValue("(ddd)", 
+		r.sum[0] / r.count, r.sum[1] / r.count, r.sum[2] / r.count);
+}
+
+/* Return the minimum and maximum particle positions */
+static PyObject *
+ParticleGroup_bounds(GroupObject *self)
+{
+	ParticleReduction r;
+
+	Group_reduce(self, offsetof(Particle, position), 3, &r);
+	if (!r.count) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	return Py_BuildValue("((fff)(fff))", r.min[0], r.min[1], r.min[2],
+		r.max[0], r.max[1], r.max[2]);
+}
+
+/* Return the position history of a particle, newest first */
+static PyObject *
+ParticleGroup_position_history(GroupObject *self, ParticleRefObject *pref)
+{
+	PyObject *samples, *t;
+	unsigned long index;
+	Vec3 *v;
+	int k;
+
+	if (!ParticleProxy_CHECK(pref)) {
+		PyErr_SetString(PyExc_TypeError, 
+			"Expected particle reference first argument");
+		return NULL;
+	}
+	if (!ParticleRefObject_IsValid(pref)) 
+		return NULL;
+	index = pref->p - self->plist->p;
+	if (pref->parent != (PyObject *)self 
+		|| index >= GroupObject_ActiveCount(self)) {
+		PyErr_SetString(PyExc_ValueError, 
+			"Particle is not an incorporated particle of the group");
+		return NULL;
+	}
+	samples = PyTuple_New(self->history.length);
+	if (samples == NULL)
+		return NULL;
+	for (k = 0; k < self->history.length; k++) {
+		v = PositionHistory_sample(&self->history, index, k);
+		t = Py_BuildValue("(fff)", v->x, v->y, v->z);
+		if (t == NULL) {
+			Py_DECREF(samples);
+			return NULL;
+		}
+		PyTuple_SET_ITEM(samples, k, t);
+	}
+	return samples;
+}
+
+static PyObject *
+ParticleGroup_kinetic_energy(GroupObject *self)
+{
+	return PyFloat_FromDouble(Group_kinetic_energy(self));
+}
+
+static PyObject *
+ParticleGroup_get_aabb(GroupObject *self, void *closure)
+{
+	if (GroupBounds_IsEmpty(&self->bounds)) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	return Py_BuildValue("((fff)(fff))", 
+		self->bounds.min.x, self->bounds.min.y, self->bounds.min.z,
+		self->bounds.max.x, self->bounds.max.y, self->bounds.max.z);
+}
+
+static PyObject *
+ParticleGroup_get_bounding_sphere(GroupObject *self, void *closure)
+{
+	Vec3 center;
+	float radius;
+
+	if (GroupBounds_IsEmpty(&self->bounds)) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	GroupBounds_sphere(&self->bounds, &center, &radius);
+	return Py_BuildValue("((fff)f)", center.x, center.y, center.z, radius);
+}
+
+static PyObject *
+ParticleGroup_get_gpu_time(GroupObject *self, void *closure)
+{
+	if (self->gpu_time < 0.0) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	return PyFloat_FromDouble(self->gpu_time);
+}
+
+static PyObject *
+ParticleGroup_get_double_buffer(GroupObject *self, void *closure)
+{
+	return PyBool_FromLong(self->snapshot[0] != NULL);
+}
+
+static PyObject *
+ParticleGroup_get_analytic(GroupObject *self, void *closure)
+{
+	return PyBool_FromLong(self->analytic != NULL);
+}
+
+static PyObject *
+ParticleGroup_get_history(GroupObject *self, void *closure)
+{
+	return PyInt_FromLong(self->history.length);
+}
+
+static int
+ParticleGroup_set_history(GroupObject *self, PyObject *value, void *closure)
+{
+	long length;
+
+	if (value == NULL) {
+		PyErr_SetString(PyExc_TypeError, "Cannot delete history");
+		return -1;
+	}
+	length = PyInt_AsLong(value);
+	if (length == -1 && PyErr_Occurred())
+		return -1;
+	if (length != 0 && self->analytic != NULL) {
+		PyErr_SetString(PyExc_ValueError, 
+			"Analytic groups cannot keep a position history");
+		return -1;
+	}
+	if (!ParticleGroup_check_writable(self))
+		return -1;
+	return Group_set_history(self, length) ? 0 : -1;
+}
+
+static PyObject *
+ParticleGroup_get_snapshot(GroupObject *self, void *closure)
+{
+	PyObject *snapshot = (PyObject *)self;
+
+	if (self->snapshot[0] != NULL)
+		snapshot = (PyObject *)self->snapshot[self->front];
+	if (self->analytic != NULL)
+		return (PyObject *)Group_evaluate(self, (GroupObject *)snapshot);
+	Py_INCREF(snapshot);
+	return snapshot;
+}
+
+static PyObject *
+ParticleGroup_get_interpolation(GroupObject *self, void *closure)
+{
+	return PyFloat_FromDouble(self->interpolation);
+}
+
+static int
+ParticleGroup_set_interpolation(GroupObject *self, PyObject *value, 
+	void *closure)
+{
+	double interpolation;
+
+	if (value == NULL) {
+		PyErr_SetString(PyExc_TypeError, "Cannot delete interpolation");
+		return -1;
+	}
+	interpolation = PyFloat_AsDouble(value);
+	if (interpolation == -1.0 && PyErr_Occurred())
+		return -1;
+	if (interpolation < 0.0 || interpolation > 1.0) {
+		PyErr_SetString(PyExc_ValueError, 
+			"interpolation must be between 0 and 1");
+		return -1;
+	}
+	self->interpolation = (float)interpolation;
+	/* The published particles are drawn with it too */
+	if (self->snapshot[0] != NULL)
+		self->snapshot[self->front]->interpolation = self->interpolation;
+	return 0;
+}
+
+static PyGetSetDef ParticleGroup_descriptors[] = {
+	{"aabb", (getter)ParticleGroup_get_aabb, NULL, 
+		"Axis-aligned bounding box of the particle positions as\n"
+		"((min_x, min_y, min_z), (max_x, max_y, max_z)), or None\n"
+		"if the group is empty. The box is maintained as particles\n"
+		"move and is conservative: it always contains every particle,\n"
+		"but may be larger than necessary until the next update.", NULL},
+	{"bounding_sphere", (getter)ParticleGroup_get_bounding_sphere, NULL, 
+		"Sphere containing the particle positions as\n"
+		"((center_x, center_y, center_z), radius), or None if the\n"
+		"group is empty. Derived from aabb.", NULL},
+	{"gpu_time", (getter)ParticleGroup_get_gpu_time, NULL, 
+		"GPU time in milliseconds taken to draw the group, as last\n"
+		"measured with renderer.set_gpu_timing() enabled, or None if\n"
+		"not measured. Results arrive a few frames after the draw.", NULL},
+	{"double_buffer", (getter)ParticleGroup_get_double_buffer, 
+		(setter)ParticleGroup_set_double_buffer,
+		"If true, a snapshot of the particles is published at the end\n"
+		"of each update, and native renderers draw the snapshot rather\n"
+		"than the particles themselves. This allows the group to be\n"
+		"drawn while its next update is in progress in another thread,\n"
+		"see ParticleSystem.update_async().", NULL},
+	{"interpolation", (getter)ParticleGroup_get_interpolation, 
+		(setter)ParticleGroup_set_interpolation,
+		"Fraction of the last update step, from 0 to 1, that native\n"
+		"renderers draw the particles at. Particle positions are\n"
+		"interpolated from last_position to position. Set by the\n"
+		"particle system when updating with a fixed time step, the\n"
+		"default of 1 draws the particles where they are. Snapshots\n"
+		"keep the value of the group when published, setting it also\n"
+		"changes that of the published snapshot.", NULL},
+	{"snapshot", (getter)ParticleGroup_get_snapshot, NULL,
+		"The particles as of the last update if double buffered, or\n"
+		"the group itself otherwise. For analytic groups, the current\n"
+		"state of the particles evaluated from their birth state.\n"
+		"Renderers implemented in Python should draw the snapshot,\n"
+		"obtained with begin_draw() so that updates wait for them. It\n"
+		"is read-only, and its particles are only valid until the next\n"
+		"update.", NULL},
+	{"analytic", (getter)ParticleGroup_get_analytic, NULL,
+		"True if the group is analytic. The particles of an analytic\n"
+		"group keep their birth state, and their current state is\n"
+		"computed in closed form from it and their age when drawn,\n"
+		"rather than by the controllers on update. Only controllers\n"
+		"with an _analytic() method can be bound: emitters, Gravity,\n"
+		"Lifetime, Fader, ColorBlender, and Movement and Growth\n"
+		"without damping or limits.", NULL},
+	{"history", (getter)ParticleGroup_get_history, 
+		(setter)ParticleGroup_set_history,
+		"Number of recent positions kept for each particle, from 2 to\n"
+		"64, or 0 if none are kept. A position is sampled at the end\n"
+		"of each update, and new particles start with every sample\n"
+		"at their initial position. Used by RibbonRenderer to draw\n"
+		"trails behind the particles. Not supported by analytic groups.", NULL},
+	{NULL}
+};
+
 static struct PyMemberDef ParticleGroup_members[] = {
     {"controllers", T_OBJECT, offsetof(GroupObject, controllers), RO,
         "Controllers bound to this group"},
@@ -405,18 +1103,61 @@ static PyMethodDef ParticleGroup_methods[] = {
 	{"killed_count", (PyCFunction)ParticleGroup_killed_count, METH_NOARGS,
 		PyDoc_STR("killed_count() -> Number of killed particles not yet reclaimed")},
 	{"update", (PyCFunction)ParticleGroup_update, METH_VARARGS,
-		PyDoc_STR("update(time_delta) -> None\n"
+		PyDoc_STR("update(time_delta[, interpolation]) -> None\n"
 			"Incorporate new particles added since the last update,\n"
 			"and optimize the particle list. Then invoke the controllers\n"
-			"bound to the group to update the particles")},
+			"bound to the group to update the particles. If specified,\n"
+			"interpolation is set once the particles are updated, and\n"
+			"published with them if double buffered")},
 	{"draw", (PyCFunction)ParticleGroup_draw, METH_NOARGS,
 		PyDoc_STR("Draw the group using its renderer (if any)")},
+	{"begin_draw", (PyCFunction)ParticleGroup_begin_draw, METH_NOARGS,
+		PyDoc_STR("begin_draw() -> group\n"
+			"Return the group whose particles should be drawn, the snapshot\n"
+			"if double buffered. Updates do not overwrite its particles\n"
+			"until its end_draw() method is called.")},
+	{"end_draw", (PyCFunction)ParticleGroup_end_draw, METH_NOARGS,
+		PyDoc_STR("end_draw()\n"
+			"Finish drawing a group returned by begin_draw()")},
 	{"bind_controller", (PyCFunction)ParticleGroup_bind_controller, METH_VARARGS,
 		PyDoc_STR("Bind one or more controllers to the group")},
 	{"unbind_controller", (PyCFunction)ParticleGroup_unbind_controller, METH_O,
 		PyDoc_STR("Unbind a controller from the group so it is no longer\n"
 			"invoked on update. If the controller is not bound to the group\n"
 			"raise ValueError")},
+	{"centroid", (PyCFunction)ParticleGroup_centroid, METH_NOARGS,
+		PyDoc_STR("centroid() -> (x, y, z)\n"
+			"Return the average position of the particles in the group,\n"
+			"or None if the group is empty.")},
+	{"bounds", (PyCFunction)ParticleGroup_bounds, METH_NOARGS,
+		PyDoc_STR("bounds() -> ((min_x, min_y, min_z), (max_x, max_y, max_z))\n"
+			"Return the corners of the axis-aligned box that contains\n"
+			"the particle positions, or None if the group is empty.")},
+	{"mean", (PyCFunction)ParticleGroup_mean, METH_VARARGS,
+		PyDoc_STR("mean(attr_name) -> average attribute value\n"
+			"Return the average of a particle attribute over the group,\n"
+			"e.g., group.mean('velocity'). Vector and color attributes\n"
+			"return a tuple. Return None if the group is empty.")},
+	{"sum", (PyCFunction)ParticleGroup_sum, METH_VARARGS,
+		PyDoc_STR("sum(attr_name) -> attribute value total\n"
+			"Return the sum of a particle attribute over the group")},
+	{"min", (PyCFunction)ParticleGroup_min, METH_VARARGS,
+		PyDoc_STR("min(attr_name) -> minimum attribute value\n"
+			"Return the minimum of a particle attribute over the group,\n"
+			"e.g., group.min('age'). Vector and color components are\n"
+			"reduced separately. Return None if the group is empty.")},
+	{"max", (PyCFunction)ParticleGroup_max, METH_VARARGS,
+		PyDoc_STR("max(attr_name) -> maximum attribute value\n"
+			"Return the maximum of a particle attribute over the group,\n"
+			"e.g., group.max('age'). Vector and color components are\n"
+			"reduced separately. Return None if the group is empty.")},
+	{"position_history", (PyCFunction)ParticleGroup_position_history, METH_O,
+		PyDoc_STR("position_history(particle) -> ((x, y, z), ...)\n"
+			"Return the recent positions of an incorporated particle,\n"
+			"newest first, see the history attribute.")},
+	{"kinetic_energy", (PyCFunction)ParticleGroup_kinetic_energy, METH_NOARGS,
+		PyDoc_STR("kinetic_energy() -> total kinetic energy of the particles\n"
+			"Particles with zero mass are treated as having unit mass.")},
 	{NULL,		NULL}		/* sentinel */
 };
 
@@ -427,13 +1168,20 @@ static PySequenceMethods ParticleGroup_as_sequence = {
 PyDoc_STRVAR(ParticleGroup__doc__, 
 	"Group of particles that share behavior via controllers\n"
 	"and are rendered as a unit\n\n"
-	"ParticleGroup(controllers=(), renderer=None, system=particle.default_system)\n\n"
+	"ParticleGroup(controllers=(), renderer=None, system=particle.default_system,\n"
+	"              double_buffer=False, analytic=False, history=0)\n\n"
 	"Initialize the particle group, binding the supplied\n"
 	"controllers to it and setting the renderer.\n\n"
 	"If a system is specified, the group is added to that particle system\n"
 	"automatically. By default, the group is added to the default particle\n"
 	"system (particle.default_system). If you do not wish to bind the group to a\n"
-	"system immediately, pass None for the system.");
+	"system immediately, pass None for the system.\n\n"
+	"If double_buffer is true, renderers draw a snapshot of the particles\n"
+	"taken at the end of each update (see the double_buffer attribute).\n\n"
+	"If analytic is true, the particle state is computed from the birth\n"
+	"state of the particles when drawn (see the analytic attribute).\n\n"
+	"If history is non-zero, that many recent positions of each particle\n"
+	"are kept (see the history attribute).");
 
 static PyTypeObject ParticleGroup_Type = {
 	/* The ob_type field must be initialized in the module init function
@@ -469,7 +1217,7 @@ static PyTypeObject ParticleGroup_Type = {
 	0,                      /*tp_iternext*/
 	ParticleGroup_methods,  /*tp_methods*/
 	ParticleGroup_members,  /*tp_members*/
-	0,                      /*tp_getset*/
+	ParticleGroup_descriptors, /*tp_getset*/
 	0,                      /*tp_base*/
 	0,                      /*tp_dict*/
 	0,                      /*tp_descr_get*/
@@ -548,6 +1296,33 @@ Vector_new(PyObject *parent, Vec3 *vec, int length)
 	return newvec;
 }
 
+/* Keep the bounds of the parent group current when a particle position or
+ * size is changed from Python
+ */
+static void
+Group_particle_vec_changed(PyObject *parent, Vec3 *vec)
+{
+	GroupObject *group;
+	Particle *p;
+	unsigned long offset, count;
+
+	if (parent == NULL || !GroupObject_ANY_CHECK(parent))
+		return;
+	group = (GroupObject *)parent;
+	count = GroupObject_ActiveCount(group) + group->plist->pnew;
+	if ((char *)vec < (char *)group->plist->p 
+		|| (char *)vec >= (char *)(group->plist->p + count))
+		return;
+	offset = ((char *)vec - (char *)group->plist->p) % sizeof(Particle);
+	p = group->plist->p + ((char *)vec - (char *)group->plist->p) / sizeof(Particle);
+	if (!Particle_IsAlive(*p))
+		return;
+	if (offset == offsetof(Particle, position))
+		GroupBounds_include(&group->bounds, &p->position);
+	else if (offset == offsetof(Particle, size))
+		GroupBounds_include_size(&group->bounds, &p->size);
+}
+
 static int
 Vector_setattr(VectorObject *self, char *name, PyObject *v)
 {
@@ -582,6 +1357,8 @@ Vector_setattr(VectorObject *self, char *name, PyObject *v)
 			PyErr_SetString(PyExc_AttributeError, name);
 			result = -1;
 	}
+	if (result == 0)
+		Group_particle_vec_changed(self->parent, self->vec);
 	
 	Py_DECREF(v);
 	return result;
@@ -883,7 +1660,8 @@ ParticleProxy_setattr(ParticleRefObject *self, char *name, PyObject *v)
 {
 	int attr_no, result = 0;
 
-	if (!ParticleRefObject_IsValid(self))
+	if (!ParticleRefObject_IsValid(self) 
+		|| !ParticleGroup_check_writable((GroupObject *)self->parent))
 		return -1;
 	
 	for (attr_no = 0; ParticleProxy_attrname[attr_no]; attr_no++) {
@@ -956,6 +1734,10 @@ ParticleProxy_setattr(ParticleRefObject *self, char *name, PyObject *v)
 			break;
 		case 9: self->p->age = (float)PyFloat_AS_DOUBLE(v);
 	};
+	if (result == 0 && (attr_no == 0 || attr_no == 2)) {
+		Group_particle_vec_changed(self->parent, 
+			attr_no == 0 ? &self->p->position : &self->p->size);
+	}
 
 	Py_XDECREF(v);
 	return result;
@@ -0,0 +1,170 @@
+/****************************************************************************
+*
+* Copyright (c) 2009 by Casey Duncan and contributors
+* All Rights Reserved.
+*
+* This software is subject to the provisions of the MIT License
+* A copy of the license should accompany this distribution.
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*
+****************************************************************************/
+/* Mass octree for Barnes-Hut style approximation
+ *
+ * $Id$
+ */
+
+#include <Python.h>
+#include <float.h>
+#include "octree.h"
+
+void
+Octree_init(Octree *tree)
+{
+	tree->nodes = NULL;
+	tree->count = 0;
+	tree->alloc = 0;
+}
+
+void
+Octree_clear(Octree *tree)
+{
+	PyMem_Free(tree->nodes);
+	Octree_init(tree);
+}
+
+/* Add a new leaf node for the particle inside the octant of the parent
+ * node specified. Return the new node index or -1 if out of memory
+ */
+static int
+Octree_new_leaf(Octree *tree, int parent, int octant, Particle *p, int body)
+{
+	OctNode *node, *nodes;
+	float half;
+	int i;
+
+	if (tree->count >= tree->alloc) {
+		nodes = PyMem_Realloc(tree->nodes, 
+			sizeof(OctNode) * (tree->alloc + tree->alloc / 2 + 64));
+		if (nodes == NULL)
+			return -1;
+		tree->nodes = nodes;
+		tree->alloc += tree->alloc / 2 + 64;
+	}
+	node = &tree->nodes[tree->count];
+	if (parent >= 0) {
+		half = tree->nodes[parent].half_size * 0.5f;
+		node->half_size = half;
+		for (i = 0; i < 3; i++) {
+			node->center[i] = tree->nodes[parent].center[i] + 
+				((octant & (1 << i)) ? half : -half);
+		}
+		tree->nodes[parent].child[octant] = tree->count;
+	}
+	node->body = body;
+	node->mass = Particle_Mass(*p);
+	Vec3_scalar_mul(&node->com, &p->position, node->mass);
+	for (i = 0; i < 8; i++)
+		node->child[i] = -1;
+	return tree->count++;
+}
+
+static inline int
+Octree_octant(OctNode *node, Vec3 *pos)
+{
+	return (pos->x >= node->center[0]) 
+		| ((pos->y >= node->center[1]) << 1)
+		| ((pos->z >= node->center[2]) << 2);
+}
+
+int
+Octree_build(Octree *tree, Particle *p, unsigned long count)
+{
+	Vec3 min, max;
+	OctNode *node;
+	unsigned long i, b;
+	int n, depth, octant, old;
+	float m, extent;
+
+	tree->count = 0;
+	if (count > INT_MAX / 2) {
+		PyErr_SetString(PyExc_OverflowError, "Too many particles for octree");
+		return 0;
+	}
+
+	/* Find the bounds of the live particles for the root node */
+	min.x = min.y = min.z = FLT_MAX;
+	max.x = max.y = max.z = -FLT_MAX;
+	for (i = 0; i < count; i++) {
+		if (Particle_IsAlive(p[i])) {
+			min.x = p[i].position.x < min.x ? p[i].position.x : min.x;
+			min.y = p[i].position.y < min.y ? p[i].position.y : min.y;
+			min.z = p[i].position.z < min.z ? p[i].position.z : min.z;
+			max.x = p[i].position.x > max.x ? p[i].position.x : max.x;
+			max.y = p[i].position.y > max.y ? p[i].position.y : max.y;
+			max.z = p[i].position.z > max.z ? p[i].position.z : max.z;
+		}
+	}
+	for (b = 0; b < count && !Particle_IsAlive(p[b]); b++);
+	if (b == count)
+		return 1; /* No live particles */
+
+	if (Octree_new_leaf(tree, -1, 0, &p[b], b) < 0)
+		goto nomem;
+	node = &tree->nodes[0];
+	node->center[0] = (min.x + max.x) * 0.5f;
+	node->center[1] = (min.y + max.y) * 0.5f;
+	node->center[2] = (min.z + max.z) * 0.5f;
+	extent = max.x - min.x;
+	extent = max.y - min.y > extent ? max.y - min.y : extent;
+	extent = max.z - min.z > extent ? max.z - min.z : extent;
+	node->half_size = extent * 0.5f + EPSILON;
+
+	for (b++; b < count; b++) {
+		if (!Particle_IsAlive(p[b]))
+			continue;
+		m = Particle_Mass(p[b]);
+		n = 0;
+		for (depth = 0;; depth++) {
+			/* Accumulate the mass of each node on the way down */
+			node = &tree->nodes[n];
+			node->mass += m;
+			node->com.x += p[b].position.x * m;
+			node->com.y += p[b].position.y * m;
+			node->com.z += p[b].position.z * m;
+			if (node->body != OCTREE_INTERNAL) {
+				if (depth >= OCTREE_MAX_DEPTH || node->body == OCTREE_LUMPED) {
+					node->body = OCTREE_LUMPED;
+					break;
+				}
+				/* Split the leaf, pushing its particle down a level */
+				old = node->body;
+				node->body = OCTREE_INTERNAL;
+				if (Octree_new_leaf(tree, n, 
+					Octree_octant(node, &p[old].position), &p[old], old) < 0)
+					goto nomem;
+				node = &tree->nodes[n];
+			}
+			octant = Octree_octant(node, &p[b].position);
+			if (node->child[octant] < 0) {
+				if (Octree_new_leaf(tree, n, octant, &p[b], b) < 0)
+					goto nomem;
+				break;
+			}
+			n = node->child[octant];
+		}
+	}
+
+	/* Convert the weighted position sums to centers of mass */
+	for (i = 0; i < tree->count; i++) {
+		node = &tree->nodes[i];
+		Vec3_scalar_muli(&node->com, 1.0f / node->mass);
+	}
+	return 1;
+
+nomem:
+	tree->count = 0;
+	PyErr_NoMemory();
+	return 0;
+}
@@ -0,0 +1,67 @@
+/****************************************************************************
+*
+* Copyright (c) 2009 by Casey Duncan and contributors
+* All Rights Reserved.
+*
+* This software is subject to the provisions of the MIT License
+* A copy of the license should accompany this distribution.
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*
+****************************************************************************/
+/* Mass octree for Barnes-Hut style approximation
+ *
+ * Each node stores the total mass and center of mass of the particles
+ * inside it, so that distant clusters of particles may be treated as a
+ * single body. Leaves hold a single particle, except at the maximum depth
+ * where coincident particles are lumped together.
+ *
+ * Nodes are kept in a single array, which is reused between builds, and
+ * refer to each other by index.
+ *
+ * $Id$
+ */
+
+#include "group.h"
+
+#ifndef _OCTREE_H_
+#define _OCTREE_H_
+
+#define OCTREE_MAX_DEPTH 32
+
+/* Special OctNode body values */
+#define OCTREE_INTERNAL -1 /* Node has children */
+#define OCTREE_LUMPED -2   /* Leaf with several particles */
+
+typedef struct {
+	float	center[3];
+	float	half_size;
+	Vec3	com; /* Center of mass */
+	float	mass;
+	int		body; /* particle index for leaves, or special value above */
+	int		child[8]; /* child node indices or -1 */
+} OctNode;
+
+typedef struct {
+	OctNode			*nodes;
+	unsigned long	count;
+	unsigned long	alloc;
+} Octree;
+
+/* Initialize an empty octree */
+void
+Octree_init(Octree *tree);
+
+/* Free the octree's nodes */
+void
+Octree_clear(Octree *tree);
+
+/* Build the octree from the live particles in the array of count particles.
+ * Return true on success, false on failure with an exception set. The tree
+ * is empty (count == 0) if there are no live particles. Node 0 is the root.
+ */
+int
+Octree_build(Octree *tree, Particle *p, unsigned long count);
+
+#endif
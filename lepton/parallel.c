@@ -0,0 +1,186 @@
+/****************************************************************************
+*
+* Copyright (c) 2009 by Casey Duncan and contributors
+* All Rights Reserved.
+*
+* This software is subject to the provisions of the MIT License
+* A copy of the license should accompany this distribution.
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*
+****************************************************************************/
+/* Data-parallel loops over particle ranges
+ *
+ * $Id$
+ */
+
+#include <Python.h>
+#include <stdlib.h>
+#include "parallel.h"
+
+#if !defined(_WIN32) && !defined(LEPTON_NO_THREADS)
+#define HAVE_PARALLEL 1
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef HAVE_PARALLEL
+
+#define PARALLEL_STACK_SIZE (256 * 1024)
+
+static struct {
+	int initialized;
+	int busy;
+	int nthreads; /* worker threads, not counting the caller */
+	pthread_mutex_t lock;
+	pthread_cond_t work_ready;
+	pthread_cond_t work_done;
+	unsigned long generation;
+	ParallelFunc func;
+	void *ctx;
+	unsigned long count;
+	unsigned long chunks;
+	unsigned long next_chunk;
+	unsigned long chunks_done;
+} pool;
+
+/* Run chunks from the current job until none are left. Called with the
+ * pool lock held, returns with it held.
+ */
+static void
+pool_run_chunks(void)
+{
+	unsigned long chunk, start, end;
+	while (pool.next_chunk < pool.chunks) {
+		chunk = pool.next_chunk++;
+		/* Compute the bounds in two steps to avoid overflow */
+		start = chunk * (pool.count / pool.chunks) +
+			chunk * (pool.count % pool.chunks) / pool.chunks;
+		end = (chunk + 1) * (pool.count / pool.chunks) +
+			(chunk + 1) * (pool.count % pool.chunks) / pool.chunks;
+		pthread_mutex_unlock(&pool.lock);
+		pool.func(pool.ctx, chunk, start, end);
+		pthread_mutex_lock(&pool.lock);
+		if (++pool.chunks_done == pool.chunks)
+			pthread_cond_signal(&pool.work_done);
+	}
+}
+
+static void *
+pool_worker(void *arg)
+{
+	unsigned long generation = 0;
+	pthread_mutex_lock(&pool.lock);
+	for (;;) {
+		while (pool.generation == generation)
+			pthread_cond_wait(&pool.work_ready, &pool.lock);
+		generation = pool.generation;
+		pool_run_chunks();
+	}
+	return NULL;
+}
+
+static void
+pool_after_fork(void)
+{
+	/* Worker threads do not survive fork(), start over in the child */
+	pool.initialized = 0;
+	pool.busy = 0;
+}
+
+static void
+pool_init(void)
+{
+	pthread_t thread;
+	pthread_attr_t attr;
+	long ncpu;
+	char *env;
+	int i;
+
+	pool.initialized = 1;
+	pool.nthreads = 0;
+	pool.busy = 0;
+	pool.generation = 0;
+	env = getenv("LEPTON_THREADS");
+	if (env != NULL) {
+		ncpu = atol(env);
+	} else {
+#ifdef _SC_NPROCESSORS_ONLN
+		ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+#else
+		ncpu = 1;
+#endif
+	}
+	if (ncpu > PARALLEL_MAX_CHUNKS)
+		ncpu = PARALLEL_MAX_CHUNKS;
+	if (ncpu <= 1)
+		return;
+	if (pthread_mutex_init(&pool.lock, NULL) != 0
+		|| pthread_cond_init(&pool.work_ready, NULL) != 0
+		|| pthread_cond_init(&pool.work_done, NULL) != 0)
+		return;
+	pthread_atfork(NULL, NULL, pool_after_fork);
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	/* Chunk functions use little stack, don't reserve the default */
+	pthread_attr_setstacksize(&attr, PARALLEL_STACK_SIZE);
+	for (i = 1; i < ncpu; i++) {
+		if (pthread_create(&thread, &attr, pool_worker, NULL) != 0)
+			break;
+		pool.nthreads++;
+	}
+	pthread_attr_destroy(&attr);
+}
+
+#endif /* HAVE_PARALLEL */
+
+unsigned long
+parallel_chunk_count(unsigned long count, unsigned long min_chunk)
+{
+#ifdef HAVE_PARALLEL
+	unsigned long chunks;
+	if (!pool.initialized)
+		pool_init();
+	if (min_chunk < 1)
+		min_chunk = 1;
+	chunks = count / min_chunk;
+	if (chunks > (unsigned long)pool.nthreads + 1)
+		chunks = pool.nthreads + 1;
+	return chunks > 0 ? chunks : 1;
+#else
+	return 1;
+#endif
+}
+
+unsigned long
+parallel_for(unsigned long count, unsigned long min_chunk,
+	ParallelFunc func, void *ctx)
+{
+#ifdef HAVE_PARALLEL
+	unsigned long chunks = parallel_chunk_count(count, min_chunk);
+	if (chunks > 1 && !pool.busy) {
+		/* busy is only read and written with the GIL held */
+		pool.busy = 1;
+		Py_BEGIN_ALLOW_THREADS
+		pthread_mutex_lock(&pool.lock);
+		pool.func = func;
+		pool.ctx = ctx;
+		pool.count = count;
+		pool.chunks = chunks;
+		pool.next_chunk = 0;
+		pool.chunks_done = 0;
+		pool.generation++;
+		pthread_cond_broadcast(&pool.work_ready);
+		pool_run_chunks();
+		while (pool.chunks_done < pool.chunks)
+			pthread_cond_wait(&pool.work_done, &pool.lock);
+		pthread_mutex_unlock(&pool.lock);
+		Py_END_ALLOW_THREADS
+		pool.busy = 0;
+		return chunks;
+	}
+#endif
+	func(ctx, 0, 0, count);
+	return 1;
+}
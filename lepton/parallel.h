@@ -0,0 +1,54 @@
+/****************************************************************************
+*
+* Copyright (c) 2009 by Casey Duncan and contributors
+* All Rights Reserved.
+*
+* This software is subject to the provisions of the MIT License
+* A copy of the license should accompany this distribution.
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+*
+****************************************************************************/
+/* Data-parallel loops over particle ranges
+ *
+ * A small persistent pool of worker threads is used to split a loop over
+ * count items into contiguous chunks. The calling thread runs chunks
+ * alongside the workers and the GIL is released for the duration, so chunk
+ * functions must never touch Python objects.
+ *
+ * Platforms without pthreads simply run the loop as a single chunk.
+ *
+ * $Id$
+ */
+
+#ifndef _PARALLEL_H_
+#define _PARALLEL_H_
+
+/* Upper bound on the number of chunks a loop is split into. Callers that
+ * keep per-chunk state (e.g., partial sums) can size arrays with this.
+ */
+#define PARALLEL_MAX_CHUNKS 16
+
+/* Function called for each chunk. chunk is the chunk number in the range
+ * [0, chunk count), start and end are the item range [start, end) the chunk
+ * covers.
+ */
+typedef void (*ParallelFunc)(void *ctx, unsigned long chunk,
+	unsigned long start, unsigned long end);
+
+/* Return the number of chunks that parallel_for() will use for count items
+ * given the minimum number of items per chunk specified
+ */
+unsigned long
+parallel_chunk_count(unsigned long count, unsigned long min_chunk);
+
+/* Call func for each chunk of count items, possibly concurrently. Does
+ * not return until all chunks are complete. Must be called with the GIL
+ * held. Return the number of chunks used.
+ */
+unsigned long
+parallel_for(unsigned long count, unsigned long min_chunk,
+	ParallelFunc func, void *ctx);
+
+#endif
@@ -34,15 +34,20 @@ class FillRenderer:
 	
 	def draw(self, group):
 		fill = self.surface.fill
-		if self.flags is None:
-			for p in group:
-				fill(p.color.clamp(0, 255), 
-					(p.position.x, p.position.y, p.size.x, p.size.y))
-		else:
-			flags = self.flags
-			for p in group:
-				fill(p.color.clamp(0, 255), 
-					(p.position.x, p.position.y, p.size.x, p.size.y), flags)
+		# Draw the published snapshot, holding off updates to it meanwhile
+		snapshot = group.begin_draw()
+		try:
+			if self.flags is None:
+				for p in snapshot:
+					fill(p.color.clamp(0, 255), 
+						(p.position.x, p.position.y, p.size.x, p.size.y))
+			else:
+				flags = self.flags
+				for p in snapshot:
+					fill(p.color.clamp(0, 255), 
+						(p.position.x, p.position.y, p.size.x, p.size.y), flags)
+		finally:
+			snapshot.end_draw()
 
 
 class Cache:
@@ -119,20 +124,25 @@ class BlitRenderer:
 	def draw(self, group):
 		blit = self.surface.blit
 		psurface = self.particle_surface
-		if not self.rotate_and_scale:
-			for p in group:
-				blit(psurface, (p.position.x, p.position.y))
-		else:
-			cache = self.surf_cache
-			surfid = id(psurface)
-			for p in group:
-				size = int(p.size.x)
-				rot = int(p.rotation.x)
-				cachekey = (surfid, size, rot)
-				try:
-					surface = cache[cachekey]
-				except KeyError:
-					scale = p.size.x / psurface.get_width()
-					surface = cache[cachekey] = rotozoom(psurface, rot, scale)
-				blit(surface, (p.position.x, p.position.y))
+		# Draw the published snapshot, holding off updates to it meanwhile
+		snapshot = group.begin_draw()
+		try:
+			if not self.rotate_and_scale:
+				for p in snapshot:
+					blit(psurface, (p.position.x, p.position.y))
+			else:
+				cache = self.surf_cache
+				surfid = id(psurface)
+				for p in snapshot:
+					size = int(p.size.x)
+					rot = int(p.rotation.x)
+					cachekey = (surfid, size, rot)
+					try:
+						surface = cache[cachekey]
+					except KeyError:
+						scale = p.size.x / psurface.get_width()
+						surface = cache[cachekey] = rotozoom(psurface, rot, scale)
+					blit(surface, (p.position.x, p.position.y))
+		finally:
+			snapshot.end_draw()
 
@@ -34,10 +34,29 @@
 #include "vector.h"
 #include "group.h"
 #include "renderer.h"
+#include "parallel.h"
+#include "glstate.h"
+
+/* Indices of the particles to draw, in draw order */
+typedef struct {
+	GLuint *index;
+	unsigned long count;
+	unsigned long alloc;
+	int sorted; /* true if index holds the last sorted draw order */
+	float *depth;
+	GLuint *sort_index;
+	unsigned short *key;
+	unsigned short *sort_key;
+	unsigned long sort_alloc;
+} DrawList;
 
 typedef struct {
 	PyObject_HEAD
 	PyObject *texturizer;
+	int cull;
+	int sort;
+	float stretch;
+	DrawList draw_list;
 } RendererObject;
 
 int
@@ -70,7 +89,7 @@ typedef struct {
 typedef struct {
 	union {
 		ColorSwizzle rgba;
-		unsigned long colorl;
+		GLuint colorl; /* Must be 32 bits for the packed color array */
 	};
 } ColorItem;
 
@@ -79,24 +98,29 @@ typedef struct {
 	Py_ssize_t size; /* Number of verts */
 	VertItem *verts;
 	ColorItem *colors;
+	float *tex_coords; /* Only allocated for a nonzero tex dimension */
 } VertArray;
 
-/* Allocate space for vertex data for the given particle group
-   and texture dimension. Store the results in data.
+/* Allocate space for vertex data for the given number of vertices
+   and texture dimension. Store the results in data. If tex_dimension
+   is zero, no space is allocated for texture coordinates.
 
    Return 1 on success, 0 on failure
 */
 static int
-VertArray_alloc(GroupObject *pgroup, VertArray *data)
+VertArray_alloc(VertArray *data, unsigned long count, long tex_dimension)
 {
-	data->size = GroupObject_ActiveCount(pgroup) * 4;
+	data->size = count;
 	data->is_vbo = 0;
 	data->verts = (VertItem *)PyMem_Malloc(
 		data->size*sizeof(VertItem) + /* vert data */
-		data->size*sizeof(ColorItem)  /* color data */
+		data->size*sizeof(ColorItem) + /* color data */
+		data->size*tex_dimension*sizeof(float) /* tex coord data */
 		);
 	if (data->verts != NULL) {
 		data->colors = (ColorItem *)(data->verts + data->size);
+		data->tex_coords = tex_dimension ? 
+			(float *)(data->colors + data->size) : NULL;
 		return 1;
 	} else {
 		PyErr_NoMemory();
@@ -110,6 +134,45 @@ VertArray_free(VertArray *data)
 	if (!data->is_vbo)
 		PyMem_Free((void *)data->verts);
 }
+
+/* Pack a color into 8 bit RGBA components, clamping them to [0, 1].
+   Each component is handled identically so this vectorizes well. */
+static inline GLuint
+pack_color(Color *color)
+{
+	ColorItem packed;
+	float c[4];
+	int i;
+
+	c[0] = color->r;
+	c[1] = color->g;
+	c[2] = color->b;
+	c[3] = color->a;
+	for (i = 0; i < 4; i++) {
+		c[i] = c[i] > 0.0f ? c[i] : 0.0f;
+		c[i] = c[i] < 1.0f ? c[i] : 1.0f;
+		c[i] = c[i] * 255.0f + 0.5f;
+	}
+	packed.rgba.r = (unsigned char)c[0];
+	packed.rgba.g = (unsigned char)c[1];
+	packed.rgba.b = (unsigned char)c[2];
+	packed.rgba.a = (unsigned char)c[3];
+	return packed.colorl;
+}
+
+/* Store the particle's position interpolated from its last position by
+   alpha, where 1 is the current position */
+static inline void
+interpolate_position(Vec3 *pos, const Particle *p, float alpha)
+{
+	if (alpha >= 1.0f) {
+		*pos = p->position;
+	} else {
+		Vec3_sub(pos, &p->position, &p->last_position);
+		Vec3_scalar_muli(pos, alpha);
+		Vec3_addi(pos, &p->last_position);
+	}
+}
 	
 /* --------------------------------------------------------------------- */
 
@@ -245,435 +308,2581 @@ static PyTypeObject FloatArray_Type = {
 
 /* --------------------------------------------------------------------- */
 
-static PyTypeObject PointRenderer_Type;
+/* View frustum culling */
 
+/* Frustum planes (a, b, c, d) with normals facing inward and normalized
+   so that a*x + b*y + c*z + d is the signed distance of (x, y, z) from
+   the plane in object coordinates */
 typedef struct {
-	PyObject_HEAD
-	float	 point_size;
-	PyObject *texturizer;
-} PointRendererObject;
+	float plane[6][4];
+} Frustum;
+
+#define FRUSTUM_OUTSIDE 0
+#define FRUSTUM_INSIDE 1
+#define FRUSTUM_INTERSECTS 2
+
+/* Quads may be rotated about the view axis, so they extend from the
+   particle position by at most half of the diagonal of their size */
+#define BILLBOARD_CULL_PAD 0.70710678f
 
+#define CULL_MIN_CHUNK 4096
+#define CULL_TILE 64
+
+/* Extract the frustum planes from column-major projection and
+   model-view matrices */
 static void
-PointRenderer_dealloc(PointRendererObject *self) 
+Frustum_from_matrices(Frustum *frustum, float *proj, float *mv)
 {
-	Py_CLEAR(self->texturizer);	
-	PyObject_Del(self);
+	float clip[16], len;
+	int row, col, k, i;
+
+	for (col = 0; col < 4; col++) {
+		for (row = 0; row < 4; row++) {
+			clip[col*4 + row] = 0.0f;
+			for (k = 0; k < 4; k++)
+				clip[col*4 + row] += proj[k*4 + row] * mv[col*4 + k];
+		}
+	}
+	/* left, right, bottom, top, near, far are row 3 +/- rows 0, 1, 2 */
+	for (i = 0; i < 6; i++) {
+		row = i / 2;
+		for (col = 0; col < 4; col++) {
+			if (i % 2 == 0)
+				frustum->plane[i][col] = clip[col*4 + 3] + clip[col*4 + row];
+			else
+				frustum->plane[i][col] = clip[col*4 + 3] - clip[col*4 + row];
+		}
+		len = sqrtf(frustum->plane[i][0] * frustum->plane[i][0] 
+			+ frustum->plane[i][1] * frustum->plane[i][1] 
+			+ frustum->plane[i][2] * frustum->plane[i][2]);
+		if (len > EPSILON) {
+			for (col = 0; col < 4; col++)
+				frustum->plane[i][col] /= len;
+		}
+	}
 }
 
+/* Classify the box min-max expanded by pad against the frustum */
 static int
-PointRenderer_init(PointRendererObject *self, PyObject *args, PyObject *kwargs)
+Frustum_classify_box(Frustum *frustum, float *min, float *max, float pad)
 {
-	static char *kwlist[] = {"point_size", "texturizer", NULL};
-
-	self->texturizer = NULL;
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "f|O:__init__",kwlist, 
-		&self->point_size, &self->texturizer))
-		return -1;
-	if (self->texturizer == Py_None)
-		self->texturizer = NULL;
-	if (self->texturizer != NULL)
-		Py_INCREF(self->texturizer);
-	return 0;
+	float *pl;
+	int i, result = FRUSTUM_INSIDE;
+
+	for (i = 0; i < 6; i++) {
+		pl = frustum->plane[i];
+		/* Test the box corners farthest along and against the normal */
+		if (pl[0] * (pl[0] >= 0.0f ? max[0] : min[0])
+			+ pl[1] * (pl[1] >= 0.0f ? max[1] : min[1])
+			+ pl[2] * (pl[2] >= 0.0f ? max[2] : min[2]) + pl[3] < -pad)
+			return FRUSTUM_OUTSIDE;
+		if (pl[0] * (pl[0] >= 0.0f ? min[0] : max[0])
+			+ pl[1] * (pl[1] >= 0.0f ? min[1] : max[1])
+			+ pl[2] * (pl[2] >= 0.0f ? min[2] : max[2]) + pl[3] < pad)
+			result = FRUSTUM_INTERSECTS;
+	}
+	return result;
 }
 
-static PyObject *
-PointRenderer_draw(PointRendererObject *self, GroupObject *pgroup)
+static int
+DrawList_reserve(DrawList *list, unsigned long count)
 {
-	Particle *p;
-	PyObject *r = NULL;
-	int GL_error;
-	unsigned long count_particles;
+	GLuint *index;
 
-	if (!GroupObject_Check(pgroup)) {
-		PyErr_SetString(PyExc_TypeError, "Expected ParticleGroup first argument");
-		return NULL;
+	if (count > list->alloc) {
+		index = PyMem_Realloc(list->index, sizeof(GLuint) * count);
+		if (index == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+		list->index = index;
+		list->alloc = count;
 	}
+	return 1;
+}
 
-	if (!glew_initialize())
-		return NULL;
+static void
+DrawList_clear(DrawList *list)
+{
+	PyMem_Free(list->index);
+	PyMem_Free(list->depth);
+	list->index = NULL;
+	list->count = 0;
+	list->alloc = 0;
+	list->sorted = 0;
+	list->depth = NULL;
+	list->sort_index = NULL;
+	list->key = NULL;
+	list->sort_key = NULL;
+	list->sort_alloc = 0;
+}
 
-	count_particles = GroupObject_ActiveCount(pgroup);
-	if (count_particles > 0){
-		p = pgroup->plist->p;
-		if (self->texturizer != NULL) {
-			r = PyObject_CallMethod(self->texturizer, "set_state", NULL);
-			if (r == NULL)
-				return NULL;
-			Py_DECREF(r);
-			glEnable(GL_POINT_SPRITE);
-			glTexEnvi(GL_POINT_SPRITE, GL_COORD_REPLACE, GL_TRUE);
+typedef struct {
+	Particle *p;
+	Frustum *frustum;
+	float pad_scale;
+	float stretch;
+	float alpha;  /* Interpolation of the positions drawn */
+	int test_planes;
+	GLuint *index;
+	unsigned long start[PARALLEL_MAX_CHUNKS];
+	unsigned long visible[PARALLEL_MAX_CHUNKS];
+} CullJob;
+
+/* Cull a chunk of particles a tile at a time. Each tile is loaded into
+   separate coordinate arrays, then the tile's bounds are tested so that
+   the per-particle plane tests are only needed for tiles that straddle
+   the frustum. The plane test loops have no branches so the compiler
+   can vectorize them. The indices of the visible particles are written
+   compacted to the start of the chunk's range of the index array */
+static void
+cull_chunk(void *ctx, unsigned long chunk, unsigned long start, unsigned long end)
+{
+	CullJob *job = (CullJob *)ctx;
+	Particle *p;
+	GLuint *out = job->index + start;
+	float x[CULL_TILE], y[CULL_TILE], z[CULL_TILE], r[CULL_TILE];
+	int visible[CULL_TILE];
+	float min[3], max[3], max_r, *pl;
+	Vec3 pos;
+	unsigned long i, n = 0;
+	int j, k, tile, result;
+
+	for (i = start; i < end; i += tile) {
+		tile = (end - i < CULL_TILE) ? (int)(end - i) : CULL_TILE;
+		min[0] = min[1] = min[2] = FLT_MAX;
+		max[0] = max[1] = max[2] = -FLT_MAX;
+		max_r = 0.0f;
+		p = job->p + i;
+		for (j = 0; j < tile; j++) {
+			/* Test where the particles are drawn */
+			interpolate_position(&pos, &p[j], job->alpha);
+			x[j] = pos.x;
+			y[j] = pos.y;
+			z[j] = pos.z;
+			r[j] = p[j].size.x > p[j].size.y ? p[j].size.x : p[j].size.y;
+			r[j] = job->pad_scale * (p[j].size.z > r[j] ? p[j].size.z : r[j]);
+			if (job->stretch > 0.0f)
+				r[j] += job->stretch * Vec3_len(&p[j].velocity);
+			visible[j] = Particle_IsAlive(p[j]);
+			if (visible[j]) {
+				min[0] = x[j] < min[0] ? x[j] : min[0];
+				min[1] = y[j] < min[1] ? y[j] : min[1];
+				min[2] = z[j] < min[2] ? z[j] : min[2];
+				max[0] = x[j] > max[0] ? x[j] : max[0];
+				max[1] = y[j] > max[1] ? y[j] : max[1];
+				max[2] = z[j] > max[2] ? z[j] : max[2];
+				max_r = r[j] > max_r ? r[j] : max_r;
+			}
 		}
+		if (min[0] > max[0])
+			continue; /* No live particles */
+		result = job->test_planes ? 
+			Frustum_classify_box(job->frustum, min, max, max_r) : FRUSTUM_INSIDE;
+		if (result == FRUSTUM_OUTSIDE)
+			continue;
+		if (result == FRUSTUM_INTERSECTS) {
+			for (k = 0; k < 6; k++) {
+				pl = job->frustum->plane[k];
+				for (j = 0; j < tile; j++)
+					visible[j] &= (pl[0] * x[j] + pl[1] * y[j] + pl[2] * z[j] 
+						+ pl[3] >= -r[j]);
+			}
+		}
+		for (j = 0; j < tile; j++) {
+			out[n] = (GLuint)(i + j);
+			n += visible[j];
+		}
+	}
+	job->start[chunk] = start;
+	job->visible[chunk] = n;
+}
 
-		glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
-		glEnableClientState(GL_VERTEX_ARRAY);
-		glEnableClientState(GL_COLOR_ARRAY);
-		glPointSize(self->point_size);
-		glVertexPointer(3, GL_FLOAT, sizeof(Particle), &p[0].position);
-		glColorPointer(4, GL_FLOAT, sizeof(Particle), &p[0].color);
-		glDrawArrays(GL_POINTS, 0, GroupObject_ActiveCount(pgroup));
-		glPopClientAttrib();
+/* Store the indices of the live particles in the group that may be
+   visible in the frustum in the draw list. Particles extend from their
+   position, interpolated as drawn, by pad_scale times their largest size
+   component, plus stretch times their speed. If frustum is NULL, all live
+   particles are stored.
+   
+   Return true on success, false on failure with an exception set.
+*/
+static int
+DrawList_cull(DrawList *list, GroupObject *pgroup, Frustum *frustum, 
+	float pad_scale, float stretch)
+{
+	CullJob job;
+	unsigned long count, chunks, c;
+	float min[3], max[3];
+	int result;
+
+	list->count = 0;
+	list->sorted = 0;
+	count = GroupObject_ActiveCount(pgroup);
+	if (count == 0 || GroupBounds_IsEmpty(&pgroup->bounds))
+		return 1;
 
-		GL_error = glGetError();
-		if (GL_error != GL_NO_ERROR) {
-			PyErr_Format(PyExc_RuntimeError, "GL error %d", GL_error);
-			return NULL;
+	result = FRUSTUM_INSIDE;
+	if (frustum != NULL) {
+		/* The group's bounds reject or accept it as a whole */
+		min[0] = pgroup->bounds.min.x;
+		min[1] = pgroup->bounds.min.y;
+		min[2] = pgroup->bounds.min.z;
+		max[0] = pgroup->bounds.max.x;
+		max[1] = pgroup->bounds.max.y;
+		max[2] = pgroup->bounds.max.z;
+		result = Frustum_classify_box(frustum, min, max, 
+			pad_scale * pgroup->bounds.max_size);
+		if (result == FRUSTUM_OUTSIDE) {
+			/* The bounds do not account for the particle speeds, so
+			   stretched particles may still reach into the frustum.
+			   Nor do they contain the last positions that interpolated
+			   particles are drawn between */
+			if (stretch <= 0.0f && pgroup->interpolation >= 1.0f)
+				return 1;
+			result = FRUSTUM_INTERSECTS;
 		}
+	}
 
-		if (self->texturizer != NULL) {
-			r = PyObject_CallMethod(self->texturizer, "restore_state", NULL);
-			if (r == NULL)
-				return NULL;
-			Py_DECREF(r);
-		}
-	}	
-	Py_INCREF(Py_None);
-	return Py_None;
+	if (!DrawList_reserve(list, count))
+		return 0;
+	job.p = pgroup->plist->p;
+	job.frustum = frustum;
+	job.pad_scale = pad_scale;
+	job.stretch = stretch;
+	job.alpha = pgroup->interpolation;
+	job.test_planes = (result == FRUSTUM_INTERSECTS);
+	job.index = list->index;
+	chunks = parallel_for(count, CULL_MIN_CHUNK, cull_chunk, &job);
+
+	list->count = job.visible[0];
+	for (c = 1; c < chunks; c++) {
+		memmove(list->index + list->count, list->index + job.start[c],
+			sizeof(GLuint) * job.visible[c]);
+		list->count += job.visible[c];
+	}
+	return 1;
 }
 
-static struct PyMemberDef PointRenderer_members[] = {
-    {"point_size", T_FLOAT, offsetof(PointRendererObject, point_size), 0,
-        "Size of GL_POINTS drawn"},
-    {"texturizer", T_OBJECT, offsetof(PointRendererObject, texturizer), 0,
-        "Texturizer used to apply texture to particles"},
-	{NULL}
-};
+/* --------------------------------------------------------------------- */
 
-static PyMethodDef PointRenderer_methods[] = {
-	{"draw", (PyCFunction)PointRenderer_draw, METH_O,
-		PyDoc_STR("Draw the particles in the specified group using GL_POINTS")},
-	{NULL,		NULL}		/* sentinel */
-};
+/* Back-to-front depth sorting of draw lists
 
-PyDoc_STRVAR(PointRenderer__doc__, 
-	"Simple particle renderer using GL_POINTS. All particles in the\n"
-	"group are rendered with the same point size\n\n"
-	"PointRenderer(point_size, texturizer=None)\n\n"
-	"point_size -- Size of GL_POINTS points to draw (float)\n\n"
-	"texturizer -- Texturizer used to apply texture to particles.\n"
-	"If specified, the points are drawn using GL_POINT_SPRITES.\n"
-	"Note that point sprites have fixed texture coordinates,\n"
-	"thus they cannot use custom per-particle coordinates\n"
-	"computed by the texturizer.");
+   Particles are sorted by the eye-space z coordinate of their position
+   interpolated as drawn, farthest first.
+   The depths are quantized to 16 bit keys and sorted with a two pass
+   radix sort whose histogram and scatter passes are split across worker
+   threads. When the particles drawn are the same as the last frame, the
+   previous order is usually nearly sorted already, so an insertion pass
+   over it is tried first, falling back to the radix sort if the order has
+   changed too much. The particles themselves are never reordered.
+*/
 
-static PyTypeObject PointRenderer_Type = {
-	/* The ob_type field must be initialized in the module init function
-	 * to be portable to Windows without using C++. */
-	PyObject_HEAD_INIT(NULL)
-	0,			/*ob_size*/
-	"renderer.PointRenderer",		/*tp_name*/
-	sizeof(PointRendererObject),	/*tp_basicsize*/
-	0,			/*tp_itemsize*/
-	/* methods */
-	(destructor)PointRenderer_dealloc, /*tp_dealloc*/
-	0,			/*tp_print*/
-	0,          /*tp_getattr*/
-	0,          /*tp_setattr*/
-	0,			/*tp_compare*/
-	0,			/*tp_repr*/
-	0,			/*tp_as_number*/
-	0,	        /*tp_as_sequence*/
-	0,			/*tp_as_mapping*/
-	0,			/*tp_hash*/
-	0,                      /*tp_call*/
-	0,                      /*tp_str*/
-	0,                      /*tp_getattro*/
-	0,                      /*tp_setattro*/
-	0,                      /*tp_as_buffer*/
-	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /*tp_flags*/
-	PointRenderer__doc__,   /*tp_doc*/
-	0,                      /*tp_traverse*/
-	0,                      /*tp_clear*/
-	0,                      /*tp_richcompare*/
-	0,                      /*tp_weaklistoffset*/
-	0,                      /*tp_iter*/
-	0,                      /*tp_iternext*/
-	PointRenderer_methods,  /*tp_methods*/
-	PointRenderer_members,  /*tp_members*/
-	0,                      /*tp_getset*/
-	0,                      /*tp_base*/
-	0,                      /*tp_dict*/
-	0,                      /*tp_descr_get*/
-	0,                      /*tp_descr_set*/
-	0,                      /*tp_dictoffset*/
-	(initproc)PointRenderer_init, /*tp_init*/
-	0,                      /*tp_alloc*/
-	0,                      /*tp_new*/
-	0,                      /*tp_free*/
-	0,                      /*tp_is_gc*/
-};
+#define SORT_MIN_CHUNK 8192
+#define SORT_BUCKETS 256
+#define SORT_KEY_MAX 65535.0f
+/* The insertion pass gives up after this many moves per particle */
+#define SORT_MAX_MOVES 4
 
-/* --------------------------------------------------------------------- */
+typedef struct {
+	Particle *p;
+	float alpha;   /* Interpolation of the positions drawn */
+	float view[4]; /* Row of the model-view matrix giving eye-space z */
+	GLuint *index;
+	GLuint *sort_index;
+	float *depth;
+	unsigned short *key;
+	unsigned short *sort_key;
+	unsigned long count;
+	unsigned long chunks; /* Chunks the radix passes split the keys into */
+	float min_depth;
+	float key_scale;
+	int shift;
+	float chunk_min[PARALLEL_MAX_CHUNKS];
+	float chunk_max[PARALLEL_MAX_CHUNKS];
+	unsigned long hist[PARALLEL_MAX_CHUNKS][SORT_BUCKETS];
+} SortJob;
 
-static PyTypeObject BillboardRenderer_Type;
+static int
+DrawList_reserve_sort(DrawList *list)
+{
+	float *buf;
+
+	if (list->count > list->sort_alloc) {
+		/* One block holds the depths, keys and scatter buffers */
+		buf = PyMem_Realloc(list->depth, list->count * 
+			(sizeof(float) + sizeof(GLuint) + sizeof(unsigned short) * 2));
+		if (buf == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+		list->depth = buf;
+		list->sort_index = (GLuint *)(list->depth + list->count);
+		list->key = (unsigned short *)(list->sort_index + list->count);
+		list->sort_key = list->key + list->count;
+		list->sort_alloc = list->count;
+	}
+	return 1;
+}
 
 static void
-BillboardRenderer_dealloc(RendererObject *self) 
+sort_depth_chunk(void *ctx, unsigned long chunk, unsigned long start, unsigned long end)
 {
-	Py_CLEAR(self->texturizer);	
-	PyObject_Del(self);
+	SortJob *job = (SortJob *)ctx;
+	Vec3 pos;
+	float d, min = FLT_MAX, max = -FLT_MAX;
+	unsigned long i;
+
+	for (i = start; i < end; i++) {
+		interpolate_position(&pos, &job->p[job->index[i]], job->alpha);
+		d = job->view[0] * pos.x + job->view[1] * pos.y 
+			+ job->view[2] * pos.z + job->view[3];
+		job->depth[i] = d;
+		min = d < min ? d : min;
+		max = d > max ? d : max;
+	}
+	job->chunk_min[chunk] = min;
+	job->chunk_max[chunk] = max;
 }
 
-static int
-BillboardRenderer_init(RendererObject *self, PyObject *args, PyObject *kwargs)
+/* Return the first of the job's keys in chunk */
+static inline unsigned long
+Sort_chunk_start(SortJob *job, unsigned long chunk)
 {
-	static char *kwlist[] = {"texturizer", NULL};
-
-	self->texturizer = NULL;
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|O:__init__", kwlist, 
-		&self->texturizer))
-		return -1;
-	if (self->texturizer == Py_None)
-		self->texturizer = NULL; /* Avoid having to test for NULL and None */
-	if (self->texturizer != NULL)
-		Py_INCREF(self->texturizer);
-	return 0;
+	return chunk * (job->count / job->chunks) 
+		+ chunk * (job->count % job->chunks) / job->chunks;
 }
 
-FloatArrayObject *
-generate_default_2D_tex_coords(GroupObject *pgroup) {
-	static FloatArrayObject *tarray = NULL;
-	float *realloc_tcoords, *tex;
-	unsigned long pcount, new_size;
+/* The radix pass functions are run over the range of chunks [start, end)
+   rather than of keys, so that the histogram and scatter of a pass split
+   the keys the same way however parallel_for() runs them */
+static void
+sort_key_chunks(SortJob *job, unsigned long unused, 
+	unsigned long start, unsigned long end)
+{
+	unsigned long *hist, c, i, last;
+	float k;
+
+	for (c = start; c < end; c++) {
+		hist = job->hist[c];
+		memset(hist, 0, sizeof(unsigned long) * SORT_BUCKETS);
+		last = Sort_chunk_start(job, c + 1);
+		for (i = Sort_chunk_start(job, c); i < last; i++) {
+			k = (job->depth[i] - job->min_depth) * job->key_scale;
+			job->key[i] = (unsigned short)(k < SORT_KEY_MAX ? k : SORT_KEY_MAX);
+			hist[job->key[i] & 0xff]++;
+		}
+	}
+}
 
-	if (tarray == NULL) {
-		tarray = PyObject_New(FloatArrayObject, &FloatArray_Type);
-		if (tarray == NULL)
-			return (FloatArrayObject *)PyErr_NoMemory();
-		tarray->size = 0;
-		tarray->data = NULL;
+static void
+sort_histogram_chunks(SortJob *job, unsigned long unused, 
+	unsigned long start, unsigned long end)
+{
+	unsigned long *hist, c, i, last;
+
+	for (c = start; c < end; c++) {
+		hist = job->hist[c];
+		memset(hist, 0, sizeof(unsigned long) * SORT_BUCKETS);
+		last = Sort_chunk_start(job, c + 1);
+		for (i = Sort_chunk_start(job, c); i < last; i++)
+			hist[(job->key[i] >> job->shift) & 0xff]++;
 	}
+}
 
-	pcount = GroupObject_ActiveCount(pgroup);
-	if (tarray->data == NULL || pcount * 8 > tarray->size) {
-		new_size = pgroup->plist->palloc * 8;
-		realloc_tcoords = PyMem_Realloc(tarray->data, sizeof(float) * new_size);
-		if (realloc_tcoords == NULL)
-			return (FloatArrayObject *)PyErr_NoMemory();
-		tarray->data = realloc_tcoords;
-		tex = tarray->data + tarray->size;
-		pcount = (new_size - tarray->size) / 8;
-		while (pcount--) {
-			*tex++ = 0.0f;
-			*tex++ = 0.0f;
-			*tex++ = 1.0f;
-			*tex++ = 0.0f;
-			*tex++ = 1.0f;
-			*tex++ = 1.0f;
-			*tex++ = 0.0f;
-			*tex++ = 1.0f;
+static void
+sort_scatter_chunks(SortJob *job, unsigned long unused, 
+	unsigned long start, unsigned long end)
+{
+	unsigned long *offset, c, i, last, dest;
+
+	for (c = start; c < end; c++) {
+		offset = job->hist[c];
+		last = Sort_chunk_start(job, c + 1);
+		for (i = Sort_chunk_start(job, c); i < last; i++) {
+			dest = offset[(job->key[i] >> job->shift) & 0xff]++;
+			job->sort_key[dest] = job->key[i];
+			job->sort_index[dest] = job->index[i];
 		}
-		tarray->size = new_size;
 	}
-
-	Py_INCREF(tarray);
-	return tarray;
 }
 
-#define MIN_SHORT_INDEX_COUNT 4096
-#define MAX_SHORT_INDEX_COUNT 65536
+/* Run one stable radix pass on the digit at job->shift, leaving the 
+   result in job->key and job->index. The histograms of the job's chunks
+   for the pass must already be computed */
+static void
+sort_radix_pass(SortJob *job)
+{
+	unsigned long d, c, total = 0, n;
+	unsigned short *key;
+	GLuint *index;
+
+	/* Convert the counts to each chunk's starting offset per digit */
+	for (d = 0; d < SORT_BUCKETS; d++) {
+		for (c = 0; c < job->chunks; c++) {
+			n = job->hist[c][d];
+			job->hist[c][d] = total;
+			total += n;
+		}
+	}
+	parallel_for(job->chunks, 1, (ParallelFunc)sort_scatter_chunks, job);
+	key = job->key;
+	job->key = job->sort_key;
+	job->sort_key = key;
+	index = job->index;
+	job->index = job->sort_index;
+	job->sort_index = index;
+}
 
+/* Insertion sort the depths and indices in ascending depth order.
+   Return false if more than max_moves moves are needed, leaving the
+   arrays partially sorted.
+*/
 static int
-draw_billboards(unsigned long count) {
-	int i;
-	unsigned short sv = 0;
-	static unsigned short *short_indices = NULL;
- 	static size_t short_alloc = 0;
-	unsigned long index_count;
-
-	index_count = count * 6;
-	if (index_count <= MAX_SHORT_INDEX_COUNT) {
-		if (index_count > short_alloc) {
-			if (short_alloc < MIN_SHORT_INDEX_COUNT)
-				short_alloc = MIN_SHORT_INDEX_COUNT;
-			while (index_count > short_alloc)
-				short_alloc *= 2;
-			if (short_indices != NULL)
-				PyMem_Free(short_indices);
-			short_indices = PyMem_Malloc(short_alloc * sizeof(unsigned short));
-			if (short_indices == NULL) {
-				PyErr_NoMemory();
-				return 0;
-			}
-
-			for (i = 0, sv = 0; i <= (short_alloc - 6); i += 6, sv += 4) {
-				short_indices[i] = sv;
-				short_indices[i+1] = sv+1;
-				short_indices[i+2] = sv+3;
-				short_indices[i+3] = sv+1;
-				short_indices[i+4] = sv+2;
-				short_indices[i+5] = sv+3;
-			}
+sort_insertion(float *depth, GLuint *index, unsigned long count, 
+	unsigned long max_moves)
+{
+	unsigned long i, j, moves = 0;
+	float d;
+	GLuint di;
+
+	for (i = 1; i < count; i++) {
+		d = depth[i];
+		di = index[i];
+		for (j = i; j > 0 && depth[j - 1] > d; j--) {
+			depth[j] = depth[j - 1];
+			index[j] = index[j - 1];
 		}
-		glDrawElements(GL_TRIANGLES, index_count, GL_UNSIGNED_SHORT, short_indices);
-	} else {
-		/* Too many verts to use an index array of short ints. Instead just
-		   draw using GL_QUADS directly and let the driver do the dirty work.
-		   Alternately we could use full int indices, but I'd prefer to save
-		   the code complexity, bandwidth and memory in this case */
-		glDrawArrays(GL_QUADS, 0, count * 4);
+		depth[j] = d;
+		index[j] = di;
+		moves += i - j;
+		if (moves > max_moves)
+			return 0;
 	}
 	return 1;
 }
 
-static PyObject *
-BillboardRenderer_draw(RendererObject *self, GroupObject *pgroup)
+/* Sort the draw list back to front for the column-major model-view
+   matrix. If incremental is true, the list holds the previous draw order
+   of the same particles. Return true on success, false on failure with
+   an exception set.
+*/
+static int
+DrawList_sort(DrawList *list, GroupObject *pgroup, float *mvmatrix, 
+	int incremental)
 {
-	Particle *p;
-	int GL_error;
-	unsigned int pcount;
-	register unsigned int i;
-	float mvmatrix[16], rotcos, rotsin;
-	Vec3 vright, vright_unit, vup, vup_unit, vrot;
-	long tex_dimension;
-	PyObject *r;
-	FloatArrayObject *tex_array = NULL;
-	VertArray data;
+	/* The job is large, but the per-chunk histograms are needed */
+	SortJob job;
+	unsigned long chunks, c;
+	float max_depth;
 
-	if (!GroupObject_Check(pgroup)) {
-		PyErr_SetString(PyExc_TypeError, "Expected ParticleGroup first argument");
-		return NULL;
+	if (list->count < 2) {
+		list->sorted = 1;
+		return 1;
+	}
+	if (!DrawList_reserve_sort(list))
+		return 0;
+	job.p = pgroup->plist->p;
+	job.alpha = pgroup->interpolation;
+	job.view[0] = mvmatrix[2];
+	job.view[1] = mvmatrix[6];
+	job.view[2] = mvmatrix[10];
+	job.view[3] = mvmatrix[14];
+	job.index = list->index;
+	job.sort_index = list->sort_index;
+	job.depth = list->depth;
+	job.key = list->key;
+	job.sort_key = list->sort_key;
+
+	chunks = parallel_for(list->count, SORT_MIN_CHUNK, sort_depth_chunk, &job);
+	job.min_depth = job.chunk_min[0];
+	max_depth = job.chunk_max[0];
+	for (c = 1; c < chunks; c++) {
+		job.min_depth = fminf(job.min_depth, job.chunk_min[c]);
+		max_depth = job.chunk_max[c] > max_depth ? job.chunk_max[c] : max_depth;
 	}
 
-	if (!glew_initialize())
-		return NULL;
+	list->sorted = 1;
+	if (incremental && sort_insertion(list->depth, list->index, list->count,
+		list->count * SORT_MAX_MOVES))
+		return 1;
+	if (max_depth - job.min_depth < EPSILON)
+		return 1; /* All at the same depth */
+
+	/* Eye-space z increases toward the viewer, so ascending keys are
+	   back to front */
+	job.key_scale = SORT_KEY_MAX / (max_depth - job.min_depth);
+	job.count = list->count;
+	job.chunks = parallel_chunk_count(list->count, SORT_MIN_CHUNK);
+	job.shift = 0;
+	parallel_for(job.chunks, 1, (ParallelFunc)sort_key_chunks, &job);
+	sort_radix_pass(&job);
+	job.shift = 8;
+	parallel_for(job.chunks, 1, (ParallelFunc)sort_histogram_chunks, &job);
+	sort_radix_pass(&job);
+	/* An even number of passes leaves the result in the list's arrays */
+	return 1;
+}
 
-	p = pgroup->plist->p;
-	pcount = GroupObject_ActiveCount(pgroup);
-	if (pcount == 0) {
-		Py_INCREF(Py_None);
-		return Py_None;
+/* Return true if the draw list holds exactly the live particles of
+   the group */
+static int
+DrawList_same_particles(DrawList *list, GroupObject *pgroup)
+{
+	Particle *p = pgroup->plist->p;
+	unsigned long count, live = 0, i;
+
+	count = GroupObject_ActiveCount(pgroup);
+	for (i = 0; i < count; i++)
+		live += Particle_IsAlive(p[i]);
+	if (live != list->count)
+		return 0;
+	/* The list holds distinct indices, so if they are all live it has
+	   them all */
+	for (i = 0; i < list->count; i++) {
+		if (list->index[i] >= count || !Particle_IsAlive(p[list->index[i]]))
+			return 0;
+	}
+	return 1;
+}
+
+/* Build the draw list for the group, culling and sorting it as
+   specified for the column-major projection and model-view matrices,
+   see DrawList_cull() for the padding. Return true on success, false on
+   failure with an exception set.
+*/
+static int
+DrawList_prepare_view(DrawList *list, GroupObject *pgroup, int cull, int sort,
+	float pad_scale, float stretch, float *proj, float *mvmatrix)
+{
+	Frustum frustum;
+	int incremental = 0;
+
+	if (sort && !cull && list->sorted && DrawList_same_particles(list, pgroup)) {
+		incremental = 1;
+	} else {
+		if (cull)
+			Frustum_from_matrices(&frustum, proj, mvmatrix);
+		if (!DrawList_cull(list, pgroup, cull ? &frustum : NULL, pad_scale,
+			stretch))
+			return 0;
 	}
-	if (!VertArray_alloc(pgroup, &data))
+	if (sort)
+		return DrawList_sort(list, pgroup, mvmatrix, incremental);
+	return 1;
+}
+
+/* Build the draw list for the group for the current GL matrices */
+static int
+DrawList_prepare(DrawList *list, GroupObject *pgroup, int cull, int sort,
+	float pad_scale, float stretch)
+{
+	float proj[16], mvmatrix[16];
+
+	if (cull)
+		glGetFloatv(GL_PROJECTION_MATRIX, proj);
+	if (cull || sort)
+		glGetFloatv(GL_MODELVIEW_MATRIX, mvmatrix);
+	return DrawList_prepare_view(list, pgroup, cull, sort, pad_scale, stretch,
+		proj, mvmatrix);
+}
+
+/* Return an array of the groups to draw for each group, which are their
+   snapshots if double buffered. The groups returned are held until 
+   unpin_groups() is called so that they are not updated while drawn.
+   Return NULL on failure with an exception set */
+static GroupObject **
+pin_groups(GroupObject **groups, int count)
+{
+	GroupObject **drawn;
+	int i;
+
+	drawn = PyMem_Malloc(sizeof(GroupObject *) * count);
+	if (drawn == NULL) {
+		PyErr_NoMemory();
 		return NULL;
-	tex_dimension = 2;
+	}
+	for (i = 0; i < count; i++) {
+		/* Evaluating an analytic group can fail */
+		drawn[i] = GroupObject_BeginDraw(groups[i]);
+		if (drawn[i] == NULL) {
+			while (i-- > 0)
+				GroupObject_EndDraw(drawn[i]);
+			PyMem_Free(drawn);
+			return NULL;
+		}
+	}
+	return drawn;
+}
+
+static void
+unpin_groups(GroupObject **drawn, int count)
+{
+	int i;
+
+	for (i = 0; i < count; i++)
+		GroupObject_EndDraw(drawn[i]);
+	PyMem_Free(drawn);
+}
+
+/* --------------------------------------------------------------------- */
+
+/* Draw instrumentation
+
+   Checking glGetError() after each draw can force the driver to wait for
+   the GPU, so it is only done in debug mode. GPU timing wraps each draw in
+   a GL_TIME_ELAPSED query. Results are collected in order as they become
+   available, a few frames later, without ever waiting on the GPU.
+*/
+
+#define GPU_TIMER_QUERIES 64
+
+static int gl_debug = 0;
+
+static struct {
+	int enabled;
+	int head;      /* Oldest pending query */
+	int pending;   /* Number of queries awaiting results */
+	GLuint queries[GPU_TIMER_QUERIES];
+	PyObject *groups[GPU_TIMER_QUERIES]; /* Tuples of the groups timed */
+	float *shares[GPU_TIMER_QUERIES];    /* Share of the time per group */
+} gpu_timer;
+
+/* In debug mode, raise an exception for any GL error. Return false if
+   there is an error */
+static int
+check_gl_error(void)
+{
+	GLenum GL_error;
+
+	if (gl_debug) {
+		GL_error = glGetError();
+		if (GL_error != GL_NO_ERROR) {
+			PyErr_Format(PyExc_RuntimeError, "GL error %d", GL_error);
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static void
+gpu_timer_release(int slot)
+{
+	Py_CLEAR(gpu_timer.groups[slot]);
+	PyMem_Free(gpu_timer.shares[slot]);
+	gpu_timer.shares[slot] = NULL;
+}
+
+/* Store the results of the finished queries in their groups */
+static void
+gpu_timer_collect(void)
+{
+	GLint available;
+	GLuint64EXT elapsed;
+	PyObject *groups;
+	Py_ssize_t i;
+	double ms;
+
+	while (gpu_timer.pending > 0) {
+		glGetQueryObjectiv(gpu_timer.queries[gpu_timer.head], 
+			GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+		glGetQueryObjectui64vEXT(gpu_timer.queries[gpu_timer.head], 
+			GL_QUERY_RESULT, &elapsed);
+		ms = (double)elapsed / 1.0e6;
+		groups = gpu_timer.groups[gpu_timer.head];
+		for (i = 0; i < PyTuple_GET_SIZE(groups); i++) {
+			((GroupObject *)PyTuple_GET_ITEM(groups, i))->gpu_time = 
+				ms * gpu_timer.shares[gpu_timer.head][i];
+		}
+		gpu_timer_release(gpu_timer.head);
+		gpu_timer.head = (gpu_timer.head + 1) % GPU_TIMER_QUERIES;
+		gpu_timer.pending--;
+	}
+}
+
+/* Start timing a draw of the groups specified. The time is shared
+   between the groups in proportion to their particle counts. Return the
+   query slot to pass to gpu_timer_end(), or -1 if not timing. Timing is
+   skipped if too many results are pending.
+*/
+static int
+gpu_timer_begin(GroupObject **groups, int count)
+{
+	unsigned long total = 0;
+	int slot, i;
+
+	if (!gpu_timer.enabled)
+		return -1;
+	gpu_timer_collect();
+	if (gpu_timer.pending == GPU_TIMER_QUERIES)
+		return -1;
+	slot = (gpu_timer.head + gpu_timer.pending) % GPU_TIMER_QUERIES;
+	gpu_timer.groups[slot] = PyTuple_New(count);
+	gpu_timer.shares[slot] = PyMem_Malloc(sizeof(float) * count);
+	if (gpu_timer.groups[slot] == NULL || gpu_timer.shares[slot] == NULL) {
+		/* Timing is not worth failing the draw */
+		gpu_timer_release(slot);
+		PyErr_Clear();
+		return -1;
+	}
+	for (i = 0; i < count; i++)
+		total += GroupObject_ActiveCount(groups[i]);
+	for (i = 0; i < count; i++) {
+		Py_INCREF(groups[i]);
+		PyTuple_SET_ITEM(gpu_timer.groups[slot], i, (PyObject *)groups[i]);
+		gpu_timer.shares[slot][i] = total > 0 ? 
+			(float)GroupObject_ActiveCount(groups[i]) / total : 1.0f / count;
+	}
+	glBeginQuery(GL_TIME_ELAPSED_EXT, gpu_timer.queries[slot]);
+	return slot;
+}
+
+static void
+gpu_timer_end(int slot)
+{
+	if (slot >= 0) {
+		glEndQuery(GL_TIME_ELAPSED_EXT);
+		gpu_timer.pending++;
+	}
+}
+
+/* Enable or disable GPU timing. Return true if timing is enabled */
+static int
+gpu_timer_enable(int enable)
+{
+	static int queries_created = 0;
+
+	if (!enable || !GLEW_VERSION_1_5 || !GLEW_EXT_timer_query) {
+		/* Discard any pending results */
+		while (gpu_timer.pending > 0) {
+			gpu_timer_release(gpu_timer.head);
+			gpu_timer.head = (gpu_timer.head + 1) % GPU_TIMER_QUERIES;
+			gpu_timer.pending--;
+		}
+		gpu_timer.enabled = 0;
+		return 0;
+	}
+	if (!queries_created) {
+		glGenQueries(GPU_TIMER_QUERIES, gpu_timer.queries);
+		queries_created = 1;
+	}
+	gpu_timer.enabled = 1;
+	return 1;
+}
+
+/* --------------------------------------------------------------------- */
+
+static PyTypeObject PointRenderer_Type;
+
+typedef struct {
+	PyObject_HEAD
+	float	 point_size;
+	PyObject *texturizer;
+	int cull;
+	int sort;
+	DrawList draw_list;
+} PointRendererObject;
+
+static void
+PointRenderer_dealloc(PointRendererObject *self) 
+{
+	Py_CLEAR(self->texturizer);	
+	DrawList_clear(&self->draw_list);
+	PyObject_Del(self);
+}
+
+static int
+PointRenderer_init(PointRendererObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = {"point_size", "texturizer", "cull", "sort", NULL};
+
+	self->texturizer = NULL;
+	self->cull = 0;
+	self->sort = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "f|Oii:__init__",kwlist, 
+		&self->point_size, &self->texturizer, &self->cull, &self->sort))
+		return -1;
+	if (self->texturizer == Py_None)
+		self->texturizer = NULL;
+	if (self->texturizer != NULL)
+		Py_INCREF(self->texturizer);
+	return 0;
+}
+
+#define POINT_MIN_CHUNK 4096
+
+typedef struct {
+	Particle *p;
+	GLuint *index;     /* Draw list, or NULL to draw all particles */
+	VertItem *verts;
+	ColorItem *colors;
+	float alpha;       /* Interpolation from the last position */
+} PointJob;
+
+/* Copy the positions and colors of a chunk of particles into the
+   vertex array */
+static void
+point_chunk(void *ctx, unsigned long chunk, unsigned long start, unsigned long end)
+{
+	PointJob *job = (PointJob *)ctx;
+	Particle *p;
+	unsigned long i;
+
+	for (i = start; i < end; i++) {
+		p = job->p + (job->index != NULL ? job->index[i] : i);
+		interpolate_position((Vec3 *)&job->verts[i], p, job->alpha);
+		job->colors[i].colorl = pack_color(&p->color);
+	}
+}
+
+/* Draw the groups of point renderers that share the same texturizer and
+   point size. A single group is drawn straight from the particle list,
+   several groups are gathered into one vertex array and drawn together.
+   The particles are drawn from the pinned groups in drawn.
+
+   Return the number of draw calls made, or -1 on failure with an 
+   exception set
+*/
+static int
+draw_point_groups(PointRendererObject **renderers, GroupObject **groups, GroupObject **drawn,
+	int count)
+{
+	PointRendererObject *self = renderers[0];
+	Particle *p;
+	PyObject *r = NULL;
+	DrawList *list = NULL;
+	VertArray data;
+	PointJob job;
+	GLState *state;
+	int i, timer, direct;
+	unsigned long count_particles, n;
+
+	state = GLState_get();
+	if (state == NULL)
+		return -1;
+	data.is_vbo = 0;
+	data.verts = NULL;
+	data.colors = NULL;
+	count_particles = 0;
+	for (i = 0; i < count; i++)
+		count_particles += GroupObject_ActiveCount(drawn[i]);
+	if (count_particles == 0)
+		return 0;
+
+	/* A single group can be drawn straight from the particles if they
+	   need not be interpolated */
+	direct = count == 1 && drawn[0]->interpolation >= 1.0f;
+
+	/* Points are clipped by their centers, they need no padding */
+	if (direct) {
+		if (self->cull || self->sort) {
+			list = &self->draw_list;
+			if (!DrawList_prepare(list, drawn[0], self->cull, self->sort, 
+				0.0f, 0.0f))
+				return -1;
+			count_particles = list->count;
+		}
+	} else {
+		if (!VertArray_alloc(&data, count_particles, 0))
+			return -1;
+		count_particles = 0;
+		for (i = 0; i < count; i++) {
+			n = GroupObject_ActiveCount(drawn[i]);
+			job.index = NULL;
+			if (n > 0 && (renderers[i]->cull || renderers[i]->sort)) {
+				if (!DrawList_prepare(&renderers[i]->draw_list, drawn[i], 
+					renderers[i]->cull, renderers[i]->sort, 0.0f, 0.0f))
+					goto error;
+				job.index = renderers[i]->draw_list.index;
+				n = renderers[i]->draw_list.count;
+			}
+			job.p = drawn[i]->plist->p;
+			job.alpha = drawn[i]->interpolation;
+			job.verts = data.verts + count_particles;
+			job.colors = data.colors + count_particles;
+			parallel_for(n, POINT_MIN_CHUNK, point_chunk, &job);
+			count_particles += n;
+		}
+	}
+	if (count_particles == 0) {
+		VertArray_free(&data);
+		return 0;
+	}
 
 	if (self->texturizer != NULL) {
-		r = PyObject_GetAttrString(self->texturizer, "tex_dimension");
+		r = PyObject_CallMethod(self->texturizer, "set_state", NULL);
 		if (r == NULL)
-			return NULL;
-		tex_dimension = PyInt_AsLong(r);
+			goto error;
 		Py_DECREF(r);
-		if (PyErr_Occurred() != NULL)
-			return NULL;
-		if (tex_dimension < 1 && tex_dimension > 3) {
-			PyErr_Format(PyExc_ValueError, 
-				"Expected texturizer.tex_dimension value of 1, 2 or 3, got %ld", tex_dimension);
-			return NULL;
-		}
-		r = PyObject_CallMethod(self->texturizer, "set_state", NULL);
+		GLState_enable(state, GLSTATE_POINT_SPRITE, 1);
+		GLState_coord_replace(state, GL_TRUE);
+	} else {
+		GLState_flush(state);
+	}
+
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	GLState_point_size(state, self->point_size);
+	timer = gpu_timer_begin(groups, count);
+	if (direct) {
+		p = drawn[0]->plist->p;
+		glVertexPointer(3, GL_FLOAT, sizeof(Particle), &p[0].position);
+		glColorPointer(4, GL_FLOAT, sizeof(Particle), &p[0].color);
+		if (list != NULL)
+			glDrawElements(GL_POINTS, count_particles, GL_UNSIGNED_INT, 
+				list->index);
+		else
+			glDrawArrays(GL_POINTS, 0, count_particles);
+	} else {
+		glVertexPointer(3, GL_FLOAT, 0, data.verts);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, data.colors);
+		glDrawArrays(GL_POINTS, 0, count_particles);
+	}
+	gpu_timer_end(timer);
+	glPopClientAttrib();
+
+	if (!check_gl_error())
+		goto error;
+
+	if (self->texturizer != NULL) {
+		r = PyObject_CallMethod(self->texturizer, "restore_state", NULL);
 		if (r == NULL)
 			goto error;
-		Py_DECREF(r);
+		Py_DECREF(r);
+	}
+	VertArray_free(&data);
+	return 1;
+error:
+	VertArray_free(&data);
+	return -1;
+}
+
+static int
+draw_point_batch(PointRendererObject **renderers, GroupObject **groups, int count)
+{
+	GroupObject **drawn;
+	int result;
+
+	drawn = pin_groups(groups, count);
+	if (drawn == NULL)
+		return -1;
+	result = draw_point_groups(renderers, groups, drawn, count);
+	unpin_groups(drawn, count);
+	return result;
+}
+
+static PyObject *
+PointRenderer_draw(PointRendererObject *self, GroupObject *pgroup)
+{
+	if (!GroupObject_Check(pgroup)) {
+		PyErr_SetString(PyExc_TypeError, "Expected ParticleGroup first argument");
+		return NULL;
+	}
+
+	if (!glew_initialize())
+		return NULL;
+
+	if (draw_point_batch(&self, &pgroup, 1) < 0)
+		return NULL;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static struct PyMemberDef PointRenderer_members[] = {
+    {"point_size", T_FLOAT, offsetof(PointRendererObject, point_size), 0,
+        "Size of GL_POINTS drawn"},
+    {"texturizer", T_OBJECT, offsetof(PointRendererObject, texturizer), 0,
+        "Texturizer used to apply texture to particles"},
+    {"cull", T_INT, offsetof(PointRendererObject, cull), 0,
+        "If true, particles outside of the view frustum are not drawn"},
+    {"sort", T_INT, offsetof(PointRendererObject, sort), 0,
+        "If true, particles are drawn sorted back to front"},
+	{NULL}
+};
+
+static PyMethodDef PointRenderer_methods[] = {
+	{"draw", (PyCFunction)PointRenderer_draw, METH_O,
+		PyDoc_STR("Draw the particles in the specified group using GL_POINTS")},
+	{NULL,		NULL}		/* sentinel */
+};
+
+PyDoc_STRVAR(PointRenderer__doc__, 
+	"Simple particle renderer using GL_POINTS. All particles in the\n"
+	"group are rendered with the same point size\n\n"
+	"PointRenderer(point_size, texturizer=None, cull=False, sort=False)\n\n"
+	"point_size -- Size of GL_POINTS points to draw (float)\n\n"
+	"texturizer -- Texturizer used to apply texture to particles.\n"
+	"If specified, the points are drawn using GL_POINT_SPRITES.\n"
+	"Note that point sprites have fixed texture coordinates,\n"
+	"thus they cannot use custom per-particle coordinates\n"
+	"computed by the texturizer.\n\n"
+	"cull -- If true, particles outside of the current view\n"
+	"frustum are skipped before drawing.\n\n"
+	"sort -- If true, particles are drawn in back to front order\n"
+	"of their depth in the model-view, for correct blending of\n"
+	"translucent particles. The group itself is not reordered.");
+
+static PyTypeObject PointRenderer_Type = {
+	/* The ob_type field must be initialized in the module init function
+	 * to be portable to Windows without using C++. */
+	PyObject_HEAD_INIT(NULL)
+	0,			/*ob_size*/
+	"renderer.PointRenderer",		/*tp_name*/
+	sizeof(PointRendererObject),	/*tp_basicsize*/
+	0,			/*tp_itemsize*/
+	/* methods */
+	(destructor)PointRenderer_dealloc, /*tp_dealloc*/
+	0,			/*tp_print*/
+	0,          /*tp_getattr*/
+	0,          /*tp_setattr*/
+	0,			/*tp_compare*/
+	0,			/*tp_repr*/
+	0,			/*tp_as_number*/
+	0,	        /*tp_as_sequence*/
+	0,			/*tp_as_mapping*/
+	0,			/*tp_hash*/
+	0,                      /*tp_call*/
+	0,                      /*tp_str*/
+	0,                      /*tp_getattro*/
+	0,                      /*tp_setattro*/
+	0,                      /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE, /*tp_flags*/
+	PointRenderer__doc__,   /*tp_doc*/
+	0,                      /*tp_traverse*/
+	0,                      /*tp_clear*/
+	0,                      /*tp_richcompare*/
+	0,                      /*tp_weaklistoffset*/
+	0,                      /*tp_iter*/
+	0,                      /*tp_iternext*/
+	PointRenderer_methods,  /*tp_methods*/
+	PointRenderer_members,  /*tp_members*/
+	0,                      /*tp_getset*/
+	0,                      /*tp_base*/
+	0,                      /*tp_dict*/
+	0,                      /*tp_descr_get*/
+	0,                      /*tp_descr_set*/
+	0,                      /*tp_dictoffset*/
+	(initproc)PointRenderer_init, /*tp_init*/
+	0,                      /*tp_alloc*/
+	0,                      /*tp_new*/
+	0,                      /*tp_free*/
+	0,                      /*tp_is_gc*/
+};
+
+/* --------------------------------------------------------------------- */
+
+static PyTypeObject BillboardRenderer_Type;
+
+static void
+BillboardRenderer_dealloc(RendererObject *self) 
+{
+	Py_CLEAR(self->texturizer);	
+	DrawList_clear(&self->draw_list);
+	PyObject_Del(self);
+}
+
+static int
+BillboardRenderer_init(RendererObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = {"texturizer", "cull", "sort", "stretch", NULL};
+
+	self->texturizer = NULL;
+	self->cull = 0;
+	self->sort = 0;
+	self->stretch = 0.0f;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Oiif:__init__", kwlist, 
+		&self->texturizer, &self->cull, &self->sort, &self->stretch))
+		return -1;
+	if (self->texturizer == Py_None)
+		self->texturizer = NULL; /* Avoid having to test for NULL and None */
+	if (self->texturizer != NULL)
+		Py_INCREF(self->texturizer);
+	return 0;
+}
+
+FloatArrayObject *
+generate_default_2D_tex_coords(GroupObject *pgroup) {
+	static FloatArrayObject *tarray = NULL;
+	float *realloc_tcoords, *tex;
+	unsigned long pcount, new_size;
+
+	if (tarray == NULL) {
+		tarray = PyObject_New(FloatArrayObject, &FloatArray_Type);
+		if (tarray == NULL)
+			return (FloatArrayObject *)PyErr_NoMemory();
+		tarray->size = 0;
+		tarray->data = NULL;
+	}
+
+	pcount = GroupObject_ActiveCount(pgroup);
+	if (tarray->data == NULL || pcount * 8 > tarray->size) {
+		new_size = pgroup->plist->palloc * 8;
+		realloc_tcoords = PyMem_Realloc(tarray->data, sizeof(float) * new_size);
+		if (realloc_tcoords == NULL)
+			return (FloatArrayObject *)PyErr_NoMemory();
+		tarray->data = realloc_tcoords;
+		tex = tarray->data + tarray->size;
+		pcount = (new_size - tarray->size) / 8;
+		while (pcount--) {
+			*tex++ = 0.0f;
+			*tex++ = 0.0f;
+			*tex++ = 1.0f;
+			*tex++ = 0.0f;
+			*tex++ = 1.0f;
+			*tex++ = 1.0f;
+			*tex++ = 0.0f;
+			*tex++ = 1.0f;
+		}
+		tarray->size = new_size;
+	}
+
+	Py_INCREF(tarray);
+	return tarray;
+}
+
+/* Quads are drawn as indexed triangles in batches of up to
+   MAX_INDEX_QUADS, the most that short indices can address. */
+#define MIN_INDEX_QUADS 1024
+#define MAX_INDEX_QUADS 16384
+
+/* Bind the shared quad index array, making it large enough for the
+   number of quads specified, up to MAX_INDEX_QUADS. The indices are
+   kept in a buffer object on the GPU when supported and are only
+   uploaded when the array grows. Store the index pointer to pass to
+   glDrawElements() in indices. The index buffer object must be unbound
+   with unbind_quad_indices() after drawing.
+
+   Return 1 on success, 0 on failure with an exception set
+*/
+static int
+bind_quad_indices(unsigned long quads, GLvoid **indices)
+{
+	static unsigned short *client_indices = NULL;
+	static GLuint index_buffer = 0;
+	static unsigned long alloc_quads = 0;
+	unsigned long new_quads, i;
+	unsigned short *buf, sv;
+
+	if (quads > MAX_INDEX_QUADS)
+		quads = MAX_INDEX_QUADS;
+	if (quads > alloc_quads) {
+		/* Grow geometrically so the array is rarely re-uploaded */
+		new_quads = alloc_quads < MIN_INDEX_QUADS ? MIN_INDEX_QUADS : alloc_quads;
+		while (new_quads < quads)
+			new_quads *= 2;
+		buf = PyMem_Malloc(new_quads * 6 * sizeof(unsigned short));
+		if (buf == NULL) {
+			PyErr_NoMemory();
+			return 0;
+		}
+		for (i = 0, sv = 0; i < new_quads * 6; i += 6, sv += 4) {
+			buf[i] = sv;
+			buf[i+1] = sv+1;
+			buf[i+2] = sv+3;
+			buf[i+3] = sv+1;
+			buf[i+4] = sv+2;
+			buf[i+5] = sv+3;
+		}
+		if (GLEW_VERSION_1_5) {
+			if (index_buffer == 0)
+				glGenBuffers(1, &index_buffer);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, 
+				new_quads * 6 * sizeof(unsigned short), buf, GL_STATIC_DRAW);
+			PyMem_Free(buf);
+		} else {
+			PyMem_Free(client_indices);
+			client_indices = buf;
+		}
+		alloc_quads = new_quads;
+	}
+	if (index_buffer != 0) {
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+		*indices = NULL; /* offset into the buffer */
+	} else {
+		*indices = client_indices;
+	}
+	return 1;
+}
+
+static void
+unbind_quad_indices(void)
+{
+	if (GLEW_VERSION_1_5)
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+/* Draw count quads from the vertex data and texture coordinates
+   specified. The vertex, color and texture coord arrays must be enabled.
+   Batches beyond the reach of short indices are drawn by pointing the
+   arrays at the start of each batch.
+
+   Return 1 on success, 0 on failure with an exception set
+*/
+static int
+draw_billboards(VertArray *data, float *tex_coords, long tex_dimension,
+	unsigned long count)
+{
+	GLvoid *indices;
+	unsigned long first, n;
+
+	if (!bind_quad_indices(count, &indices))
+		return 0;
+	for (first = 0; first < count; first += MAX_INDEX_QUADS) {
+		n = count - first < MAX_INDEX_QUADS ? count - first : MAX_INDEX_QUADS;
+		glVertexPointer(3, GL_FLOAT, 0, data->verts + first * 4);
+		glColorPointer(4, GL_UNSIGNED_BYTE, 0, data->colors + first * 4);
+		glTexCoordPointer(tex_dimension, GL_FLOAT, 0, 
+			tex_coords + first * 4 * tex_dimension);
+		glDrawElements(GL_TRIANGLES, n * 6, GL_UNSIGNED_SHORT, indices);
+	}
+	unbind_quad_indices();
+	return 1;
+}
+
+#define BILLBOARD_MIN_CHUNK 2048
+
+/* Most views drawn by BillboardRenderer.draw_multiview() */
+#define BILLBOARD_MAX_VIEWS 8
+
+/* Alignment of the quads to a view */
+typedef struct {
+	Vec3 right;
+	Vec3 up;
+	Vec3 view;         /* View direction, for stretching */
+	VertItem *verts;   /* Quads generated for the view */
+} BillboardView;
+
+typedef struct {
+	Particle *p;
+	GLuint *index;     /* Draw list, or NULL to draw all particles */
+	ColorItem *colors;
+	float *tex_src;    /* Texture coords of the group's particles */
+	float *tex_dest;   /* Gathered texture coords, or NULL to not gather */
+	long tex_dimension;
+	float stretch;     /* Length added per unit of speed */
+	float alpha;       /* Interpolation from the last position */
+	int view_count;
+	BillboardView views[BILLBOARD_MAX_VIEWS];
+} BillboardJob;
+
+/* Get the alignment vectors from the column-major model-view matrix */
+static void
+BillboardView_from_matrix(BillboardView *view, float *mvmatrix)
+{
+	view->right.x = mvmatrix[0];
+	view->right.y = mvmatrix[4];
+	view->right.z = mvmatrix[8];
+	Vec3_normalize(&view->right, &view->right);
+	view->up.x = mvmatrix[1];
+	view->up.y = mvmatrix[5];
+	view->up.z = mvmatrix[9];
+	Vec3_normalize(&view->up, &view->up);
+	view->view.x = mvmatrix[2];
+	view->view.y = mvmatrix[6];
+	view->view.z = mvmatrix[10];
+	Vec3_normalize(&view->view, &view->view);
+}
+
+/* Store the corners of the particle's quad at pos aligned to the view */
+static inline void
+billboard_quad(BillboardView *view, Particle *p, Vec3 *pos, float stretch,
+	VertItem *verts)
+{
+	Vec3 vright, vup, vrot, center, vel;
+	float rotsin, rotcos, speed;
+
+	/*
+
+	verts[3]              verts[2]
+		   +-------------+
+		   |\            |
+		   |  \          |
+		   |    \        |
+		   |      + ---- | --- Particle position
+		   |        \    |
+		   |          \  |
+		   |            \|
+		   +-------------+
+	verts[0]              verts[1]
+
+	*/
+
+	center = *pos;
+	speed = 0.0f;
+	if (stretch > 0.0f) {
+		/* Velocity projected onto the view plane */
+		Vec3_scalar_mul(&vrot, &view->view, Vec3_dot(&p->velocity, &view->view));
+		Vec3_sub(&vel, &p->velocity, &vrot);
+		speed = Vec3_len(&vel);
+	}
+	if (speed > EPSILON) {
+		/* Stretched billboard: the quad's up is along the screen
+		   velocity, and it trails behind the particle by the stretch
+		   length, so its leading edge stays where it would be
+		   unstretched */
+		Vec3_scalar_mul(&vup, &vel, 1.0f / speed);
+		Vec3_cross(&vright, &vup, &view->view);
+		speed *= stretch * 0.5f;
+		Vec3_scalar_mul(&vrot, &vup, speed);
+		Vec3_subi(&center, &vrot);
+		Vec3_scalar_muli(&vright, p->size.x * 0.5f);
+		Vec3_scalar_muli(&vup, p->size.y * 0.5f + speed);
+	} else if (p->up.z) {
+		/* billboard supports only z-axis rotation
+		   where the z-axiz is always that of the
+		   model-view matrix
+		*/
+		FastSinCos(p->up.z, &rotsin, &rotcos);
+		Vec3_scalar_mul(&vright, &view->right, rotcos);
+		Vec3_scalar_mul(&vrot, &view->up, rotsin);
+		Vec3_addi(&vright, &vrot);
+		Vec3_scalar_mul(&vup, &view->up, rotcos);
+		Vec3_scalar_mul(&vrot, &view->right, rotsin);
+		Vec3_subi(&vup, &vrot);
+		Vec3_scalar_muli(&vright, p->size.x * 0.5f);
+		Vec3_scalar_muli(&vup, p->size.y * 0.5f);
+	} else {
+		Vec3_scalar_mul(&vright, &view->right, p->size.x * 0.5f);
+		Vec3_scalar_mul(&vup, &view->up, p->size.y * 0.5f);
+	}
+
+	Vec3_sub(&verts[0], &center, &vright);
+	Vec3_subi(&verts[0], &vup);
+	Vec3_add(&verts[1], &center, &vright);
+	Vec3_subi(&verts[1], &vup);
+	Vec3_add(&verts[2], &center, &vright);
+	Vec3_addi(&verts[2], &vup);
+	Vec3_sub(&verts[3], &center, &vright);
+	Vec3_addi(&verts[3], &vup);
+}
+
+/* Generate the quads for a chunk of billboards directly into the vertex
+   array of each view. The colors and texture coords are the same for
+   every view, so they are only generated once. Run by worker threads 
+   with the GIL released */
+static void
+billboard_chunk(void *ctx, unsigned long chunk, unsigned long start, unsigned long end)
+{
+	BillboardJob *job = (BillboardJob *)ctx;
+	Particle *p;
+	ColorItem *colors;
+	Vec3 pos;
+	unsigned long i, tex_size;
+	GLuint color;
+	int v;
+
+	tex_size = job->tex_dimension * 4;
+	for (i = start; i < end; i++) {
+		p = job->p + (job->index != NULL ? job->index[i] : i);
+		colors = job->colors + i * 4;
+
+		/* vertex coords */
+		interpolate_position(&pos, p, job->alpha);
+		for (v = 0; v < job->view_count; v++)
+			billboard_quad(&job->views[v], p, &pos, job->stretch, 
+				job->views[v].verts + i * 4);
+
+		/* colors */
+		color = pack_color(&p->color);
+		colors[0].colorl = color;
+		colors[1].colorl = color;
+		colors[2].colorl = color;
+		colors[3].colorl = color;
+
+		if (job->tex_dest != NULL) {
+			memcpy(job->tex_dest + i * tex_size, 
+				job->tex_src + (p - job->p) * tex_size, sizeof(float) * tex_size);
+		}
+	}
+}
+
+/* Return the dimension of the texture coords generated by the texturizer,
+   or 2 if it is NULL. Return -1 on failure with an exception set */
+static long
+billboard_tex_dimension(PyObject *texturizer)
+{
+	PyObject *r;
+	long tex_dimension;
+
+	if (texturizer == NULL)
+		return 2;
+	r = PyObject_GetAttrString(texturizer, "tex_dimension");
+	if (r == NULL)
+		return -1;
+	tex_dimension = PyInt_AsLong(r);
+	Py_DECREF(r);
+	if (PyErr_Occurred() != NULL)
+		return -1;
+	if (tex_dimension < 1 || tex_dimension > 3) {
+		PyErr_Format(PyExc_ValueError, 
+			"Expected texturizer.tex_dimension value of 1, 2 or 3, got %ld", tex_dimension);
+		return -1;
+	}
+	return tex_dimension;
+}
+
+/* Draw the groups of billboard renderers that share the same texturizer.
+   The quads of all of the groups are generated into one vertex array
+   and drawn together. The particles are drawn from the pinned groups in
+   drawn.
+
+   Return the number of draw calls made, or -1 on failure with an 
+   exception set
+*/
+static int
+draw_billboard_groups(RendererObject **renderers, GroupObject **groups, GroupObject **drawn,
+	int count)
+{
+	PyObject *texturizer = renderers[0]->texturizer;
+	int i, gather, timer;
+	unsigned long pcount, n;
+	float mvmatrix[16], *tex_coords;
+	long tex_dimension;
+	PyObject *r, *type, *value, *traceback;
+	FloatArrayObject *tex_array = NULL;
+	VertArray data;
+	DrawList *list;
+	BillboardJob job;
+	GLState *state;
+
+	state = GLState_get();
+	if (state == NULL)
+		return -1;
+	/* The draw lists are at most the size of the groups */
+	pcount = 0;
+	for (i = 0; i < count; i++)
+		pcount += GroupObject_ActiveCount(drawn[i]);
+	if (pcount == 0)
+		return 0;
+	tex_dimension = billboard_tex_dimension(texturizer);
+	if (tex_dimension < 0)
+		return -1;
+	/* Texture coordinates are generated for all particles in a group, so
+	   they must be gathered unless all particles of a single group are
+	   drawn */
+	gather = count > 1 || renderers[0]->cull || renderers[0]->sort;
+	if (!VertArray_alloc(&data, pcount * 4, gather ? tex_dimension : 0))
+		return -1;
+	if (texturizer != NULL) {
+		r = PyObject_CallMethod(texturizer, "set_state", NULL);
+		if (r == NULL)
+			goto error;
+		Py_DECREF(r);
+	} else {
+		GLState_flush(state);
+	}
+
+	/* Get the alignment vectors from the view matrix */
+	glGetFloatv(GL_MODELVIEW_MATRIX, mvmatrix);
+	BillboardView_from_matrix(&job.views[0], mvmatrix);
+	job.view_count = 1;
+	job.tex_dimension = tex_dimension;
+
+	/* Each group's quads are generated right after its draw list is
+	   prepared, since groups may share a renderer and its list */
+	pcount = 0;
+	for (i = 0; i < count; i++) {
+		n = GroupObject_ActiveCount(drawn[i]);
+		list = NULL;
+		if (n > 0 && (renderers[i]->cull || renderers[i]->sort)) {
+			list = &renderers[i]->draw_list;
+			if (!DrawList_prepare(list, drawn[i], renderers[i]->cull, 
+				renderers[i]->sort, BILLBOARD_CULL_PAD, renderers[i]->stretch))
+				goto restore_error;
+			n = list->count;
+		}
+		if (n == 0)
+			continue;
+		Py_CLEAR(tex_array);
+		if (texturizer != NULL) {
+			tex_array = (FloatArrayObject *)PyObject_CallMethod(
+				texturizer, "generate_tex_coords", "O", drawn[i]);
+		} else {
+			tex_array = generate_default_2D_tex_coords(drawn[i]);
+		}
+		if (tex_array == NULL)
+			goto restore_error;
+
+		job.p = drawn[i]->plist->p;
+		job.alpha = drawn[i]->interpolation;
+		job.stretch = renderers[i]->stretch;
+		job.index = list != NULL ? list->index : NULL;
+		job.views[0].verts = data.verts + pcount * 4;
+		job.colors = data.colors + pcount * 4;
+		job.tex_src = tex_array->data;
+		job.tex_dest = gather ? data.tex_coords + pcount * 4 * tex_dimension : NULL;
+		parallel_for(n, BILLBOARD_MIN_CHUNK, billboard_chunk, &job);
+		pcount += n;
+	}
+	if (pcount == 0) {
+		if (texturizer != NULL) {
+			r = PyObject_CallMethod(texturizer, "restore_state", NULL);
+			if (r == NULL)
+				goto error;
+			Py_DECREF(r);
+		}
+		VertArray_free(&data);
+		return 0;
+	}
+	tex_coords = gather ? data.tex_coords : tex_array->data;
+
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	timer = gpu_timer_begin(groups, count);
+	i = draw_billboards(&data, tex_coords, tex_dimension, pcount);
+	gpu_timer_end(timer);
+	glPopClientAttrib();
+	if (!i)
+		goto restore_error;
+
+	if (!check_gl_error())
+		goto error;
+
+	if (texturizer != NULL) {
+		r = PyObject_CallMethod(texturizer, "restore_state", NULL);
+		if (r == NULL)
+			goto error;
+		Py_DECREF(r);
+	}
+	
+	Py_XDECREF(tex_array);
+	VertArray_free(&data);
+	return (pcount + MAX_INDEX_QUADS - 1) / MAX_INDEX_QUADS;
+
+restore_error:
+	if (texturizer != NULL) {
+		PyErr_Fetch(&type, &value, &traceback);
+		r = PyObject_CallMethod(texturizer, "restore_state", NULL);
+		Py_XDECREF(r);
+		PyErr_Restore(type, value, traceback);
+	}
+error:
+	Py_XDECREF(tex_array);
+	VertArray_free(&data);
+	return -1;
+}
+
+static int
+draw_billboard_batch(RendererObject **renderers, GroupObject **groups, int count)
+{
+	GroupObject **drawn;
+	int result;
+
+	drawn = pin_groups(groups, count);
+	if (drawn == NULL)
+		return -1;
+	result = draw_billboard_groups(renderers, groups, drawn, count);
+	unpin_groups(drawn, count);
+	return result;
+}
+
+static PyObject *
+BillboardRenderer_draw(RendererObject *self, GroupObject *pgroup)
+{
+	if (!GroupObject_Check(pgroup)) {
+		PyErr_SetString(PyExc_TypeError, "Expected ParticleGroup first argument");
+		return NULL;
+	}
+
+	if (!glew_initialize())
+		return NULL;
+
+	if (draw_billboard_batch(&self, &pgroup, 1) < 0)
+		return NULL;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+/* Draw the particles of the pinned group drawn once for each of the
+   column-major model-view matrices, calling begin_view with the index of
+   each view before it is drawn if not NULL. The quads of all of the views
+   are generated in one pass over the particles, sharing their colors and
+   texture coords. The particles are not culled or sorted.
+
+   Return the number of draw calls made, or -1 on failure with an 
+   exception set
+*/
+static int
+draw_billboard_views(RendererObject *self, GroupObject *pgroup, GroupObject *drawn,
+	float (*matrices)[16], int view_count, PyObject *begin_view)
+{
+	PyObject *texturizer = self->texturizer;
+	PyObject *r, *type, *value, *traceback;
+	FloatArrayObject *tex_array = NULL;
+	VertItem *verts;
+	VertArray data;
+	BillboardJob job;
+	GLState *state;
+	unsigned long pcount;
+	long tex_dimension;
+	int v, timer, ok = 1, draws = 0;
+
+	state = GLState_get();
+	if (state == NULL)
+		return -1;
+	pcount = GroupObject_ActiveCount(drawn);
+	if (pcount == 0)
+		return 0;
+	tex_dimension = billboard_tex_dimension(texturizer);
+	if (tex_dimension < 0)
+		return -1;
+	verts = (VertItem *)PyMem_Malloc(sizeof(VertItem) * pcount * 4 * view_count
+		+ sizeof(ColorItem) * pcount * 4);
+	if (verts == NULL) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	data.is_vbo = 0;
+	data.size = pcount * 4;
+	data.colors = (ColorItem *)(verts + pcount * 4 * view_count);
+	data.tex_coords = NULL;
+
+	if (texturizer != NULL) {
+		tex_array = (FloatArrayObject *)PyObject_CallMethod(
+			texturizer, "generate_tex_coords", "O", drawn);
+	} else {
+		tex_array = generate_default_2D_tex_coords(drawn);
+	}
+	if (tex_array == NULL)
+		goto error;
+
+	job.p = drawn->plist->p;
+	job.index = NULL;
+	job.colors = data.colors;
+	job.tex_src = tex_array->data;
+	job.tex_dest = NULL;
+	job.tex_dimension = tex_dimension;
+	job.stretch = self->stretch;
+	job.alpha = drawn->interpolation;
+	job.view_count = view_count;
+	for (v = 0; v < view_count; v++) {
+		BillboardView_from_matrix(&job.views[v], matrices[v]);
+		job.views[v].verts = verts + pcount * 4 * v;
+	}
+	parallel_for(pcount, BILLBOARD_MIN_CHUNK / view_count + 1, 
+		billboard_chunk, &job);
+
+	if (texturizer != NULL) {
+		r = PyObject_CallMethod(texturizer, "set_state", NULL);
+		if (r == NULL)
+			goto error;
+		Py_DECREF(r);
+	} else {
+		GLState_flush(state);
+	}
+
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	timer = gpu_timer_begin(&pgroup, 1);
+	for (v = 0; ok && v < view_count; v++) {
+		if (begin_view != NULL) {
+			r = PyObject_CallFunction(begin_view, "i", v);
+			if (r == NULL) {
+				ok = 0;
+				break;
+			}
+			Py_DECREF(r);
+		}
+		glMatrixMode(GL_MODELVIEW);
+		glLoadMatrixf(matrices[v]);
+		data.verts = job.views[v].verts;
+		ok = draw_billboards(&data, tex_array->data, tex_dimension, pcount);
+		draws += (pcount + MAX_INDEX_QUADS - 1) / MAX_INDEX_QUADS;
+	}
+	gpu_timer_end(timer);
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+	glPopClientAttrib();
+	if (!ok || !check_gl_error())
+		goto restore_error;
+
+	if (texturizer != NULL) {
+		r = PyObject_CallMethod(texturizer, "restore_state", NULL);
+		if (r == NULL)
+			goto error;
+		Py_DECREF(r);
+	}
+	Py_DECREF(tex_array);
+	PyMem_Free(verts);
+	return draws;
+
+restore_error:
+	if (texturizer != NULL) {
+		PyErr_Fetch(&type, &value, &traceback);
+		r = PyObject_CallMethod(texturizer, "restore_state", NULL);
+		Py_XDECREF(r);
+		PyErr_Restore(type, value, traceback);
+	}
+error:
+	Py_XDECREF(tex_array);
+	PyMem_Free(verts);
+	return -1;
+}
+
+/* Copy a column-major matrix from a sequence of 16 floats. Return true on
+   success, false on failure with an exception set */
+static int
+matrix_from_sequence(PyObject *obj, float *matrix)
+{
+	PyObject *seq;
+	int i;
+
+	seq = PySequence_Fast(obj, "expected sequence of 16 floats for matrix");
+	if (seq == NULL)
+		return 0;
+	if (PySequence_Fast_GET_SIZE(seq) != 16) {
+		PyErr_SetString(PyExc_ValueError, 
+			"expected sequence of 16 floats for matrix");
+		Py_DECREF(seq);
+		return 0;
+	}
+	for (i = 0; i < 16; i++)
+		matrix[i] = (float)PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, i));
+	Py_DECREF(seq);
+	return !PyErr_Occurred();
+}
+
+static PyObject *
+BillboardRenderer_draw_multiview(RendererObject *self, PyObject *args, 
+	PyObject *kwargs)
+{
+	GroupObject *pgroup, *drawn;
+	PyObject *views, *begin_view = NULL, *seq;
+	float matrices[BILLBOARD_MAX_VIEWS][16];
+	Py_ssize_t count, i;
+	int result;
+
+	static char *kwlist[] = {"group", "views", "begin_view", NULL};
+
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O:draw_multiview", 
+		kwlist, &pgroup, &views, &begin_view))
+		return NULL;
+	if (!GroupObject_Check(pgroup)) {
+		PyErr_SetString(PyExc_TypeError, "Expected ParticleGroup first argument");
+		return NULL;
+	}
+	if (begin_view == Py_None)
+		begin_view = NULL;
+	if (begin_view != NULL && !PyCallable_Check(begin_view)) {
+		PyErr_SetString(PyExc_TypeError, "Expected callable begin_view");
+		return NULL;
+	}
+
+	seq = PySequence_Fast(views, "expected sequence of view matrices");
+	if (seq == NULL)
+		return NULL;
+	count = PySequence_Fast_GET_SIZE(seq);
+	if (count < 1 || count > BILLBOARD_MAX_VIEWS) {
+		PyErr_Format(PyExc_ValueError, "Expected 1 to %d views", 
+			BILLBOARD_MAX_VIEWS);
+		Py_DECREF(seq);
+		return NULL;
+	}
+	for (i = 0; i < count; i++) {
+		if (!matrix_from_sequence(PySequence_Fast_GET_ITEM(seq, i), 
+			matrices[i])) {
+			Py_DECREF(seq);
+			return NULL;
+		}
+	}
+	Py_DECREF(seq);
+
+	if (!glew_initialize())
+		return NULL;
+
+	drawn = GroupObject_BeginDraw(pgroup);
+	if (drawn == NULL)
+		return NULL;
+	result = draw_billboard_views(self, pgroup, drawn, matrices, (int)count,
+		begin_view);
+	GroupObject_EndDraw(drawn);
+	if (result < 0)
+		return NULL;
+	return PyInt_FromLong(result);
+}
+
+static PyMethodDef BillboardRenderer_methods[] = {
+	{"draw", (PyCFunction)BillboardRenderer_draw, METH_O,
+		PyDoc_STR("Draw the particles using textured billboard quads")},
+	{"draw_multiview", (PyCFunction)BillboardRenderer_draw_multiview, 
+		METH_VARARGS | METH_KEYWORDS,
+		PyDoc_STR("draw_multiview(group, views, begin_view=None) -> draw count\n"
+			"Draw the particles once for each view, for split-screen and\n"
+			"shadow or reflection passes. views is a sequence of up to 8\n"
+			"model-view matrices, each a sequence of 16 floats in\n"
+			"column-major order as returned by glGetFloatv(). The quads\n"
+			"of every view are generated in a single pass over the\n"
+			"particles, which is much cheaper than drawing the group\n"
+			"once per view. Each matrix is loaded into the model-view\n"
+			"before the view is drawn, and the model-view is restored\n"
+			"afterward. If begin_view is given, it is called with the\n"
+			"index of each view before it is drawn, to set the viewport,\n"
+			"projection or render target. The particles are not culled\n"
+			"or sorted. Return the number of draw calls made.")},
+	{NULL,		NULL}		/* sentinel */
+};
+
+static struct PyMemberDef BillboardRenderer_members[] = {
+    {"texturizer", T_OBJECT, offsetof(RendererObject, texturizer), 0,
+        "A texturizer object that generates texture coordinates\n"
+		"for the particles and sets up texture state for the renderer."},
+    {"cull", T_INT, offsetof(RendererObject, cull), 0,
+        "If true, particles outside of the view frustum are not drawn"},
+    {"sort", T_INT, offsetof(RendererObject, sort), 0,
+        "If true, particles are drawn sorted back to front"},
+    {"stretch", T_FLOAT, offsetof(RendererObject, stretch), 0,
+        "Length the quads are stretched along the particle velocity\n"
+		"per unit of speed, or 0 to not stretch them"},
+	{NULL}
+};
+
+PyDoc_STRVAR(BillboardRenderer__doc__, 
+	"Particle renderer using textured billboard-aligned quads\n"
+	"quads are aligned orthogonal to the model-view matrix\n\n"
+	"BillboardRenderer(texturizer=None, cull=False, sort=False, stretch=0)\n\n"
+	"texturizer -- A texturizer object that generates texture\n"
+	"coordinates for the particles and sets up texture state.\n"
+	"If not specified, texture coordinates are fixed at (0,0)\n"
+	"for the lower-left corner of each particle quad and (1,1)\n"
+	"for the upper-right. Without a texturizer the application\n"
+	"is responsible for setting up the desired texture state\n"
+	"before invoking the renderer.\n\n"
+	"cull -- If true, particles outside of the current view\n"
+	"frustum are skipped before generating their quads.\n\n"
+	"sort -- If true, quads are drawn in back to front order\n"
+	"of their depth in the model-view, for correct blending of\n"
+	"translucent particles. The group itself is not reordered.\n\n"
+	"stretch -- If non-zero, the quads of moving particles are\n"
+	"aligned with their velocity on the screen instead of the\n"
+	"view, and lengthened behind them by stretch times their\n"
+	"speed, for sparks, rain and other motion streaks. size.y is\n"
+	"the length of the quad at rest, and up.z rotation is ignored.");
+
+static PyTypeObject BillboardRenderer_Type = {
+	/* The ob_type field must be initialized in the module init function
+	 * to be portable to Windows without using C++. */
+	PyObject_HEAD_INIT(NULL)
+	0,			/*ob_size*/
+	"renderer.BillboardRenderer",		/*tp_name*/
+	sizeof(RendererObject),	/*tp_basicsize*/
+	0,			/*tp_itemsize*/
+	/* methods */
+	(destructor)BillboardRenderer_dealloc, /*tp_dealloc*/
+	0,			/*tp_print*/
+	0,          /*tp_getattr*/
+	0,          /*tp_setattr*/
+	0,			/*tp_compare*/
+	0,			/*tp_repr*/
+	0,			/*tp_as_number*/
+	0,	        /*tp_as_sequence*/
+	0,			/*tp_as_mapping*/
+	0,			/*tp_hash*/
+	0,                      /*tp_call*/
+	0,                      /*tp_str*/
+	0,                      /*tp_getattro*/
+	0,                      /*tp_setattro*/
+	0,                      /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,     /*tp_flags*/
+	BillboardRenderer__doc__,   /*tp_doc*/
+	0,                      /*tp_traverse*/
+	0,                      /*tp_clear*/
+	0,                      /*tp_richcompare*/
+	0,                      /*tp_weaklistoffset*/
+	0,                      /*tp_iter*/
+	0,                      /*tp_iternext*/
+	BillboardRenderer_methods,  /*tp_methods*/
+	BillboardRenderer_members,  /*tp_members*/
+	0,                      /*tp_getset*/
+	0,                      /*tp_base*/
+	0,                      /*tp_dict*/
+	0,                      /*tp_descr_get*/
+	0,                      /*tp_descr_set*/
+	0,                      /*tp_dictoffset*/
+	(initproc)BillboardRenderer_init, /*tp_init*/
+	0,                      /*tp_alloc*/
+	0,                      /*tp_new*/
+	0,                      /*tp_free*/
+	0,                      /*tp_is_gc*/
+};
+
+/* --------------------------------------------------------------------- */
+
+static PyTypeObject RibbonRenderer_Type;
+
+typedef struct {
+	PyObject_HEAD
+	PyObject *texturizer;
+	int fade;
+	int taper;
+} RibbonRendererObject;
+
+static void
+RibbonRenderer_dealloc(RibbonRendererObject *self) 
+{
+	Py_CLEAR(self->texturizer);	
+	PyObject_Del(self);
+}
+
+static int
+RibbonRenderer_init(RibbonRendererObject *self, PyObject *args, PyObject *kwargs)
+{
+	static char *kwlist[] = {"texturizer", "fade", "taper", NULL};
+
+	self->texturizer = NULL;
+	self->fade = 1;
+	self->taper = 0;
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|Oii:__init__", kwlist, 
+		&self->texturizer, &self->fade, &self->taper))
+		return -1;
+	if (self->texturizer == Py_None)
+		self->texturizer = NULL;
+	if (self->texturizer != NULL)
+		Py_INCREF(self->texturizer);
+	return 0;
+}
+
+#define RIBBON_MIN_CHUNK 256
+
+/* Vertices per ribbon, including the first and last repeated to join
+   the ribbons into one strip with degenerate triangles */
+#define RIBBON_VERTS(length) (2 * (length) + 2)
+
+typedef struct {
+	Particle *p;
+	PositionHistory *history;
+	VertItem *verts;
+	ColorItem *colors;
+	float *tex_coords;
+	Vec3 view;         /* View direction in model space */
+	Vec3 right;        /* Side direction where the ribbon has no length */
+	float alpha;       /* Interpolation from the last position */
+	int fade;
+	int taper;
+} RibbonJob;
+
+/* Generate the triangle strips for a chunk of ribbons, following the
+   position history of each particle from its current position back.
+   Run by worker threads with the GIL released */
+static void
+ribbon_chunk(void *ctx, unsigned long chunk, unsigned long start, unsigned long end)
+{
+	RibbonJob *job = (RibbonJob *)ctx;
+	int length = job->history->length;
+	int nverts = RIBBON_VERTS(length);
+	Particle *p;
+	VertItem *verts;
+	ColorItem *colors;
+	float *tex;
+	Vec3 pts[GROUP_MAX_HISTORY], tangent, dir, side;
+	Color color;
+	float t, width;
+	unsigned long i;
+	int k;
+
+	for (i = start; i < end; i++) {
+		p = job->p + i;
+		verts = job->verts + i * nverts;
+		colors = job->colors + i * nverts;
+		tex = job->tex_coords + i * nverts * 2;
+		if (!Particle_IsAlive(*p)) {
+			/* Collapse the ribbons of killed particles to a point */
+			memset(verts, 0, sizeof(VertItem) * nverts);
+			memset(colors, 0, sizeof(ColorItem) * nverts);
+			memset(tex, 0, sizeof(float) * nverts * 2);
+			continue;
+		}
+		interpolate_position(&pts[0], p, job->alpha);
+		for (k = 1; k < length; k++)
+			pts[k] = *PositionHistory_sample(job->history, i, k);
+
+		/*
+
+		verts[1]   verts[3]        verts[2k+1]
+		   +----------+----- ... -----+
+		   |          |               |
+		 pts[0]     pts[1]          pts[k]
+		   |          |               |
+		   +----------+----- ... -----+
+		verts[2]   verts[4]        verts[2k+2]
+
+		*/
+		dir = job->right;
+		for (k = 0; k < length; k++) {
+			/* The ribbon faces the viewer across the path at each point,
+			   keeping the last direction found where it has no length */
+			Vec3_sub(&tangent, &pts[k > 0 ? k - 1 : 0], 
+				&pts[k < length - 1 ? k + 1 : k]);
+			Vec3_cross(&side, &tangent, &job->view);
+			if (Vec3_normalize(&side, &side))
+				dir = side;
+			t = (float)k / (float)(length - 1);
+			width = p->size.x * 0.5f;
+			if (job->taper)
+				width *= 1.0f - t;
+			Vec3_scalar_mul(&side, &dir, width);
+			Vec3_add(&verts[2 * k + 1], &pts[k], &side);
+			Vec3_sub(&verts[2 * k + 2], &pts[k], &side);
+
+			color = p->color;
+			if (job->fade)
+				color.a *= 1.0f - t;
+			colors[2 * k + 1].colorl = colors[2 * k + 2].colorl = 
+				pack_color(&color);
+			tex[(2 * k + 1) * 2] = tex[(2 * k + 2) * 2] = t;
+			tex[(2 * k + 1) * 2 + 1] = 0.0f;
+			tex[(2 * k + 2) * 2 + 1] = 1.0f;
+		}
+		verts[0] = verts[1];
+		colors[0] = colors[1];
+		tex[0] = tex[2];
+		tex[1] = tex[3];
+		verts[nverts - 1] = verts[nverts - 2];
+		colors[nverts - 1] = colors[nverts - 2];
+		tex[(nverts - 1) * 2] = tex[(nverts - 2) * 2];
+		tex[(nverts - 1) * 2 + 1] = tex[(nverts - 2) * 2 + 1];
+	}
+}
+
+/* Draw the ribbons of the particles of the pinned group drawn as a
+   single triangle strip.
+
+   Return 1 on success, 0 if there was nothing to draw, or -1 on failure
+   with an exception set
+*/
+static int
+draw_ribbons(RibbonRendererObject *self, GroupObject *pgroup, GroupObject *drawn)
+{
+	PyObject *r, *type, *value, *traceback;
+	unsigned long pcount, vcount;
+	float mvmatrix[16];
+	VertArray data;
+	RibbonJob job;
+	GLState *state;
+	int timer;
+
+	if (drawn->history.length == 0) {
+		PyErr_SetString(PyExc_ValueError, 
+			"RibbonRenderer requires a group with a position history");
+		return -1;
+	}
+	if (!glew_initialize())
+		return -1;
+	state = GLState_get();
+	if (state == NULL)
+		return -1;
+	pcount = GroupObject_ActiveCount(drawn);
+	if (pcount == 0)
+		return 0;
+	vcount = pcount * RIBBON_VERTS(drawn->history.length);
+	if (!VertArray_alloc(&data, vcount, 2))
+		return -1;
+	if (self->texturizer != NULL) {
+		r = PyObject_CallMethod(self->texturizer, "set_state", NULL);
+		if (r == NULL)
+			goto error;
+		Py_DECREF(r);
+	} else {
+		GLState_flush(state);
+	}
+
+	/* Get the view direction and fallback side from the view matrix */
+	glGetFloatv(GL_MODELVIEW_MATRIX, mvmatrix);
+	job.view.x = mvmatrix[2];
+	job.view.y = mvmatrix[6];
+	job.view.z = mvmatrix[10];
+	Vec3_normalize(&job.view, &job.view);
+	job.right.x = mvmatrix[0];
+	job.right.y = mvmatrix[4];
+	job.right.z = mvmatrix[8];
+	Vec3_normalize(&job.right, &job.right);
+	job.p = drawn->plist->p;
+	job.history = &drawn->history;
+	job.verts = data.verts;
+	job.colors = data.colors;
+	job.tex_coords = data.tex_coords;
+	job.alpha = drawn->interpolation;
+	job.fade = self->fade;
+	job.taper = self->taper;
+	parallel_for(pcount, RIBBON_MIN_CHUNK, ribbon_chunk, &job);
+
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(3, GL_FLOAT, 0, data.verts);
+	glColorPointer(4, GL_UNSIGNED_BYTE, 0, data.colors);
+	glTexCoordPointer(2, GL_FLOAT, 0, data.tex_coords);
+	timer = gpu_timer_begin(&pgroup, 1);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, vcount);
+	gpu_timer_end(timer);
+	glPopClientAttrib();
+
+	if (!check_gl_error())
+		goto restore_error;
+
+	if (self->texturizer != NULL) {
+		r = PyObject_CallMethod(self->texturizer, "restore_state", NULL);
+		if (r == NULL)
+			goto error;
+		Py_DECREF(r);
+	}
+	VertArray_free(&data);
+	return 1;
+
+restore_error:
+	if (self->texturizer != NULL) {
+		PyErr_Fetch(&type, &value, &traceback);
+		r = PyObject_CallMethod(self->texturizer, "restore_state", NULL);
+		Py_XDECREF(r);
+		PyErr_Restore(type, value, traceback);
+	}
+error:
+	VertArray_free(&data);
+	return -1;
+}
+
+static PyObject *
+RibbonRenderer_draw(RibbonRendererObject *self, GroupObject *pgroup)
+{
+	GroupObject *drawn;
+	int result;
+
+	if (!GroupObject_Check(pgroup)) {
+		PyErr_SetString(PyExc_TypeError, "Expected ParticleGroup first argument");
+		return NULL;
+	}
+
+	drawn = GroupObject_BeginDraw(pgroup);
+	if (drawn == NULL)
+		return NULL;
+	result = draw_ribbons(self, pgroup, drawn);
+	GroupObject_EndDraw(drawn);
+	if (result < 0)
+		return NULL;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static PyMethodDef RibbonRenderer_methods[] = {
+	{"draw", (PyCFunction)RibbonRenderer_draw, METH_O,
+		PyDoc_STR("Draw the particles as ribbons along their recent path")},
+	{NULL,		NULL}		/* sentinel */
+};
+
+static struct PyMemberDef RibbonRenderer_members[] = {
+    {"texturizer", T_OBJECT, offsetof(RibbonRendererObject, texturizer), 0,
+        "A texturizer object that sets up texture state for the renderer."},
+    {"fade", T_INT, offsetof(RibbonRendererObject, fade), 0,
+        "If true, the ribbons fade to transparent toward their tails"},
+    {"taper", T_INT, offsetof(RibbonRendererObject, taper), 0,
+        "If true, the ribbons narrow to a point toward their tails"},
+	{NULL}
+};
+
+PyDoc_STRVAR(RibbonRenderer__doc__, 
+	"Particle renderer that draws a ribbon behind each particle along\n"
+	"its recent path, for trails, streaks and swooshes. The group must\n"
+	"keep a position history (see ParticleGroup.history), the ribbons\n"
+	"join the positions in it. They face the viewer, and their width\n"
+	"is the particle size.x.\n\n"
+	"RibbonRenderer(texturizer=None, fade=True, taper=False)\n\n"
+	"texturizer -- A texturizer object that sets up texture state.\n"
+	"Its texture coordinates are not used: the ribbons have the\n"
+	"texture s coordinate running from 0 at the particle to 1 at\n"
+	"the tail, and t from 0 to 1 across.\n\n"
+	"fade -- If true, the particle color alpha fades to zero at the\n"
+	"tail of the ribbon.\n\n"
+	"taper -- If true, the ribbon narrows to a point at the tail.");
+
+static PyTypeObject RibbonRenderer_Type = {
+	/* The ob_type field must be initialized in the module init function
+	 * to be portable to Windows without using C++. */
+	PyObject_HEAD_INIT(NULL)
+	0,			/*ob_size*/
+	"renderer.RibbonRenderer",		/*tp_name*/
+	sizeof(RibbonRendererObject),	/*tp_basicsize*/
+	0,			/*tp_itemsize*/
+	/* methods */
+	(destructor)RibbonRenderer_dealloc, /*tp_dealloc*/
+	0,			/*tp_print*/
+	0,          /*tp_getattr*/
+	0,          /*tp_setattr*/
+	0,			/*tp_compare*/
+	0,			/*tp_repr*/
+	0,			/*tp_as_number*/
+	0,	        /*tp_as_sequence*/
+	0,			/*tp_as_mapping*/
+	0,			/*tp_hash*/
+	0,                      /*tp_call*/
+	0,                      /*tp_str*/
+	0,                      /*tp_getattro*/
+	0,                      /*tp_setattro*/
+	0,                      /*tp_as_buffer*/
+	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,     /*tp_flags*/
+	RibbonRenderer__doc__,  /*tp_doc*/
+	0,                      /*tp_traverse*/
+	0,                      /*tp_clear*/
+	0,                      /*tp_richcompare*/
+	0,                      /*tp_weaklistoffset*/
+	0,                      /*tp_iter*/
+	0,                      /*tp_iternext*/
+	RibbonRenderer_methods, /*tp_methods*/
+	RibbonRenderer_members, /*tp_members*/
+	0,                      /*tp_getset*/
+	0,                      /*tp_base*/
+	0,                      /*tp_dict*/
+	0,                      /*tp_descr_get*/
+	0,                      /*tp_descr_set*/
+	0,                      /*tp_dictoffset*/
+	(initproc)RibbonRenderer_init, /*tp_init*/
+	0,                      /*tp_alloc*/
+	0,                      /*tp_new*/
+	0,                      /*tp_free*/
+	0,                      /*tp_is_gc*/
+};
+
+/* --------------------------------------------------------------------- */
+
+static PyTypeObject MeshRenderer_Type;
+
+typedef struct {
+	PyObject_HEAD
+	PyObject *texturizer;
+	int cull;
+	DrawList draw_list;
+	Vec3 *mesh_verts;
+	float *mesh_tex_coords;      /* 2 per vertex, or NULL */
+	GLuint *mesh_indices;
+	unsigned long vertex_count;
+	unsigned long index_count;
+	float radius;                /* Largest vertex distance from the origin */
+	GLuint *indices;             /* Mesh indices repeated for each instance */
+	unsigned long instance_alloc;
+} MeshRendererObject;
+
+/* Free the renderer's mesh arrays */
+static void
+MeshRenderer_free_mesh(MeshRendererObject *self)
+{
+	PyMem_Free(self->mesh_verts);
+	self->mesh_verts = NULL;
+	PyMem_Free(self->mesh_tex_coords);
+	self->mesh_tex_coords = NULL;
+	PyMem_Free(self->mesh_indices);
+	self->mesh_indices = NULL;
+	self->vertex_count = 0;
+	self->index_count = 0;
+}
+
+static void
+MeshRenderer_dealloc(MeshRendererObject *self) 
+{
+	Py_CLEAR(self->texturizer);	
+	DrawList_clear(&self->draw_list);
+	MeshRenderer_free_mesh(self);
+	PyMem_Free(self->indices);
+	PyObject_Del(self);
+}
+
+/* Copy the mesh from Python sequences into the renderer. Return true
+   on success, false on failure with an exception set and no mesh */
+static int
+MeshRenderer_set_mesh(MeshRendererObject *self, PyObject *vertices, 
+	PyObject *indices, PyObject *tex_coords)
+{
+	PyObject *seq = NULL, *item;
+	Py_ssize_t i, count;
+	float len;
+	long index;
+
+	seq = PySequence_Fast(vertices, "expected sequence of vertices");
+	if (seq == NULL)
+		goto error;
+	count = PySequence_Fast_GET_SIZE(seq);
+	if (count == 0) {
+		PyErr_SetString(PyExc_ValueError, "Mesh has no vertices");
+		goto error;
+	}
+	self->mesh_verts = PyMem_Malloc(sizeof(Vec3) * count);
+	if (self->mesh_verts == NULL) {
+		PyErr_NoMemory();
+		goto error;
+	}
+	self->vertex_count = count;
+	self->radius = 0.0f;
+	for (i = 0; i < count; i++) {
+		if (!Vec3_FromSequence(&self->mesh_verts[i], 
+			PySequence_Fast_GET_ITEM(seq, i)))
+			goto error;
+		len = Vec3_len(&self->mesh_verts[i]);
+		if (len > self->radius)
+			self->radius = len;
+	}
+	Py_CLEAR(seq);
+
+	seq = PySequence_Fast(indices, "expected sequence of indices");
+	if (seq == NULL)
+		goto error;
+	count = PySequence_Fast_GET_SIZE(seq);
+	if (count == 0 || count % 3 != 0) {
+		PyErr_SetString(PyExc_ValueError, 
+			"Expected a non-zero multiple of 3 triangle indices");
+		goto error;
+	}
+	self->mesh_indices = PyMem_Malloc(sizeof(GLuint) * count);
+	if (self->mesh_indices == NULL) {
+		PyErr_NoMemory();
+		goto error;
+	}
+	self->index_count = count;
+	for (i = 0; i < count; i++) {
+		index = PyInt_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+		if (index == -1 && PyErr_Occurred())
+			goto error;
+		if (index < 0 || (unsigned long)index >= self->vertex_count) {
+			PyErr_Format(PyExc_IndexError, 
+				"Mesh index %ld out of range", index);
+			goto error;
+		}
+		self->mesh_indices[i] = (GLuint)index;
 	}
+	Py_CLEAR(seq);
 
-	/* Get the alignment vectors from the view matrix */
-	glGetFloatv(GL_MODELVIEW_MATRIX, mvmatrix);
-	vright_unit.x = mvmatrix[0];
-	vright_unit.y = mvmatrix[4];
-	vright_unit.z = mvmatrix[8];
-	Vec3_normalize(&vright_unit, &vright_unit);
-	vup_unit.x = mvmatrix[1];
-	vup_unit.y = mvmatrix[5];
-	vup_unit.z = mvmatrix[9];
-	Vec3_normalize(&vup_unit, &vup_unit);
+	if (tex_coords != NULL && tex_coords != Py_None) {
+		seq = PySequence_Fast(tex_coords, "expected sequence of texture coordinates");
+		if (seq == NULL)
+			goto error;
+		count = PySequence_Fast_GET_SIZE(seq);
+		if ((unsigned long)count != self->vertex_count) {
+			PyErr_SetString(PyExc_ValueError, 
+				"Expected texture coordinates for each vertex");
+			goto error;
+		}
+		self->mesh_tex_coords = PyMem_Malloc(sizeof(float) * 2 * count);
+		if (self->mesh_tex_coords == NULL) {
+			PyErr_NoMemory();
+			goto error;
+		}
+		for (i = 0; i < count; i++) {
+			item = PySequence_Tuple(PySequence_Fast_GET_ITEM(seq, i));
+			if (item == NULL)
+				goto error;
+			if (!PyArg_ParseTuple(item, "ff;expected 2 floats for texture coordinates",
+				&self->mesh_tex_coords[i * 2], &self->mesh_tex_coords[i * 2 + 1])) {
+				Py_DECREF(item);
+				goto error;
+			}
+			Py_DECREF(item);
+		}
+		Py_CLEAR(seq);
+	}
+	return 1;
 
-	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
-	glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-	glEnableClientState(GL_VERTEX_ARRAY);
-	glEnableClientState(GL_COLOR_ARRAY);
-	for (i = 0; i < pcount*4; i += 4) {
+error:
+	Py_XDECREF(seq);
+	MeshRenderer_free_mesh(self);
+	return 0;
+}
 
-#define POINT0 i
-#define POINT1 i+1
-#define POINT2 i+2
-#define POINT3 i+3
+static int
+MeshRenderer_init(MeshRendererObject *self, PyObject *args, PyObject *kwargs)
+{
+	PyObject *vertices, *indices, *tex_coords = NULL, *texturizer = NULL;
+	int cull = 0;
+	static char *kwlist[] = {"vertices", "indices", "tex_coords", 
+		"texturizer", "cull", NULL};
+
+	/* The object is zeroed when allocated, the arrays are freed with it */
+	if (self->mesh_verts != NULL) {
+		PyErr_SetString(PyExc_TypeError, "MeshRenderer is already initialized");
+		return -1;
+	}
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|OOi:__init__", kwlist, 
+		&vertices, &indices, &tex_coords, &texturizer, &cull))
+		return -1;
+	if (!MeshRenderer_set_mesh(self, vertices, indices, tex_coords))
+		return -1;
+	if (texturizer == Py_None)
+		texturizer = NULL;
+	Py_XINCREF(texturizer);
+	Py_XDECREF(self->texturizer);
+	self->texturizer = texturizer;
+	self->cull = cull;
+	return 0;
+}
 
-		/*
+/* Ensure the repeated index array covers count instances. The indices
+   of the first instances do not depend on the count, so the array only
+   needs to be extended as it grows. Return true on success, false on
+   failure with an exception set */
+static int
+MeshRenderer_reserve_indices(MeshRendererObject *self, unsigned long count)
+{
+	GLuint *indices;
+	unsigned long i, j, alloc;
 
-		POINT3                POINT2
-			   +-------------+
-			   |\            |
-			   |  \          |
-			   |    \        |
-			   |      + ---- | --- Particle position
-			   |        \    |
-			   |          \  |
-			   |            \|
-			   +-------------+
-		POINT0                POINT1
+	if (count <= self->instance_alloc)
+		return 1;
+	alloc = self->instance_alloc * 2 > count ? self->instance_alloc * 2 : count;
+	indices = PyMem_Realloc(self->indices, 
+		sizeof(GLuint) * self->index_count * alloc);
+	if (indices == NULL) {
+		PyErr_NoMemory();
+		return 0;
+	}
+	for (i = self->instance_alloc; i < alloc; i++) {
+		for (j = 0; j < self->index_count; j++)
+			indices[i * self->index_count + j] = 
+				self->mesh_indices[j] + (GLuint)(i * self->vertex_count);
+	}
+	self->indices = indices;
+	self->instance_alloc = alloc;
+	return 1;
+}
 
-		*/
-		
+#define MESH_MIN_VERTS 8192
 
-		/* vertex coords */
+typedef struct {
+	MeshRendererObject *renderer;
+	Particle *p;
+	GLuint *index;     /* Draw list */
+	VertItem *verts;
+	ColorItem *colors;
+	float *tex_coords; /* Instance texture coords, or NULL */
+	float alpha;       /* Interpolation from the last position */
+} MeshJob;
 
-		if (p->up.z) {
-			/* billboard supports only z-axis rotation
-			   where the z-axiz is always that of the
-			   model-view matrix
-			*/
-			rotsin = (float)sin(p->up.z);
-			rotcos = (float)cos(p->up.z);
-			Vec3_scalar_mul(&vright, &vright_unit, rotcos);
-			Vec3_scalar_mul(&vrot, &vup_unit, rotsin);
-			Vec3_addi(&vright, &vrot);
-			Vec3_scalar_mul(&vup, &vup_unit, rotcos);
-			Vec3_scalar_mul(&vrot, &vright_unit, rotsin);
-			Vec3_subi(&vup, &vrot);
-			Vec3_scalar_muli(&vright, p->size.x * 0.5f);
-			Vec3_scalar_muli(&vup, p->size.y * 0.5f);
-		} else {
-			Vec3_scalar_mul(&vright, &vright_unit, p->size.x * 0.5f);
-			Vec3_scalar_mul(&vup, &vup_unit, p->size.y * 0.5f);
+/* Transform the mesh into place for a chunk of particles. Run by worker
+   threads with the GIL released */
+static void
+mesh_chunk(void *ctx, unsigned long chunk, unsigned long start, unsigned long end)
+{
+	MeshJob *job = (MeshJob *)ctx;
+	MeshRendererObject *self = job->renderer;
+	unsigned long nverts = self->vertex_count;
+	Particle *p;
+	VertItem *verts;
+	ColorItem *colors;
+	Vec3 pos, *v;
+	float m[9], sx, cx, sy, cy, sz, cz;
+	unsigned long i, j;
+	GLuint color;
+
+	for (i = start; i < end; i++) {
+		p = job->p + job->index[i];
+		verts = job->verts + i * nverts;
+		colors = job->colors + i * nverts;
+
+		/* The up vector holds the rotation angles about the x, y and z
+		   axes, applied in that order. The columns of the rotation are
+		   scaled by the particle size */
+		FastSinCos(p->up.x, &sx, &cx);
+		FastSinCos(p->up.y, &sy, &cy);
+		FastSinCos(p->up.z, &sz, &cz);
+		m[0] = cy * cz * p->size.x;
+		m[1] = (sx * sy * cz - cx * sz) * p->size.y;
+		m[2] = (cx * sy * cz + sx * sz) * p->size.z;
+		m[3] = cy * sz * p->size.x;
+		m[4] = (sx * sy * sz + cx * cz) * p->size.y;
+		m[5] = (cx * sy * sz - sx * cz) * p->size.z;
+		m[6] = -sy * p->size.x;
+		m[7] = sx * cy * p->size.y;
+		m[8] = cx * cy * p->size.z;
+		interpolate_position(&pos, p, job->alpha);
+
+		v = self->mesh_verts;
+		for (j = 0; j < nverts; j++) {
+			verts[j].x = pos.x + m[0] * v[j].x + m[1] * v[j].y + m[2] * v[j].z;
+			verts[j].y = pos.y + m[3] * v[j].x + m[4] * v[j].y + m[5] * v[j].z;
+			verts[j].z = pos.z + m[6] * v[j].x + m[7] * v[j].y + m[8] * v[j].z;
 		}
+		color = pack_color(&p->color);
+		for (j = 0; j < nverts; j++)
+			colors[j].colorl = color;
+		if (job->tex_coords != NULL)
+			memcpy(job->tex_coords + i * nverts * 2, self->mesh_tex_coords,
+				sizeof(float) * nverts * 2);
+	}
+}
 
-		Vec3_sub(&data.verts[POINT0], &p->position, &vright);
-		Vec3_subi(&data.verts[POINT0], &vup);
-		Vec3_add(&data.verts[POINT1], &p->position, &vright);
-		Vec3_subi(&data.verts[POINT1], &vup);
-		Vec3_add(&data.verts[POINT2], &p->position, &vright);
-		Vec3_addi(&data.verts[POINT2], &vup);
-		Vec3_sub(&data.verts[POINT3], &p->position, &vright);
-		Vec3_addi(&data.verts[POINT3], &vup);
+/* Draw the mesh for each live particle of the pinned group drawn with
+   a single draw call.
 
-		/* colors */
-		data.colors[POINT0].rgba.r = (unsigned char)(p->color.r * 255);
-		data.colors[POINT0].rgba.g = (unsigned char)(p->color.g * 255);
-		data.colors[POINT0].rgba.b = (unsigned char)(p->color.b * 255);
-		data.colors[POINT0].rgba.a = (unsigned char)(p->color.a * 255);
-		data.colors[POINT1].colorl = data.colors[POINT0].colorl;
-		data.colors[POINT2].colorl = data.colors[POINT0].colorl;
-		data.colors[POINT3].colorl = data.colors[POINT0].colorl;
+   Return 1 on success, 0 if there was nothing to draw, or -1 on failure
+   with an exception set
+*/
+static int
+draw_meshes(MeshRendererObject *self, GroupObject *pgroup, GroupObject *drawn)
+{
+	PyObject *r, *type, *value, *traceback;
+	DrawList *list = &self->draw_list;
+	unsigned long count;
+	VertArray data;
+	MeshJob job;
+	GLState *state;
+	long tex_dimension;
+	int timer;
 
-		p++;
-	}
+	state = GLState_get();
+	if (state == NULL)
+		return -1;
+	/* Without culling the list holds the live particles. The mesh extends
+	   from the particle position by its radius times the particle size */
+	if (!DrawList_prepare(list, drawn, self->cull, 0, self->radius, 0.0f))
+		return -1;
+	count = list->count;
+	if (count == 0)
+		return 0;
+	if (!MeshRenderer_reserve_indices(self, count))
+		return -1;
+	tex_dimension = self->mesh_tex_coords != NULL ? 2 : 0;
+	if (!VertArray_alloc(&data, count * self->vertex_count, tex_dimension))
+		return -1;
+
+	job.renderer = self;
+	job.p = drawn->plist->p;
+	job.index = list->index;
+	job.verts = data.verts;
+	job.colors = data.colors;
+	job.tex_coords = data.tex_coords;
+	job.alpha = drawn->interpolation;
+	parallel_for(count, MESH_MIN_VERTS / self->vertex_count + 1, mesh_chunk, &job);
 
 	if (self->texturizer != NULL) {
-		tex_array = (FloatArrayObject *)PyObject_CallMethod(
-			self->texturizer, "generate_tex_coords", "O", pgroup);
-		if (tex_array == NULL) {
-			r = PyObject_CallMethod(self->texturizer, "restore_state", NULL);
-			Py_XDECREF(r);
+		r = PyObject_CallMethod(self->texturizer, "set_state", NULL);
+		if (r == NULL)
 			goto error;
-		}
+		Py_DECREF(r);
 	} else {
-		tex_array = generate_default_2D_tex_coords(pgroup);
-		if (tex_array == NULL)
-			goto error;
+		GLState_flush(state);
 	}
 
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
 	glVertexPointer(3, GL_FLOAT, 0, data.verts);
 	glColorPointer(4, GL_UNSIGNED_BYTE, 0, data.colors);
-	glTexCoordPointer(tex_dimension, GL_FLOAT, 0, tex_array->data);
-	if (!draw_billboards(pcount))
-		goto error;
+	if (tex_dimension) {
+		glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		glTexCoordPointer(2, GL_FLOAT, 0, data.tex_coords);
+	}
+	timer = gpu_timer_begin(&pgroup, 1);
+	glDrawElements(GL_TRIANGLES, count * self->index_count, GL_UNSIGNED_INT,
+		self->indices);
+	gpu_timer_end(timer);
 	glPopClientAttrib();
 
-	GL_error = glGetError();
-	if (GL_error != GL_NO_ERROR) {
-		PyErr_Format(PyExc_RuntimeError, "GL error %d", GL_error);
-		goto error;
-	}
+	if (!check_gl_error())
+		goto restore_error;
 
 	if (self->texturizer != NULL) {
 		r = PyObject_CallMethod(self->texturizer, "restore_state", NULL);
@@ -681,53 +2890,99 @@ BillboardRenderer_draw(RendererObject *self, GroupObject *pgroup)
 			goto error;
 		Py_DECREF(r);
 	}
-	
-	Py_DECREF(tex_array);
 	VertArray_free(&data);
+	return 1;
 
-	Py_INCREF(Py_None);
-	return Py_None;
+restore_error:
+	if (self->texturizer != NULL) {
+		PyErr_Fetch(&type, &value, &traceback);
+		r = PyObject_CallMethod(self->texturizer, "restore_state", NULL);
+		Py_XDECREF(r);
+		PyErr_Restore(type, value, traceback);
+	}
 error:
-	Py_XDECREF(tex_array);
 	VertArray_free(&data);
-	return NULL;
+	return -1;
 }
 
-static PyMethodDef BillboardRenderer_methods[] = {
-	{"draw", (PyCFunction)BillboardRenderer_draw, METH_O,
-		PyDoc_STR("Draw the particles using textured billboard quads")},
+static PyObject *
+MeshRenderer_draw(MeshRendererObject *self, GroupObject *pgroup)
+{
+	GroupObject *drawn;
+	int result;
+
+	if (!GroupObject_Check(pgroup)) {
+		PyErr_SetString(PyExc_TypeError, "Expected ParticleGroup first argument");
+		return NULL;
+	}
+	if (self->mesh_verts == NULL) {
+		PyErr_SetString(PyExc_TypeError, "MeshRenderer is not initialized");
+		return NULL;
+	}
+
+	if (!glew_initialize())
+		return NULL;
+
+	drawn = GroupObject_BeginDraw(pgroup);
+	if (drawn == NULL)
+		return NULL;
+	result = draw_meshes(self, pgroup, drawn);
+	GroupObject_EndDraw(drawn);
+	if (result < 0)
+		return NULL;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static PyMethodDef MeshRenderer_methods[] = {
+	{"draw", (PyCFunction)MeshRenderer_draw, METH_O,
+		PyDoc_STR("Draw the mesh for each particle in the specified group")},
 	{NULL,		NULL}		/* sentinel */
 };
 
-static struct PyMemberDef BillboardRenderer_members[] = {
-    {"texturizer", T_OBJECT, offsetof(RendererObject, texturizer), 0,
-        "A texturizer object that generates texture coordinates\n"
-		"for the particles and sets up texture state for the renderer."},
+static struct PyMemberDef MeshRenderer_members[] = {
+    {"texturizer", T_OBJECT, offsetof(MeshRendererObject, texturizer), 0,
+        "A texturizer object that sets up texture state for the renderer."},
+    {"cull", T_INT, offsetof(MeshRendererObject, cull), 0,
+        "If true, particles outside of the view frustum are not drawn"},
+    {"vertex_count", T_ULONG, offsetof(MeshRendererObject, vertex_count), RO,
+        "Number of vertices in the mesh"},
+    {"index_count", T_ULONG, offsetof(MeshRendererObject, index_count), RO,
+        "Number of triangle indices in the mesh"},
 	{NULL}
 };
 
-PyDoc_STRVAR(BillboardRenderer__doc__, 
-	"Particle renderer using textured billboard-aligned quads\n"
-	"quads are aligned orthogonal to the model-view matrix\n\n"
-	"BillboardRenderer(texturizer=None)\n\n"
-	"texturizer -- A texturizer object that generates texture\n"
-	"coordinates for the particles and sets up texture state.\n"
-	"If not specified, texture coordinates are fixed at (0,0)\n"
-	"for the lower-left corner of each particle quad and (1,1)\n"
-	"for the upper-right. Without a texturizer the application\n"
-	"is responsible for setting up the desired texture state\n"
-	"before invoking the renderer.");
-
-static PyTypeObject BillboardRenderer_Type = {
+PyDoc_STRVAR(MeshRenderer__doc__, 
+	"Particle renderer that draws a triangle mesh for each particle,\n"
+	"for debris, leaves and other solid particles. The mesh is scaled\n"
+	"by the particle size, rotated by the angles in radians in the\n"
+	"particle up vector about the x, y and z axes in that order, and\n"
+	"placed at the particle position. The Movement controller turns\n"
+	"the particles by adding their rotation to up. The mesh is drawn\n"
+	"in the particle color.\n\n"
+	"The meshes of the group are transformed across threads into a\n"
+	"single vertex array, and drawn with one draw call.\n\n"
+	"MeshRenderer(vertices, indices, tex_coords=None, texturizer=None,\n"
+	"             cull=False)\n\n"
+	"vertices -- Sequence of (x, y, z) mesh vertices.\n\n"
+	"indices -- Sequence of vertex indices, three for each triangle.\n\n"
+	"tex_coords -- Optional sequence of (s, t) texture coordinates,\n"
+	"one for each vertex.\n\n"
+	"texturizer -- A texturizer object that sets up texture state.\n"
+	"Its texture coordinates are not used.\n\n"
+	"cull -- If true, particles whose mesh is outside of the current\n"
+	"view frustum are skipped before transforming their mesh.");
+
+static PyTypeObject MeshRenderer_Type = {
 	/* The ob_type field must be initialized in the module init function
 	 * to be portable to Windows without using C++. */
 	PyObject_HEAD_INIT(NULL)
 	0,			/*ob_size*/
-	"renderer.BillboardRenderer",		/*tp_name*/
-	sizeof(RendererObject),	/*tp_basicsize*/
+	"renderer.MeshRenderer",		/*tp_name*/
+	sizeof(MeshRendererObject),	/*tp_basicsize*/
 	0,			/*tp_itemsize*/
 	/* methods */
-	(destructor)BillboardRenderer_dealloc, /*tp_dealloc*/
+	(destructor)MeshRenderer_dealloc, /*tp_dealloc*/
 	0,			/*tp_print*/
 	0,          /*tp_getattr*/
 	0,          /*tp_setattr*/
@@ -743,28 +2998,439 @@ static PyTypeObject BillboardRenderer_Type = {
 	0,                      /*tp_setattro*/
 	0,                      /*tp_as_buffer*/
 	Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,     /*tp_flags*/
-	BillboardRenderer__doc__,   /*tp_doc*/
+	MeshRenderer__doc__,    /*tp_doc*/
 	0,                      /*tp_traverse*/
 	0,                      /*tp_clear*/
 	0,                      /*tp_richcompare*/
 	0,                      /*tp_weaklistoffset*/
 	0,                      /*tp_iter*/
 	0,                      /*tp_iternext*/
-	BillboardRenderer_methods,  /*tp_methods*/
-	BillboardRenderer_members,  /*tp_members*/
+	MeshRenderer_methods,   /*tp_methods*/
+	MeshRenderer_members,   /*tp_members*/
 	0,                      /*tp_getset*/
 	0,                      /*tp_base*/
 	0,                      /*tp_dict*/
 	0,                      /*tp_descr_get*/
 	0,                      /*tp_descr_set*/
 	0,                      /*tp_dictoffset*/
-	(initproc)BillboardRenderer_init, /*tp_init*/
+	(initproc)MeshRenderer_init, /*tp_init*/
 	0,                      /*tp_alloc*/
 	0,                      /*tp_new*/
 	0,                      /*tp_free*/
 	0,                      /*tp_is_gc*/
 };
 
+/* --------------------------------------------------------------------- */
+
+/* Batched drawing of several groups */
+
+static PyObject *draw_str = NULL;
+
+/* Return true if the groups drawn by the native renderers a and b can be
+   drawn in the same batch */
+static int
+same_batch(PyObject *a, PyObject *b)
+{
+	if (a->ob_type != b->ob_type)
+		return 0;
+	if (a->ob_type == &PointRenderer_Type) {
+		return ((PointRendererObject *)a)->texturizer == 
+			((PointRendererObject *)b)->texturizer
+			&& ((PointRendererObject *)a)->point_size == 
+			((PointRendererObject *)b)->point_size;
+	}
+	return ((RendererObject *)a)->texturizer == 
+		((RendererObject *)b)->texturizer;
+}
+
+/* Store a new reference to the native renderer of each of the count 
+   groups in items that can be batched in renderers, NULL for the others.
+   Groups with no renderer are marked drawn. Return true on success, false
+   on failure with an exception set */
+static int
+find_batch_renderers(PyObject **items, Py_ssize_t count, PyObject **renderers,
+	char *drawn)
+{
+	PyObject *renderer;
+	Py_ssize_t i;
+
+	memset(renderers, 0, sizeof(PyObject *) * count);
+	memset(drawn, 0, count);
+	/* References are held in case a group's draw() method changes 
+	   another's renderer */
+	for (i = 0; i < count; i++) {
+		if (!GroupObject_Check((GroupObject *)items[i])) {
+			if (!PyErr_ExceptionMatches(PyExc_TypeError))
+				return 0;
+			PyErr_Clear();
+			continue;
+		}
+		renderer = ((GroupObject *)items[i])->renderer;
+		if (renderer == NULL || renderer == Py_None) {
+			drawn[i] = 1; /* Nothing to draw */
+		} else if (renderer->ob_type == &PointRenderer_Type
+			|| renderer->ob_type == &BillboardRenderer_Type) {
+			Py_INCREF(renderer);
+			renderers[i] = renderer;
+		}
+	}
+	return 1;
+}
+
+/* Gather the batch of groups starting with group i, which has a native
+   renderer, marking them drawn. Return the number of groups stored in
+   batch_renderers and batch_groups */
+static int
+gather_batch(PyObject **items, Py_ssize_t count, PyObject **renderers,
+	char *drawn, Py_ssize_t i, PyObject **batch_renderers, 
+	GroupObject **batch_groups)
+{
+	Py_ssize_t j;
+	int batch_count = 0;
+
+	for (j = i; j < count; j++) {
+		if (j == i || (!drawn[j] && renderers[j] != NULL 
+			&& same_batch(renderers[i], renderers[j]))) {
+			drawn[j] = 1;
+			batch_renderers[batch_count] = renderers[j];
+			batch_groups[batch_count++] = (GroupObject *)items[j];
+		}
+	}
+	return batch_count;
+}
+
+static PyObject *
+renderer_draw_groups(PyObject *module, PyObject *groups)
+{
+	PyObject *seq, *item, *r, *result = NULL;
+	PyObject **items, **renderers = NULL, **batch_renderers = NULL;
+	GroupObject **batch_groups = NULL;
+	GLState *state;
+	char *drawn = NULL;
+	Py_ssize_t count, i;
+	int batch_count, draws = 0, n, batched = 0, depth;
+
+	if (draw_str == NULL) {
+		draw_str = PyString_InternFromString("draw");
+		if (draw_str == NULL)
+			return NULL;
+	}
+	state = GLState_get();
+	if (state == NULL)
+		return NULL;
+	seq = PySequence_Fast(groups, "expected sequence of particle groups");
+	if (seq == NULL)
+		return NULL;
+	count = PySequence_Fast_GET_SIZE(seq);
+	items = PySequence_Fast_ITEMS(seq);
+	renderers = PyMem_Malloc(sizeof(PyObject *) * (count + 1));
+	batch_renderers = PyMem_Malloc(sizeof(PyObject *) * (count + 1));
+	batch_groups = PyMem_Malloc(sizeof(GroupObject *) * (count + 1));
+	drawn = PyMem_Malloc(count + 1);
+	if (renderers == NULL || batch_renderers == NULL || batch_groups == NULL 
+		|| drawn == NULL) {
+		PyMem_Free(renderers);
+		renderers = NULL; /* Not initialized */
+		PyErr_NoMemory();
+		goto done;
+	}
+	if (!find_batch_renderers(items, count, renderers, drawn))
+		goto done;
+
+	/* Draw in order, each batch is drawn where its first group appears */
+	for (i = 0; i < count; i++) {
+		if (drawn[i])
+			continue;
+		drawn[i] = 1;
+		item = items[i];
+		if (renderers[i] == NULL) {
+			/* Other renderers may make any GL calls */
+			if (batched) {
+				depth = GLState_suspend(state);
+				r = PyObject_CallMethodObjArgs(item, draw_str, NULL);
+				GLState_resume(state, depth);
+			} else {
+				r = PyObject_CallMethodObjArgs(item, draw_str, NULL);
+			}
+			if (r == NULL)
+				goto done;
+			Py_DECREF(r);
+			draws++;
+			continue;
+		}
+		batch_count = gather_batch(items, count, renderers, drawn, i, 
+			batch_renderers, batch_groups);
+		if (!batched) {
+			if (!glew_initialize())
+				goto done;
+			GLState_begin_batch(state);
+			batched = 1;
+		}
+		if (renderers[i]->ob_type == &PointRenderer_Type)
+			n = draw_point_batch((PointRendererObject **)batch_renderers, 
+				batch_groups, batch_count);
+		else
+			n = draw_billboard_batch((RendererObject **)batch_renderers, 
+				batch_groups, batch_count);
+		if (n < 0)
+			goto done;
+		draws += n;
+	}
+
+	result = PyInt_FromLong(draws);
+done:
+	if (batched)
+		GLState_end_batch(state);
+	if (renderers != NULL) {
+		for (i = 0; i < count; i++)
+			Py_XDECREF(renderers[i]);
+	}
+	PyMem_Free(renderers);
+	PyMem_Free(batch_renderers);
+	PyMem_Free(batch_groups);
+	PyMem_Free(drawn);
+	Py_DECREF(seq);
+	return result;
+}
+
+/* Return the list of batches draw_groups() would draw, as tuples of
+   groups, without drawing them */
+static PyObject *
+renderer_batches(PyObject *module, PyObject *groups)
+{
+	PyObject *seq, *batches = NULL, *batch = NULL;
+	PyObject **items, **renderers = NULL, **batch_renderers = NULL;
+	GroupObject **batch_groups = NULL;
+	char *drawn = NULL;
+	Py_ssize_t count, i;
+	int batch_count, b, have_renderers = 0;
+
+	seq = PySequence_Fast(groups, "expected sequence of particle groups");
+	if (seq == NULL)
+		return NULL;
+	count = PySequence_Fast_GET_SIZE(seq);
+	items = PySequence_Fast_ITEMS(seq);
+	renderers = PyMem_Malloc(sizeof(PyObject *) * (count + 1));
+	batch_renderers = PyMem_Malloc(sizeof(PyObject *) * (count + 1));
+	batch_groups = PyMem_Malloc(sizeof(GroupObject *) * (count + 1));
+	drawn = PyMem_Malloc(count + 1);
+	if (renderers == NULL || batch_renderers == NULL || batch_groups == NULL 
+		|| drawn == NULL) {
+		PyErr_NoMemory();
+		goto done;
+	}
+	if (!find_batch_renderers(items, count, renderers, drawn))
+		goto done;
+	have_renderers = 1;
+	batches = PyList_New(0);
+	if (batches == NULL)
+		goto done;
+	for (i = 0; i < count; i++) {
+		if (drawn[i])
+			continue;
+		if (renderers[i] == NULL) {
+			drawn[i] = 1;
+			batch = PyTuple_Pack(1, items[i]);
+		} else {
+			batch_count = gather_batch(items, count, renderers, drawn, i, 
+				batch_renderers, batch_groups);
+			batch = PyTuple_New(batch_count);
+			for (b = 0; batch != NULL && b < batch_count; b++) {
+				Py_INCREF(batch_groups[b]);
+				PyTuple_SET_ITEM(batch, b, (PyObject *)batch_groups[b]);
+			}
+		}
+		if (batch == NULL || PyList_Append(batches, batch) < 0) {
+			Py_CLEAR(batches);
+			goto done;
+		}
+		Py_CLEAR(batch);
+	}
+done:
+	Py_XDECREF(batch);
+	if (have_renderers) {
+		for (i = 0; i < count; i++)
+			Py_XDECREF(renderers[i]);
+	}
+	PyMem_Free(renderers);
+	PyMem_Free(batch_renderers);
+	PyMem_Free(batch_groups);
+	PyMem_Free(drawn);
+	Py_DECREF(seq);
+	return batches;
+}
+
+static PyObject *
+renderer_draw_list(PyObject *module, PyObject *args)
+{
+	PyObject *renderer, *modelview, *projection, *indices = NULL, *item;
+	GroupObject *pgroup, *drawn;
+	DrawList *list;
+	float mvmatrix[16], proj[16], pad_scale = 0.0f, stretch = 0.0f;
+	unsigned long i;
+	int cull, sort;
+
+	if (!PyArg_ParseTuple(args, "OOOO:_draw_list", 
+		&renderer, &pgroup, &modelview, &projection))
+		return NULL;
+	if (renderer->ob_type == &PointRenderer_Type) {
+		/* Points are clipped by their centers, they need no padding */
+		list = &((PointRendererObject *)renderer)->draw_list;
+		cull = ((PointRendererObject *)renderer)->cull;
+		sort = ((PointRendererObject *)renderer)->sort;
+	} else if (renderer->ob_type == &BillboardRenderer_Type) {
+		list = &((RendererObject *)renderer)->draw_list;
+		cull = ((RendererObject *)renderer)->cull;
+		sort = ((RendererObject *)renderer)->sort;
+		pad_scale = BILLBOARD_CULL_PAD;
+		stretch = ((RendererObject *)renderer)->stretch;
+	} else {
+		PyErr_SetString(PyExc_TypeError, 
+			"Expected PointRenderer or BillboardRenderer");
+		return NULL;
+	}
+	if (!GroupObject_Check(pgroup))
+		return NULL;
+	if (!matrix_from_sequence(modelview, mvmatrix) 
+		|| !matrix_from_sequence(projection, proj))
+		return NULL;
+
+	drawn = GroupObject_BeginDraw(pgroup);
+	if (drawn == NULL)
+		return NULL;
+	if (!DrawList_prepare_view(list, drawn, cull, sort, pad_scale, stretch,
+		proj, mvmatrix))
+		goto done;
+	indices = PyList_New(list->count);
+	for (i = 0; indices != NULL && i < list->count; i++) {
+		item = PyInt_FromLong(list->index[i]);
+		if (item == NULL)
+			Py_CLEAR(indices);
+		else
+			PyList_SET_ITEM(indices, i, item);
+	}
+done:
+	GroupObject_EndDraw(drawn);
+	return indices;
+}
+
+static GLState gl_state;
+
+static PyObject *
+renderer_begin_batch(PyObject *module)
+{
+	if (!glew_initialize())
+		return NULL;
+	GLState_begin_batch(&gl_state);
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static PyObject *
+renderer_end_batch(PyObject *module)
+{
+	GLState_end_batch(&gl_state);
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static PyObject *
+renderer_set_debug(PyObject *module, PyObject *enable)
+{
+	int debug = PyObject_IsTrue(enable);
+
+	if (debug < 0)
+		return NULL;
+	gl_debug = debug;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static PyObject *
+renderer_set_gpu_timing(PyObject *module, PyObject *enable)
+{
+	int timing = PyObject_IsTrue(enable);
+
+	if (timing < 0)
+		return NULL;
+	if (timing && !glew_initialize())
+		return NULL;
+	return PyBool_FromLong(gpu_timer_enable(timing));
+}
+
+static PyObject *
+renderer_gl_state_stats(PyObject *module)
+{
+	return Py_BuildValue("{s:k,s:k}", 
+		"issued", gl_state.issued, "skipped", gl_state.skipped);
+}
+
+static PyObject *
+renderer_reset_gl_state_stats(PyObject *module)
+{
+	gl_state.issued = 0;
+	gl_state.skipped = 0;
+	Py_INCREF(Py_None);
+	return Py_None;
+}
+
+static PyMethodDef renderer_methods[] = {
+	{"draw_groups", (PyCFunction)renderer_draw_groups, METH_O,
+		PyDoc_STR("draw_groups(groups) -> draw count\n\n"
+		"Draw a sequence of particle groups. Groups using PointRenderers\n"
+		"or BillboardRenderers that share a texturizer (and point size)\n"
+		"are drawn together in a batch with a single texturizer state\n"
+		"change, at the position of the first group of the batch. Other\n"
+		"groups are drawn by calling their draw() method. Return the\n"
+		"number of draw calls made.")},
+	{"_batches", (PyCFunction)renderer_batches, METH_O,
+		PyDoc_STR("_batches(groups) -> list of tuples of groups\n\n"
+		"Return the batches of groups draw_groups() would draw, in order,\n"
+		"without drawing them. Groups that are not drawn natively are in\n"
+		"batches of their own.")},
+	{"_draw_list", (PyCFunction)renderer_draw_list, METH_VARARGS,
+		PyDoc_STR("_draw_list(renderer, group, modelview, projection) -> list\n\n"
+		"Return the indices of the particles of the group the Point or\n"
+		"Billboard renderer would draw, culled and sorted as it would for\n"
+		"the column-major model-view and projection matrices, in draw\n"
+		"order, without drawing them.")},
+	{"begin_batch", (PyCFunction)renderer_begin_batch, METH_NOARGS,
+		PyDoc_STR("begin_batch() -> None\n\n"
+		"Begin a batch of draws. Within a batch, GL state changes by\n"
+		"the native renderers and texturizers that would not change\n"
+		"the current state are skipped, and texturizers do not restore\n"
+		"the state until it is needed. The GL enable, point and texture\n"
+		"state is saved and restored by end_batch(). The application\n"
+		"must not change that state itself during the batch.")},
+	{"end_batch", (PyCFunction)renderer_end_batch, METH_NOARGS,
+		PyDoc_STR("end_batch() -> None\n\n"
+		"End a batch begun with begin_batch(), restoring GL state")},
+	{"gl_state_stats", (PyCFunction)renderer_gl_state_stats, METH_NOARGS,
+		PyDoc_STR("gl_state_stats() -> dict\n\n"
+		"Return the number of GL state calls issued and skipped as\n"
+		"redundant by the native renderers and texturizers, as a dict\n"
+		"with the keys 'issued' and 'skipped'.")},
+	{"reset_gl_state_stats", (PyCFunction)renderer_reset_gl_state_stats, 
+		METH_NOARGS, PyDoc_STR("reset_gl_state_stats() -> None\n\n"
+		"Reset the GL state call counts to zero")},
+	{"set_debug", (PyCFunction)renderer_set_debug, METH_O,
+		PyDoc_STR("set_debug(enable) -> None\n\n"
+		"Enable or disable checking for GL errors after each draw,\n"
+		"raising RuntimeError if one occurs. Checking can stall the\n"
+		"GPU pipeline, so it is off unless the LEPTON_GL_DEBUG\n"
+		"environment variable is set.")},
+	{"set_gpu_timing", (PyCFunction)renderer_set_gpu_timing, METH_O,
+		PyDoc_STR("set_gpu_timing(enable) -> bool\n\n"
+		"Enable or disable measuring the GPU time of native renderer\n"
+		"draws using timer queries. The results are stored in the\n"
+		"gpu_time attribute of each group drawn a few frames later,\n"
+		"without stalling. Groups drawn in a batch share its time in\n"
+		"proportion to their particle counts. Return True if timing\n"
+		"is enabled, False if disabled or not supported by the GL\n"
+		"implementation (requires EXT_timer_query).")},
+	{NULL,		NULL}		/* sentinel */
+};
+
 PyMODINIT_FUNC
 initrenderer(void)
 {
@@ -783,12 +3449,24 @@ initrenderer(void)
 	if (PyType_Ready(&BillboardRenderer_Type) < 0)
 		return;
 	
+	RibbonRenderer_Type.tp_alloc = PyType_GenericAlloc;
+	RibbonRenderer_Type.tp_new = PyType_GenericNew;
+	RibbonRenderer_Type.tp_getattro = PyObject_GenericGetAttr;
+	if (PyType_Ready(&RibbonRenderer_Type) < 0)
+		return;
+	
+	MeshRenderer_Type.tp_alloc = PyType_GenericAlloc;
+	MeshRenderer_Type.tp_new = PyType_GenericNew;
+	MeshRenderer_Type.tp_getattro = PyObject_GenericGetAttr;
+	if (PyType_Ready(&MeshRenderer_Type) < 0)
+		return;
+	
 	/* FloatArray objects cannot be instantiated from Python */
 	if (PyType_Ready(&FloatArray_Type) < 0)
 		return;
 
 	/* Create the module and add the types */
-	m = Py_InitModule3("renderer", NULL, "Particle Renderers");
+	m = Py_InitModule3("renderer", renderer_methods, "Particle Renderers");
 	if (m == NULL)
 		return;
 
@@ -796,4 +3474,14 @@ initrenderer(void)
 	PyModule_AddObject(m, "PointRenderer", (PyObject *)&PointRenderer_Type);
 	Py_INCREF(&BillboardRenderer_Type);
 	PyModule_AddObject(m, "BillboardRenderer", (PyObject *)&BillboardRenderer_Type);
+	Py_INCREF(&RibbonRenderer_Type);
+	PyModule_AddObject(m, "RibbonRenderer", (PyObject *)&RibbonRenderer_Type);
+	Py_INCREF(&MeshRenderer_Type);
+	PyModule_AddObject(m, "MeshRenderer", (PyObject *)&MeshRenderer_Type);
+
+	gl_debug = (getenv("LEPTON_GL_DEBUG") != NULL);
+
+	/* The GL state tracker shared with the texturizers */
+	GLState_init(&gl_state);
+	PyModule_AddObject(m, "_gl_state", PyCObject_FromVoidPtr(&gl_state, NULL));
 }
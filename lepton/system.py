@@ -14,16 +14,38 @@
 
 __version__ = '$Id$'
 
+import sys
+import threading
+
 class ParticleSystem(object):
 
-	def __init__(self, global_controllers=()):
+	def __init__(self, global_controllers=(), batch_draw=False, 
+		fixed_step=None, max_steps=5):
 		"""Initialize the particle system, adding the specified global
-		controllers, if any
+		controllers, if any.
+
+		If batch_draw is true, groups whose native renderers share the
+		same texturizer are drawn together in a single batch. Note this
+		can change the order that groups are drawn in.
+
+		If fixed_step is specified, the groups are always updated in
+		steps of that length, regardless of the time passed to update().
+		Time left over is carried to the next update, and native renderers
+		interpolate the particle positions to account for it. At most
+		max_steps steps are made per update, time beyond that is dropped
+		so that a slow frame does not cause ever slower ones.
 		"""
 		# Tuples are used for global controllers to prevent
 		# unpleasant side-affects if they are added during update or draw
 		self.controllers = tuple(global_controllers)
 		self.groups = []
+		self.batch_draw = batch_draw
+		self.draw_count = 0
+		self.fixed_step = fixed_step
+		self.max_steps = max_steps
+		self._accumulated = 0.0
+		self._update_thread = None
+		self._update_error = None
 
 	def add_global_controller(self, *controllers):
 		"""Add a global controller applied to all groups on update"""
@@ -60,11 +82,95 @@ class ParticleSystem(object):
 		When updating, first the global controllers are applied to
 		all groups. Then update(time_delta) is called for all groups.
 
+		If the system has a fixed_step, the groups are updated zero or
+		more times with that time delta instead.
+
 		This method can be conveniently scheduled using the Pyglet
 		scheduler method: pyglet.clock.schedule_interval
 		"""
-		for group in self:
-			group.update(time_delta)
+		self.wait()
+		steps, time_delta, interpolation = self._steps(time_delta)
+		self._update_groups(list(self.groups), steps, time_delta, interpolation)
+
+	def update_async(self, time_delta):
+		"""Start updating all particle groups in the system in a background
+		thread, and return immediately. The system may be drawn while the
+		update is in progress, which draws the particles as of the previous
+		update. Call wait() to wait for the update to finish.
+
+		All groups in the system must be double buffered so that their
+		renderers draw the snapshot published by their last update
+		instead of particles in the midst of an update. Native controllers
+		and renderers release the GIL while they work, allowing the draw
+		and update to proceed at the same time. Python controllers are
+		run in the background thread, so they should not make GL calls.
+
+		If the previous update is still in progress, it is waited for
+		before starting the next one.
+		"""
+		self.wait()
+		groups = list(self.groups)
+		for group in groups:
+			if not getattr(group, 'double_buffer', False):
+				raise ValueError(
+					"update_async() requires double buffered groups")
+		steps, time_delta, interpolation = self._steps(time_delta)
+		self._update_thread = threading.Thread(target=self._update_background, 
+			args=(groups, steps, time_delta, interpolation))
+		self._update_thread.setDaemon(True)
+		self._update_thread.start()
+	
+	def _steps(self, time_delta):
+		"""Return the number of update steps to make for the time passed,
+		the time delta for each and the interpolation of the groups for
+		the time left over after them, or None without a fixed step.
+		"""
+		if self.fixed_step is None:
+			return 1, time_delta, None
+		self._accumulated += time_delta
+		steps = int(self._accumulated / self.fixed_step)
+		if steps > self.max_steps:
+			steps = self.max_steps
+			self._accumulated = 0.0
+		else:
+			self._accumulated -= steps * self.fixed_step
+		interpolation = min(self._accumulated / self.fixed_step, 1.0)
+		return steps, self.fixed_step, interpolation
+
+	def _update_groups(self, groups, steps, time_delta, interpolation):
+		"""Update the groups steps times. The interpolation is applied
+		by the last step of each group, so that it is published along with
+		the particles it applies to, or right away if there are no steps.
+		"""
+		for i in xrange(steps - 1):
+			for group in groups:
+				group.update(time_delta)
+		for group in groups:
+			if interpolation is None or not hasattr(group, 'interpolation'):
+				if steps:
+					group.update(time_delta)
+			elif steps:
+				group.update(time_delta, interpolation)
+			else:
+				group.interpolation = interpolation
+
+	def _update_background(self, *args):
+		try:
+			self._update_groups(*args)
+		except:
+			self._update_error = sys.exc_info()
+
+	def wait(self):
+		"""Wait for an update started by update_async() to finish. Any
+		exception raised by the update is raised here. Does nothing if no
+		update is in progress.
+		"""
+		if self._update_thread is not None:
+			self._update_thread.join()
+			self._update_thread = None
+			error, self._update_error = self._update_error, None
+			if error is not None:
+				raise error[0], error[1], error[2]
 	
 	def run_ahead(self, time, framerate):
 		"""Run the particle system for the specified time frame at the 
@@ -89,6 +195,16 @@ class ParticleSystem(object):
 		
 		This method is convenient to call from your Pyglet window's
 		on_draw handler to redraw particles when needed.
+
+		The number of draw calls made, or groups drawn if not batching,
+		is stored in the draw_count attribute.
 		"""
-		for group in self:
-			group.draw()
+		if self.batch_draw:
+			from lepton.renderer import draw_groups
+			self.draw_count = draw_groups(list(self.groups))
+		else:
+			draw_count = 0
+			for group in self:
+				group.draw()
+				draw_count += 1
+			self.draw_count = draw_count
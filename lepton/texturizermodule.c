@@ -34,6 +34,7 @@
 #include "vector.h"
 #include "group.h"
 #include "renderer.h"
+#include "glstate.h"
 
 static void
 adjust_particle_widths(GroupObject *pgroup, FloatArrayObject *tex_array)
@@ -98,7 +99,11 @@ typedef struct {
 	Py_ssize_t coord_count;
 	float *tex_coords;
 	FloatArrayObject *tex_array;
-	unsigned long *weights;
+	float *weights;             /* Normalized weight of each coord set */
+	unsigned long *alias_prob;  /* Alias table for weighted selection */
+	Py_ssize_t *alias;
+	float *aspects;             /* Width/height and height/width of each set */
+	Py_ssize_t *sprites;        /* Coord set index of each particle */
 } SpriteTexObject;
 
 static PyObject *
@@ -116,6 +121,10 @@ SpriteTex_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
 	}
 	self->tex_coords = NULL;
 	self->weights = NULL;
+	self->alias_prob = NULL;
+	self->alias = NULL;
+	self->aspects = NULL;
+	self->sprites = NULL;
 	self->tex_array = NULL;
 	return (PyObject *)self;
 }
@@ -129,12 +138,26 @@ SpriteTex_clear(SpriteTexObject *self)
 }
 
 static void
-SpriteTex_dealloc(SpriteTexObject *self) 
+SpriteTex_free_tables(SpriteTexObject *self) 
 {
 	PyMem_Free(self->tex_coords);
 	self->tex_coords = NULL;
 	PyMem_Free(self->weights);
 	self->weights = NULL;
+	PyMem_Free(self->alias_prob);
+	self->alias_prob = NULL;
+	PyMem_Free(self->alias);
+	self->alias = NULL;
+	PyMem_Free(self->aspects);
+	self->aspects = NULL;
+	PyMem_Free(self->sprites);
+	self->sprites = NULL;
+}
+
+static void
+SpriteTex_dealloc(SpriteTexObject *self) 
+{
+	SpriteTex_free_tables(self);
 	SpriteTex_clear(self);
 	self->ob_type->tp_free((PyObject *)self);
 }
@@ -149,6 +172,88 @@ SpriteTex_traverse(SpriteTexObject *self, visitproc visit, void *arg)
 
 #define WEIGHT_MAX INT_MAX
 
+/* Store the width/height and height/width ratios of each set of
+   2D texture coordinates in aspects */
+static void
+get_tex_aspects_2d(float *tex_coords, Py_ssize_t count, float *aspects)
+{
+	float *tex, min_s, min_t, max_s, max_t;
+	Py_ssize_t i;
+	int j;
+
+	for (i = 0; i < count; i++) {
+		tex = tex_coords + i * 8;
+		min_s = max_s = tex[0];
+		min_t = max_t = tex[1];
+		for (j = 2; j < 8; j += 2) {
+			min_s = min_s <= tex[j] ? min_s : tex[j];
+			max_s = max_s >= tex[j] ? max_s : tex[j];
+			min_t = min_t <= tex[j+1] ? min_t : tex[j+1];
+			max_t = max_t >= tex[j+1] ? max_t : tex[j+1];
+		}
+		aspects[i*2] = (max_s - min_s) / (max_t - min_t + EPSILON);
+		aspects[i*2+1] = (max_t - min_t) / (max_s - min_s + EPSILON);
+	}
+}
+
+/* Build the alias table for picking coord sets by weight with
+   a single draw (Vose's method). Return true on success, false on 
+   failure with an exception set */
+static int
+SpriteTex_build_alias(SpriteTexObject *self)
+{
+	Py_ssize_t n = self->coord_count, i, l, g, small_count = 0, large_count = 0;
+	Py_ssize_t *small = NULL, *large = NULL;
+	double *scaled = NULL;
+
+	self->alias_prob = (unsigned long *)PyMem_Malloc(sizeof(unsigned long) * n);
+	self->alias = (Py_ssize_t *)PyMem_Malloc(sizeof(Py_ssize_t) * n);
+	scaled = (double *)PyMem_Malloc(sizeof(double) * n);
+	small = (Py_ssize_t *)PyMem_Malloc(sizeof(Py_ssize_t) * n);
+	large = (Py_ssize_t *)PyMem_Malloc(sizeof(Py_ssize_t) * n);
+	if (self->alias_prob == NULL || self->alias == NULL || 
+		scaled == NULL || small == NULL || large == NULL) {
+		PyErr_NoMemory();
+		PyMem_Free(scaled);
+		PyMem_Free(small);
+		PyMem_Free(large);
+		return 0;
+	}
+	for (i = 0; i < n; i++) {
+		scaled[i] = self->weights[i] * n;
+		if (scaled[i] < 1.0)
+			small[small_count++] = i;
+		else
+			large[large_count++] = i;
+	}
+	while (small_count > 0 && large_count > 0) {
+		l = small[--small_count];
+		g = large[large_count - 1];
+		self->alias_prob[l] = (unsigned long)(scaled[l] * WEIGHT_MAX);
+		self->alias[l] = g;
+		scaled[g] -= 1.0 - scaled[l];
+		if (scaled[g] < 1.0) {
+			large_count--;
+			small[small_count++] = g;
+		}
+	}
+	/* Whatever remains is full, up to rounding */
+	while (large_count > 0) {
+		g = large[--large_count];
+		self->alias_prob[g] = WEIGHT_MAX;
+		self->alias[g] = g;
+	}
+	while (small_count > 0) {
+		l = small[--small_count];
+		self->alias_prob[l] = WEIGHT_MAX;
+		self->alias[l] = l;
+	}
+	PyMem_Free(scaled);
+	PyMem_Free(small);
+	PyMem_Free(large);
+	return 1;
+}
+
 static float *
 get_tex_coords_2d(PyObject *tex_coords_seq, Py_ssize_t *count_out)
 {
@@ -278,15 +383,12 @@ SpriteTex_init(SpriteTexObject *self, PyObject *args, PyObject *kwargs)
 	PyObject *tex_coords_seq = NULL, *weights_seq = NULL;
 	PyObject *s = NULL, *t = NULL, **item;
 	int i;
-	double total_weight, weight_scale, w;
+	double total_weight, w;
 
 	static char *kwlist[] = {"texture", "coords", "weights", "filter", "wrap", 
 		"aspect_adjust_width", "aspect_adjust_height", NULL};
 
-	PyMem_Free(self->tex_coords);
-	self->tex_coords = NULL;
-	PyMem_Free(self->weights);
-	self->weights = NULL;
+	SpriteTex_free_tables(self);
 	self->tex_filter = GL_LINEAR;
 	self->tex_wrap = GL_CLAMP;
 	self->coord_count = 0;
@@ -308,6 +410,12 @@ SpriteTex_init(SpriteTexObject *self, PyObject *args, PyObject *kwargs)
 		self->tex_coords = get_tex_coords_2d(tex_coords_seq, &self->coord_count);
 		if (self->tex_coords == NULL)
 			goto error;
+		self->aspects = (float *)PyMem_Malloc(sizeof(float) * 2 * self->coord_count);
+		if (self->aspects == NULL) {
+			PyErr_NoMemory();
+			goto error;
+		}
+		get_tex_aspects_2d(self->tex_coords, self->coord_count, self->aspects);
 		if (weights_seq != NULL && weights_seq != Py_None) {
 			s = PySequence_Fast(weights_seq, "SpriteTexturizer: weights not iterable");
 			if (s == NULL)
@@ -317,8 +425,7 @@ SpriteTex_init(SpriteTexObject *self, PyObject *args, PyObject *kwargs)
 					"SpriteTexturizer: length of coords and weights do not match");
 				goto error;
 			}
-			self->weights = (unsigned long *)PyMem_Malloc(
-				sizeof(unsigned long) * self->coord_count);
+			self->weights = (float *)PyMem_Malloc(sizeof(float) * self->coord_count);
 			if (self->weights == NULL) {
 				PyErr_NoMemory();
 				goto error;
@@ -334,21 +441,13 @@ SpriteTex_init(SpriteTexObject *self, PyObject *args, PyObject *kwargs)
 						"SpriteTexturizer: weight values must be >= 0");
 					goto error;
 				}
+				self->weights[i] = (float)w;
 				total_weight += w;
 			}
-			/* scale weights to full integer range */
-			if (total_weight > (double)(WEIGHT_MAX)) {
-				PyErr_SetString(PyExc_ValueError, "SpriteTexturizer: weights out of range");
+			for (i = 0; i < self->coord_count; i++)
+				self->weights[i] = (float)(self->weights[i] / total_weight);
+			if (!SpriteTex_build_alias(self))
 				goto error;
-			}
-			weight_scale = (double)(WEIGHT_MAX) / total_weight;
-			total_weight = 0;
-			for (i = 0; i < self->coord_count; i++) {
-				total_weight += PyFloat_AsDouble(item[i]);
-				if (PyErr_Occurred())
-					goto error;
-				 self->weights[i] = (unsigned long)(total_weight * weight_scale);
-			}
 			Py_CLEAR(s);
 		}
 	} else if (weights_seq != NULL) {
@@ -361,10 +460,7 @@ SpriteTex_init(SpriteTexObject *self, PyObject *args, PyObject *kwargs)
 error:
 	Py_XDECREF(s);
 	Py_XDECREF(t);
-	PyMem_Free(self->tex_coords);
-	self->tex_coords = NULL;
-	PyMem_Free(self->weights);
-	self->weights = NULL;
+	SpriteTex_free_tables(self);
 	return -1;
 }
 
@@ -402,7 +498,6 @@ static PyObject *
 SpriteTex_get_weights(SpriteTexObject *self, void *closure)
 {
 	PyObject *weights = NULL, *w = NULL;
-	double total = 0.0;
 	int i;
 	
 	if (self->weights != NULL) {
@@ -410,11 +505,10 @@ SpriteTex_get_weights(SpriteTexObject *self, void *closure)
 		if (weights == NULL)
 			goto error;
 		for (i = 0; i < self->coord_count; i++) {
-			w = PyFloat_FromDouble(((double)self->weights[i] - total) / (double)WEIGHT_MAX);
+			w = PyFloat_FromDouble(self->weights[i]);
 			if (w == NULL)
 				goto error;
 			PyTuple_SET_ITEM(weights, i, w);
-			total = (double)self->weights[i];
 		}
 		return weights;
 	} else {
@@ -436,13 +530,14 @@ SpriteTex_get_tex_dimension(SpriteTexObject *self, void *closure)
 static PyObject *
 SpriteTex_set_state(SpriteTexObject *self)
 {
-	glPushAttrib(GL_ENABLE_BIT);
-	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, self->texture);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, self->tex_filter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, self->tex_filter);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, self->tex_wrap);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, self->tex_wrap);
+	GLState *state = GLState_get();
+
+	if (state == NULL)
+		return NULL;
+	GLState_push(state);
+	GLState_enable_texture(state, GL_TEXTURE_2D);
+	GLState_bind_texture(state, GL_TEXTURE_2D, self->texture, 
+		self->tex_filter, self->tex_wrap);
 
 	Py_INCREF(Py_None);
 	return Py_None;
@@ -451,7 +546,11 @@ SpriteTex_set_state(SpriteTexObject *self)
 static PyObject *
 SpriteTex_restore_state(SpriteTexObject *self)
 {
-	glPopAttrib();
+	GLState *state = GLState_get();
+
+	if (state == NULL)
+		return NULL;
+	GLState_pop(state);
 
 	Py_INCREF(Py_None);
 	return Py_None;
@@ -461,14 +560,45 @@ static unsigned long jz, jsr=123456789;
 #define SHR3SEED(s) (jz=0,jsr=(s))
 #define SHR3RAND() (jz=jsr, jsr^=(jsr<<13), jsr^=(jsr>>17), jsr^=(jsr<<5),jz+jsr)
 
+/* Assign a coord set index to each of count particles */
+static void
+SpriteTex_assign_sprites(SpriteTexObject *self, unsigned long count)
+{
+	Py_ssize_t *sprites = self->sprites, coord_count = self->coord_count, c;
+	unsigned long i;
+
+	if (self->alias_prob == NULL) {
+		/* Assign coords in round-robin fashion */
+		for (i = 0, c = 0; i < count; i++) {
+			sprites[i] = c;
+			if (++c >= coord_count)
+				c = 0;
+		}
+	} else {
+		/* Assign coords randomly according to weight, picking a 
+		   column uniformly then it or its alias by the column's odds */
+
+		/* use our pointer as the random seed so the generated
+		   random sequence is repeatable */
+		SHR3SEED((unsigned long)self);
+		for (i = 0; i < count; i++) {
+			c = (Py_ssize_t)(SHR3RAND() % (unsigned long)coord_count);
+			sprites[i] = (SHR3RAND() & WEIGHT_MAX) < self->alias_prob[c] ? 
+				c : self->alias[c];
+		}
+	}
+}
+
 static FloatArrayObject *
 SpriteTex_generate_tex_coords(SpriteTexObject *self, GroupObject *pgroup)
 {
-	register unsigned long pcount, i;
-	unsigned long w, *weights;
-	Py_ssize_t tcount, coord_count;
-	float *ptex, *ttex, *tex_coords;
+	unsigned long pcount, i;
+	Py_ssize_t *sprites;
+	float *ptex, *aspects;
 	FloatArrayObject *tex_array;
+	Particle *p;
+	float default_aspects[2];
+	static float default_coords[8] = {0,0, 1,0, 1,1, 0,1};
 
 	if (!GroupObject_Check(pgroup)) {
 		PyErr_SetString(PyExc_TypeError, "Expected ParticleGroup first argument");
@@ -479,77 +609,59 @@ SpriteTex_generate_tex_coords(SpriteTexObject *self, GroupObject *pgroup)
 		/* Special case, default texture coordinates. These can be cached
 		   and shared between texturizers, so we don't generate them here */
 		tex_array = generate_default_2D_tex_coords(pgroup);
+		if (tex_array == NULL)
+			return NULL;
 	} else if (self->tex_array == NULL ||
 		       self->tex_array->size < GroupObject_ActiveCount(pgroup) * 8) {
-		/* calculate texture coordinates and cache them */
+		/* pick the coord set of each particle, and expand them 
+		   into texture coordinates to cache */
 		pcount = pgroup->plist->palloc;
 		Py_XDECREF(self->tex_array);
-		tex_array = self->tex_array = FloatArray_new(pgroup->plist->palloc * 8);
+		tex_array = self->tex_array = FloatArray_new(pcount * 8);
 		if (tex_array == NULL)
 			return NULL;
-		Py_INCREF(self->tex_array); /* for persistence */
-		Py_INCREF(tex_array); /* for the caller */
-		ptex = self->tex_array->data;
-		ttex = tex_coords = self->tex_coords;
-		tcount = coord_count = self->coord_count;
-		weights = self->weights;
-		if (self->coord_count == 1) {
-			/* Special case, all particles have same coords */
-			while (pcount--) {
-				*ptex++ = ttex[0];
-				*ptex++ = ttex[1];
-				*ptex++ = ttex[2];
-				*ptex++ = ttex[3];
-				*ptex++ = ttex[4];
-				*ptex++ = ttex[5];
-				*ptex++ = ttex[6];
-				*ptex++ = ttex[7];
-			}
-		} else if (self->weights == NULL) {
-			/* Assign coords in round-robin fashion */
-			while (pcount--) {
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				if (--tcount <= 0) {
-					ttex = tex_coords;
-					tcount = coord_count;
-				}
-			}
-		} else {
-			/* Assign coords randomly according to weight */
-
-			/* use our pointer as the random seed so the generated
-			   random sequence is repeatable */
-			SHR3SEED((unsigned long)self);
-			while (pcount--) {
-				w = SHR3RAND() & WEIGHT_MAX;
-				for (i = 0; i < coord_count && w > weights[i]; i++);
-				ttex = tex_coords + i * 8;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-			}
+		sprites = (Py_ssize_t *)PyMem_Realloc(
+			self->sprites, sizeof(Py_ssize_t) * pcount);
+		if (sprites == NULL) {
+			Py_CLEAR(self->tex_array);
+			PyErr_NoMemory();
+			return NULL;
 		}
+		self->sprites = sprites;
+		SpriteTex_assign_sprites(self, pcount);
+		ptex = tex_array->data;
+		for (i = 0; i < pcount; i++, ptex += 8)
+			memcpy(ptex, self->tex_coords + sprites[i] * 8, sizeof(float) * 8);
+		Py_INCREF(tex_array); /* for the caller, we keep the other */
 	} else {
 		/* use cached texture coordinates */
 		tex_array = self->tex_array;
 		Py_INCREF(tex_array);
 	}
-	if (self->adjust_width) {
-		adjust_particle_widths(pgroup, tex_array);
-	} else if (self->adjust_height) {
-		adjust_particle_heights(pgroup, tex_array);
+	if (self->adjust_width || self->adjust_height) {
+		/* Apply the cached aspect ratio of each particle's coord set */
+		p = pgroup->plist->p;
+		pcount = GroupObject_ActiveCount(pgroup);
+		if (self->tex_coords == NULL) {
+			get_tex_aspects_2d(default_coords, 1, default_aspects);
+			if (self->adjust_width) {
+				for (i = 0; i < pcount; i++)
+					p[i].size.x = p[i].size.y * default_aspects[0];
+			} else {
+				for (i = 0; i < pcount; i++)
+					p[i].size.y = p[i].size.x * default_aspects[1];
+			}
+		} else {
+			sprites = self->sprites;
+			aspects = self->aspects;
+			if (self->adjust_width) {
+				for (i = 0; i < pcount; i++)
+					p[i].size.x = p[i].size.y * aspects[sprites[i] * 2];
+			} else {
+				for (i = 0; i < pcount; i++)
+					p[i].size.y = p[i].size.x * aspects[sprites[i] * 2 + 1];
+			}
+		}
 	}
 
 	return tex_array;
@@ -686,10 +798,17 @@ typedef struct {
 	FloatArrayObject *tex_array;
 	int dimension;
 	int loop;
+	int blend;
 	float duration;
 	float *frame_times;
+	int *frame_lut;   /* First frame of each age bucket, for frame_times */
+	int lut_size;
+	float lut_scale;  /* Buckets per unit of age */
 } FlipBookTexObject;
 
+/* Most buckets in the age to frame lookup table */
+#define FLIPBOOK_MAX_LUT 4096
+
 static PyObject *
 FlipBookTex_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
 {
@@ -705,6 +824,7 @@ FlipBookTex_new(PyTypeObject *type, PyObject *args, PyObject *kwargs)
 	}
 	self->tex_coords = NULL;
 	self->frame_times = NULL;
+	self->frame_lut = NULL;
 	self->tex_array = NULL;
 	return (PyObject *)self;
 }
@@ -724,6 +844,8 @@ FlipBookTex_dealloc(FlipBookTexObject *self)
 	self->tex_coords = NULL;
 	PyMem_Free(self->frame_times);
 	self->frame_times = NULL;
+	PyMem_Free(self->frame_lut);
+	self->frame_lut = NULL;
 	FlipBookTex_clear(self);
 	self->ob_type->tp_free((PyObject *)self);
 }
@@ -736,6 +858,81 @@ FlipBookTex_traverse(FlipBookTexObject *self, visitproc visit, void *arg)
     return 0;
 }
 
+/* Build the table of the frame at the start of each age bucket, so that
+   the frame at any age is found from its bucket's in a step or two. The
+   buckets are no longer than the shortest frame. Return true on success,
+   false on failure with an exception set */
+static int
+FlipBookTex_build_lut(FlipBookTexObject *self)
+{
+	float *times = self->frame_times;
+	int last = self->coord_count - 1;
+	float total = times[last], shortest = total, d, age;
+	int i, frame, size;
+
+	self->lut_size = 0;
+	if (total <= 0.0f)
+		return 1;
+	for (i = 0; i <= last; i++) {
+		d = times[i] - (i > 0 ? times[i - 1] : 0.0f);
+		if (d > 0.0f && d < shortest)
+			shortest = d;
+	}
+	d = ceilf(total / shortest);
+	size = d < FLIPBOOK_MAX_LUT ? (int)d : FLIPBOOK_MAX_LUT;
+	if (size < 1)
+		size = 1;
+	self->frame_lut = (int *)PyMem_Malloc(sizeof(int) * size);
+	if (self->frame_lut == NULL) {
+		PyErr_NoMemory();
+		return 0;
+	}
+	self->lut_size = size;
+	self->lut_scale = size / total;
+	frame = 0;
+	for (i = 0; i < size; i++) {
+		age = i / self->lut_scale;
+		for (; frame < last && age > times[frame]; frame++);
+		self->frame_lut[i] = frame;
+	}
+	return 1;
+}
+
+/* Return the frame shown at the age, and store the fraction of the
+   frame's duration elapsed in frac */
+static inline int
+FlipBookTex_frame(FlipBookTexObject *self, float age, float *frac)
+{
+	float *times = self->frame_times;
+	int last = self->coord_count - 1;
+	int frame, bucket;
+	float t, start;
+
+	if (times == NULL) {
+		if (!self->loop)
+			age = fminf(age, self->duration * last);
+		t = age / self->duration;
+		frame = (int)t;
+		*frac = t - frame;
+		return self->loop ? frame % self->coord_count : frame;
+	}
+	*frac = 0.0f;
+	if (self->lut_size == 0)
+		return self->loop ? 0 : last; /* Every frame has zero duration */
+	if (self->loop)
+		age = fmodf(age, times[last]);
+	t = age * self->lut_scale;
+	bucket = t < self->lut_size ? (int)t : self->lut_size - 1;
+	frame = self->frame_lut[bucket];
+	/* Rounding may put the age just outside of its bucket */
+	for (; frame < last && age > times[frame]; frame++);
+	for (; frame > 0 && age <= times[frame - 1]; frame--);
+	start = frame > 0 ? times[frame - 1] : 0.0f;
+	if (times[frame] > start && age > start)
+		*frac = fminf((age - start) / (times[frame] - start), 1.0f);
+	return frame;
+}
+
 static int
 FlipBookTex_init(FlipBookTexObject *self, PyObject *args, PyObject *kwargs)
 {
@@ -745,24 +942,29 @@ FlipBookTex_init(FlipBookTexObject *self, PyObject *args, PyObject *kwargs)
 	double total_time, t;
 
 	static char *kwlist[] = {"texture", "coords", "duration", "loop", "dimension",
-		"filter", "wrap", "aspect_adjust_width", "aspect_adjust_height", NULL};
+		"filter", "wrap", "aspect_adjust_width", "aspect_adjust_height", "blend",
+		NULL};
 
 	PyMem_Free(self->tex_coords);
 	self->tex_coords = NULL;
 	PyMem_Free(self->frame_times);
 	self->frame_times = NULL;
+	PyMem_Free(self->frame_lut);
+	self->frame_lut = NULL;
+	self->lut_size = 0;
 	self->tex_filter = GL_LINEAR;
 	self->tex_wrap = GL_CLAMP;
 	self->coord_count = 0;
 	self->adjust_width = 0;
 	self->adjust_height = 0;
 	self->loop = 1;
+	self->blend = 0;
 	self->dimension = 2;
 	Py_CLEAR(self->tex_array);
-	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iOO|iiiiii:__init__", kwlist,
+	if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iOO|iiiiiii:__init__", kwlist,
 		&self->texture, &tex_coords_seq, &duration, &self->loop, &self->dimension,
 		&self->tex_filter, &self->tex_wrap,
-		&self->adjust_width, &self->adjust_height))
+		&self->adjust_width, &self->adjust_height, &self->blend))
 		return -1;
 	
 	if (self->adjust_height && self->adjust_width) {
@@ -784,6 +986,11 @@ FlipBookTex_init(FlipBookTexObject *self, PyObject *args, PyObject *kwargs)
 			"FlipBookTexturizer: expected dimension value of 2 or 3");
 		goto error;
 	}
+	if (self->blend && self->dimension != 3) {
+		PyErr_SetString(PyExc_ValueError,
+			"FlipBookTexturizer: blend requires dimension 3");
+		goto error;
+	}
 	
 	if (PySequence_Check(duration)) {
 		s = PySequence_Fast(duration, "FlipBookTexturizer: duration not iterable");
@@ -814,6 +1021,8 @@ FlipBookTex_init(FlipBookTexObject *self, PyObject *args, PyObject *kwargs)
 		}
 		self->duration = (float)(total_time / self->coord_count);
 		Py_CLEAR(s);
+		if (!FlipBookTex_build_lut(self))
+			goto error;
 	} else if (PyNumber_Check(duration)) {
 		s = PyNumber_Float(duration);
 		if (s == NULL)
@@ -839,6 +1048,9 @@ error:
 	self->tex_coords = NULL;
 	PyMem_Free(self->frame_times);
 	self->frame_times = NULL;
+	PyMem_Free(self->frame_lut);
+	self->frame_lut = NULL;
+	self->lut_size = 0;
 	return -1;
 }
 
@@ -915,6 +1127,7 @@ static PyObject *
 FlipBookTex_set_state(FlipBookTexObject *self)
 {
 	GLenum tex_target;
+	GLState *state;
 	if (self->dimension == 2) {
 		tex_target = GL_TEXTURE_2D;
 	} else if (self->dimension == 3) {
@@ -924,13 +1137,13 @@ FlipBookTex_set_state(FlipBookTexObject *self)
 			"FlipBookTexturizer: invalid dimension value");
 		return NULL;
 	}
-	glPushAttrib(GL_ENABLE_BIT);
-	glEnable(tex_target);
-	glBindTexture(tex_target, self->texture);
-	glTexParameteri(tex_target, GL_TEXTURE_MIN_FILTER, self->tex_filter);
-	glTexParameteri(tex_target, GL_TEXTURE_MAG_FILTER, self->tex_filter);
-	glTexParameteri(tex_target, GL_TEXTURE_WRAP_S, self->tex_wrap);
-	glTexParameteri(tex_target, GL_TEXTURE_WRAP_T, self->tex_wrap);
+	state = GLState_get();
+	if (state == NULL)
+		return NULL;
+	GLState_push(state);
+	GLState_enable_texture(state, tex_target);
+	GLState_bind_texture(state, tex_target, self->texture, 
+		self->tex_filter, self->tex_wrap);
 
 	Py_INCREF(Py_None);
 	return Py_None;
@@ -939,7 +1152,11 @@ FlipBookTex_set_state(FlipBookTexObject *self)
 static PyObject *
 FlipBookTex_restore_state(FlipBookTexObject *self)
 {
-	glPopAttrib();
+	GLState *state = GLState_get();
+
+	if (state == NULL)
+		return NULL;
+	GLState_pop(state);
 
 	Py_INCREF(Py_None);
 	return Py_None;
@@ -948,11 +1165,10 @@ FlipBookTex_restore_state(FlipBookTexObject *self)
 static FloatArrayObject *
 FlipBookTex_generate_tex_coords(FlipBookTexObject *self, GroupObject *pgroup)
 {
-	register unsigned long pcount;
-	register Particle *p;
-	int coord_count, loop, last_coord, frame = 0;
-	register float *ptex, *ttex;
-	float *tex_coords, total_time, duration, age, *times;
+	unsigned long pcount, i;
+	Particle *p;
+	int size, frame, next, c;
+	float *ptex, *ttex, *ntex, frac;
 
 	if (!GroupObject_Check(pgroup)) {
 		PyErr_SetString(PyExc_TypeError, "Expected ParticleGroup first argument");
@@ -970,119 +1186,34 @@ FlipBookTex_generate_tex_coords(FlipBookTexObject *self, GroupObject *pgroup)
 	}
 
 	ptex = self->tex_array->data;
-	tex_coords = self->tex_coords;
-	coord_count = self->coord_count;
-	last_coord = self->coord_count - 1;
-	times = self->frame_times;
-	loop = self->loop;
-	
-	if (self->dimension == 2) {
-		if (times == NULL) {
-			total_time = self->duration * last_coord;
-			duration = self->duration;
-			while (pcount--) {
-				if (p->age >= 0.0f) {
-					if (loop) {
-						frame = (int)(p->age / duration) % coord_count; 
-					} else {
-						frame = (int)(fminf(p->age, total_time) / duration);
-					}
-				} /* we don't care what the frame is for dead particles */ 
-				ttex = tex_coords + frame * 8;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				p++;
-			}
+	size = self->dimension * 4;
+	for (i = 0; i < pcount; i++, ptex += size) {
+		if (p[i].age < 0.0f) {
+			/* we don't care what the frame is for dead particles */ 
+			memcpy(ptex, self->tex_coords, sizeof(float) * size);
+			continue;
+		}
+		frame = FlipBookTex_frame(self, p[i].age, &frac);
+		ttex = self->tex_coords + frame * size;
+		next = frame + 1;
+		if (self->blend && frac > 0.0f && next < self->coord_count) {
+			/* Blend toward the next frame, the texture filtering 
+			   mixes the slices of a 3D texture between them. The last
+			   frame is not blended back to the first when looping, 
+			   since that would sweep through the slices between */
+			ntex = self->tex_coords + next * size;
+			for (c = 0; c < size; c++)
+				ptex[c] = ttex[c] + (ntex[c] - ttex[c]) * frac;
 		} else {
-			total_time = times[last_coord];
-			while (pcount--) {
-				if (p->age >= 0.0f) {
-					if (loop) {
-						age = fmodf(p->age, total_time);
-					} else {
-						age = p->age;
-					}
-					for (; frame < last_coord && age > times[frame]; frame++);
-					for (; frame > 0 && age <= times[frame - 1]; frame--);
-				} /* we don't care what the frame is for dead particles */ 
-				ttex = tex_coords + frame * 8;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				p++;
-			}
+			memcpy(ptex, ttex, sizeof(float) * size);
 		}
+	}
+	if (self->dimension == 2) {
 		if (self->adjust_width) {
 			adjust_particle_widths(pgroup, self->tex_array);
 		} else if (self->adjust_height) {
 			adjust_particle_heights(pgroup, self->tex_array);
 		}
-	} else { /* 3D texture coords */
-		if (times == NULL) {
-			total_time = self->duration * last_coord;
-			duration = self->duration;
-			while (pcount--) {
-				if (p->age >= 0.0f) {
-					if (loop) {
-						frame = (int)(p->age / duration) % coord_count; 
-					} else {
-						frame = (int)(fminf(p->age, total_time) / duration);
-					}
-				} /* we don't care what the frame is for dead particles */ 
-				ttex = tex_coords + frame * 12;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				p++;
-			}
-		} else {
-			total_time = times[last_coord];
-			while (pcount--) {
-				if (p->age >= 0.0f) {
-					if (loop) {
-						age = fmodf(p->age, total_time);
-					} else {
-						age = p->age;
-					}
-					for (; frame < last_coord && age > times[frame]; frame++);
-					for (; frame > 0 && age <= times[frame - 1]; frame--);
-				} /* we don't care what the frame is for dead particles */ 
-				ttex = tex_coords + frame * 12;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				*ptex++ = *ttex++;
-				p++;
-			}
-		}
 	}
 	Py_INCREF(self->tex_array);
 	return self->tex_array;
@@ -1093,6 +1224,9 @@ static PyMemberDef FlipBookTex_members[] = {
 	{"loop", T_INT, offsetof(FlipBookTexObject, loop), 0,
 		"If true the animation will loop continuously, if false it "
 		"stop at the last texture frame."},
+	{"blend", T_INT, offsetof(FlipBookTexObject, blend), READONLY,
+		"If true, the texture coordinates are interpolated between "
+		"each frame and the next by the time elapsed in the frame."},
 	{"tex_dimension", T_INT, offsetof(FlipBookTexObject, dimension), READONLY,
 		"The number of dimensions per texture coordinate"},
 	{"aspect_adjust_width", T_INT, offsetof(FlipBookTexObject, adjust_width), 0,
@@ -1135,7 +1269,7 @@ PyDoc_STRVAR(FlipBookTex__doc__,
 	"\"flipbook\" texture to a particle group according to each particle's age.\n\n"
 	"FlipBookTexturizer(texture, coords, duration, loop=True, dimension=2, "
 	"filter=GL_LINEAR, wrap=GL_CLAMP, "
-	"aspect_adjust_width=False, aspect_adjust_height=False)\n\n"
+	"aspect_adjust_width=False, aspect_adjust_height=False, blend=False)\n\n"
 	"texture -- OpenGL texture name, acquired via glGenTextures. It is up\n"
 	"to the application to load the texture's data before using the texturizer\n\n"
 	"coords -- A sequence of texture coordinate sets. Each set is used as one\n"
@@ -1160,7 +1294,13 @@ PyDoc_STRVAR(FlipBookTex__doc__,
 	"match particles to textures of various dimensions without distortion.\n"
 	"If one flag is set, the texturizer adjusts the width or height of the\n"
 	"particle size respectively as appropriate. Only one of these flags\n"
-	"may be set at one time.");
+	"may be set at one time.\n\n"
+	"blend -- If true, the texture coordinates of each particle are\n"
+	"interpolated from its frame toward the next by the fraction of the\n"
+	"frame's duration elapsed. Requires dimension 3: with the frames\n"
+	"stored as slices of a 3D texture filtered with GL_LINEAR, the\n"
+	"interpolated r coordinate blends adjacent frames smoothly. The last\n"
+	"frame is shown unblended, even when looping.");
 
 static PyTypeObject FlipBookTex_Type = {
 	/* The ob_type field must be initialized in the module init function
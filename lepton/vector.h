@@ -56,6 +56,32 @@ static inline float InvSqrt (float x) {
     return x;
 }
 
+/* Sine and cosine of a together by polynomial approximation, accurate
+ * to within about 1e-6 for angles of moderate magnitude. The angle is
+ * reduced to the quadrant around zero and the quadrant selects the sign
+ * and order of the results.
+ */
+static inline void FastSinCos(float a, float *s, float *c) {
+	float q, r, r2, ps, pc;
+	int quadrant;
+
+	q = floorf(a * 0.63661977f + 0.5f); /* a / (pi/2), rounded */
+	quadrant = (int)q & 3;
+	/* Subtract q * pi/2 in two parts to retain precision */
+	r = a - q * 1.5703125f - q * 4.8382679e-4f;
+	r2 = r * r;
+	ps = r * (1.0f + r2 * (-1.6666667e-1f + r2 * (8.3333333e-3f 
+		+ r2 * -1.9841270e-4f)));
+	pc = 1.0f + r2 * (-0.5f + r2 * (4.1666667e-2f + r2 * (-1.3888889e-3f
+		+ r2 * 2.4801587e-5f)));
+	switch (quadrant) {
+		case 0: *s = ps; *c = pc; break;
+		case 1: *s = pc; *c = -ps; break;
+		case 2: *s = -ps; *c = -pc; break;
+		default: *s = -pc; *c = ps; break;
+	}
+}
+
 #define clamp(n, min, max) \
 	((n) < (min) ? (min) : ((n) > (max) ? (max) : (n)))
 
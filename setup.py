@@ -13,7 +13,7 @@ if sys.platform.startswith('linux'):
 		'/usr/X11/include', '/usr/X11R6/include', 'glew/include']
 	library_dirs = ['/usr/lib', '/usr/local/lib', 
 		'/usr/X11/lib', '/usr/X11R6/lib']
-	libraries = ['GL', 'X11', 'Xext']
+	libraries = ['GL', 'X11', 'Xext', 'pthread']
 elif sys.platform == 'cygwin':
 	include_dirs = ['/usr/include', '/usr/include/win32api/', 'glew/include']
 	library_dirs = ['/usr/lib']
@@ -79,7 +79,7 @@ You can download binary releases or browse the source code at our Google code si
     packages=['lepton', 'lepton.examples'],
 	ext_modules=[
 		Extension('lepton.group', 
-			['lepton/group.c', 'lepton/groupmodule.c'], 
+			['lepton/group.c', 'lepton/groupmodule.c', 'lepton/parallel.c'], 
 			include_dirs=include_dirs,
 			library_dirs=library_dirs,
 			libraries=libraries,
@@ -90,7 +90,8 @@ You can download binary releases or browse the source code at our Google code si
 		Extension('lepton.renderer', 
 			['lepton/group.c', 'lepton/renderermodule.c',
 			 'lepton/controllermodule.c', 'lepton/groupmodule.c',
-			 'glew/src/glew.c'], 
+			 'lepton/parallel.c', 'lepton/grid.c', 'lepton/octree.c',
+			 'lepton/glstate.c', 'glew/src/glew.c'], 
 			include_dirs=include_dirs,
 			library_dirs=library_dirs,
 			libraries=libraries,
@@ -101,7 +102,8 @@ You can download binary releases or browse the source code at our Google code si
 		Extension('lepton._texturizer', 
 			['lepton/group.c', 'lepton/texturizermodule.c', 
 			 'lepton/renderermodule.c', 'lepton/controllermodule.c', 
-			 'lepton/groupmodule.c', 'glew/src/glew.c'], 
+			 'lepton/groupmodule.c', 'lepton/parallel.c', 'lepton/grid.c',
+			 'lepton/octree.c', 'lepton/glstate.c', 'glew/src/glew.c'], 
 			include_dirs=include_dirs,
 			library_dirs=library_dirs,
 			libraries=libraries,
@@ -111,7 +113,8 @@ You can download binary releases or browse the source code at our Google code si
 		),
 		Extension('lepton._controller', 
 			['lepton/group.c', 'lepton/groupmodule.c', 
-			 'lepton/controllermodule.c'], 
+			 'lepton/controllermodule.c', 'lepton/parallel.c', 'lepton/grid.c',
+			 'lepton/octree.c'], 
 			include_dirs=include_dirs,
 			library_dirs=library_dirs,
 			libraries=libraries,
@@ -121,7 +124,7 @@ You can download binary releases or browse the source code at our Google code si
 		),
 		Extension('lepton.emitter', 
 			['lepton/group.c', 'lepton/groupmodule.c',
-			 'lepton/fastrng.c', 'lepton/emittermodule.c'], 
+			 'lepton/fastrng.c', 'lepton/emittermodule.c', 'lepton/parallel.c'], 
 			include_dirs=include_dirs,
 			library_dirs=library_dirs,
 			libraries=libraries,
@@ -131,7 +134,7 @@ You can download binary releases or browse the source code at our Google code si
 		),
 		Extension('lepton._domain', 
 			['lepton/group.c', 'lepton/groupmodule.c',
-			 'lepton/fastrng.c', 'lepton/domainmodule.c'], 
+			 'lepton/fastrng.c', 'lepton/domainmodule.c', 'lepton/parallel.c'], 
 			include_dirs=include_dirs,
 			library_dirs=library_dirs,
 			libraries=libraries,
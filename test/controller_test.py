@@ -101,6 +101,40 @@ class ControllerTest(ControllerTestBase):
 		self.assertEqual(len(g), 2)
 		self.assertFloatEqiv(p[0].age, 0.0)
 		self.assertFloatEqiv(p[1].age, 0.75)
+
+	def test_Lifetime_controller_sub_emitter(self):
+		from lepton import controller, Particle, ParticleGroup
+		from lepton.emitter import StaticEmitter
+		g = ParticleGroup()
+		g.new(Particle(age=0, position=(1,2,3)))
+		g.new(Particle(age=1.0, position=(4,5,6), velocity=(1,0,0)))
+		g.update(0)
+		sparks = ParticleGroup()
+		emitter = StaticEmitter(template=Particle(velocity=(0,1,0)))
+		lifetime = controller.Lifetime(0.75, 
+			sub_emitter=emitter, sub_group=sparks, sub_count=3)
+		self.failUnless(lifetime.sub_emitter is emitter)
+		self.failUnless(lifetime.sub_group is sparks)
+		self.assertEqual(lifetime.sub_count, 3)
+		self.assertRaises((TypeError, AttributeError), setattr, lifetime, 'sub_count', -1)
+		lifetime(0, g)
+		sparks.update(0)
+		self.assertEqual(len(g), 1)
+		self.assertEqual(len(sparks), 3)
+		for p in sparks:
+			self.assertVector(p.position, (4, 5, 6))
+			self.assertVector(p.velocity, (1, 1, 0))
+		# Already dead particles do not burst again
+		lifetime(0, g)
+		sparks.update(0)
+		self.assertEqual(len(sparks), 3)
+
+	def test_Lifetime_controller_sub_emitter_not_analytic(self):
+		from lepton import controller, ParticleGroup
+		from lepton.emitter import StaticEmitter
+		self.assertRaises(TypeError, ParticleGroup, 
+			controllers=[controller.Lifetime(1, sub_emitter=StaticEmitter())], analytic=True)
+		self.assertRaises(TypeError, controller.Lifetime, 1, sub_emitter=object())
 	
 	def test_Movement_controller_simple(self):
 		from lepton import controller
@@ -114,6 +148,15 @@ class ControllerTest(ControllerTestBase):
 		self.assertVector(p[1].position, (0.2,0.2,0.2))
 		self.assertVector(p[2].position, (0.6,0.6,0.6))
 
+	def test_Movement_controller_bounds(self):
+		from lepton import controller
+		g = self._make_group()
+		self.assertEqual(g.aabb, ((0, 0, 0), (1, 1, 1)))
+		controller.Movement()(1, g)
+		self.assertEqual(g.aabb, ((-1, -1, -1), (1, 1, 1)))
+		controller.Movement()(1, g)
+		self.assertEqual(g.aabb, ((-3, -3, -3), (2, 2, 2)))
+
 	def test_Movement_controller_damping_scalar(self):
 		from lepton import controller
 		group = self._make_group()
@@ -242,6 +285,96 @@ class ControllerTest(ControllerTestBase):
 		p = list(group)
 		self.assertVector(p[0].position, (1, 1, 1))
 		self.assertEqual(killed_pos, [(0,0,0), (0,0,0)])
+
+	def test_Collector_controller_event_buffer(self):
+		from lepton import controller, Particle
+		import struct
+		group = self._make_group()
+		calls = []
+
+		def callback(events, pgroup, ctrl):
+			self.failUnless(pgroup is group, pgroup)
+			self.failUnless(ctrl is collector, ctrl)
+			calls.append(events)
+
+		collector = controller.Collector(DummyCubeDomain(size=0.5), 
+			callback=callback, event_buffer=True)
+		self.failUnless(collector.event_buffer)
+		collector(0, group)
+		self.assertEqual(len(group), 1)
+		self.assertEqual(len(calls), 1)
+		events = calls[0]
+		self.failUnless(isinstance(events, controller.EventBuffer))
+		self.assertEqual(len(events), 2)
+		self.assertEqual(events[0], (0, (0,0,0), (0,0,0), (0,0,0)))
+		self.assertEqual(events[1], (1, (0,0,0), (0,0,0), (1,1,1)))
+		self.assertRaises(IndexError, lambda: events[2])
+		data = str(buffer(events))
+		self.assertEqual(len(data), events.itemsize * 2)
+		self.assertEqual(struct.calcsize(events.format), events.itemsize)
+		self.assertEqual(struct.unpack_from(events.format, data, events.itemsize),
+			(1, 0, 0, 0, 0, 0, 0, 1, 1, 1))
+		self.assertEqual(memoryview(events).tobytes(), data)
+		# Nothing collected, no callback
+		collector(0, group)
+		self.assertEqual(len(calls), 1)
+		# Delivered events are not overwritten if kept
+		group.new(Particle((0,0,0), (2,2,2)))
+		group.update(0)
+		collector(0, group)
+		self.assertEqual(len(calls), 2)
+		self.failIf(calls[1] is events)
+		self.assertEqual(len(events), 2)
+		self.assertEqual(calls[1][0][3], (2,2,2))
+
+	def test_Collector_controller_sub_emitter(self):
+		from lepton import controller, Particle, ParticleGroup
+		from lepton.emitter import StaticEmitter
+		group = self._make_group()
+		sparks = ParticleGroup()
+		emitter = StaticEmitter(template=Particle(position=(0,0,1), velocity=(0,0,1)))
+		collector = controller.Collector(DummyCubeDomain(size=0.5), 
+			sub_emitter=emitter, sub_group=sparks, sub_count=3)
+		self.failUnless(collector.sub_emitter is emitter)
+		self.failUnless(collector.sub_group is sparks)
+		self.assertEqual(collector.sub_count, 3)
+		collector(0, group)
+		sparks.update(0)
+		self.assertEqual(len(group), 1)
+		self.assertEqual(len(sparks), 6)
+		p = list(sparks)
+		for particle in p:
+			self.assertVector(particle.position, (0, 0, 1))
+		for particle in p[:3]:
+			self.assertVector(particle.velocity, (0, 0, 1))
+		for particle in p[3:]:
+			self.assertVector(particle.velocity, (1, 1, 2))
+
+	def test_Collector_controller_sub_emitter_invalid(self):
+		from lepton import controller
+		from lepton.emitter import StaticEmitter
+		self.assertRaises(TypeError, controller.Collector, DummyCubeDomain(),
+			sub_emitter=object())
+		self.assertRaises(TypeError, controller.Collector, DummyCubeDomain(),
+			sub_emitter=StaticEmitter(), sub_group=object())
+		self.assertRaises(ValueError, controller.Collector, DummyCubeDomain(),
+			sub_emitter=StaticEmitter(), sub_count=-1)
+		callback = lambda *args: None
+		domain = DummyCubeDomain()
+		for i in range(1000):
+			self.assertRaises(TypeError, controller.Collector, domain,
+				callback=callback, sub_emitter=object())
+			self.assertRaises(TypeError, controller.Bounce, domain,
+				callback=callback, sub_emitter=object())
+			self.assertRaises(TypeError, controller.Collector, domain, callback, 
+				object())
+		self.failUnless(sys.getrefcount(domain) < 10, sys.getrefcount(domain))
+		self.failUnless(sys.getrefcount(callback) < 10, sys.getrefcount(callback))
+		collector = controller.Collector(domain, sub_emitter=StaticEmitter(), sub_count=2)
+		self.assertRaises((TypeError, AttributeError), setattr, collector, 'sub_count', -1)
+		self.assertEqual(collector.sub_count, 2)
+		bounce = controller.Bounce(domain, sub_emitter=StaticEmitter(), sub_count=2)
+		self.assertRaises((TypeError, AttributeError), setattr, bounce, 'sub_count', -1)
 	
 
 class BounceControllerTest(ControllerTestBase):
@@ -277,6 +410,15 @@ class BounceControllerTest(ControllerTestBase):
 		self.assertVector(p[3].position, (1, 2, 1))
 		self.assertVector(p[3].velocity, (0, 1, 0))
 
+	def test_Bounce_controller_bounds(self):
+		from lepton import controller
+		group = self._make_group()
+		controller.Bounce(DummyPlaneDomain())(0, group)
+		low, high = group.aabb
+		for p in group:
+			for i in range(3):
+				self.failUnless(low[i] <= p.position[i] <= high[i], (p, group.aabb))
+
 	def test_Bounce_controller_low_bounce(self):
 		from lepton import controller
 		group = self._make_group()
@@ -346,6 +488,359 @@ class BounceControllerTest(ControllerTestBase):
 			self.failUnless(cbcontroller is bounce, cbcontroller)
 			self.assertEqual(cbpoint[1], 0)
 
+	def test_Bounce_controller_event_buffer(self):
+		from lepton import controller
+		import struct
+		group = self._make_group()
+		calls = []
+
+		def callback(*args):
+			calls.append(args)
+
+		bounce = controller.Bounce(DummyPlaneDomain(), callback=callback, event_buffer=True)
+		bounce(0, group)
+		self.assertEqual(len(calls), 1)
+		events, cbgroup, cbcontroller = calls[0]
+		self.failUnless(cbgroup is group, cbgroup)
+		self.failUnless(cbcontroller is bounce, cbcontroller)
+		p = list(group)
+		self.assertEqual(len(events), 3)
+		for (index, point, normal, velocity), particle in zip(events, p):
+			self.assertEqual(point[1], 0)
+			self.assertVector(particle.velocity, velocity)
+		self.assertEqual([e[0] for e in events], [0, 1, 2])
+		self.assertEqual([e[2] for e in events], [(0, 1, 0), (0, 1, 0), (0, -1, 0)])
+		fields = struct.unpack_from(events.format, str(buffer(events)), events.itemsize * 2)
+		self.assertEqual(fields[0], 2)
+		self.assertEqual(fields[7:], (2, -2, 0))
+
+	def test_Bounce_controller_sub_emitter(self):
+		from lepton import controller, Particle
+		from lepton.emitter import StaticEmitter
+		group = self._make_group()
+		callback_args = []
+		bounce = controller.Bounce(DummyPlaneDomain(), 
+			callback=lambda *args: callback_args.append(args),
+			sub_emitter=StaticEmitter(template=Particle(velocity=(0,0,-1))), sub_count=2)
+		self.failUnless(bounce.sub_group is None)
+		bounce(0, group)
+		# Per particle callbacks are still made with a sub-emitter
+		self.assertEqual(len(callback_args), 3)
+		group.update(0)
+		self.assertEqual(len(group), 10)
+		spawned = list(group)[4:]
+		self.assertEqual([tuple(p.velocity) for p in spawned], 
+			[(0, 1, -1)] * 2 + [(0, 1.5, -1)] * 2 + [(2, -2, -1)] * 2)
+		for p in spawned:
+			self.assertEqual(p.position.y, 0)
+
+
+class CollisionControllerTest(ControllerTestBase):
+
+	def _make_group(self):
+		from lepton import Particle, ParticleGroup
+		g = ParticleGroup()
+		g.new(Particle(position=(-0.4, 0, 0), velocity=(1, 0, 0), size=(1, 1, 1), mass=1))
+		g.new(Particle(position=(0.4, 0, 0), velocity=(-1, 0, 0), size=(1, 1, 1), mass=1))
+		g.new(Particle(position=(5, 0, 0), velocity=(0, 1, 0), size=(1, 1, 1), mass=1))
+		g.update(0)
+		return g
+
+	def test_Collision_controller_defaults(self):
+		from lepton import controller
+		group = self._make_group()
+		collision = controller.Collision()
+		self.assertEqual(collision.bounce, 1.0)
+		self.failUnless(collision.other_group is None)
+		collision(0, group)
+		p = list(group)
+		self.assertVector(p[0].position, (-0.5, 0, 0))
+		self.assertVector(p[0].velocity, (-1, 0, 0))
+		self.assertVector(p[1].position, (0.5, 0, 0))
+		self.assertVector(p[1].velocity, (1, 0, 0))
+		self.assertVector(p[2].position, (5, 0, 0))
+		self.assertVector(p[2].velocity, (0, 1, 0))
+
+	def test_Collision_controller_bounds(self):
+		from lepton import controller
+		group = self._make_group()
+		controller.Collision()(0, group)
+		low, high = group.aabb
+		self.assertFloatEqiv(low[0], -0.5)
+		self.assertFloatEqiv(high[0], 5)
+
+	def test_Collision_controller_inelastic(self):
+		from lepton import controller
+		group = self._make_group()
+		controller.Collision(bounce=0)(0, group)
+		p = list(group)
+		self.assertVector(p[0].velocity, (0, 0, 0))
+		self.assertVector(p[1].velocity, (0, 0, 0))
+
+	def test_Collision_controller_mass(self):
+		from lepton import controller
+		group = self._make_group()
+		p = list(group)
+		p[1].mass = 3
+		controller.Collision()(0, group)
+		p = list(group)
+		# The heavier particle gets a quarter of the response
+		self.assertVector(p[0].position, (-0.55, 0, 0))
+		self.assertVector(p[0].velocity, (-2, 0, 0))
+		self.assertVector(p[1].position, (0.45, 0, 0))
+		self.assertVector(p[1].velocity, (0, 0, 0))
+
+	def test_Collision_controller_separating(self):
+		from lepton import controller
+		group = self._make_group()
+		p = list(group)
+		p[0].velocity = (-1, 0, 0)
+		p[1].velocity = (1, 0, 0)
+		controller.Collision()(0, group)
+		p = list(group)
+		# Overlap is resolved, but the velocities are left alone
+		self.assertVector(p[0].position, (-0.5, 0, 0))
+		self.assertVector(p[0].velocity, (-1, 0, 0))
+		self.assertVector(p[1].position, (0.5, 0, 0))
+		self.assertVector(p[1].velocity, (1, 0, 0))
+
+	def test_Collision_controller_other_group(self):
+		from lepton import controller, Particle, ParticleGroup
+		group = self._make_group()
+		other = ParticleGroup()
+		other.new(Particle(position=(5, 0.8, 0), velocity=(0, -1, 0), size=(1, 1, 1), mass=1))
+		other.update(0)
+		collision = controller.Collision(other_group=other)
+		self.failUnless(collision.other_group is other)
+		collision(0, group)
+		p = list(group)
+		# The group particles no longer collide with each other
+		self.assertVector(p[0].velocity, (1, 0, 0))
+		self.assertVector(p[1].velocity, (-1, 0, 0))
+		self.assertVector(p[2].position, (5, -0.1, 0))
+		self.assertVector(p[2].velocity, (0, -1, 0))
+		# Only the group being updated is affected
+		o = list(other)
+		self.assertVector(o[0].position, (5, 0.8, 0))
+		self.assertVector(o[0].velocity, (0, -1, 0))
+
+	def test_Collision_controller_many(self):
+		import random
+		from lepton import controller, Particle, ParticleGroup
+		rand = random.Random(1)
+		group = ParticleGroup()
+		for i in range(5000):
+			group.new(Particle(
+				position=(rand.uniform(-10, 10), rand.uniform(-10, 10), rand.uniform(-10, 10)),
+				velocity=(rand.uniform(-1, 1), rand.uniform(-1, 1), rand.uniform(-1, 1)),
+				size=(0.5, 0.5, 0.5), mass=rand.uniform(1, 2)))
+		group.update(0)
+		def momentum():
+			mx = my = mz = 0.0
+			for p in group:
+				mx += p.velocity.x * p.mass
+				my += p.velocity.y * p.mass
+				mz += p.velocity.z * p.mass
+			return mx, my, mz
+		before = momentum()
+		controller.Collision()(0, group)
+		after = momentum()
+		for b, a in zip(before, after):
+			self.failUnless(abs(b - a) < 0.01, (before, after))
+
+	def test_Collision_controller_invalid_args(self):
+		from lepton import controller
+		self.assertRaises(TypeError, controller.Collision, other_group=object())
+
+
+class FlockControllerTest(ControllerTestBase):
+
+	def _make_group(self):
+		from lepton import Particle, ParticleGroup
+		g = ParticleGroup()
+		g.new(Particle(position=(0, 0, 0), velocity=(0, 0, 0)))
+		g.new(Particle(position=(1, 0, 0), velocity=(0, 2, 0)))
+		g.new(Particle(position=(10, 0, 0), velocity=(0, 0, 1)))
+		g.update(0)
+		return g
+
+	def test_Flock_controller_defaults(self):
+		from lepton import controller
+		flock = controller.Flock(2.0)
+		self.assertEqual(flock.radius, 2.0)
+		self.assertEqual(flock.separation, 1.0)
+		self.assertEqual(flock.alignment, 1.0)
+		self.assertEqual(flock.cohesion, 1.0)
+		self.assertEqual(flock.max_neighbors, 16)
+
+	def test_Flock_controller_cohesion(self):
+		from lepton import controller
+		group = self._make_group()
+		controller.Flock(2.0, separation=0, alignment=0, cohesion=2.0)(0.5, group)
+		p = list(group)
+		self.assertVector(p[0].velocity, (1, 0, 0))
+		self.assertVector(p[1].velocity, (-1, 2, 0))
+		# Too far away to be affected
+		self.assertVector(p[2].velocity, (0, 0, 1))
+		# Positions are not changed
+		self.assertVector(p[0].position, (0, 0, 0))
+		self.assertVector(p[1].position, (1, 0, 0))
+
+	def test_Flock_controller_alignment(self):
+		from lepton import controller
+		group = self._make_group()
+		controller.Flock(2.0, separation=0, alignment=0.5, cohesion=0)(1.0, group)
+		p = list(group)
+		self.assertVector(p[0].velocity, (0, 1, 0))
+		self.assertVector(p[1].velocity, (0, 1, 0))
+		self.assertVector(p[2].velocity, (0, 0, 1))
+
+	def test_Flock_controller_separation(self):
+		from lepton import controller
+		group = self._make_group()
+		controller.Flock(2.0, separation=1.0, alignment=0, cohesion=0)(1.0, group)
+		p = list(group)
+		self.assertVector(p[0].velocity, (-0.5, 0, 0))
+		self.assertVector(p[1].velocity, (0.5, 2, 0))
+		self.assertVector(p[2].velocity, (0, 0, 1))
+
+	def test_Flock_controller_max_neighbors(self):
+		from lepton import controller, Particle, ParticleGroup
+		group = ParticleGroup()
+		for i in range(10):
+			group.new(Particle(position=(i * 0.1, 0, 0)))
+		group.update(0)
+		controller.Flock(5.0, separation=0, alignment=0, cohesion=1.0, 
+			max_neighbors=1)(1.0, group)
+		for p in group:
+			# Each particle moves toward one neighbor only
+			self.failUnless(abs(p.velocity.x) <= 0.9 + 0.00001, p.velocity)
+			self.failIf(p.velocity.x == 0, p.velocity)
+
+	def test_Flock_controller_invalid_args(self):
+		from lepton import controller
+		self.assertRaises(ValueError, controller.Flock, 0)
+		self.assertRaises(TypeError, controller.Flock)
+
+
+class NBodyControllerTest(ControllerTestBase):
+
+	def test_NBody_controller_defaults(self):
+		from lepton import controller
+		nbody = controller.NBody()
+		self.assertEqual(nbody.G, 1.0)
+		self.assertEqual(nbody.theta, 0.5)
+		self.failUnless(nbody.epsilon > 0)
+		self.assertRaises(ValueError, controller.NBody, theta=-1)
+
+	def test_NBody_controller_pair(self):
+		from lepton import controller, Particle, ParticleGroup
+		group = ParticleGroup()
+		group.new(Particle(position=(0, 0, 0), mass=1))
+		group.new(Particle(position=(2, 0, 0), mass=3))
+		group.update(0)
+		controller.NBody(G=2.0, epsilon=0)(0.5, group)
+		p = list(group)
+		self.assertVector(p[0].velocity, (0.75, 0, 0))
+		self.assertVector(p[1].velocity, (-0.25, 0, 0))
+		self.assertVector(p[0].position, (0, 0, 0))
+		self.assertVector(p[1].position, (2, 0, 0))
+
+	def _brute_force(self, group, G, epsilon):
+		particles = list(group)
+		result = []
+		for p in particles:
+			ax = ay = az = 0.0
+			for q in particles:
+				if q is p:
+					continue
+				dx = q.position.x - p.position.x
+				dy = q.position.y - p.position.y
+				dz = q.position.z - p.position.z
+				d2 = dx*dx + dy*dy + dz*dz + epsilon**2
+				f = q.mass / (d2 * math.sqrt(d2))
+				ax += dx * f
+				ay += dy * f
+				az += dz * f
+			result.append((ax * G, ay * G, az * G))
+		return result
+
+	def _make_random_group(self, count):
+		import random
+		from lepton import Particle, ParticleGroup
+		rand = random.Random(42)
+		group = ParticleGroup()
+		for i in range(count):
+			group.new(Particle(
+				position=(rand.gauss(0, 5), rand.gauss(0, 5), rand.gauss(0, 5)),
+				mass=rand.uniform(0.5, 2)))
+		group.update(0)
+		return group
+
+	def test_NBody_controller_exact(self):
+		from lepton import controller
+		group = self._make_random_group(300)
+		expected = self._brute_force(group, 1.0, 0.1)
+		controller.NBody(theta=0, epsilon=0.1)(1.0, group)
+		for p, accel in zip(group, expected):
+			self.assertVector(p.velocity, accel, tolerance=0.0001)
+
+	def test_NBody_controller_approximate(self):
+		from lepton import controller
+		group = self._make_random_group(300)
+		expected = self._brute_force(group, 1.0, 0.1)
+		controller.NBody(theta=0.5, epsilon=0.1)(1.0, group)
+		error = total = 0.0
+		for p, (ax, ay, az) in zip(group, expected):
+			error += math.sqrt((p.velocity.x - ax)**2 
+				+ (p.velocity.y - ay)**2 + (p.velocity.z - az)**2)
+			total += math.sqrt(ax**2 + ay**2 + az**2)
+		self.failUnless(error / total < 0.05, error / total)
+
+	def test_NBody_controller_coincident(self):
+		from lepton import controller, Particle, ParticleGroup
+		group = ParticleGroup()
+		for i in range(10):
+			group.new(Particle(position=(1, 1, 1), mass=1))
+		group.new(Particle(position=(-1, 1, 1), mass=1))
+		group.update(0)
+		controller.NBody(epsilon=0)(1.0, group)
+		p = list(group)
+		self.assertVector(p[-1].velocity, (2.5, 0, 0))
+
+
+class ClumperControllerTest(ControllerTestBase):
+
+	def test_Clumper_controller(self):
+		from lepton import controller, Particle, ParticleGroup
+		group = ParticleGroup()
+		group.new(Particle(position=(-2, 0, 0)))
+		group.new(Particle(position=(2, 0, 0)))
+		group.new(Particle(position=(0, 3, 0), velocity=(0, -3, 0)))
+		group.new(Particle(position=(0, -3, 0)))
+		group.update(0)
+		clumper = controller.Clumper(2)
+		self.assertEqual(clumper.magnitude, 2)
+		clumper(0.5, group)
+		p = list(group)
+		self.assertVector(p[0].velocity, (1, 0, 0))
+		self.assertVector(p[1].velocity, (-1, 0, 0))
+		# Already headed to the center next frame, no acceleration
+		self.assertVector(p[2].velocity, (0, -3, 0))
+		self.assertVector(p[3].velocity, (0, 1, 0))
+		self.assertVector(p[0].position, (-2, 0, 0))
+
+	def test_Clumper_controller_repel(self):
+		from lepton import controller, Particle, ParticleGroup
+		group = ParticleGroup()
+		group.new(Particle(position=(0, -1, 0)))
+		group.new(Particle(position=(0, 1, 0)))
+		group.update(0)
+		controller.Clumper(-1)(1.0, group)
+		p = list(group)
+		self.assertVector(p[0].velocity, (0, -1, 0))
+		self.assertVector(p[1].velocity, (0, 1, 0))
+
 
 class MagnetControllerTest(ControllerTestBase):
 
@@ -236,6 +236,39 @@ class PerParticleEmitterTest(EmitterTestBase, unittest.TestCase):
 		emitter = PerParticleEmitter(source_group)
 		self.failUnless(emitter.source_group is source_group)
 
+	def test_PerParticleEmitter_source_group_ref(self):
+		from lepton.emitter import PerParticleEmitter
+		from lepton import ParticleGroup
+		source_group = ParticleGroup()
+		source_group.new(object())
+		source_group.update(0)
+		refs = sys.getrefcount(source_group)
+		emitter = PerParticleEmitter(source_group)
+		self.assertEqual(sys.getrefcount(source_group), refs + 1)
+		PerParticleEmitter.__init__(emitter, source_group)
+		self.assertEqual(sys.getrefcount(source_group), refs + 1)
+		PerParticleEmitter.__init__(emitter, ParticleGroup())
+		self.assertEqual(sys.getrefcount(source_group), refs)
+		# The emitter keeps the source group alive
+		emitter = PerParticleEmitter(self._make_source())
+		group = ParticleGroup()
+		emitter.emit(2, group)
+		group.update(0)
+		self.assertEqual(len(group), 2)
+		emitter.source_group = None
+		emitter.rate = 10
+		self.assertRaises(TypeError, emitter.emit, 1, group)
+		self.assertRaises(TypeError, emitter, 1, group)
+		emitter.source_group = source_group
+		emitter.emit(1, group)
+
+	def _make_source(self):
+		from lepton import ParticleGroup
+		source_group = ParticleGroup()
+		source_group.new(object())
+		source_group.update(0)
+		return source_group
+
 	def test_PerParticleEmitter_invalid_rate(self):
 		from lepton import Particle, ParticleGroup
 		from lepton.emitter import PerParticleEmitter
@@ -291,6 +324,30 @@ class PerParticleEmitterTest(EmitterTestBase, unittest.TestCase):
 		self.assertEqual(len(group), expected)
 
 
+	def test_PerParticleEmitter_analytic_source(self):
+		from lepton import ParticleGroup, controller
+		from lepton.emitter import PerParticleEmitter
+
+		source_group = ParticleGroup(controllers=[controller.Movement()], 
+			analytic=True)
+		source_group.new(position=(1, 0, 0), velocity=(1, 2, 0))
+		source_group.update(0)
+		source_group.update(2)
+		# Particles spawn from the evaluated state, not the birth state
+		group = ParticleGroup()
+		PerParticleEmitter(source_group).emit(2, group)
+		self.assertEqual(PerParticleEmitter(source_group, rate=1)(1, group), 1)
+		group.update(0)
+		self.assertEqual(len(group), 3)
+		for particle in group:
+			self.assertVector(particle.position, (3, 4, 0))
+		# Spawning from a source that is being drawn does not wait for it
+		drawn = source_group.begin_draw()
+		PerParticleEmitter(source_group).emit(1, group)
+		drawn.end_draw()
+		group.update(0)
+		self.assertEqual(len(group), 4)
+
 	def test_PerParticleEmitter_emit_empty_source(self):
 		from lepton import ParticleGroup
 		from lepton.emitter import PerParticleEmitter
@@ -346,5 +403,216 @@ class PerParticleEmitterTest(EmitterTestBase, unittest.TestCase):
 		group.update(0)
 		self.assertEqual(len(group), len(source_group))
 
+	def test_PerParticleEmitter_emit_many(self):
+		from lepton import Particle, ParticleGroup
+		from lepton.emitter import PerParticleEmitter
+
+		source_group = ParticleGroup()
+		for i in range(20000):
+			source_group.new(Particle(position=(i, 0, 0)))
+		source_group.update(0)
+		# Dead source particles emit nothing
+		for i, p in enumerate(source_group):
+			if i % 3 == 0:
+				source_group.kill(p)
+		live = [i for i in range(20000) if i % 3]
+
+		emitter = PerParticleEmitter(source_group, 
+			template=Particle(velocity=(0, 1, 0), color=(1, 0, 0, 1), age=1))
+		group = ParticleGroup()
+		emitter.emit(3, group)
+		group.update(0)
+		self.assertEqual(len(group), 3 * len(live))
+		particles = list(group)
+		for j, i in enumerate(live):
+			for particle in particles[j * 3:j * 3 + 3]:
+				self.assertVector(particle.position, (i, 0, 0))
+				self.assertVector(particle.velocity, (0, 1, 0))
+				self.assertColor(particle.color, (1, 0, 0, 1))
+				self.assertEqual(particle.age, 1)
+
+		self.assertEqual(emitter(0, group), 0)
+		emitter.rate = 2.5
+		self.assertEqual(emitter(1, group), 2 * len(live))
+		self.assertEqual(emitter(0.2, group), 1 * len(live))
+		group.update(0)
+		self.assertEqual(len(group), 6 * len(live))
+
+	def test_PerParticleEmitter_deviation_many(self):
+		from lepton import Particle, ParticleGroup
+		from lepton.emitter import PerParticleEmitter
+
+		source_group = ParticleGroup()
+		for i in range(10000):
+			source_group.new(Particle(position=(0, 0, 0)))
+		source_group.update(0)
+		emitter = PerParticleEmitter(source_group, 
+			template=Particle(velocity=(0, 10, 0)),
+			deviation=Particle(velocity=(1, 2, 0), age=1))
+		group = ParticleGroup()
+		emitter.emit(2, group)
+		group.update(0)
+		self.assertEqual(len(group), 20000)
+		n = float(len(group))
+		mean = [sum(p.velocity[i] for p in group) / n for i in range(3)]
+		dev = [math.sqrt(sum((p.velocity[i] - mean[i])**2 for p in group) / n)
+			for i in range(3)]
+		self.assertVector(mean, (0, 10, 0), tolerance=0.1)
+		self.assertVector(dev, (1, 2, 0), tolerance=0.1)
+		self.failUnless(min(p.age for p in group) >= 0)
+		# Each particle is randomized independently of the others
+		self.failUnless(len(set(p.velocity.x for p in group)) > len(group) * 0.99)
+
+
+class TrailEmitterTest(EmitterTestBase, unittest.TestCase):
+
+	def _make_source(self, count=1):
+		from lepton import Particle, ParticleGroup
+		source_group = ParticleGroup()
+		for i in range(count):
+			source_group.new(Particle(position=(0, i, 0), velocity=(10, 0, 0), 
+				color=(1, 0, 0, 1)))
+		source_group.update(0)
+		for p in source_group:
+			p.position = (10, p.position.y, 0)
+			p.velocity = (20, 0, 0)
+		return source_group
+
+	def test_TrailEmitter_emit(self):
+		from lepton import Particle, ParticleGroup
+		from lepton.emitter import TrailEmitter
+
+		emitter = TrailEmitter(self._make_source(), template=Particle(velocity=(0, 1, 0)))
+		group = ParticleGroup()
+		emitter.emit(5, group)
+		group.update(0)
+		self.assertEqual(len(group), 5)
+		for particle, x in zip(group, (2, 4, 6, 8, 10)):
+			self.assertVector(particle.position, (x, 0, 0))
+			self.assertVector(particle.velocity, (0, 1, 0))
+			self.assertEqual(particle.age, 0)
+
+	def test_TrailEmitter_rate(self):
+		from lepton import ParticleGroup
+		from lepton.emitter import TrailEmitter
+
+		emitter = TrailEmitter(self._make_source(2), rate=4)
+		self.assertEqual(emitter.rate, 4)
+		group = ParticleGroup()
+		self.assertEqual(emitter(1, group), 8)
+		group.update(0)
+		particles = list(group)
+		for particle, x, age in zip(particles, (2.5, 5, 7.5, 10), (0.75, 0.5, 0.25, 0)):
+			self.assertVector(particle.position, (x, 0, 0))
+			self.assertAlmostEqual(particle.age, age, 5)
+		self.assertVector(particles[4].position, (2.5, 1, 0))
+
+	def test_TrailEmitter_density(self):
+		from lepton import ParticleGroup
+		from lepton.emitter import TrailEmitter
+
+		emitter = TrailEmitter(self._make_source(), density=0.5)
+		self.assertEqual(emitter.density, 0.5)
+		group = ParticleGroup()
+		self.assertEqual(emitter(0, group), 5)
+		group.update(0)
+		self.assertEqual([p.position.x for p in group], [2, 4, 6, 8, 10])
+
+	def test_TrailEmitter_fractional_rate(self):
+		from lepton import ParticleGroup
+		from lepton.emitter import TrailEmitter
+
+		emitter = TrailEmitter(self._make_source(5000), rate=0.5)
+		group = ParticleGroup()
+		count = emitter(1, group)
+		self.failUnless(2250 < count < 2750, count)
+		group.update(0)
+		self.assertEqual(len(group), count)
+		for p in group:
+			self.assertVector(p.position, (10, p.position.y, 0))
+
+	def test_TrailEmitter_inherit(self):
+		from lepton import Particle, ParticleGroup
+		from lepton.emitter import TrailEmitter
+
+		emitter = TrailEmitter(self._make_source(), 
+			template=Particle(velocity=(0, 1, 0), color=(0, 0, 0.5, 0)),
+			inherit_velocity=0.5, inherit_color=True)
+		self.assertEqual(emitter.inherit_velocity, 0.5)
+		self.failUnless(emitter.inherit_color)
+		group = ParticleGroup()
+		emitter.emit(2, group)
+		group.update(0)
+		p = list(group)
+		self.assertVector(p[0].velocity, (7.5, 1, 0))
+		self.assertVector(p[1].velocity, (10, 1, 0))
+		for particle in p:
+			self.assertColor(particle.color, (1, 0, 0, 1))
+
+	def test_TrailEmitter_analytic_source(self):
+		from lepton import ParticleGroup, controller
+		from lepton.emitter import TrailEmitter
+
+		source_group = ParticleGroup(controllers=[controller.Movement()], 
+			analytic=True)
+		source_group.new(velocity=(10, 0, 0))
+		source_group.update(0)
+		source_group.update(1)
+		emitter = TrailEmitter(source_group)
+		group = ParticleGroup()
+		drawn = source_group.begin_draw()
+		emitter.emit(5, group)
+		drawn.end_draw()
+		group.update(0)
+		self.assertEqual([p.position.x for p in group], [2, 4, 6, 8, 10])
+
+	def test_TrailEmitter_empty_source(self):
+		from lepton import ParticleGroup
+		from lepton.emitter import TrailEmitter
+
+		emitter = TrailEmitter(ParticleGroup(), rate=10, density=10)
+		group = ParticleGroup()
+		self.assertEqual(emitter(1, group), 0)
+		emitter.emit(10, group)
+		group.update(0)
+		self.assertEqual(len(group), 0)
+
+	def test_TrailEmitter_source_group_ref(self):
+		from lepton import ParticleGroup
+		from lepton.emitter import TrailEmitter
+
+		source_group = self._make_source()
+		refs = sys.getrefcount(source_group)
+		emitter = TrailEmitter(source_group)
+		self.assertEqual(sys.getrefcount(source_group), refs + 1)
+		TrailEmitter.__init__(emitter, source_group)
+		self.assertEqual(sys.getrefcount(source_group), refs + 1)
+		other = ParticleGroup()
+		TrailEmitter.__init__(emitter, other)
+		self.assertEqual(sys.getrefcount(source_group), refs)
+		self.failUnless(emitter.source_group is other)
+		del other
+		# The emitter keeps the source group alive
+		emitter = TrailEmitter(self._make_source())
+		group = ParticleGroup()
+		emitter.emit(5, group)
+		self.assertEqual(len(emitter.source_group), 1)
+		del emitter
+		emitter = TrailEmitter(source_group)
+		emitter.source_group = None
+		self.assertRaises(TypeError, emitter.emit, 1, group)
+		self.assertRaises(TypeError, emitter, 1, group)
+		emitter.source_group = source_group
+		emitter.emit(1, group)
+
+	def test_TrailEmitter_invalid(self):
+		from lepton import ParticleGroup
+		from lepton.emitter import TrailEmitter
+
+		self.assertRaises(ValueError, TrailEmitter, ParticleGroup(), rate=-1)
+		self.assertRaises(ValueError, TrailEmitter, ParticleGroup(), density=-1)
+		self.assertRaises(TypeError, TrailEmitter, ParticleGroup(), velocity=[(0,0,0)])
+		self.assertRaises(TypeError, TrailEmitter, object())
+
 if __name__ == '__main__':
 	unittest.main()
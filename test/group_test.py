@@ -369,6 +369,114 @@ class GroupTest(unittest.TestCase):
 		self.failUnless(ctrl2.group is group)
 		self.assertAlmostEqual(ctrl2.time_delta, 0.33)
 			
+	def _make_reduction_group(self):
+		from lepton import ParticleGroup, Particle
+		group = ParticleGroup()
+		group.new(Particle(position=(1, 2, 3), velocity=(1, 0, 0), age=1, mass=2))
+		group.new(Particle(position=(-1, 4, 0), velocity=(0, 2, 0), age=3, mass=0))
+		doomed = group.new(Particle(position=(100, 100, 100), age=10))
+		group.new(Particle(position=(3, 0, 3), velocity=(0, 0, 0), age=2, mass=1))
+		group.update(0)
+		for p in group:
+			if p.age == 10:
+				group.kill(p)
+		return group
+
+	def assertTuple(self, t, expected):
+		self.assertEqual(len(t), len(expected))
+		for v, e in zip(t, expected):
+			self.assertAlmostEqual(v, e, 5)
+
+	def test_centroid(self):
+		from lepton import ParticleGroup
+		group = self._make_reduction_group()
+		self.assertTuple(group.centroid(), (1, 2, 2))
+		self.assertEqual(ParticleGroup().centroid(), None)
+
+	def test_bounds(self):
+		from lepton import ParticleGroup
+		group = self._make_reduction_group()
+		low, high = group.bounds()
+		self.assertTuple(low, (-1, 0, 0))
+		self.assertTuple(high, (3, 4, 3))
+		self.assertEqual(ParticleGroup().bounds(), None)
+
+	def test_reductions(self):
+		from lepton import ParticleGroup
+		group = self._make_reduction_group()
+		self.assertTuple(group.mean('velocity'), (1.0/3, 2.0/3, 0))
+		self.assertTuple(group.sum('position'), (3, 6, 6))
+		self.assertAlmostEqual(group.mean('age'), 2)
+		self.assertAlmostEqual(group.sum('mass'), 3)
+		self.assertAlmostEqual(group.min('age'), 1)
+		self.assertAlmostEqual(group.max('age'), 3)
+		self.assertTuple(group.min('position'), (-1, 0, 0))
+		self.assertTuple(group.max('color'), (0, 0, 0, 0))
+		self.assertRaises(ValueError, group.mean, 'foobar')
+		self.assertRaises(TypeError, group.sum)
+		empty = ParticleGroup()
+		self.assertEqual(empty.mean('age'), None)
+		self.assertEqual(empty.min('age'), None)
+		self.assertEqual(empty.max('velocity'), None)
+		self.assertAlmostEqual(empty.sum('age'), 0)
+
+	def test_kinetic_energy(self):
+		from lepton import ParticleGroup
+		group = self._make_reduction_group()
+		# Particles with zero mass count as unit mass
+		self.assertAlmostEqual(group.kinetic_energy(), 3)
+		self.assertAlmostEqual(ParticleGroup().kinetic_energy(), 0)
+
+	def test_large_reductions(self):
+		from lepton import ParticleGroup
+		count = 50000
+		group = ParticleGroup()
+		p = TestParticle()
+		for i in xrange(count):
+			p.age = i
+			p.position = (i, -i, 1)
+			group.new(p)
+		group.update(0)
+		self.assertAlmostEqual(group.min('age'), 0)
+		self.assertAlmostEqual(group.max('age'), count - 1)
+		self.assertAlmostEqual(group.mean('age'), (count - 1) / 2.0)
+		self.assertTuple(group.centroid(), ((count - 1) / 2.0, -(count - 1) / 2.0, 1))
+
+	def test_aabb(self):
+		from lepton import ParticleGroup
+		group = self._make_reduction_group()
+		group.update(0) # Remove killed particle from bounds
+		low, high = group.aabb
+		self.assertTuple(low, (-1, 0, 0))
+		self.assertTuple(high, (3, 4, 3))
+		self.assertEqual(ParticleGroup().aabb, None)
+		self.assertEqual(ParticleGroup().bounding_sphere, None)
+
+	def test_aabb_tracks_changes(self):
+		group = self._make_reduction_group()
+		group.update(0)
+		p = list(group)
+		p[0].position = (10, 2, 3)
+		self.assertTuple(group.aabb[1], (10, 4, 3))
+		p[1].position.z = -5
+		self.assertTuple(group.aabb[0], (-1, 0, -5))
+		# Bounds are conservative, killing does not shrink them until update
+		group.kill(p[0])
+		self.assertTuple(group.aabb[1], (10, 4, 3))
+		group.update(0)
+		self.assertTuple(group.aabb[0], (-1, 0, -5))
+		self.assertTuple(group.aabb[1], (3, 4, 3))
+
+	def test_bounding_sphere(self):
+		group = self._make_reduction_group()
+		group.update(0)
+		center, radius = group.bounding_sphere
+		self.assertTuple(center, (1, 2, 1.5))
+		self.assertAlmostEqual(radius, (2**2 + 2**2 + 1.5**2)**0.5, 5)
+		for p in group:
+			d = sum((a - b)**2 for a, b in zip(p.position, center))**0.5
+			self.failUnless(d <= radius, (p, center, radius))
+
 	def test_draw(self):
 		group, particles = self.test_new_particle()
 		renderer = TestRenderer()
@@ -379,6 +487,295 @@ class GroupTest(unittest.TestCase):
 		self.assertTrue(renderer.drawn)
 		self.failUnless(renderer.group is group)
 
+	def _analytic_controllers(self):
+		from lepton import controller
+		return [controller.Movement(), controller.Growth(2),
+			controller.Fader(fade_in_end=1.0, max_alpha=0.5),
+			controller.Lifetime(2.0)]
+
+	def test_analytic(self):
+		from lepton import ParticleGroup
+		analytic = ParticleGroup(controllers=self._analytic_controllers(), 
+			analytic=True)
+		simulated = ParticleGroup(controllers=self._analytic_controllers())
+		self.failUnless(analytic.analytic)
+		self.failIf(simulated.analytic)
+		for group in analytic, simulated:
+			group.new(position=(1, 0, 0), velocity=(1, 2, 0), size=(1, 1, 1),
+				color=(1, 1, 1, 1))
+		for i in range(2):
+			analytic.update(0.25)
+			simulated.update(0.25)
+		# The particles keep their birth state
+		p = list(analytic)[0]
+		self.assertTuple(p.position, (1, 0, 0))
+		self.assertAlmostEqual(p.age, 0.5)
+		expected = list(simulated)[0]
+		evaluated = list(analytic.snapshot)
+		self.assertEqual(len(evaluated), 1)
+		p = evaluated[0]
+		self.assertTuple(p.position, expected.position)
+		self.assertTuple(p.position, (1.5, 1, 0))
+		self.assertTuple(p.last_position, (1.25, 0.5, 0))
+		self.assertTuple(p.size, expected.size)
+		self.assertTuple(p.color, expected.color)
+		self.assertAlmostEqual(p.color.a, 0.25, 5)
+		self.assertTuple(analytic.snapshot.aabb[0], (1.5, 1, 0))
+		for i in range(6):
+			analytic.update(0.25)
+		self.assertEqual(len(analytic), 1)
+		analytic.update(0.25)
+		self.assertEqual(len(analytic), 0)
+
+	def test_analytic_gravity(self):
+		from lepton import ParticleGroup, controller
+		group = ParticleGroup(controllers=[controller.Gravity((0, -2, 0)), 
+			controller.Movement()], analytic=True)
+		group.new(velocity=(0, 3, 0), age=1.0)
+		for i in range(4):
+			group.update(0.5)
+		p = list(group.snapshot)[0]
+		# Two time units since birth
+		self.assertTuple(p.position, (0, 3 * 2 - 2 * 2, 0))
+		self.assertTuple(p.velocity, (0, 3 - 2 * 2, 0))
+
+	def test_analytic_color_blender(self):
+		from lepton import ParticleGroup, controller
+		blender = controller.ColorBlender([(0, (1, 0, 0, 1)), (1, (0, 0, 1, 1))], 
+			resolution=10)
+		analytic = ParticleGroup(controllers=[blender], analytic=True)
+		simulated = ParticleGroup(controllers=[blender])
+		for group in analytic, simulated:
+			group.new(color=(0, 1, 0, 1))
+			for i in range(5):
+				group.update(0.1)
+		self.assertTuple(list(analytic.snapshot)[0].color, 
+			list(simulated)[0].color)
+
+	def test_analytic_rejects_controllers(self):
+		from lepton import ParticleGroup, Particle, controller, emitter
+		group = ParticleGroup(analytic=True)
+		self.assertRaises(TypeError, group.bind_controller, TestController())
+		self.assertRaises(TypeError, group.bind_controller, controller.Drag(0.1, 0.1))
+		self.assertRaises(ValueError, group.bind_controller, 
+			controller.Movement(damping=0.5))
+		self.assertRaises(ValueError, group.bind_controller, 
+			controller.Growth(1, damping=0.5))
+		self.assertRaises(ValueError, group.bind_controller, 
+			controller.Movement(), controller.Movement())
+		self.failIf(group.controllers)
+		self.assertRaises(TypeError, ParticleGroup, 
+			controllers=[controller.Drag(0.1, 0.1)], analytic=True)
+		# Emitters add particles as usual
+		emit = emitter.StaticEmitter(rate=10, template=Particle())
+		group.bind_controller(emit)
+		group.update(1.0)
+		self.assertEqual(group.new_count(), 10)
+		group.unbind_controller(emit)
+		self.failIf(group.controllers)
+
+	def test_interpolation(self):
+		from lepton import ParticleGroup
+		group = ParticleGroup()
+		self.assertEqual(group.interpolation, 1.0)
+		group.interpolation = 0.25
+		self.assertEqual(group.interpolation, 0.25)
+		self.assertRaises(ValueError, setattr, group, 'interpolation', 1.5)
+		self.assertRaises(ValueError, setattr, group, 'interpolation', -0.1)
+		self.assertEqual(group.interpolation, 0.25)
+
+	def test_double_buffer(self):
+		from lepton import ParticleGroup
+		group = ParticleGroup()
+		self.failIf(group.double_buffer)
+		self.failUnless(group.snapshot is group)
+		group.new(position=(1, 2, 3))
+		group.double_buffer = True
+		self.failUnless(group.double_buffer)
+		self.assertEqual(len(group.snapshot), 0)
+		group.update(0)
+		snapshot = group.snapshot
+		self.failIf(snapshot is group)
+		self.assertEqual(len(snapshot), 1)
+		self.assertTuple(list(snapshot)[0].position, (1, 2, 3))
+		self.assertEqual(snapshot.aabb, group.aabb)
+		# Changes are not visible until published by the next update
+		list(group)[0].position = (4, 5, 6)
+		group.new(position=(7, 8, 9))
+		self.assertTuple(list(group.snapshot)[0].position, (1, 2, 3))
+		group.update(0)
+		self.failIf(group.snapshot is snapshot)
+		self.assertEqual(len(group.snapshot), 2)
+		self.assertEqual(sorted(tuple(p.position) for p in group.snapshot),
+			[(4, 5, 6), (7, 8, 9)])
+		snapshot = group.snapshot
+		self.assertRaises(TypeError, snapshot.update, 0)
+		self.assertRaises(TypeError, snapshot.new, position=(0, 0, 0))
+		self.assertRaises(TypeError, snapshot.kill, list(snapshot)[0])
+		self.assertRaises(TypeError, setattr, list(snapshot)[0], 'position', (0, 0, 0))
+		self.assertRaises(TypeError, snapshot.bind_controller, lambda td, g: None)
+		self.assertRaises(TypeError, setattr, snapshot, 'double_buffer', True)
+		self.assertEqual(len(snapshot), 2)
+		group.double_buffer = False
+		self.failUnless(group.snapshot is group)
+		group = ParticleGroup(double_buffer=True)
+		self.failUnless(group.double_buffer)
+
+	def test_begin_draw_fence(self):
+		import threading, time
+		from lepton import ParticleGroup
+		group = ParticleGroup()
+		self.failUnless(group.begin_draw() is group)
+		group.end_draw()
+		self.assertRaises(ValueError, group.end_draw)
+		group.double_buffer = True
+		group.new(position=(1, 2, 3))
+		group.update(0)
+		drawn = group.begin_draw()
+		self.failUnless(drawn is group.snapshot)
+		# The next update publishes to the other snapshot, the one after
+		# that waits for the draw to finish
+		group.update(0)
+		updated = threading.Event()
+		def update():
+			group.update(0)
+			updated.set()
+		thread = threading.Thread(target=update)
+		thread.start()
+		time.sleep(0.05)
+		self.failIf(updated.isSet())
+		self.assertTuple(list(drawn)[0].position, (1, 2, 3))
+		drawn.end_draw()
+		thread.join(5)
+		self.failUnless(updated.isSet())
+
+	def test_analytic_nested_draw(self):
+		from lepton import ParticleGroup, controller
+		group = ParticleGroup(controllers=[controller.Movement()], analytic=True)
+		group.new(velocity=(1, 0, 0))
+		group.update(0)
+		group.update(1)
+		drawn = group.begin_draw()
+		# Drawing or evaluating again while drawn does not wait for the
+		# draw, the current evaluation is shared
+		again = group.begin_draw()
+		self.failUnless(again is drawn)
+		self.failUnless(group.snapshot is drawn)
+		again.end_draw()
+		# Once stale, the state is evaluated into another group, the draw
+		# keeps its particles
+		group.update(1)
+		current = group.begin_draw()
+		self.failIf(current is drawn)
+		self.assertTuple(list(drawn)[0].position, (1, 0, 0))
+		self.assertTuple(list(current)[0].position, (2, 0, 0))
+		self.failUnless(group.snapshot is current)
+		drawn.end_draw()
+		current.end_draw()
+		group.update(1)
+		self.assertTuple(list(group.snapshot)[0].position, (3, 0, 0))
+
+	def test_analytic_draw_while_evaluating(self):
+		import threading
+		from lepton import ParticleGroup, controller
+		group = ParticleGroup(controllers=[controller.Movement()], analytic=True)
+		for i in range(20000):
+			group.new(velocity=(1, 0, 0))
+		group.update(0)
+		group.update(1)
+		errors = []
+		def draw():
+			try:
+				for i in range(20):
+					drawn = group.begin_draw()
+					try:
+						for p in list(drawn)[:10]:
+							self.assertTuple(p.position, (1, 0, 0))
+					finally:
+						drawn.end_draw()
+			except Exception, e:
+				errors.append(e)
+		threads = [threading.Thread(target=draw) for i in range(3)]
+		for thread in threads:
+			thread.start()
+		for thread in threads:
+			thread.join(10)
+			self.failIf(thread.isAlive())
+		self.assertEqual(errors, [])
+
+	def test_position_history(self):
+		from lepton import ParticleGroup, controller
+		group = ParticleGroup(controllers=[controller.Movement()], history=3)
+		self.assertEqual(group.history, 3)
+		group.new(position=(0, 0, 0), velocity=(1, 0, 0))
+		group.update(1)
+		p = list(group)[0]
+		self.assertEqual(group.position_history(p), 
+			((1, 0, 0), (0, 0, 0), (0, 0, 0)))
+		group.update(1)
+		group.update(1)
+		p = list(group)[0]
+		self.assertEqual(group.position_history(p), 
+			((3, 0, 0), (2, 0, 0), (1, 0, 0)))
+		self.assertRaises(ValueError, group.position_history, 
+			group.new(position=(0, 0, 0)))
+		self.assertRaises(TypeError, group.position_history, None)
+
+	def test_position_history_follows_particles(self):
+		from lepton import ParticleGroup, controller
+		group = ParticleGroup(controllers=[controller.Movement()], history=4)
+		group.new(position=(0, 0, 0), velocity=(1, 0, 0))
+		group.new(position=(0, 0, 0), velocity=(0, 1, 0))
+		group.update(1)
+		group.update(1)
+		# The new particle is moved into the killed particle's slot
+		group.kill([p for p in group if p.velocity.x][0])
+		group.new(position=(0, 0, 5), velocity=(0, 0, 1))
+		group.update(1)
+		self.assertEqual(len(group), 2)
+		for p in group:
+			history = group.position_history(p)
+			self.assertEqual(history[0], tuple(p.position))
+			if p.velocity.y:
+				self.assertEqual(history, 
+					((0, 3, 0), (0, 2, 0), (0, 1, 0), (0, 0, 0)))
+			else:
+				self.assertEqual(history, 
+					((0, 0, 6), (0, 0, 5), (0, 0, 5), (0, 0, 5)))
+
+	def test_set_history(self):
+		from lepton import ParticleGroup
+		group = ParticleGroup()
+		self.assertEqual(group.history, 0)
+		group.new(position=(1, 2, 3))
+		group.update(0)
+		p = list(group)[0]
+		self.assertEqual(group.position_history(p), ())
+		group.history = 2
+		self.assertEqual(group.position_history(p), ((1, 2, 3), (1, 2, 3)))
+		for length in (-1, 1, 65):
+			self.assertRaises(ValueError, setattr, group, 'history', length)
+		self.assertEqual(group.history, 2)
+		group.history = 0
+		self.assertEqual(group.history, 0)
+		self.assertRaises(ValueError, ParticleGroup, history=1)
+		self.assertRaises(ValueError, ParticleGroup, analytic=True, history=2)
+		group = ParticleGroup(analytic=True)
+		self.assertRaises(ValueError, setattr, group, 'history', 2)
+
+	def test_double_buffer_history(self):
+		from lepton import ParticleGroup
+		group = ParticleGroup(double_buffer=True, history=2)
+		group.new(position=(1, 2, 3))
+		group.update(0)
+		list(group)[0].position = (4, 5, 6)
+		group.update(0)
+		snapshot = group.snapshot
+		self.assertEqual(snapshot.history, 2)
+		self.assertEqual(snapshot.position_history(list(snapshot)[0]),
+			((4, 5, 6), (1, 2, 3)))
+		self.assertRaises(TypeError, setattr, snapshot, 'history', 4)
+
 
 if __name__=='__main__':
 	unittest.main()
@@ -0,0 +1,337 @@
+#############################################################################
+#
+# Copyright (c) 2009 by Casey Duncan and contributors
+# All Rights Reserved.
+#
+# This software is subject to the provisions of the MIT License
+# A copy of the license should accompany this distribution.
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+#
+#############################################################################
+
+# $Id$
+
+import unittest
+import sys
+import ctypes
+
+try:
+	import pyglet
+	from pyglet.gl import *
+except ImportError:
+	import warnings
+	warnings.warn("Pyglet not installed, some renderer tests disabled")
+	pyglet = None
+
+IDENTITY = (1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1)
+# glOrtho(-2, 2, -2, 2, 0, 10), the visible eye-space box is x and y 
+# from -2 to 2, z from -10 to 0
+ORTHO = (0.5,0,0,0, 0,0.5,0,0, 0,0,-0.2,0, 0,0,-1,1)
+
+
+class DrawGroupsTest(unittest.TestCase):
+
+	def test_native_batches(self):
+		from lepton import ParticleGroup
+		from lepton.renderer import PointRenderer, BillboardRenderer, _batches
+		from lepton.texturizer import SpriteTexturizer
+		tex1 = SpriteTexturizer(0)
+		tex2 = SpriteTexturizer(0)
+		class PyRenderer:
+			def draw(self, group):
+				pass
+		groups = [
+			ParticleGroup(renderer=BillboardRenderer(tex1)),
+			ParticleGroup(renderer=PointRenderer(2)),
+			ParticleGroup(renderer=PyRenderer()),
+			ParticleGroup(renderer=BillboardRenderer(tex1)),
+			ParticleGroup(renderer=BillboardRenderer(tex2)),
+			ParticleGroup(renderer=PointRenderer(2)),
+			ParticleGroup(renderer=PointRenderer(3)),
+			ParticleGroup(),
+			ParticleGroup(renderer=BillboardRenderer()),
+			ParticleGroup(renderer=BillboardRenderer()),
+		]
+		g = groups
+		# Same renderer type and texturizer (and point size) share a batch
+		# drawn where its first group is, groups without renderers are not
+		# drawn
+		self.assertEqual(_batches(groups), [
+			(g[0], g[3]), (g[1], g[5]), (g[2],), (g[4],), (g[6],), (g[8], g[9])])
+		self.assertEqual(_batches([]), [])
+		self.assertRaises(TypeError, _batches, None)
+
+
+class MeshRendererTest(unittest.TestCase):
+
+	vertices = [(0,0,0), (1,0,0), (0,1,0), (0,0,1)]
+	indices = [0,1,2, 0,2,3]
+
+	def test_init(self):
+		from lepton.renderer import MeshRenderer
+		from lepton.texturizer import SpriteTexturizer
+		tex = SpriteTexturizer(0)
+		mesh = MeshRenderer(self.vertices, self.indices, 
+			tex_coords=[(0,0), (1,0), (0,1), (1,1)], texturizer=tex, cull=True)
+		self.assertEqual(mesh.vertex_count, 4)
+		self.assertEqual(mesh.index_count, 6)
+		self.failUnless(mesh.texturizer is tex)
+		self.failUnless(mesh.cull)
+		refs = sys.getrefcount(tex)
+		for i in range(10):
+			self.assertRaises(TypeError, 
+				mesh.__init__, self.vertices, self.indices, texturizer=tex)
+		self.assertEqual(sys.getrefcount(tex), refs)
+		self.failUnless(mesh.texturizer is tex)
+		self.assertEqual(mesh.vertex_count, 4)
+
+	def test_invalid_mesh(self):
+		from lepton.renderer import MeshRenderer
+		self.assertRaises(ValueError, MeshRenderer, [], [0, 0, 0])
+		self.assertRaises(ValueError, MeshRenderer, self.vertices, [])
+		self.assertRaises(ValueError, MeshRenderer, self.vertices, [0, 1])
+		self.assertRaises(IndexError, MeshRenderer, self.vertices, [0, 1, 4])
+		self.assertRaises(IndexError, MeshRenderer, self.vertices, [0, -1, 2])
+		self.assertRaises(ValueError, MeshRenderer, self.vertices, self.indices,
+			tex_coords=[(0, 0)])
+		self.assertRaises(TypeError, MeshRenderer, self.vertices, self.indices,
+			tex_coords=[(0, 0, 0)] * 4)
+		self.assertRaises(TypeError, MeshRenderer, [(0, 0)], [0, 0, 0])
+
+	def test_init_after_failure(self):
+		from lepton.renderer import MeshRenderer
+		mesh = MeshRenderer.__new__(MeshRenderer)
+		self.assertRaises(IndexError, mesh.__init__, self.vertices, [0, 1, 9])
+		self.assertEqual(mesh.vertex_count, 0)
+		mesh.__init__(self.vertices, self.indices)
+		self.assertEqual(mesh.vertex_count, 4)
+		self.assertEqual(mesh.index_count, 6)
+
+
+class DrawListTest(unittest.TestCase):
+
+	def _make_group(self, positions, size=0):
+		from lepton import Particle, ParticleGroup
+		group = ParticleGroup()
+		for position in positions:
+			group.new(Particle(position=position, size=(size, size, size)))
+		group.update(0)
+		return group
+
+	def test_cull_points(self):
+		from lepton.renderer import PointRenderer, _draw_list
+		group = self._make_group([(x * 1.5, 0, -5) for x in range(-3, 4)]
+			+ [(0, 0, 5), (0, 0, -20), (0, 3, -5)])
+		renderer = PointRenderer(1, cull=True)
+		self.assertEqual(_draw_list(renderer, group, IDENTITY, ORTHO), [2, 3, 4])
+		# The frustum moves with the model-view
+		translated = IDENTITY[:12] + (3, 0, 0, 1)
+		self.assertEqual(_draw_list(renderer, group, translated, ORTHO), 
+			[0, 1, 2])
+		# Groups entirely outside are rejected by their bounds
+		self.assertEqual(_draw_list(renderer, 
+			self._make_group([(5, 5, -5), (6, 5, -5)]), IDENTITY, ORTHO), [])
+		# Without culling all live particles are drawn
+		self.assertEqual(_draw_list(PointRenderer(1), group, IDENTITY, ORTHO), 
+			range(10))
+
+	def test_cull_billboards(self):
+		from lepton.renderer import BillboardRenderer, _draw_list
+		group = self._make_group([(2.3, 0, -5), (2.9, 0, -5), (0, -2.5, -5)], 
+			size=1)
+		# Quads reach half their diagonal from the particle position
+		self.assertEqual(_draw_list(BillboardRenderer(cull=True), group, 
+			IDENTITY, ORTHO), [0, 2])
+
+	def test_cull_interpolated(self):
+		from lepton import ParticleGroup, controller
+		from lepton.renderer import PointRenderer, _draw_list
+		group = ParticleGroup(controllers=[controller.Movement()])
+		group.new(position=(1, 0, -5), velocity=(4, 0, 0))
+		group.update(0)
+		group.update(1)
+		renderer = PointRenderer(1, cull=True)
+		self.assertEqual(_draw_list(renderer, group, IDENTITY, ORTHO), [])
+		# Drawn a fifth of the way from its last position, in view
+		group.interpolation = 0.2
+		self.assertEqual(_draw_list(renderer, group, IDENTITY, ORTHO), [0])
+
+	def test_sort(self):
+		from lepton.renderer import BillboardRenderer, PointRenderer, _draw_list
+		group = self._make_group([(0, 0, -3), (1, 0, -8), (0, 1, -1), (0, 0, -5)])
+		for renderer in BillboardRenderer(sort=True), PointRenderer(1, sort=True):
+			# Farthest from the viewer first
+			self.assertEqual(_draw_list(renderer, group, IDENTITY, ORTHO), 
+				[1, 3, 0, 2])
+			# Sorted again by the new view, starting from the last order
+			turned = (-1,0,0,0, 0,1,0,0, 0,0,-1,0, 0,0,0,1)
+			self.assertEqual(_draw_list(renderer, group, turned, ORTHO), 
+				[2, 0, 3, 1])
+			self.assertEqual(_draw_list(renderer, group, IDENTITY, ORTHO), 
+				[1, 3, 0, 2])
+
+	def test_sort_culled(self):
+		from lepton.renderer import BillboardRenderer, _draw_list
+		group = self._make_group([(0, 0, -3), (5, 0, -8), (0, 1, -1), 
+			(0, 0, -5), (0, 0, -9)])
+		renderer = BillboardRenderer(cull=True, sort=True)
+		self.assertEqual(_draw_list(renderer, group, IDENTITY, ORTHO), 
+			[4, 3, 0, 2])
+
+	def test_sort_interpolated(self):
+		from lepton import ParticleGroup, controller
+		from lepton.renderer import BillboardRenderer, _draw_list
+		group = ParticleGroup(controllers=[controller.Movement()])
+		group.new(position=(0, 0, -2), velocity=(0, 0, -4))
+		group.new(position=(0, 0, -4))
+		group.update(0)
+		group.update(1)
+		renderer = BillboardRenderer(sort=True)
+		self.assertEqual(_draw_list(renderer, group, IDENTITY, ORTHO), [0, 1])
+		group.interpolation = 0.25
+		self.assertEqual(_draw_list(renderer, group, IDENTITY, ORTHO), [1, 0])
+
+	def test_sort_many(self):
+		import random
+		from lepton.renderer import BillboardRenderer, _draw_list
+		rand = random.Random(42)
+		depths = [-rand.uniform(0, 10) for i in range(30000)]
+		group = self._make_group([(0, 0, z) for z in depths])
+		renderer = BillboardRenderer(sort=True)
+		# The radix sort orders by 16 bit depth keys
+		tolerance = 10.0 / 65535 * 2
+		for view in IDENTITY, (-1,0,0,0, 0,1,0,0, 0,0,-1,0, 0,0,0,1):
+			order = _draw_list(renderer, group, view, ORTHO)
+			self.assertEqual(sorted(order), range(len(depths)))
+			eye = [depths[i] * view[10] for i in order]
+			for i in range(1, len(eye)):
+				self.failUnless(eye[i] >= eye[i - 1] - tolerance, 
+					(i, eye[i - 1], eye[i]))
+
+	def test_invalid(self):
+		from lepton.renderer import PointRenderer, MeshRenderer, _draw_list
+		group = self._make_group([(0, 0, 0)])
+		self.assertRaises(TypeError, _draw_list, 
+			MeshRenderer([(0,0,0)], [0,0,0]), group, IDENTITY, ORTHO)
+		self.assertRaises(TypeError, 
+			_draw_list, PointRenderer(1), None, IDENTITY, ORTHO)
+		self.assertRaises(ValueError, 
+			_draw_list, PointRenderer(1), group, IDENTITY[:15], ORTHO)
+		self.assertRaises(TypeError, 
+			_draw_list, PointRenderer(1), group, IDENTITY, None)
+
+
+class RendererTest(unittest.TestCase):
+
+	def _make_group(self, pcount, **kw):
+		from lepton import Particle, ParticleGroup
+		group = ParticleGroup(**kw)
+		for i in range(pcount):
+			group.new(Particle(position=(i, 0, 0), size=(1, 1, 1)))
+		group.update(0)
+		return group
+
+	def test_draw_multiview_invalid(self):
+		from lepton.renderer import BillboardRenderer
+		renderer = BillboardRenderer()
+		group = self._make_group(2)
+		self.assertRaises(TypeError, renderer.draw_multiview, None, [IDENTITY])
+		self.assertRaises(TypeError, renderer.draw_multiview, group, None)
+		self.assertRaises(TypeError, 
+			renderer.draw_multiview, group, [IDENTITY], begin_view=1)
+		self.assertRaises(ValueError, renderer.draw_multiview, group, [])
+		self.assertRaises(ValueError, 
+			renderer.draw_multiview, group, [IDENTITY] * 9)
+		self.assertRaises(ValueError, 
+			renderer.draw_multiview, group, [IDENTITY[:15]])
+		self.assertRaises(ValueError, 
+			renderer.draw_multiview, group, [IDENTITY, IDENTITY + (0,)])
+		self.assertRaises(TypeError, renderer.draw_multiview, group, [1])
+		self.assertRaises(TypeError, 
+			renderer.draw_multiview, group, [('x',) * 16])
+
+	def test_ribbon_requires_history(self):
+		from lepton.renderer import RibbonRenderer
+		renderer = RibbonRenderer()
+		self.assertRaises(TypeError, renderer.draw, None)
+		group = self._make_group(2)
+		self.assertRaises(ValueError, renderer.draw, group)
+		group = self._make_group(2, double_buffer=True)
+		self.assertRaises(ValueError, renderer.draw, group)
+		# The failed draws do not leave the snapshot held
+		group.update(0)
+		group.update(0)
+
+	def test_gl_state_stats(self):
+		from lepton import renderer
+		renderer.reset_gl_state_stats()
+		self.assertEqual(renderer.gl_state_stats(), {'issued': 0, 'skipped': 0})
+
+	if pyglet is not None:
+		def _texture(self):
+			texture = (ctypes.c_ulong * 1)()
+			glGenTextures(1, texture)
+			return texture[0]
+
+		def test_draw(self):
+			from lepton.renderer import PointRenderer, BillboardRenderer
+			from lepton.texturizer import SpriteTexturizer
+			tex = SpriteTexturizer(self._texture())
+			for renderer in (PointRenderer(2), PointRenderer(2, tex),
+				BillboardRenderer(), BillboardRenderer(tex, cull=True, sort=True)):
+				group = self._make_group(10, double_buffer=True)
+				renderer.draw(group)
+				renderer.draw(self._make_group(0))
+				# The drawn snapshot is released
+				group.update(0)
+				group.update(0)
+
+		def test_draw_multiview(self):
+			from lepton.renderer import BillboardRenderer
+			renderer = BillboardRenderer()
+			views = []
+			self.assertEqual(renderer.draw_multiview(self._make_group(10), 
+				[IDENTITY, IDENTITY], begin_view=views.append), 2)
+			self.assertEqual(views, [0, 1])
+			self.assertEqual(
+				renderer.draw_multiview(self._make_group(0), [IDENTITY]), 0)
+
+		def test_ribbon_draw(self):
+			from lepton.renderer import RibbonRenderer
+			group = self._make_group(10, history=4)
+			RibbonRenderer().draw(group)
+			RibbonRenderer(fade=True, taper=True).draw(group)
+
+		def test_mesh_draw(self):
+			from lepton.renderer import MeshRenderer
+			mesh = MeshRenderer([(0,0,0), (1,0,0), (0,1,0)], [0, 1, 2], 
+				cull=True)
+			mesh.draw(self._make_group(10))
+			mesh.draw(self._make_group(0))
+
+		def test_gl_state_stats_batch(self):
+			from lepton import renderer
+			from lepton.renderer import BillboardRenderer
+			from lepton.texturizer import SpriteTexturizer
+			tex = SpriteTexturizer(self._texture())
+			group = self._make_group(10, renderer=BillboardRenderer(tex))
+			renderer.reset_gl_state_stats()
+			renderer.begin_batch()
+			try:
+				group.draw()
+				group.draw()
+			finally:
+				renderer.end_batch()
+			stats = renderer.gl_state_stats()
+			self.failUnless(stats['issued'] > 0, stats)
+			# The second draw's texturizer state is already set
+			self.failUnless(stats['skipped'] > 0, stats)
+			renderer.reset_gl_state_stats()
+			self.assertEqual(renderer.gl_state_stats(), 
+				{'issued': 0, 'skipped': 0})
+
+
+if __name__ == '__main__':
+	unittest.main()
@@ -22,6 +22,7 @@ from group_test import *
 from system_test import *
 from domain_test import *
 from texturizer_test import *
+from renderer_test import *
 
 if __name__ == '__main__':
 	unittest.main()
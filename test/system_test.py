@@ -37,6 +37,15 @@ class TestGroup:
 		self.drawn = True
 
 
+class TestRenderer:
+
+	def __init__(self):
+		self.drawn = []
+	
+	def draw(self, group):
+		self.drawn.append(group)
+
+
 class TestController:
 
 	def __init__(self):
@@ -124,6 +133,49 @@ class SystemTest(unittest.TestCase):
 		self.failIf(group1.drawn)
 		self.failIf(group2.drawn)
 
+	def test_fixed_step(self):
+		from lepton import ParticleSystem, ParticleGroup
+		system = ParticleSystem(fixed_step=0.1, max_steps=3)
+		group1 = TestGroup()
+		group2 = ParticleGroup(system=system)
+		system.add_group(group1)
+		system.update(0.05)
+		self.assertEqual(group1.updated, 0)
+		self.assertAlmostEqual(group2.interpolation, 0.5, 5)
+		system.update(0.17)
+		self.assertEqual(group1.updated, 2)
+		self.assertAlmostEqual(group1.time_delta, 0.1)
+		self.assertAlmostEqual(group2.interpolation, 0.2, 5)
+		# Time beyond max_steps is dropped
+		system.update(1.0)
+		self.assertEqual(group1.updated, 5)
+		self.assertAlmostEqual(group2.interpolation, 0.0)
+		system.run_ahead(1, 20)
+		self.assertEqual(group1.updated, 15)
+
+	def test_fixed_step_async_interpolation(self):
+		from lepton import ParticleSystem, ParticleGroup
+		system = ParticleSystem(fixed_step=0.1)
+		drawn_interpolation = []
+		def controller(td, group):
+			# What a draw during the update would use
+			drawn_interpolation.append(group.snapshot.interpolation)
+		group = ParticleGroup(controllers=[controller], system=system, 
+			double_buffer=True)
+		system.update(0.05)
+		self.assertEqual(drawn_interpolation, [])
+		self.assertAlmostEqual(group.interpolation, 0.5, 5)
+		self.assertAlmostEqual(group.snapshot.interpolation, 0.5, 5)
+		system.update_async(0.17)
+		system.wait()
+		# The new interpolation is only published with the last step
+		self.assertEqual(len(drawn_interpolation), 2)
+		for interpolation in drawn_interpolation:
+			self.assertAlmostEqual(interpolation, 0.5, 5)
+		self.assertAlmostEqual(group.interpolation, 0.2, 5)
+		self.assertAlmostEqual(group.snapshot.interpolation, 0.2, 5)
+		self.assertRaises(ValueError, group.update, 0.1, 2.0)
+
 	def test_draw(self):
 		from lepton import ParticleSystem
 		system = ParticleSystem()
@@ -136,6 +188,50 @@ class SystemTest(unittest.TestCase):
 		system.draw()
 		self.failUnless(group1.drawn)
 		self.failUnless(group2.drawn)
+		self.assertEqual(system.draw_count, 2)
+
+	def test_batch_draw(self):
+		from lepton import ParticleSystem, ParticleGroup
+		system = ParticleSystem(batch_draw=True)
+		group1 = TestGroup()
+		group2 = ParticleGroup(renderer=TestRenderer())
+		group3 = ParticleGroup()
+		for group in (group1, group2, group3):
+			system.add_group(group)
+		system.draw()
+		self.failUnless(group1.drawn)
+		self.assertEqual(group2.renderer.drawn, [group2])
+		self.assertEqual(system.draw_count, 2)
+
+	def test_update_async(self):
+		from lepton import ParticleSystem, ParticleGroup
+		system = ParticleSystem()
+		controller = TestController()
+		group1 = ParticleGroup(controllers=[controller], system=system, 
+			double_buffer=True)
+		group2 = ParticleGroup(controllers=[controller], system=system, 
+			double_buffer=True)
+		group1.new(position=(1, 0, 0))
+		system.update_async(0.05)
+		# The snapshot is drawn while the update is in progress
+		system.draw()
+		system.wait()
+		self.assertEqual(controller.groups, set([group1, group2]))
+		self.assertAlmostEqual(controller.time_delta, 0.05)
+		self.assertEqual(len(group1.snapshot), 1)
+		system.wait() # No update in progress
+		ParticleGroup(system=system)
+		self.assertRaises(ValueError, system.update_async, 0.05)
+
+	def test_update_async_error(self):
+		from lepton import ParticleSystem, ParticleGroup
+		def fail(td, group):
+			raise RuntimeError("fail")
+		system = ParticleSystem()
+		ParticleGroup(controllers=[fail], system=system, double_buffer=True)
+		system.update_async(0.05)
+		self.assertRaises(RuntimeError, system.wait)
+		system.wait()
 
 
 if __name__=='__main__':
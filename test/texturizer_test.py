@@ -196,6 +196,52 @@ class SpriteTexturizerTest(TexTestBase, unittest.TestCase):
 		for p, b in zip(group, expected):
 			self.assertVector(p.size, b)
 
+	def test_many_coord_set_weights(self):
+		from lepton.texturizer import SpriteTexturizer
+		weights = [1, 8, 2, 0.5, 4, 0.5, 16, 1]
+		coord_sets = tuple((0,0, i,0, i,1, 0,1) for i in range(1, len(weights) + 1))
+		tex = SpriteTexturizer(0, coords=coord_sets, weights=weights)
+		total = float(sum(weights))
+		for w, expected in zip(tex.weights, weights):
+			self.assertAlmostEqual(w, expected / total, 6)
+		group = self._make_group(4000)
+		coords = tuple(tex.generate_tex_coords(group))
+		counts = dict((cs, 0) for cs in tex.tex_coords)
+		for i in range(4000):
+			counts[coords[i*8:i*8+8]] += 1
+		for cs, w in zip(tex.tex_coords, weights):
+			expected = 4000 * w / total
+			self.failUnless(abs(counts[cs] - expected) < expected * 0.3 + 15, 
+				(counts[cs], expected))
+	
+	def test_weighted_aspect_adjust(self):
+		from lepton.texturizer import SpriteTexturizer
+		coord_set1 = (0,0, 1,0, 1,0.5, 0,0.5)
+		coord_set2 = (0,0.5, 0.25,0.5, 0.25,1, 0,1)
+		tex = SpriteTexturizer(0, coords=(coord_set1, coord_set2), weights=(1, 3),
+			aspect_adjust_width=True)
+		group = self._make_group(50)
+		for p in group:
+			p.size = (1, 2, 0)
+		coords = tuple(tex.generate_tex_coords(group))
+		for i, p in enumerate(group):
+			cset = coords[i*8:i*8+8]
+			if cset == coord_set1:
+				self.assertVector(p.size, (4, 2, 0))
+			else:
+				self.assertEqual(cset, coord_set2)
+				self.assertVector(p.size, (1, 2, 0))
+
+	def test_default_coords_aspect_adjust(self):
+		from lepton.texturizer import SpriteTexturizer
+		tex = SpriteTexturizer(0, aspect_adjust_height=True)
+		group = self._make_group(3)
+		for p in group:
+			p.size = (3, 1, 0)
+		tex.generate_tex_coords(group)
+		for p in group:
+			self.assertVector(p.size, (3, 3, 0))
+
 	def test_invalid_args(self):
 		from lepton.texturizer import SpriteTexturizer
 		self.assertRaises(TypeError, SpriteTexturizer, 0, object())
@@ -572,6 +618,78 @@ class FlipBookTexturizerTest(TexTestBase, unittest.TestCase):
 				i += 12
 			group.update(0.17)
 
+	def test_uneven_duration_list(self):
+		from lepton.texturizer import FlipBookTexturizer
+		durations = [0.01, 0.5, 0.03, 0.2, 0.0, 0.07, 1.3, 0.02, 0.4, 0.11]
+		coord_sets = [(0,0,i, 1,0,i, 1,1,i, 0,1,i) for i in range(len(durations))]
+		times = []
+		t = 0
+		for d in durations:
+			t += d
+			times.append(t)
+		for loop in (True, False):
+			fbtex = FlipBookTexturizer(0,
+				coords=coord_sets,
+				duration=durations,
+				dimension=3,
+				loop=loop,
+				)
+			group = self._make_group(50)
+			age = 0.0
+			for p in group:
+				p.age = age
+				age += 0.093
+			coords = tuple(fbtex.generate_tex_coords(group))
+			i = 0
+			for p in group:
+				age = p.age
+				if loop:
+					age = age % times[-1]
+				c = 0
+				while c < len(times) - 1 and age > times[c]:
+					c += 1
+				self.assertEqual(coords[i:i+12], coord_sets[c], "loop=%s c=%s age=%s: %s != %s" % 
+					(loop, c, age, coords[i:i+12], coord_sets[c]))
+				i += 12
+
+	def test_blend(self):
+		from lepton.texturizer import FlipBookTexturizer
+		coord_sets = [
+			(0,0,0, 1,0,0, 1,1,0, 0,1,0),
+			(0,0,0.5, 1,0,0.5, 1,1,0.5, 0,1,0.5),
+			(0,0,1, 1,0,1, 1,1,1, 0,1,1),
+			]
+		fbtex = FlipBookTexturizer(0,
+			coords=coord_sets,
+			duration=[0.5, 1.0, 0.5],
+			dimension=3,
+			loop=False,
+			blend=True,
+			)
+		self.failUnless(fbtex.blend)
+		group = self._make_group(4)
+		for p, age in zip(group, [0.0, 0.25, 1.0, 5.0]):
+			p.age = age
+		coords = tuple(fbtex.generate_tex_coords(group))
+		# r coordinate of each particle's first vertex
+		for i, expected in enumerate([0.0, 0.25, 0.5 + 0.25, 1.0]):
+			self.assertAlmostEqual(coords[i * 12 + 2], expected, 5)
+			self.assertAlmostEqual(coords[i * 12 + 3], 1.0, 5)
+		# Looping does not blend the last frame back through the others
+		fbtex = FlipBookTexturizer(0,
+			coords=coord_sets,
+			duration=[0.5, 1.0, 0.5],
+			dimension=3,
+			blend=True,
+			)
+		for p, age in zip(group, [1.6, 1.8, 1.95, 2.25]):
+			p.age = age
+		coords = tuple(fbtex.generate_tex_coords(group))
+		for i, expected in enumerate([1.0, 1.0, 1.0, 0.25]):
+			self.assertAlmostEqual(coords[i * 12 + 2], expected, 5)
+		fbtex = FlipBookTexturizer(0, coords=coord_sets, duration=0.5, dimension=3)
+		self.failIf(fbtex.blend)
+
 	def test_invalid_args(self):
 		from lepton.texturizer import FlipBookTexturizer
 		self.assertRaises(TypeError, FlipBookTexturizer, 0, object(), 1)
@@ -587,6 +705,8 @@ class FlipBookTexturizerTest(TexTestBase, unittest.TestCase):
 			FlipBookTexturizer, 0, [(0,0,0,0,0,0,0,0), (0,0,0,0,0,0,0,0)], [1,1], dimension=0)
 		self.assertRaises(ValueError, 
 			FlipBookTexturizer, 0, [(0,0,0,0,0,0,0,0), (0,0,0,0,0,0,0,0)], [1,1], dimension=4)
+		self.assertRaises(ValueError, 
+			FlipBookTexturizer, 0, [(0,0,0,0,0,0,0,0), (0,0,0,0,0,0,0,0)], [1,1], blend=True)
 
 	if pyglet is not None:
 		def _glGet(self, what):